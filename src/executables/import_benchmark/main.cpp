@@ -0,0 +1,311 @@
+/*******************************************
+ * **** DESCRIPTION ****
+ * Measures CPU side volume import paths on synthetic data, no files or GL context needed.
+ ****************************************/
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <algorithm>
+#include <limits>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fstream>
+
+#include <Core/DebugLog.h>
+#include <Importing/Importer.h>
+#include <Importing/VoxelConversion.h>
+#include <Importing/ddsbase.h>
+#include <Importing/ChunkedPVM.h>
+#include <Core/ThreadPool.h>
+
+////////////////////// PARAMETERS /////////////////////////////
+const unsigned int VOLUME_SIZE_X = 256;
+const unsigned int VOLUME_SIZE_Y = 256;
+const unsigned int VOLUME_SIZE_Z = 256;
+const int NUM_REPETITIONS = 10;
+
+/** @brief run func NUM_REPETITIONS times, return the fastest run in milliseconds */
+double measure(std::function<void()> func)
+{
+	double best = -1.0;
+	for (int i = 0; i < NUM_REPETITIONS; i++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		func();
+		auto end = std::chrono::high_resolution_clock::now();
+		double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		if (best < 0.0 || ms < best) { best = ms; }
+	}
+	return best;
+}
+
+void report(std::string name, double legacyMs, double newMs, bool equal)
+{
+	DEBUGLOG->log(name);
+	DEBUGLOG->indent();
+	DEBUGLOG->log("original  (ms): ", legacyMs);
+	DEBUGLOG->log("optimized (ms): ", newMs);
+	DEBUGLOG->log("speedup       : ", legacyMs / newMs);
+	DEBUGLOG->log("results equal : ", equal);
+	DEBUGLOG->outdent();
+}
+
+/** @brief Importer::load3DData as it was before it was forwarded to load3DDataParallel, kept verbatim for comparison */
+template<class T>
+VolumeData<T> legacyLoad3DData(std::string path, unsigned size_x, unsigned size_y, unsigned int num_files, unsigned int num_bytes_per_entry = 1)
+{
+	VolumeData<T> result;
+	result.size_x = size_x;
+	result.size_y = size_y;
+	result.size_z = num_files;
+	result.data.clear();
+
+	T min = SHRT_MAX;
+	T max = SHRT_MIN;
+
+	for (unsigned int i = 1; i <= num_files; i++)
+	{
+		std::string current_file_path = path + "." + DebugLog::to_string(i);
+
+		std::cout << ".";
+
+		// read file into input vector
+		std::ifstream file( current_file_path.c_str(), std::ifstream::binary);	
+		std::vector<char> input;
+
+		if (file.is_open()) {
+			// get length of file:
+			file.seekg (0, file.end);
+			int length = (int) file.tellg();
+			file.seekg (0, file.beg);
+
+			// allocate memory:
+			input.resize(length);
+
+			// read data as a block:
+			file.read( &input[0], length );
+
+			file.close();
+		}
+
+		// create data vector for this slice
+		std::vector<T> slice(size_x * size_y, 0);
+
+		for(unsigned int j = 0 ; j < slice.size(); j++)
+		{
+			int val = input[num_bytes_per_entry*j];
+			for (unsigned int k = 1; k < num_bytes_per_entry; k++)
+			{
+				val = (val << 8) + input[ num_bytes_per_entry*j + k];
+			}
+    		
+			slice[j] = (T) val;
+
+			min = std::min<T>((T) val, min);
+			max = std::max<T>((T) val, max);
+		}
+
+		// push slice to data vector
+		result.data.insert(result.data.end(), slice.begin(), slice.end());
+	}
+	std::cout << std::endl;
+
+	result.min = min;		
+	result.max = max;
+
+	return result;
+}
+
+/** @brief load the slice stack at path (signed big endian 16 bit input) with the original and the current loader */
+template<class T>
+void benchmarkSliceStack(std::string name, std::string path, const std::vector<unsigned char>& input)
+{
+	const size_t numVoxels = input.size() / 2;
+	std::vector<T> reference(numVoxels);
+	T referenceMin = std::numeric_limits<T>::max(), referenceMax = std::numeric_limits<T>::lowest();
+	for (size_t j = 0; j < numVoxels; j++)
+	{
+		reference[j] = (T) (short) ((input[2 * j] << 8) | input[2 * j + 1]);
+		referenceMin = std::min(referenceMin, reference[j]);
+		referenceMax = std::max(referenceMax, reference[j]);
+	}
+
+	DEBUGLOG->setAutoPrint(false); // the loaders log every call
+	VolumeData<T> legacyVolume, newVolume;
+	double legacyMs = measure([&]() { legacyVolume = legacyLoad3DData<T>(path, VOLUME_SIZE_X, VOLUME_SIZE_Y, VOLUME_SIZE_Z, 2); });
+	double newMs = measure([&]() { newVolume = Importer::load3DData<T>(path, VOLUME_SIZE_X, VOLUME_SIZE_Y, VOLUME_SIZE_Z, 2); });
+	DEBUGLOG->setAutoPrint(true);
+
+	size_t misread = 0;
+	for (size_t j = 0; j < numVoxels; j++) { misread += (legacyVolume.data[j] != reference[j]); }
+	bool equal = newVolume.data.size() == numVoxels && std::equal(reference.begin(), reference.end(), newVolume.data.begin()) && newVolume.min == referenceMin && newVolume.max == referenceMax;
+	report(name, legacyMs, newMs, equal);
+	DEBUGLOG->indent();
+	DEBUGLOG->log("voxels misread by the original (sign extended low byte): " + DebugLog::to_string(misread));
+	DEBUGLOG->outdent();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// MAIN ///////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+	DEBUGLOG->setAutoPrint(true);
+
+	const size_t numVoxels = (size_t) VOLUME_SIZE_X * VOLUME_SIZE_Y * VOLUME_SIZE_Z;
+
+	// big endian 16 bit input, as found in slice stacks and PVM files
+	std::vector<unsigned char> input(2 * numVoxels);
+	std::mt19937 rng(42);
+	for (auto& b : input) { b = (unsigned char) rng(); }
+
+	//++++++++++++++ signed int16 slice stack (Importer::load3DData) ++++++++++++++//
+	{
+		// 12 bit values like CT scans, so low bytes above 127 occur
+		std::string stackPath = "import_benchmark_stack";
+		const size_t sliceVoxels = (size_t) VOLUME_SIZE_X * VOLUME_SIZE_Y;
+		std::vector<unsigned char> stackInput(2 * numVoxels);
+		for (size_t i = 0; i < numVoxels; i++)
+		{
+			unsigned int value = rng() % 4096;
+			stackInput[2 * i] = (unsigned char) (value >> 8);
+			stackInput[2 * i + 1] = (unsigned char) (value & 0xFF);
+		}
+		for (unsigned int z = 0; z < VOLUME_SIZE_Z; z++)
+		{
+			std::ofstream slice((stackPath + "." + DebugLog::to_string(z + 1)).c_str(), std::ofstream::binary);
+			slice.write((const char*) &stackInput[2 * z * sliceVoxels], 2 * sliceVoxels);
+		}
+
+		benchmarkSliceStack<float>("int16 big endian slice stack -> float", stackPath, stackInput);
+		benchmarkSliceStack<short>("int16 big endian slice stack -> int16", stackPath, stackInput);
+
+		for (unsigned int z = 0; z < VOLUME_SIZE_Z; z++) { std::remove((stackPath + "." + DebugLog::to_string(z + 1)).c_str()); }
+	}
+
+	std::vector<float> legacyResult(numVoxels);
+	std::vector<float> newResult(numVoxels);
+	float legacyMin, legacyMax, newMin, newMax;
+
+	//++++++++++++++ unsigned int16 (PVM, see Importer::load3DDataPVM) ++++++++++++++//
+	double legacyMs = measure([&]()
+	{
+		legacyMin = (float) SHRT_MAX;
+		legacyMax = (float) SHRT_MIN;
+		for (unsigned int i = 0; i < numVoxels; i++)
+		{
+			int val = input[2 * i];
+			val = (val << 8) + input[2 * i + 1];
+			legacyResult[i] = (float) val;
+		}
+		for (auto v : legacyResult)
+		{
+			legacyMin = std::min<float>(v, legacyMin);
+			legacyMax = std::max<float>(v, legacyMax);
+		}
+	});
+	double newMs = measure([&]()
+	{
+		newMin = std::numeric_limits<float>::max();
+		newMax = std::numeric_limits<float>::lowest();
+		VoxelConversion::convert(&input[0], VoxelConversion::UINT16, true, &newResult[0], numVoxels, newMin, newMax);
+	});
+	report("uint16 big endian -> float", legacyMs, newMs, legacyResult == newResult && legacyMin == newMin && legacyMax == newMax);
+
+	//++++++++++++++ uint8 (PVM) ++++++++++++++//
+	legacyMs = measure([&]()
+	{
+		std::copy(input.begin(), input.begin() + numVoxels, legacyResult.begin());
+		legacyMin = (float) CHAR_MAX;
+		legacyMax = (float) CHAR_MIN;
+		for (auto v : legacyResult)
+		{
+			legacyMin = std::min<float>(v, legacyMin);
+			legacyMax = std::max<float>(v, legacyMax);
+		}
+	});
+	newMs = measure([&]()
+	{
+		newMin = std::numeric_limits<float>::max();
+		newMax = std::numeric_limits<float>::lowest();
+		VoxelConversion::convert(&input[0], VoxelConversion::UINT8, true, &newResult[0], numVoxels, newMin, newMax);
+	});
+	report("uint8 -> float", legacyMs, newMs, legacyResult == newResult && legacyMin == newMin && legacyMax == newMax);
+
+	//++++++++++++++ DDS decoding (readPVMvolume) ++++++++++++++//
+	{
+		// smooth 16 bit data, compresses similar to CT scans
+		std::vector<unsigned char> ddsInput(2 * numVoxels);
+		for (size_t i = 0; i < numVoxels; i++)
+		{
+			unsigned int x = (unsigned int) (i % VOLUME_SIZE_X);
+			unsigned int y = (unsigned int) ((i / VOLUME_SIZE_X) % VOLUME_SIZE_Y);
+			unsigned int z = (unsigned int) (i / ((size_t) VOLUME_SIZE_X * VOLUME_SIZE_Y));
+			unsigned int value = (x * x + y * y + z * z) / 8 + (rng() % 16);
+			ddsInput[2 * i] = (unsigned char) (value >> 8);
+			ddsInput[2 * i + 1] = (unsigned char) (value & 0xFF);
+		}
+		std::string ddsPath = "import_benchmark.dds";
+		writeDDSfile(ddsPath.c_str(), &ddsInput[0], (unsigned int) ddsInput.size(), 2, VOLUME_SIZE_X, TRUE);
+
+		unsigned char* legacyData = nullptr;
+		unsigned char* newData = nullptr;
+		unsigned int legacyBytes = 0;
+		unsigned int newBytes = 0;
+		legacyMs = measure([&]()
+		{
+			free(legacyData);
+			setDDSdecoder(FALSE);
+			legacyData = readDDSfile(ddsPath.c_str(), &legacyBytes);
+		});
+		newMs = measure([&]()
+		{
+			free(newData);
+			setDDSdecoder(TRUE);
+			newData = readDDSfile(ddsPath.c_str(), &newBytes);
+		});
+		bool equal = legacyData && newData && legacyBytes == newBytes && legacyBytes == ddsInput.size()
+			&& memcmp(legacyData, newData, newBytes) == 0
+			&& memcmp(newData, &ddsInput[0], newBytes) == 0;
+		report("DDS decode (2 byte interleave)", legacyMs, newMs, equal);
+
+		free(legacyData);
+		free(newData);
+		remove(ddsPath.c_str());
+
+		//++++++++++++++ chunked PVM (parallel decoding) ++++++++++++++//
+		std::string pvmPath = "import_benchmark.pvm";
+		std::string chunkedPath = "import_benchmark.pvmc";
+		writePVMvolume(pvmPath.c_str(), &ddsInput[0], VOLUME_SIZE_X, VOLUME_SIZE_Y, VOLUME_SIZE_Z, 2);
+		ChunkedPVM::writeVolume(chunkedPath, &ddsInput[0], VOLUME_SIZE_X, VOLUME_SIZE_Y, VOLUME_SIZE_Z, 2);
+
+		unsigned int w, h, d, c;
+		legacyData = nullptr;
+		newData = nullptr;
+		legacyMs = measure([&]()
+		{
+			free(legacyData);
+			legacyData = readPVMvolume(pvmPath.c_str(), &w, &h, &d, &c);
+		});
+		newMs = measure([&]()
+		{
+			free(newData);
+			newData = ChunkedPVM::readVolume(chunkedPath, &w, &h, &d, &c);
+		});
+		equal = legacyData && newData && memcmp(legacyData, newData, ddsInput.size()) == 0 && memcmp(newData, &ddsInput[0], ddsInput.size()) == 0;
+		report("chunked PVM read, threads: " + DebugLog::to_string(THREADPOOL->getNumThreads() + 1), legacyMs, newMs, equal);
+
+		free(legacyData);
+		free(newData);
+		remove(pvmPath.c_str());
+		remove(chunkedPath.c_str());
+	}
+
+	return 0;
+}
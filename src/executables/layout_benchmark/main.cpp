@@ -0,0 +1,216 @@
+/*******************************************
+ * **** DESCRIPTION ****
+ * Compares CPU side volume passes on x-fastest linear memory and on the 8^3 brick layout of SwizzledVolumeData,
+ * on synthetic data, no files or GL context needed.
+ ****************************************/
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <algorithm>
+#include <cmath>
+
+#include <Core/DebugLog.h>
+#include <Core/ThreadPool.h>
+#include <Core/VolumeData.h>
+#include <Core/SwizzledVolume.h>
+
+////////////////////// PARAMETERS /////////////////////////////
+const unsigned int VOLUME_SIZE_X = 384;
+const unsigned int VOLUME_SIZE_Y = 384;
+const unsigned int VOLUME_SIZE_Z = 384;
+const int NUM_REPETITIONS = 3;
+const int NUM_RAYS = 1 << 16;
+
+/** @brief run func NUM_REPETITIONS times, return the fastest run in milliseconds */
+double measure(std::function<void()> func)
+{
+	double best = -1.0;
+	for (int i = 0; i < NUM_REPETITIONS; i++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		func();
+		auto end = std::chrono::high_resolution_clock::now();
+		double ms = std::chrono::duration<double, std::milli>(end - start).count();
+		if (best < 0.0 || ms < best) { best = ms; }
+	}
+	return best;
+}
+
+void report(std::string name, double linearMs, double swizzledMs, bool equal)
+{
+	DEBUGLOG->log(name);
+	DEBUGLOG->indent();
+	DEBUGLOG->log("linear   (ms): ", linearMs);
+	DEBUGLOG->log("swizzled (ms): ", swizzledMs);
+	DEBUGLOG->log("speedup      : ", linearMs / swizzledMs);
+	DEBUGLOG->log("results equal: ", equal);
+	DEBUGLOG->outdent();
+}
+
+//////////////////////////////////////////////////////////////////////////////
+/////////////////////////////// KERNELS //////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+// written once against the accessor interface, instantiated for both layouts
+
+/** @brief sum of every line along z, one task per range of lines. Worst case for linear memory */
+template<class Accessor>
+void sumAlongZ(const Accessor& volume, std::vector<double>& result)
+{
+	result.assign((size_t) volume.size_x * volume.size_y, 0.0);
+	THREADPOOL->parallelFor(0, (size_t) volume.size_y, [&](size_t begin, size_t end)
+	{
+		for (int y = (int) begin; y < (int) end; y++) { for (int x = 0; x < volume.size_x; x++)
+		{
+			double sum = 0.0;
+			for (int z = 0; z < volume.size_z; z++) { sum += (double) volume.at(x, y, z); }
+			result[(size_t) y * volume.size_x + x] = sum;
+		}}
+	});
+}
+
+/** @brief central difference gradient magnitude of every voxel, brick by brick */
+template<class Accessor>
+void gradientMagnitudes(const Accessor& volume, std::vector<float>& result)
+{
+	result.resize((size_t) volume.size_x * volume.size_y * volume.size_z);
+	SwizzledVolume::forEachBrick(volume.size_x, volume.size_y, volume.size_z, [&](unsigned int x0, unsigned int y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1)
+	{
+		for (int z = (int) z0; z < (int) z1; z++) { for (int y = (int) y0; y < (int) y1; y++) { for (int x = (int) x0; x < (int) x1; x++)
+		{
+			float gx = (float) volume.clamped(x + 1, y, z) - (float) volume.clamped(x - 1, y, z);
+			float gy = (float) volume.clamped(x, y + 1, z) - (float) volume.clamped(x, y - 1, z);
+			float gz = (float) volume.clamped(x, y, z + 1) - (float) volume.clamped(x, y, z - 1);
+			result[((size_t) z * volume.size_y + y) * volume.size_x + x] = 0.5f * std::sqrt(gx * gx + gy * gy + gz * gz);
+		}}}
+	});
+}
+
+/** @brief mean of the 3^3 neighbourhood of every voxel, like the ambient occlusion kernel, brick by brick */
+template<class Accessor>
+void boxFilter(const Accessor& volume, std::vector<float>& result)
+{
+	result.resize((size_t) volume.size_x * volume.size_y * volume.size_z);
+	SwizzledVolume::forEachBrick(volume.size_x, volume.size_y, volume.size_z, [&](unsigned int x0, unsigned int y0, unsigned int z0, unsigned int x1, unsigned int y1, unsigned int z1)
+	{
+		for (int z = (int) z0; z < (int) z1; z++) { for (int y = (int) y0; y < (int) y1; y++) { for (int x = (int) x0; x < (int) x1; x++)
+		{
+			float sum = 0.0f;
+			for (int k = -1; k <= 1; k++) { for (int j = -1; j <= 1; j++) { for (int i = -1; i <= 1; i++) { sum += (float) volume.clamped(x + i, y + j, z + k); }}}
+			result[((size_t) z * volume.size_y + y) * volume.size_x + x] = sum / 27.0f;
+		}}}
+	});
+}
+
+/** @brief maximum intensity along rays in random directions with trilinear samples, like the CPU raycaster */
+template<class Accessor>
+void castRays(const Accessor& volume, const std::vector<float>& directions, std::vector<float>& result)
+{
+	const int numRays = (int) directions.size() / 3;
+	result.assign(numRays, 0.0f);
+	const float center[3] = { 0.5f * volume.size_x, 0.5f * volume.size_y, 0.5f * volume.size_z };
+	const float length = 0.5f * (float) std::min(volume.size_x, std::min(volume.size_y, volume.size_z)) - 1.0f;
+	THREADPOOL->parallelFor(0, (size_t) numRays, [&](size_t begin, size_t end)
+	{
+		for (size_t r = begin; r < end; r++)
+		{
+			const float* d = &directions[3 * r];
+			float maximum = 0.0f;
+			for (float t = -length; t < length; t += 0.5f)
+			{
+				float p[3] = { center[0] + t * d[0], center[1] + t * d[1], center[2] + t * d[2] };
+				int x = (int) p[0], y = (int) p[1], z = (int) p[2];
+				float fx = p[0] - x, fy = p[1] - y, fz = p[2] - z;
+				float c00 = volume.at(x, y, z) + fx * ((float) volume.at(x + 1, y, z) - volume.at(x, y, z));
+				float c10 = volume.at(x, y + 1, z) + fx * ((float) volume.at(x + 1, y + 1, z) - volume.at(x, y + 1, z));
+				float c01 = volume.at(x, y, z + 1) + fx * ((float) volume.at(x + 1, y, z + 1) - volume.at(x, y, z + 1));
+				float c11 = volume.at(x, y + 1, z + 1) + fx * ((float) volume.at(x + 1, y + 1, z + 1) - volume.at(x, y + 1, z + 1));
+				float c0 = c00 + fy * (c10 - c00), c1 = c01 + fy * (c11 - c01);
+				maximum = std::max(maximum, c0 + fz * (c1 - c0));
+			}
+			result[r] = maximum;
+		}
+	}, 256);
+}
+
+//////////////////////////////////////////////////////////////////////////////
+///////////////////////////////// MAIN ///////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+	DEBUGLOG->setAutoPrint(true);
+
+	// smooth 16 bit data with noise, similar to CT scans
+	VolumeData<unsigned short> linear;
+	linear.size_x = VOLUME_SIZE_X;
+	linear.size_y = VOLUME_SIZE_Y;
+	linear.size_z = VOLUME_SIZE_Z;
+	linear.real_size_x = linear.real_size_y = linear.real_size_z = 1.0f;
+	linear.data.resize((size_t) VOLUME_SIZE_X * VOLUME_SIZE_Y * VOLUME_SIZE_Z);
+	std::mt19937 rng(42);
+	for (size_t i = 0; i < linear.data.size(); i++)
+	{
+		unsigned int x = (unsigned int) (i % VOLUME_SIZE_X);
+		unsigned int y = (unsigned int) ((i / VOLUME_SIZE_X) % VOLUME_SIZE_Y);
+		unsigned int z = (unsigned int) (i / ((size_t) VOLUME_SIZE_X * VOLUME_SIZE_Y));
+		linear.data[i] = (unsigned short) ((x * x + y * y + z * z) / 8 + (rng() % 16));
+	}
+	linear.min = *std::min_element(linear.data.begin(), linear.data.end());
+	linear.max = *std::max_element(linear.data.begin(), linear.data.end());
+
+	//++++++++++++++ conversion ++++++++++++++//
+	SwizzledVolumeData<unsigned short> swizzled;
+	VolumeData<unsigned short> roundTrip;
+	double toSwizzledMs = measure([&]() { SwizzledVolume::fromLinear(linear, swizzled); });
+	double toLinearMs = measure([&]() { SwizzledVolume::toLinear(swizzled, roundTrip); });
+	DEBUGLOG->log("conversion, threads: " + DebugLog::to_string(THREADPOOL->getNumThreads() + 1));
+	DEBUGLOG->indent();
+	DEBUGLOG->log("linear -> swizzled (ms): ", toSwizzledMs);
+	DEBUGLOG->log("swizzled -> linear (ms): ", toLinearMs);
+	DEBUGLOG->log("round trip equal       : ", roundTrip.data == linear.data);
+	DEBUGLOG->outdent();
+
+	LinearVolumeAccessor<unsigned short> linearAccess(linear);
+	SwizzledVolumeAccessor<unsigned short> swizzledAccess(swizzled);
+
+	//++++++++++++++ lines along z ++++++++++++++//
+	{
+		std::vector<double> linearResult, swizzledResult;
+		double linearMs = measure([&]() { sumAlongZ(linearAccess, linearResult); });
+		double swizzledMs = measure([&]() { sumAlongZ(swizzledAccess, swizzledResult); });
+		report("sum along z", linearMs, swizzledMs, linearResult == swizzledResult);
+	}
+
+	//++++++++++++++ neighbourhood kernels ++++++++++++++//
+	{
+		std::vector<float> linearResult, swizzledResult;
+		double linearMs = measure([&]() { gradientMagnitudes(linearAccess, linearResult); });
+		double swizzledMs = measure([&]() { gradientMagnitudes(swizzledAccess, swizzledResult); });
+		report("gradient magnitude (6 neighbours)", linearMs, swizzledMs, linearResult == swizzledResult);
+
+		linearMs = measure([&]() { boxFilter(linearAccess, linearResult); });
+		swizzledMs = measure([&]() { boxFilter(swizzledAccess, swizzledResult); });
+		report("box filter (27 neighbours)", linearMs, swizzledMs, linearResult == swizzledResult);
+	}
+
+	//++++++++++++++ rays in random directions ++++++++++++++//
+	{
+		std::vector<float> directions(3 * NUM_RAYS);
+		std::normal_distribution<float> normal;
+		for (int r = 0; r < NUM_RAYS; r++)
+		{
+			float d[3] = { normal(rng), normal(rng), normal(rng) };
+			float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]) + 1e-6f;
+			for (int i = 0; i < 3; i++) { directions[3 * r + i] = d[i] / length; }
+		}
+
+		std::vector<float> linearResult, swizzledResult;
+		double linearMs = measure([&]() { castRays(linearAccess, directions, linearResult); });
+		double swizzledMs = measure([&]() { castRays(swizzledAccess, directions, swizzledResult); });
+		report("maximum intensity rays (trilinear)", linearMs, swizzledMs, linearResult == swizzledResult);
+	}
+
+	return 0;
+}
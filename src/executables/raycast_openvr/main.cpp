@@ -10,6 +10,7 @@
 #include <Rendering/GLTools.h>
 #include <Rendering/VertexArrayObjects.h>
 #include <Rendering/RenderPass.h>
+#include <Rendering/IncrementalTextureUploader.h>
 #include <Volume/ChunkedRenderPass.h>
 
 #include <UI/imgui/imgui.h>
@@ -23,10 +24,16 @@
 
 #include <Volume/TransferFunction.h>
 #include <Volume/SyntheticVolume.h>
+#include <Volume/VolumeCrop.h>
+#include <Volume/MacroCellGrid.h>
+#include <Volume/GradientVolume.h>
+#include <Volume/AmbientOcclusionVolume.h>
+#include <Volume/LightVolume.h>
 
 #include <Misc/TransferFunctionPresets.h>
 #include <Misc/Parameters.h>
 #include <Misc/VolumePresets.h>
+#include <Misc/AsyncVolumeLoader.h>
 
 // openvr includes
 #include <openvr.h>
@@ -34,6 +41,8 @@
 
 ////////////////////// PARAMETERS /////////////////////////////
 static const float MIRROR_SCREEN_FRAME_INTERVAL = 0.03f; // interval time (seconds) to mirror the screen (to avoid wait for vsync stalls)
+static const double VOLUME_UPLOAD_BUDGET = 4.0; // maximum time (milliseconds) per frame to spend on uploading a newly loaded volume
+static const double VOLUME_UPLOAD_MIN_BUDGET = 0.5; // time (milliseconds) spent per frame even if the raycasters leave no slack
 
 static float FRAMEBUFFER_SCALE = 0.5f;
 static glm::vec2 FRAMEBUFFER_RESOLUTION(700.f,700.f);
@@ -41,15 +50,20 @@ static glm::vec2 WINDOW_RESOLUTION(FRAMEBUFFER_RESOLUTION.x * 2.f, FRAMEBUFFER_R
 
 const char* SHADER_DEFINES[] = {
 	"AMBIENT_OCCLUSION",
+	"AMBIENT_OCCLUSION_VOLUME",
 	"CUBEMAP_SAMPLING",
 	"CULL_PLANES",
+	"DISTANCE_SKIPPING",
 	"EMISSION_ABSORPTION_RAW",
+	"EMPTY_SPACE_SKIPPING",
 	//"FIRST_HIT",
+	"GRADIENT_SHADING",
 	"LEVEL_OF_DETAIL",
 	"OCCLUSION_MAP",
 	"RANDOM_OFFSET",
 	"SCENE_DEPTH",
 	"SHADOW_SAMPLING",
+	"SHADOW_VOLUME",
 	"STEREO_SINGLE_PASS",
 };
 
@@ -114,6 +128,22 @@ private:
 	// Render objects bookkeeping
 	VolumeData<float> m_volumeData;
 	GLuint m_volumeTexture;
+	LoadedVolume<float> m_loadedVolume; // loaded or cropped, until its upload is complete
+	IncrementalTextureUploader m_volumeUploader;
+	LoadedVolume<float> m_sourceVolume; // voxels of the active volume, kept to crop it
+	AsyncVolumeLoader<float> m_volumeLoader; // destroyed first, a running crop reads m_sourceVolume
+	VolumeCrop::Region m_cropRegion; // of the active volume texture within m_sourceVolume
+	VolumeCrop::Region m_pendingCropRegion; // of the texture being uploaded, if m_bCropPending
+	bool m_bCropPending;
+	float m_fCropResolution; // of the cropped volume relative to the source, box filtered below 1
+	glm::mat4 m_cropToModel; // moves the proxy geometry onto the cropped region
+	VolumeData<float> m_activeCroppedVolume; // voxels of the active volume texture if it is cropped, the derived volumes are built from them
+	MacroCellGrid m_macroCellGrid; // of the active volume texture, for EMPTY_SPACE_SKIPPING and DISTANCE_SKIPPING
+	GradientVolume m_gradientVolume; // of the active volume texture, for GRADIENT_SHADING
+	AmbientOcclusionVolume m_occlusionVolume; // of the active volume texture, for AMBIENT_OCCLUSION with AMBIENT_OCCLUSION_VOLUME
+	LightVolume m_lightVolume; // of the active volume texture, for SHADOW_SAMPLING with SHADOW_VOLUME
+	bool m_bDerivedVolumesOutdated; // transfer function edited or derived volumes rebuilt since they were last classified
+	glm::vec2 m_derivedVolumesWindowing; // min value and range the derived volumes were last classified for
 	Quad*	m_pQuad;
 	Grid*	m_pGrid;
 	VertexGrid* m_pVertexGrid;
@@ -261,6 +291,7 @@ private:
 
 	std::vector<float> m_fpsCounter;
 	int m_iCurFpsIdx;
+	std::vector<float> m_histogramPlot; // values of the active volume, logarithmic, for the transfer function editor
 
 	float m_fElapsedTime;
 	float m_fMirrorScreenTimer;
@@ -343,8 +374,14 @@ public:
 	void loadShaders();
 	void loadGeometries();
 	void initSceneVariables();
-	void handleVolume();
+	void handleVolume(bool wait = false); //!< request the active model, wait: block until it is loaded and uploaded
 	void loadVolume();
+	void updateVolume(bool wait = false); //!< pick up a loaded volume and continue its upload
+	void cropVolume(bool reset = false); //!< upload only the region inside the cull planes, reset: upload the whole volume again
+	void updateCropTransforms(); //!< s_modelToTexture and m_cropToModel for m_cropRegion, use instead of updateModelToTexture()
+	VolumeDataView<float> getActiveVolume() const; //!< voxels of the active volume texture, the cropped region if one is locked
+	void buildDerivedVolumes(); //!< rebuild the volumes derived from the active voxels that the set shader defines use
+	void updateDerivedVolumes(); //!< classify and upload the derived volumes again if the transfer function, windowing or light direction changed
 	void initOpenVR();
 	void handleFrameType();
 
@@ -360,6 +397,7 @@ public:
 		, m_shaderDefines(0) // currently set defines
 		, m_fpsCounter(120)
 		, m_iCurFpsIdx(0)
+		, m_histogramPlot(0)
 		, m_iActiveModel(VolumePresets::CT_Head)
 		, m_iActiveView(WARPED)
 		, m_iLeftDebugView(14)
@@ -395,6 +433,13 @@ public:
 		, m_sShaderDirectory(SHADERS_PATH)
 		, m_iNumShadowSteps(8)
 		, m_shadowDir(glm::normalize(glm::vec3(0.0f, -0.5f, -1.0f)))
+		, m_cropRegion(VolumeCrop::getFullRegion(1, 1, 1))
+		, m_pendingCropRegion(VolumeCrop::getFullRegion(1, 1, 1))
+		, m_bCropPending(false)
+		, m_fCropResolution(1.0f)
+		, m_cropToModel(1.0f)
+		, m_bDerivedVolumesOutdated(true)
+		, m_derivedVolumesWindowing(0.0f)
 	{
 		DEBUGLOG->setAutoPrint(true);
 
@@ -492,19 +537,255 @@ public:
 			numLevels = 4;
 		}}
 
-		VolumePresets::loadPreset( m_volumeData, (VolumePresets::Preset) m_iActiveModel, m_sResourceDirectory);
-		m_volumeTexture = loadTo3DTexture<float>(m_volumeData, numLevels, GL_R16F, GL_RED, GL_FLOAT);
-		m_volumeData.data.clear(); // set free	
+		// the volume was mapped from its cache (or imported) in the background, upload it a few slices per frame
+		m_volumeUploader.begin<float>(m_loadedVolume.getLevels(), numLevels, GL_R16F, GL_RED, GL_FLOAT);
+	}
+
+	void CMainApplication::updateVolume(bool wait)
+	{
+		if (wait ? m_volumeLoader.wait(m_loadedVolume) : m_volumeLoader.poll(m_loadedVolume))
+		{
+			loadVolume(); // a cropped volume is uploaded the same way
+		}
+		else if (m_bCropPending && !m_volumeLoader.isLoading() && !m_volumeUploader.isActive())
+		{
+			m_bCropPending = false; // cropping failed, keep the active region
+		}
+		if (!m_volumeUploader.isActive())
+		{
+			return;
+		}
+
+		// use what the raycasters left of their target render time in the last frame
+		double budget = VOLUME_UPLOAD_BUDGET;
+		if (!wait)
+		{
+			int pass = 2 * (int) (m_iActiveWarpingTechnique == NOVELVIEW);
+			double slack = std::min(m_pRaycastChunked[LEFT + pass]->getLastSlackTime(), m_pRaycastChunked[RIGHT + pass]->getLastSlackTime());
+			budget = std::max(VOLUME_UPLOAD_MIN_BUDGET, std::min(budget, slack));
+		}
+		while (!m_volumeUploader.step(budget))
+		{
+			if (!wait) { return; } // keep rendering the current volume
+		}
+
+		// upload complete, switch over
+		glDeleteTextures(1, &m_volumeTexture);
+		m_volumeTexture = m_volumeUploader.release();
+		OPENGLCONTEXT->bindTextureToUnit(m_volumeTexture, GL_TEXTURE0, GL_TEXTURE_3D);
+
+		glm::vec3 cropExtent = m_cropRegion.textureMax - m_cropRegion.textureMin;
+		glm::vec3 cullMin = m_cropRegion.textureMin + s_cullMin * cropExtent; // in texture coordinates of the whole volume
+		glm::vec3 cullMax = m_cropRegion.textureMin + s_cullMax * cropExtent;
+		if (m_bCropPending)
+		{
+			// same volume, other region: keep windowing and transfer function. The step size refers to the whole volume (uCropExtent), so it stays as well
+			glm::vec3 pendingExtent = m_pendingCropRegion.textureMax - m_pendingCropRegion.textureMin;
+			s_cullMin = glm::clamp((cullMin - m_pendingCropRegion.textureMin) / pendingExtent, glm::vec3(0.0f), glm::vec3(1.0f));
+			s_cullMax = glm::clamp((cullMax - m_pendingCropRegion.textureMin) / pendingExtent, glm::vec3(0.0f), glm::vec3(1.0f));
+
+			m_cropRegion = m_pendingCropRegion;
+			m_bCropPending = false;
+			updateCropTransforms();
+			std::swap(m_activeCroppedVolume, m_loadedVolume.volumeData); // empty if the whole volume was uploaded again
+			m_loadedVolume = LoadedVolume<float>(); // set free
+			if (m_activeCroppedVolume.data.empty())
+			{
+				m_volumeData = m_sourceVolume.getInfo();
+			}
+			else
+			{
+				m_volumeData.size_x = m_activeCroppedVolume.size_x; m_volumeData.size_y = m_activeCroppedVolume.size_y; m_volumeData.size_z = m_activeCroppedVolume.size_z;
+			}
+			DEBUGLOG->log("Cropped volume resolution: ", glm::vec3(m_volumeData.size_x, m_volumeData.size_y, m_volumeData.size_z));
+			buildDerivedVolumes();
+			return;
+		}
+
+		// keep the voxels for cropping, the cull planes stay where they were
+		std::swap(m_sourceVolume, m_loadedVolume);
+		m_loadedVolume = LoadedVolume<float>(); // set free
+		m_activeCroppedVolume = VolumeData<float>();
+		m_volumeData = m_sourceVolume.getInfo();
+		VolumePresets::Preset preset = m_sourceVolume.preset;
+		s_cullMin = cullMin;
+		s_cullMax = cullMax;
+		m_cropRegion = VolumeCrop::getFullRegion(m_volumeData.size_x, m_volumeData.size_y, m_volumeData.size_z);
+		updateCropTransforms();
+
+		activateVolume(m_volumeData);
+		m_sourceVolume.histogram.getNormalized(128, m_histogramPlot, true); // counted once by the loader, cropping keeps it
+
+		// adjust scale
+		m_volumeScale = VolumePresets::getScalation(preset);
+		s_rotation = VolumePresets::getRotation(preset);
+
+		TransferFunctionPresets::loadPreset(TransferFunctionPresets::s_transferFunction, preset );
+		buildDerivedVolumes();
 
 		DEBUGLOG->log("Initial ray sampling step size: ", s_rayStepSize);
 		checkGLError(true);
 	}
 
+	void CMainApplication::cropVolume(bool reset)
+	{
+		if (m_sourceVolume.isEmpty() || m_volumeLoader.isLoading() || m_volumeUploader.isActive())
+		{
+			return;
+		}
+
+		int numLevels = 1;
+		{bool hasLod = false; for (auto e : m_shaderDefines) { hasLod |= (e == "LEVEL_OF_DETAIL"); } if ( hasLod){
+			numLevels = 4;
+		}}
+
+		std::vector< VolumeDataView<float> > levels = m_sourceVolume.getLevels();
+		const VolumeDataView<float>& source = levels[0];
+		if (reset)
+		{
+			m_pendingCropRegion = VolumeCrop::getFullRegion(source.size_x, source.size_y, source.size_z);
+			m_volumeUploader.begin<float>(levels, numLevels, GL_R16F, GL_RED, GL_FLOAT);
+		}
+		else
+		{
+			// the cull planes refer to the active region
+			glm::vec3 cropExtent = m_cropRegion.textureMax - m_cropRegion.textureMin;
+			m_pendingCropRegion = VolumeCrop::getRegion(source.size_x, source.size_y, source.size_z, m_cropRegion.textureMin + s_cullMin * cropExtent, m_cropRegion.textureMin + s_cullMax * cropExtent);
+
+			unsigned int targetSize[3];
+			for (int a = 0; a < 3; a++) { targetSize[a] = std::max(1u, (unsigned int) (m_fCropResolution * (float) m_pendingCropRegion.size[a] + 0.5f)); }
+			VolumeCrop::Filter filter = (m_fCropResolution < 1.0f) ? VolumeCrop::BOX : VolumeCrop::TRILINEAR;
+
+			// on the loader thread, updateVolume() uploads the result like a loaded volume. m_sourceVolume stays until the loader is done with it
+			VolumeCrop::Region region = m_pendingCropRegion;
+			m_volumeLoader.requestTask([source, region, targetSize, filter](LoadedVolume<float>& result)
+			{
+				VolumeCrop::cropAndResample(source, region, targetSize[0], targetSize[1], targetSize[2], filter, result.volumeData); // stays empty if it failed or was cancelled
+			}, m_sourceVolume.preset);
+		}
+		m_bCropPending = true;
+	}
+
+	void CMainApplication::updateCropTransforms()
+	{
+		updateModelToTexture();
+		m_cropToModel = VolumeCrop::getCropToModel(s_modelToTexture, m_cropRegion);
+		s_modelToTexture = VolumeCrop::getModelToTexture(s_modelToTexture, m_cropRegion);
+	}
+
+	VolumeDataView<float> CMainApplication::getActiveVolume() const
+	{
+		if (!m_activeCroppedVolume.data.empty())
+		{
+			return VolumeDataView<float>(m_activeCroppedVolume);
+		}
+		return m_sourceVolume.isEmpty() ? VolumeDataView<float>() : m_sourceVolume.getLevels()[0];
+	}
+
+	void CMainApplication::buildDerivedVolumes()
+	{
+		VolumeDataView<float> volume = getActiveVolume();
+
+		// textures may be recreated under the names of deleted ones, which the cached bindings would not notice
+		OPENGLCONTEXT->bindTextureToUnit(0, GL_TEXTURE27, GL_TEXTURE_3D);
+		OPENGLCONTEXT->bindTextureToUnit(0, GL_TEXTURE28, GL_TEXTURE_3D);
+		OPENGLCONTEXT->bindTextureToUnit(0, GL_TEXTURE29, GL_TEXTURE_3D);
+		OPENGLCONTEXT->bindTextureToUnit(0, GL_TEXTURE30, GL_TEXTURE_3D);
+		OPENGLCONTEXT->activeTexture(GL_TEXTURE31);
+
+		{bool hasSkipping = false; for (auto e : m_shaderDefines) { hasSkipping |= (e == "EMPTY_SPACE_SKIPPING" || e == "DISTANCE_SKIPPING"); } if (hasSkipping) {
+			m_macroCellGrid.build(volume);
+		}
+		else
+		{
+			m_macroCellGrid.release();
+		}}
+
+		{bool hasGradients = false; for (auto e : m_shaderDefines) { hasGradients |= (e == "GRADIENT_SHADING"); } if (hasGradients) {
+			// independent of the transfer function, so uploaded right away
+			m_gradientVolume.build(volume);
+			m_gradientVolume.upload();
+			m_gradientVolume.clearData();
+			OPENGLCONTEXT->bindTextureToUnit(m_gradientVolume.getTexture(), GL_TEXTURE28, GL_TEXTURE_3D);
+			OPENGLCONTEXT->activeTexture(GL_TEXTURE31);
+		}
+		else
+		{
+			m_gradientVolume.release();
+		}}
+
+		{bool hasOcclusion = false; bool hasOcclusionVolume = false; for (auto e : m_shaderDefines) { hasOcclusion |= (e == "AMBIENT_OCCLUSION"); hasOcclusionVolume |= (e == "AMBIENT_OCCLUSION_VOLUME"); } if (hasOcclusion && hasOcclusionVolume) {
+			m_occlusionVolume.build(volume);
+		}
+		else
+		{
+			m_occlusionVolume.release();
+		}}
+
+		{bool hasShadow = false; bool hasShadowVolume = false; for (auto e : m_shaderDefines) { hasShadow |= (e == "SHADOW_SAMPLING"); hasShadowVolume |= (e == "SHADOW_VOLUME"); } if (hasShadow && hasShadowVolume) {
+			m_lightVolume.build(volume); // only its size is needed, it is swept through the volume texture on the GPU
+		}
+		else
+		{
+			m_lightVolume.release();
+		}}
+
+		m_bDerivedVolumesOutdated = true;
+	}
+
+	void CMainApplication::updateDerivedVolumes()
+	{
+		glm::vec2 windowing(s_windowingMinValue, s_windowingMaxValue - s_windowingMinValue);
+		bool classify = m_bDerivedVolumesOutdated || windowing != m_derivedVolumesWindowing;
+		m_bDerivedVolumesOutdated = false;
+		m_derivedVolumesWindowing = windowing;
+		OPENGLCONTEXT->activeTexture(GL_TEXTURE31); // uploads bind to the active unit
+
+		{bool hasSkipping = false; for (auto e : m_shaderDefines) { hasSkipping |= (e == "EMPTY_SPACE_SKIPPING" || e == "DISTANCE_SKIPPING"); } if (hasSkipping && classify) {
+			bool hasLod = false; for (auto e : m_shaderDefines) { hasLod |= (e == "LEVEL_OF_DETAIL"); } // coarser levels average voxels beyond a cell
+			m_macroCellGrid.updateVisibility(TransferFunctionPresets::s_transferFunction, windowing.x, windowing.y, hasLod);
+
+			bool hasDistances = false; for (auto e : m_shaderDefines) { hasDistances |= (e == "DISTANCE_SKIPPING"); }
+			if (hasDistances) // macro_cell_texture holds the distances to the nearest visible cell instead
+			{
+				m_macroCellGrid.updateDistances();
+				m_macroCellGrid.uploadDistances();
+				OPENGLCONTEXT->bindTextureToUnit(m_macroCellGrid.getDistanceTexture(), GL_TEXTURE27, GL_TEXTURE_3D);
+			}
+			else
+			{
+				m_macroCellGrid.upload();
+				OPENGLCONTEXT->bindTextureToUnit(m_macroCellGrid.getTexture(), GL_TEXTURE27, GL_TEXTURE_3D);
+			}
+			OPENGLCONTEXT->activeTexture(GL_TEXTURE31);
+		}}
+
+		{bool hasOcclusion = false; bool hasOcclusionVolume = false; for (auto e : m_shaderDefines) { hasOcclusion |= (e == "AMBIENT_OCCLUSION"); hasOcclusionVolume |= (e == "AMBIENT_OCCLUSION_VOLUME"); } if (hasOcclusion && hasOcclusionVolume && classify) {
+			if (m_occlusionVolume.updateOcclusion(TransferFunctionPresets::s_transferFunction, windowing.x, windowing.y)) // skipped if neither changed
+			{
+				m_occlusionVolume.upload();
+				OPENGLCONTEXT->bindTextureToUnit(m_occlusionVolume.getTexture(), GL_TEXTURE29, GL_TEXTURE_3D);
+			}
+			OPENGLCONTEXT->activeTexture(GL_TEXTURE31);
+		}}
+
+		// every frame, the light direction may have changed as well
+		{bool hasShadow = false; bool hasShadowVolume = false; for (auto e : m_shaderDefines) { hasShadow |= (e == "SHADOW_SAMPLING"); hasShadowVolume |= (e == "SHADOW_VOLUME"); } if (hasShadow && hasShadowVolume) {
+			glm::vec3 lightDirection = glm::normalize(m_shadowDir) / (m_cropRegion.textureMax - m_cropRegion.textureMin); // in the active texture, like the shadow rays
+			float alphaScale = 20.0f / glm::length(lightDirection); // ALPHA_SCALE of the raycaster, per unit length in the whole volume
+			if (m_lightVolume.updateOnGpu(m_volumeTexture, TransferFunctionPresets::s_transferFunction, windowing.x, windowing.y, lightDirection, alphaScale)) // skipped if nothing changed
+			{
+				OPENGLCONTEXT->bindTextureToUnit(m_lightVolume.getTexture(), GL_TEXTURE30, GL_TEXTURE_3D);
+			}
+			OPENGLCONTEXT->activeTexture(GL_TEXTURE31);
+		}}
+	}
+
 	void CMainApplication::initSceneVariables()
 	{
 		/////////////////////     Scene / View Settings     //////////////////////////
 		s_volumeSize = glm::vec3(1.0f);
-		updateModelToTexture();
+		updateCropTransforms();
 
 		if (m_pOvr->m_pHMD)
 		{
@@ -665,6 +946,12 @@ public:
 		DEBUGLOG->log("Shader Compilation: grid warp shader"); DEBUGLOG->indent();
 		m_pGridWarpShader = new ShaderProgram("/raycast/gridWarp.vert", "/raycast/gridWarp.frag", m_shaderDefines, m_sShaderDirectory);
 		DEBUGLOG->outdent();
+
+		{bool hasShadow = false; bool hasShadowVolume = false; for (auto e : m_shaderDefines) { hasShadow |= (e == "SHADOW_SAMPLING"); hasShadowVolume |= (e == "SHADOW_VOLUME"); } if (hasShadow && hasShadowVolume) {
+			DEBUGLOG->log("Shader Compilation: light volume compute shader"); DEBUGLOG->indent();
+			m_lightVolume.loadShader(m_sShaderDirectory);
+			DEBUGLOG->outdent();
+		}}
 	
 	}
 
@@ -688,7 +975,7 @@ public:
 
 	void CMainApplication::initUniforms()
 	{
-		m_pUvwShader->update("model", s_translation * s_rotation * s_scale * m_volumeScale);
+		m_pUvwShader->update("model", s_translation * s_rotation * s_scale * m_volumeScale * m_cropToModel);
 		m_pUvwShader->update("view", s_view);
 		m_pUvwShader->update("projection", s_perspective);
 
@@ -927,6 +1214,10 @@ public:
 	{
 		m_pRaycastShader->update("volume_texture", 0); // m_pVolume texture
 		m_pRaycastShader->update("transferFunctionTex", 1);
+		m_pRaycastShader->update("macro_cell_texture", 27);
+		m_pRaycastShader->update("gradient_texture", 28);
+		m_pRaycastShader->update("occlusion_texture", 29);
+		m_pRaycastShader->update("light_texture", 30);
 		
 		m_pRaycastLayersShader->update("volume_texture", 0); // m_pVolume texture
 		m_pRaycastLayersShader->update("transferFunctionTex", 1);
@@ -1497,21 +1788,18 @@ public:
 		}
 	}
 	
-	void CMainApplication::handleVolume()
+	void CMainApplication::handleVolume(bool wait)
 	{
-		glDeleteTextures(1, &m_volumeTexture);
-		OPENGLCONTEXT->bindTextureToUnit(0, GL_TEXTURE0, GL_TEXTURE_3D);
-	
-		loadVolume();
-
-		activateVolume(m_volumeData);
-
-		// adjust scale
-		m_volumeScale = VolumePresets::getScalation((VolumePresets::Preset) m_iActiveModel);
-		s_rotation = VolumePresets::getRotation((VolumePresets::Preset) m_iActiveModel);
+		// a pending upload belongs to a superseded request
+		m_volumeUploader.cancel();
+		m_loadedVolume = LoadedVolume<float>();
+		m_bCropPending = false; // the request cancels a running crop
 
-		OPENGLCONTEXT->bindTextureToUnit(m_volumeTexture, GL_TEXTURE0, GL_TEXTURE_3D);
-		TransferFunctionPresets::loadPreset(TransferFunctionPresets::s_transferFunction, (VolumePresets::Preset) m_iActiveModel );
+		m_volumeLoader.request((VolumePresets::Preset) m_iActiveModel, m_sResourceDirectory);
+		if (wait)
+		{
+			updateVolume(true);
+		}
 	}
 
 	////////////////////////////////     GUI      ////////////////////////////////
@@ -1551,6 +1839,11 @@ public:
 		{
 			handleVolume();
 		}
+		if (m_volumeLoader.isLoading() || m_volumeUploader.isActive())
+		{
+			const char* task = m_volumeLoader.isLoading() ? (m_bCropPending ? "cropping" : "loading") : "uploading";
+			ImGui::ProgressBar(m_volumeLoader.isLoading() ? m_volumeLoader.getProgress() : m_volumeUploader.getProgress(), ImVec2(-1, 0), task);
+		}
 		ImGui::PopItemWidth();
 
 		ImGui::Separator();
@@ -1561,6 +1854,13 @@ public:
 		ImGui::SetNextWindowSize(ImVec2(getResolution(m_pWindow).x / 3 - 20, getResolution(m_pWindow).y / 5.0f));
 		if (ImGui::Begin("Transfer Function Settings", NULL, ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoSavedSettings))
 		{
+			if (!m_histogramPlot.empty())
+			{
+				ImGui::PushStyleColor(ImGuiCol_PlotHistogram, ImVec4(0.5f, 0.5f, 0.6f, 1.0f));
+				ImGui::PlotHistogram("Values", &m_histogramPlot[0], m_histogramPlot.size(), 0, NULL, 0.0f, 1.0f, ImVec2(0, 40));
+				ImGui::PopStyleColor();
+				if (ImGui::IsItemHovered()) ImGui::SetTooltip("Logarithmic histogram of the volume values from min to max");
+			}
 			ImGui::Columns(2, "mycolumns2", true);
 			ImGui::Separator();
 			bool changed = false;
@@ -1576,6 +1876,7 @@ public:
 			if(changed)
 			{
 				TransferFunctionPresets::updateTransferFunctionTex();
+				m_bDerivedVolumesOutdated = true;
 			}
 			ImGui::Columns(1);
 			ImGui::Separator();
@@ -1593,6 +1894,16 @@ public:
 			ImGui::Separator();
 			ImGui::DragFloatRange2("Windowing Range", &s_windowingMinValue, &s_windowingMaxValue, 1.0f, (float) s_minValue, (float) s_maxValue); // grayscale ramp boundaries
 			if (ImGui::IsItemHovered()) ImGui::SetTooltip("Value range to which the transfer function is mapped");
+			if (ImGui::Button("Auto Windowing"))
+			{
+				float windowingMinVal, windowingRange;
+				if (m_sourceVolume.histogram.getWindowing(0.01f, 0.99f, windowingMinVal, windowingRange))
+				{
+					s_windowingMinValue = windowingMinVal;
+					s_windowingMaxValue = windowingMinVal + windowingRange;
+				}
+			}
+			if (ImGui::IsItemHovered()) ImGui::SetTooltip("Window between the 1st and 99th percentile of the volume values");
         	ImGui::SliderFloat("Ray Step Size",   &s_rayStepSize,  0.0001f, 0.1f, "%.5f", 2.0f);
 			if (ImGui::IsItemHovered()) ImGui::SetTooltip("Texture space ray step size in range [0..1]");
 			{bool hasCullPlanes = false; for (auto e : m_shaderDefines) { hasCullPlanes |= (e == "CULL_PLANES"); } if ( hasCullPlanes ){
@@ -1600,6 +1911,12 @@ public:
 				if (ImGui::IsItemHovered()) ImGui::SetTooltip("Maximal culling limits in texture space");
 				ImGui::SliderFloat3("Cull Min", glm::value_ptr(s_cullMin),0.0f, 1.0f);
 				if (ImGui::IsItemHovered()) ImGui::SetTooltip("Minimal culling limits in texture space");
+				ImGui::SliderFloat("Crop Resolution", &m_fCropResolution, 0.25f, 1.0f, "%.2f");
+				if (ImGui::IsItemHovered()) ImGui::SetTooltip("Resolution of a locked region relative to the volume, box filtered below 1");
+				if (ImGui::Button("Lock Cull Region")) { cropVolume(); }
+				if (ImGui::IsItemHovered()) ImGui::SetTooltip("Upload only the voxels inside the cull planes, rays only traverse them");
+				ImGui::SameLine();
+				if (ImGui::Button("Unlock")) { cropVolume(true); }
 				ImGui::Separator();
 			}}
 			{
@@ -1677,7 +1994,7 @@ public:
 				}
 			}}
 
-			{bool hasShadow = false; for (auto e : m_shaderDefines) { hasShadow |= (e == "SHADOW_SAMPLING"); } if (hasShadow) {
+			{bool hasShadow = false; for (auto e : m_shaderDefines) { hasShadow |= (e == "SHADOW_SAMPLING" || e == "GRADIENT_SHADING"); } if (hasShadow) {
 				float alpha = angles[0] * glm::pi<float>();
 				float beta = angles[1] * glm::half_pi<float>();
 				if (ImGui::IsItemHovered()) ImGui::SetTooltip("Set shadow technique related values");
@@ -1876,7 +2193,7 @@ public:
 		if (ImGui::Button("Reset Transform"))
 		{
 			s_volumeSize = glm::vec3(1.0f);
-			updateModelToTexture();
+			updateCropTransforms();
 
 			if (m_pOvr->m_pHMD)
 			{
@@ -1921,6 +2238,8 @@ public:
 		/************* update color mapping parameters ******************/
 		m_pRaycastShader->update("uStepSize", s_rayStepSize); 	  // ray step size
 		m_pRaycastLayersShader->update("uStepSize", s_rayStepSize); 	  // ray step size
+		m_pRaycastShader->update("uCropExtent", m_cropRegion.textureMax - m_cropRegion.textureMin); // step sizes are measured in the whole volume
+		m_pRaycastLayersShader->update("uCropExtent", m_cropRegion.textureMax - m_cropRegion.textureMin);
 
 		// Level of Detail
 		{bool hasLod = false; for (auto e : m_shaderDefines) { hasLod |= (e == "LEVEL_OF_DETAIL"); } if ( hasLod){
@@ -1964,6 +2283,15 @@ public:
 			m_pRaycastLayersShader->update("uNumSamples", m_iNumSamples);
 		}}
 
+		{bool hasSkipping = false; for (auto e : m_shaderDefines) { hasSkipping |= (e == "EMPTY_SPACE_SKIPPING" || e == "DISTANCE_SKIPPING"); } if ( hasSkipping ){
+			m_pRaycastShader->update("uVolumeSize", m_macroCellGrid.getVolumeSize());
+			m_pRaycastShader->update("uMacroCellSize", (float) m_macroCellGrid.getCellSize());
+		}}
+
+		{bool hasGradients = false; for (auto e : m_shaderDefines) { hasGradients |= (e == "GRADIENT_SHADING"); } if ( hasGradients ){
+			m_pRaycastShader->update("uLightDirection", glm::normalize(m_shadowDir)); // the light the shadows are cast by
+		}}
+
 		glm::vec3 sceneVolSize = glm::vec3(s_scale * m_volumeScale * glm::vec4(s_volumeSize, 0.0f));
 		float radius = sqrtf( powf( sceneVolSize.x, 2.0f) + powf(sceneVolSize.y, 2.0f) + powf(sceneVolSize.z, 2.0f));
 		glm::vec4 objectCenter = s_view * s_model * glm::vec4(0.0f, 0.0f, 0.0f, 1.0);
@@ -2191,7 +2519,7 @@ public:
 		m_frame.Timings.getBack().beginTimerElapsed("UVW" + STR_SUFFIX[eye]);
 		m_pUvw->setFrameBufferObject( m_pUvwFBO[eye] );
 		m_pUvwShader->update("view", matrixSet.view);
-		m_pUvwShader->update("model", matrixSet.model);
+		m_pUvwShader->update("model", matrixSet.model * m_cropToModel); // proxy geometry of the cropped region only
 		m_pUvwShader->update("projection", matrixSet.perspective);
 		m_pUvw->render();
 		m_frame.Timings.getBack().stopTimerElapsed();
@@ -2730,6 +3058,7 @@ public:
 
 		// reload shader defines
 		updateShaderDefines();
+		buildDerivedVolumes();
 
 		// reload shaders
 		loadRaycastingShaders();
@@ -2767,6 +3096,12 @@ public:
 		
 			//////////////////////////////////////////////////////////////////////////////
 			updateGui();
+
+			//////////////////////////////////////////////////////////////////////////////
+			updateVolume();
+
+			//////////////////////////////////////////////////////////////////////////////
+			updateDerivedVolumes();
 			
 			//////////////////////////////////////////////////////////////////////////////
 			//updateModel(); 
@@ -2954,7 +3289,7 @@ int main(int argc, char *argv[])
 
 	pMainApplication->initSceneVariables();
 
-	pMainApplication->handleVolume();
+	pMainApplication->handleVolume(true);
 
 	pMainApplication->loadGeometries();
 
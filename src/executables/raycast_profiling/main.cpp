@@ -1084,8 +1084,17 @@ void CMainApplication::loadVolume()
 		numLevels = 4;
 	}}
 
-	VolumePresets::loadPreset( m_volumeData, (VolumePresets::Preset) m_iActiveModel);
-	m_volumeTexture = loadTo3DTexture<float>(m_volumeData, numLevels, GL_R16F, GL_RED, GL_FLOAT);
+	// map the preprocessed cache, the first launch imports the preset and writes it
+	VolumeCache::CachedVolume<float> cached = VolumePresets::loadPresetCached( m_volumeData, (VolumePresets::Preset) m_iActiveModel);
+	if (cached.isValid())
+	{
+		m_volumeTexture = loadTo3DTexture<float>(cached.levels, numLevels, GL_R16F, GL_RED, GL_FLOAT);
+		m_volumeData = cached.getInfo();
+	}
+	else
+	{
+		m_volumeTexture = loadTo3DTexture<float>(m_volumeData, numLevels, GL_R16F, GL_RED, GL_FLOAT);
+	}
 	m_volumeData.data.clear(); // set free	
 
 	DEBUGLOG->log("Initial ray sampling step size: ", s_rayStepSize);
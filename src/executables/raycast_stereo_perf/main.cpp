@@ -12,6 +12,7 @@
 #include <Rendering/VertexArrayObjects.h>
 #include <Rendering/RenderPass.h>
 #include <Rendering/ComputePass.h>
+#include <Rendering/IncrementalTextureUploader.h>
 #include <Importing/TextureTools.h>
 
 #include "UI/imgui/imgui.h"
@@ -33,8 +34,11 @@
 #include <Misc/TransferFunctionPresets.h>>
 #include <Misc/Parameters.h>
 #include <Misc/VolumePresets.h>
+#include <Misc/AsyncVolumeLoader.h>
 
 ////////////////////// PARAMETERS /////////////////////////////
+static const double VOLUME_UPLOAD_BUDGET = 2.0; // time (milliseconds) per frame to spend on uploading a newly loaded volume
+
 static const char* resolutionPresetsStr[]  = {"256", "512", "768", "1024","Vive (1080)"};
 static const int resolutionPresets[]  = {256, 512, 768, 1024, 1080};
 static const char* numLayersPresetsStr[]  = {"24", "32", "48", "64"};
@@ -78,6 +82,9 @@ public: // who cares
 	// Render objects bookkeeping
 	VolumeData<float> m_volumeData;
 	GLuint m_volumeTexture;
+	AsyncVolumeLoader<float> m_volumeLoader;
+	LoadedVolume<float> m_loadedVolume; // until its upload is complete
+	IncrementalTextureUploader m_volumeUploader;
 	Quad*	m_pQuad;
 	Grid*	m_pGrid;
 	VertexGrid* m_pVertexGrid;
@@ -221,6 +228,7 @@ public:
 	void loadGeometries();
 	void initSceneVariables();
 	void loadVolume();
+	void updateVolume(bool wait = false); //!< pick up a loaded volume and continue its upload
 
 	CMainApplication( int argc, char *argv[] );
 	virtual ~CMainApplication();
@@ -232,7 +240,7 @@ public:
 	void handleCsvProfilingShadingComplexity(); // CSV Profiling when envmap sampling is enabled
 	void updateError();
 
-	void handleVolume();
+	void handleVolume(bool wait = false); //!< request the active model, wait: block until it is loaded and uploaded
 	void handleResolutionPreset(int resolution);
 	void handleNumLayersPreset(int numLayers);
 	void handleFieldOfViewPreset(float fov);
@@ -396,9 +404,40 @@ void CMainApplication::loadVolume()
 		numLevels = 4;
 	}}
 
-	VolumePresets::loadPreset( m_volumeData, (VolumePresets::Preset) m_iActiveModel);
-	m_volumeTexture = loadTo3DTexture<float>(m_volumeData, numLevels, GL_R16F, GL_RED, GL_FLOAT);
-	m_volumeData.data.clear(); // set free	
+	// the volume was mapped from its cache (or imported) in the background, upload it a few slices per frame
+	m_volumeUploader.begin<float>(m_loadedVolume.getLevels(), numLevels, GL_R16F, GL_RED, GL_FLOAT);
+}
+
+void CMainApplication::updateVolume(bool wait)
+{
+	if (wait ? m_volumeLoader.wait(m_loadedVolume) : m_volumeLoader.poll(m_loadedVolume))
+	{
+		loadVolume();
+	}
+	if (!m_volumeUploader.isActive())
+	{
+		return;
+	}
+	while (!m_volumeUploader.step(VOLUME_UPLOAD_BUDGET))
+	{
+		if (!wait) { return; } // keep rendering the current volume
+	}
+
+	// upload complete, switch over
+	glDeleteTextures(1, &m_volumeTexture);
+	m_volumeTexture = m_volumeUploader.release();
+	m_volumeData = m_loadedVolume.getInfo();
+	VolumePresets::Preset preset = m_loadedVolume.preset;
+	m_loadedVolume = LoadedVolume<float>(); // set free
+
+	activateVolume(m_volumeData);
+
+	// adjust scale
+	s_scale = VolumePresets::getScalation(preset);
+	s_rotation = VolumePresets::getRotation(preset);
+
+	OPENGLCONTEXT->bindTextureToUnit(m_volumeTexture, GL_TEXTURE0, GL_TEXTURE_3D);
+	TransferFunctionPresets::loadPreset(TransferFunctionPresets::s_transferFunction, preset );
 
 	DEBUGLOG->log("Initial ray sampling step size: ", s_rayStepSize);
 	checkGLError(true);
@@ -792,21 +831,17 @@ void CMainApplication::pollEvents()
 	pollSDLEvents(m_pWindow, m_sdlEventFunc);
 }
 
-void CMainApplication::handleVolume()
+void CMainApplication::handleVolume(bool wait)
 {
-	glDeleteTextures(1, &m_volumeTexture);
-	OPENGLCONTEXT->bindTextureToUnit(0, GL_TEXTURE0, GL_TEXTURE_3D);
-	
-	loadVolume();
-
-	activateVolume(m_volumeData);
-
-	// adjust scale
-	s_scale = VolumePresets::getScalation((VolumePresets::Preset) m_iActiveModel);
-	s_rotation = VolumePresets::getRotation((VolumePresets::Preset) m_iActiveModel);
+	// a pending upload belongs to a superseded request
+	m_volumeUploader.cancel();
+	m_loadedVolume = LoadedVolume<float>();
 
-	OPENGLCONTEXT->bindTextureToUnit(m_volumeTexture, GL_TEXTURE0, GL_TEXTURE_3D);
-	TransferFunctionPresets::loadPreset(TransferFunctionPresets::s_transferFunction, (VolumePresets::Preset) m_iActiveModel );
+	m_volumeLoader.request((VolumePresets::Preset) m_iActiveModel);
+	if (wait)
+	{
+		updateVolume(true);
+	}
 }
 
 float CMainApplication::getIdealNearValue()
@@ -927,6 +962,10 @@ void CMainApplication::updateGui()
     {
 		handleVolume();
     }
+	if (m_volumeLoader.isLoading() || m_volumeUploader.isActive())
+	{
+		ImGui::ProgressBar(m_volumeLoader.isLoading() ? m_volumeLoader.getProgress() : m_volumeUploader.getProgress(), ImVec2(-1, 0), m_volumeLoader.isLoading() ? "loading" : "uploading");
+	}
 	ImGui::PopItemWidth();
 
 	if (ImGui::CollapsingHeader("Transfer Function"))
@@ -2062,6 +2101,9 @@ void CMainApplication::loop()
 		//////////////////////////////////////////////////////////////////////////////
 		updateGui();
 
+		//////////////////////////////////////////////////////////////////////////////
+		updateVolume();
+
 		//////////////////////////////////////////////////////////////////////////////
 		handleCsvProfiling();
 
@@ -2202,7 +2244,7 @@ int main(int argc, char *argv[])
 
 	pMainApplication->initSceneVariables();
 
-	pMainApplication->handleVolume();
+	pMainApplication->handleVolume(true);
 
 	pMainApplication->loadGeometries();
 
@@ -20,7 +20,6 @@
 
 // vtk includes
 #include <vtkSmartPointer.h>
-#include <vtkMetaImageReader.h>
 #include <vtkImageData.h>
 #include "vtkProperty.h"
 #include "vtkRenderer.h"
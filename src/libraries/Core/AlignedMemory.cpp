@@ -0,0 +1,47 @@
+#include "AlignedMemory.h"
+
+#include <cstdlib>
+
+#ifdef _WIN32
+	#include <malloc.h>
+#else
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+void* AlignedMemory::allocate(size_t bytes, size_t alignment)
+{
+	if (bytes == 0) { bytes = alignment; }
+#ifdef _WIN32
+	return _aligned_malloc(bytes, alignment);
+#else
+	void* ptr = nullptr;
+	if (posix_memalign(&ptr, alignment, bytes) != 0) { return nullptr; }
+	return ptr;
+#endif
+}
+
+void AlignedMemory::free(void* ptr)
+{
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	std::free(ptr);
+#endif
+}
+
+bool AlignedMemory::adviseHugePages(void* ptr, size_t bytes)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	// madvise needs page aligned boundaries, shrink the range to whole pages
+	size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+	size_t begin = ((size_t) ptr + pageSize - 1) / pageSize * pageSize;
+	size_t end = ((size_t) ptr + bytes) / pageSize * pageSize;
+	if (end <= begin) { return false; }
+	return madvise((void*) begin, end - begin, MADV_HUGEPAGE) == 0;
+#else
+	// large pages on Windows require SeLockMemoryPrivilege and VirtualAlloc, not worth it for a hint
+	(void) ptr; (void) bytes;
+	return false;
+#endif
+}
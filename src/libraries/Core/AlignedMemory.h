@@ -0,0 +1,50 @@
+#ifndef CORE_ALIGNEDMEMORY_H_
+#define CORE_ALIGNEDMEMORY_H_
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+namespace AlignedMemory
+{
+	static const size_t CACHE_LINE_SIZE = 64;
+	static const size_t HUGE_PAGE_SIZE = 2 << 20; //!< allocations of at least this size are aligned to it, so they can be backed by huge pages
+
+	void* allocate(size_t bytes, size_t alignment = CACHE_LINE_SIZE); //!< nullptr on failure
+	void free(void* ptr);
+
+	/**
+	 * @brief ask the OS to back the given range with huge pages (transparent huge pages on Linux). Call before the memory is touched.
+	 * @return false where unsupported, the memory stays usable either way
+	 */
+	bool adviseHugePages(void* ptr, size_t bytes);
+}
+
+/** @brief stateless std allocator returning cache line aligned (or huge page aligned, for large blocks) memory */
+template<class T>
+struct AlignedAllocator
+{
+	typedef T value_type;
+
+	AlignedAllocator() {}
+	template<class U> AlignedAllocator(const AlignedAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+		size_t bytes = n * sizeof(T);
+		void* ptr = AlignedMemory::allocate(bytes, (bytes >= AlignedMemory::HUGE_PAGE_SIZE) ? AlignedMemory::HUGE_PAGE_SIZE : AlignedMemory::CACHE_LINE_SIZE);
+		if (ptr == nullptr && n > 0) { throw std::bad_alloc(); }
+		return static_cast<T*>(ptr);
+	}
+	void deallocate(T* ptr, size_t) { AlignedMemory::free(ptr); }
+
+	template<class U> struct rebind { typedef AlignedAllocator<U> other; };
+};
+
+template<class T, class U> inline bool operator==(const AlignedAllocator<T>&, const AlignedAllocator<U>&) { return true; }
+template<class T, class U> inline bool operator!=(const AlignedAllocator<T>&, const AlignedAllocator<U>&) { return false; }
+
+template<class T>
+using AlignedVector = std::vector<T, AlignedAllocator<T> >;
+
+#endif
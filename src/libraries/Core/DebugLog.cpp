@@ -15,10 +15,11 @@ DebugLog::~DebugLog()
 
 void DebugLog::log(std::string msg)
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_log.push_back( createIndent() +  msg );
 	if (m_autoPrint)
 	{
-		printLast();
+		std::cout << m_log.back() << std::endl;
 	}
 }
 
@@ -115,11 +116,13 @@ void DebugLog::log(std::string msg, double value)
 
 void DebugLog::indent()
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_indent++;
 }
 
 void DebugLog::outdent()
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_indent--;
 	if(m_indent < 0)
 	{
@@ -138,6 +141,7 @@ std::string DebugLog::createIndent() const
 }
 
 void DebugLog::print() const{
+	std::lock_guard<std::mutex> lock(m_mutex);
 	for (unsigned int i = 0; i < m_log.size(); i++)
 	{
 		std::cout << m_log[i] << std::endl;
@@ -145,6 +149,7 @@ void DebugLog::print() const{
 }
 
 void DebugLog::printLast() const{
+	std::lock_guard<std::mutex> lock(m_mutex);
 	if (!m_log.empty())
 	{
 		std::cout << m_log.back() << std::endl;
@@ -153,6 +158,7 @@ void DebugLog::printLast() const{
 
 void DebugLog::clear()
 {
+	std::lock_guard<std::mutex> lock(m_mutex);
 	m_log.clear();
 }
 
@@ -6,10 +6,17 @@
 #include <sstream>
 #include <vector>
 
+#ifdef MINGW_THREADS
+	#include <mingw-std-threads/mingw.mutex.h>
+#else
+	#include <mutex>
+#endif
+
 #include <glm/glm.hpp>
 
 #include "Singleton.h"
 
+/** @brief log of messages, may be written from several threads (i.e. background loaders), every entry is appended under a lock */
 class DebugLog : public Singleton<DebugLog>
 {
 friend class Singleton< DebugLog >;
@@ -17,6 +24,7 @@ private:
 	std::vector< std::string > m_log;
 	int  m_indent;
 	bool m_autoPrint;
+	mutable std::mutex m_mutex; //!< guards m_log, m_indent and std::cout output
 	inline std::string createIndent() const;
 public:
 	DebugLog(bool autoPrint = false);
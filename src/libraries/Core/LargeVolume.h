@@ -0,0 +1,198 @@
+#ifndef CORE_LARGEVOLUME_H_
+#define CORE_LARGEVOLUME_H_
+
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+
+#include "AlignedMemory.h"
+#include "VolumeData.h"
+
+/**
+ * @brief non-owning, strided window into voxels with 64 bit extents, i.e. a sub-volume or slice of a LargeVolumeData.
+ *        T may be const for read-only views. Voxels are x-fastest, rows and slices may be further apart than size_x and size_x * size_y.
+ */
+template<class T>
+struct LargeVolumeView
+{
+	T* data; //!< first voxel of the view
+
+	unsigned long long size_x;
+	unsigned long long size_y;
+	unsigned long long size_z;
+
+	unsigned long long stride_y; //!< elements from one row to the next
+	unsigned long long stride_z; //!< elements from one slice to the next
+
+	LargeVolumeView<T>()
+		: data(nullptr), size_x(0), size_y(0), size_z(0), stride_y(0), stride_z(0)
+	{}
+
+	/** @brief contiguous view */
+	LargeVolumeView<T>(T* data, unsigned long long size_x, unsigned long long size_y, unsigned long long size_z)
+		: data(data), size_x(size_x), size_y(size_y), size_z(size_z), stride_y(size_x), stride_z(size_x * size_y)
+	{}
+
+	/** @brief read-only view of mutable voxels */
+	operator LargeVolumeView<const T>() const
+	{
+		LargeVolumeView<const T> result(data, size_x, size_y, size_z);
+		result.stride_y = stride_y;
+		result.stride_z = stride_z;
+		return result;
+	}
+
+	inline T& at(unsigned long long x, unsigned long long y, unsigned long long z) const { return data[z * stride_z + y * stride_y + x]; }
+	inline T* row(unsigned long long y, unsigned long long z) const { return data + z * stride_z + y * stride_y; }
+
+	inline unsigned long long getNumVoxels() const { return size_x * size_y * size_z; }
+	inline bool isEmpty() const { return data == nullptr || getNumVoxels() == 0; }
+	inline bool isContiguous() const { return stride_y == size_x && stride_z == size_x * size_y; }
+
+	/** @brief view of the box [x0, x0 + sx) x [y0, y0 + sy) x [z0, z0 + sz), clamped to this view */
+	LargeVolumeView<T> subVolume(unsigned long long x0, unsigned long long y0, unsigned long long z0,
+		unsigned long long sx, unsigned long long sy, unsigned long long sz) const
+	{
+		LargeVolumeView<T> result;
+		if (x0 >= size_x || y0 >= size_y || z0 >= size_z) { return result; }
+		result.data = data + z0 * stride_z + y0 * stride_y + x0;
+		result.size_x = std::min(sx, size_x - x0);
+		result.size_y = std::min(sy, size_y - y0);
+		result.size_z = std::min(sz, size_z - z0);
+		result.stride_y = stride_y;
+		result.stride_z = stride_z;
+		return result;
+	}
+
+	/** @brief view of a single slice orthogonal to axis (0: x, 1: y, 2: z), the extent along axis is 1 */
+	LargeVolumeView<T> slice(int axis, unsigned long long index) const
+	{
+		switch (axis)
+		{
+			case 0: return subVolume(index, 0, 0, 1, size_y, size_z);
+			case 1: return subVolume(0, index, 0, size_x, 1, size_z);
+			default: return subVolume(0, 0, index, size_x, size_y, 1);
+		}
+	}
+
+	/** @brief copy voxels row by row into a view of the same extents */
+	template<class U>
+	bool copyTo(const LargeVolumeView<U>& target) const
+	{
+		static_assert(std::is_same<typename std::remove_const<T>::type, U>::value, "copyTo requires a mutable target of the same element type");
+		if (target.size_x != size_x || target.size_y != size_y || target.size_z != size_z) { return false; }
+		for (unsigned long long z = 0; z < size_z; z++) { for (unsigned long long y = 0; y < size_y; y++)
+		{
+			memcpy(target.row(y, z), row(y, z), (size_t) size_x * sizeof(T));
+		}}
+		return true;
+	}
+};
+
+/**
+ * @brief owning counterpart of VolumeData for volumes beyond 4G voxels: 64 bit extents, 64 byte aligned storage
+ *        (huge page aligned and optionally huge page backed for large volumes). Shares the storage type of VolumeData,
+ *        so either converts into the other by swapping buffers instead of copying voxels.
+ */
+template<class T>
+struct LargeVolumeData
+{
+	unsigned long long size_x; //!< x: left
+	unsigned long long size_y; //!< y: forward
+	unsigned long long size_z; //!< z: up
+
+	AlignedVector<T> data; //!< size: x * y * z
+
+	float real_size_x; // actual step size in mm
+	float real_size_y; // actual step size in mm
+	float real_size_z; // actual step size in mm
+
+	T min;
+	T max;
+
+	LargeVolumeData<T>()
+		: size_x(0), size_y(0), size_z(0), real_size_x(1.0f), real_size_y(1.0f), real_size_z(1.0f), min(T()), max(T())
+	{}
+
+	/**
+	 * @brief (re)allocate storage, voxels are value initialized
+	 * @param hugePages (optional) ask the OS to back the storage with huge pages, reduces TLB misses when sampling large volumes
+	 */
+	void allocate(unsigned long long x, unsigned long long y, unsigned long long z, bool hugePages = false)
+	{
+		size_x = x; size_y = y; size_z = z;
+		AlignedVector<T>().swap(data);
+
+		// advise before the first touch, resize() touches every page
+		data.reserve((size_t) getNumVoxels());
+		if (hugePages && data.capacity() > 0) { AlignedMemory::adviseHugePages(data.data(), data.capacity() * sizeof(T)); }
+		data.resize((size_t) getNumVoxels());
+	}
+
+	/** @brief take over the voxels of volumeData without copying, volumeData is left empty */
+	void adopt(VolumeData<T>& volumeData)
+	{
+		size_x = volumeData.size_x; size_y = volumeData.size_y; size_z = volumeData.size_z;
+		real_size_x = volumeData.real_size_x; real_size_y = volumeData.real_size_y; real_size_z = volumeData.real_size_z;
+		min = volumeData.min; max = volumeData.max;
+		data.swap(volumeData.data);
+
+		volumeData.data.clear();
+		volumeData.size_x = volumeData.size_y = volumeData.size_z = 0;
+	}
+
+	/**
+	 * @brief hand the voxels over to result without copying, this is left empty
+	 * @return false if the extents do not fit into VolumeData, nothing is moved then
+	 */
+	bool release(VolumeData<T>& result)
+	{
+		const unsigned long long limit = std::numeric_limits<unsigned int>::max();
+		if (size_x > limit || size_y > limit || size_z > limit) { return false; }
+
+		result.size_x = (unsigned int) size_x; result.size_y = (unsigned int) size_y; result.size_z = (unsigned int) size_z;
+		result.real_size_x = real_size_x; result.real_size_y = real_size_y; result.real_size_z = real_size_z;
+		result.min = min; result.max = max;
+		result.data.swap(data);
+
+		data.clear();
+		size_x = size_y = size_z = 0;
+		return true;
+	}
+
+	inline unsigned long long getNumVoxels() const { return size_x * size_y * size_z; }
+
+	inline LargeVolumeView<T> view() { return LargeVolumeView<T>(data.empty() ? nullptr : data.data(), size_x, size_y, size_z); }
+	inline LargeVolumeView<const T> view() const { return LargeVolumeView<const T>(data.empty() ? nullptr : data.data(), size_x, size_y, size_z); }
+
+	/** @brief VolumeDataView of the voxels (i.e. for uploading), empty if the extents do not fit */
+	VolumeDataView<T> toVolumeDataView() const
+	{
+		VolumeDataView<T> result;
+		const unsigned long long limit = std::numeric_limits<unsigned int>::max();
+		if (data.empty() || size_x > limit || size_y > limit || size_z > limit) { return result; }
+
+		result.size_x = (unsigned int) size_x; result.size_y = (unsigned int) size_y; result.size_z = (unsigned int) size_z;
+		result.data = data.data();
+		result.real_size_x = real_size_x; result.real_size_y = real_size_y; result.real_size_z = real_size_z;
+		result.min = min; result.max = max;
+		return result;
+	}
+};
+
+/** @brief read-only LargeVolumeView of a VolumeData */
+template<class T>
+inline LargeVolumeView<const T> makeLargeVolumeView(const VolumeData<T>& volumeData)
+{
+	return LargeVolumeView<const T>(volumeData.data.empty() ? nullptr : volumeData.data.data(), volumeData.size_x, volumeData.size_y, volumeData.size_z);
+}
+
+/** @brief read-only LargeVolumeView of a VolumeDataView, i.e. of a mapped file */
+template<class T>
+inline LargeVolumeView<const T> makeLargeVolumeView(const VolumeDataView<T>& volumeData)
+{
+	return LargeVolumeView<const T>(volumeData.data, volumeData.size_x, volumeData.size_y, volumeData.size_z);
+}
+
+#endif
@@ -0,0 +1,155 @@
+#include "MappedFile.h"
+
+#include <Core/DebugLog.h>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+	#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+	: m_data(nullptr),
+	m_size(0)
+#ifdef _WIN32
+	, m_fileHandle(INVALID_HANDLE_VALUE),
+	m_mappingHandle(NULL)
+#else
+	, m_fileDescriptor(-1)
+#endif
+{
+}
+
+MappedFile::MappedFile(const std::string& path)
+	: MappedFile()
+{
+	open(path);
+}
+
+MappedFile::MappedFile(MappedFile&& other)
+	: MappedFile()
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other)
+{
+	if (this != &other)
+	{
+		close();
+		m_data = other.m_data;
+		m_size = other.m_size;
+#ifdef _WIN32
+		m_fileHandle = other.m_fileHandle;
+		m_mappingHandle = other.m_mappingHandle;
+		other.m_fileHandle = INVALID_HANDLE_VALUE;
+		other.m_mappingHandle = NULL;
+#else
+		m_fileDescriptor = other.m_fileDescriptor;
+		other.m_fileDescriptor = -1;
+#endif
+		other.m_data = nullptr;
+		other.m_size = 0;
+	}
+	return *this;
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	m_fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_fileHandle == INVALID_HANDLE_VALUE)
+	{
+		DEBUGLOG->log("ERROR: could not open file: " + path);
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_fileHandle, &size) || size.QuadPart == 0)
+	{
+		DEBUGLOG->log("ERROR: file is empty or size unknown: " + path);
+		close();
+		return false;
+	}
+	m_size = (unsigned long long) size.QuadPart;
+
+	m_mappingHandle = CreateFileMappingA(m_fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mappingHandle == NULL)
+	{
+		DEBUGLOG->log("ERROR: could not create file mapping: " + path);
+		close();
+		return false;
+	}
+
+	m_data = (const unsigned char*) MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+#else
+	m_fileDescriptor = ::open(path.c_str(), O_RDONLY);
+	if (m_fileDescriptor == -1)
+	{
+		DEBUGLOG->log("ERROR: could not open file: " + path);
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		DEBUGLOG->log("ERROR: file is empty or size unknown: " + path);
+		close();
+		return false;
+	}
+	m_size = (unsigned long long) fileStat.st_size;
+
+	void* mapping = mmap(nullptr, (size_t) m_size, PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+	m_data = (mapping == MAP_FAILED) ? nullptr : (const unsigned char*) mapping;
+#endif
+
+	if (m_data == nullptr)
+	{
+		DEBUGLOG->log("ERROR: could not map file: " + path);
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (m_data != nullptr) { UnmapViewOfFile(m_data); }
+	if (m_mappingHandle != NULL) { CloseHandle(m_mappingHandle); }
+	if (m_fileHandle != INVALID_HANDLE_VALUE) { CloseHandle(m_fileHandle); }
+	m_mappingHandle = NULL;
+	m_fileHandle = INVALID_HANDLE_VALUE;
+#else
+	if (m_data != nullptr) { munmap((void*) m_data, (size_t) m_size); }
+	if (m_fileDescriptor != -1) { ::close(m_fileDescriptor); }
+	m_fileDescriptor = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
+
+void MappedFile::adviseSequential()
+{
+#ifndef _WIN32
+	if (m_data != nullptr)
+	{
+		madvise((void*) m_data, (size_t) m_size, MADV_SEQUENTIAL);
+		madvise((void*) m_data, (size_t) m_size, MADV_WILLNEED);
+	}
+#endif
+}
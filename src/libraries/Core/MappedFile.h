@@ -0,0 +1,38 @@
+#ifndef CORE_MAPPEDFILE_H_
+#define CORE_MAPPEDFILE_H_
+
+#include <string>
+
+/** @brief read-only memory mapping of a complete file. The mapping is released on destruction. */
+class MappedFile {
+protected:
+	const unsigned char* m_data; //!< first byte of mapped file, nullptr if not open
+	unsigned long long m_size;   //!< size of mapped file in bytes
+
+#ifdef _WIN32
+	void* m_fileHandle;
+	void* m_mappingHandle;
+#else
+	int m_fileDescriptor;
+#endif
+
+public:
+	MappedFile();
+	MappedFile(const std::string& path);
+	MappedFile(MappedFile&& other);
+	MappedFile& operator=(MappedFile&& other);
+	virtual ~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path); //!< maps the whole file, closes any previous mapping
+	void close();
+	void adviseSequential(); //!< hint the OS that the mapping will be read front to back (no-op where unsupported)
+
+	inline bool isOpen() const { return m_data != nullptr; }
+	inline const unsigned char* getData() const { return m_data; }
+	inline unsigned long long getSize() const { return m_size; }
+};
+
+#endif
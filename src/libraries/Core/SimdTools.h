@@ -0,0 +1,364 @@
+#ifndef CORE_SIMDTOOLS_H_
+#define CORE_SIMDTOOLS_H_
+
+#include <cstddef>
+#include <algorithm>
+
+// compile time selection of the widest available instruction set
+#if defined(__AVX2__)
+	#define SIMDTOOLS_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define SIMDTOOLS_SSE2
+#endif
+
+#if defined(SIMDTOOLS_AVX2)
+	#include <immintrin.h>
+#elif defined(SIMDTOOLS_SSE2)
+	#include <emmintrin.h>
+#endif
+
+namespace SimdTools
+{
+	/** @brief extend the range [min, max] by count values, generic scalar version
+	 * @param data first value
+	 * @param count number of values
+	 * @param min will be lowered to the smallest value found (initialize it, e.g. with the first value)
+	 * @param max will be raised to the largest value found
+	 */
+	template<class T>
+	inline void updateMinMax(const T* data, size_t count, T& min, T& max)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (data[i] < min) { min = data[i]; }
+			if (data[i] > max) { max = data[i]; }
+		}
+	}
+
+	inline void updateMinMax(const short* data, size_t count, short& min, short& max);
+	inline void updateMinMax(const unsigned short* data, size_t count, unsigned short& min, unsigned short& max);
+	inline void updateMinMax(const signed char* data, size_t count, signed char& min, signed char& max);
+	inline void updateMinMax(const unsigned char* data, size_t count, unsigned char& min, unsigned char& max);
+	inline void updateMinMax(const float* data, size_t count, float& min, float& max);
+
+	/** @brief per element range of several rows: min[i] = min(min[i], data[i]), max[i] = max(max[i], data[i]), generic scalar version
+	 * @param data row of count values
+	 * @param min, max running ranges of count values each (initialize them, e.g. with the first row)
+	 */
+	template<class T>
+	inline void updateMinMaxPerElement(const T* data, size_t count, T* min, T* max)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			if (data[i] < min[i]) { min[i] = data[i]; }
+			if (data[i] > max[i]) { max[i] = data[i]; }
+		}
+	}
+
+	inline void updateMinMaxPerElement(const short* data, size_t count, short* min, short* max);
+	inline void updateMinMaxPerElement(const unsigned short* data, size_t count, unsigned short* min, unsigned short* max);
+	inline void updateMinMaxPerElement(const unsigned char* data, size_t count, unsigned char* min, unsigned char* max);
+	inline void updateMinMaxPerElement(const float* data, size_t count, float* min, float* max);
+
+	/** @brief horizontal reduction of lane values that were written to memory */
+	template<class T>
+	inline void reduceLanes(const T* lanesMin, const T* lanesMax, int numLanes, T& min, T& max)
+	{
+		for (int i = 0; i < numLanes; i++)
+		{
+			min = std::min<T>(min, lanesMin[i]);
+			max = std::max<T>(max, lanesMax[i]);
+		}
+	}
+}
+
+////// IMPLEMENTATION
+inline void SimdTools::updateMinMax(const short* data, size_t count, short& min, short& max)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	if (count >= 16)
+	{
+		__m256i vMin = _mm256_set1_epi16(min);
+		__m256i vMax = _mm256_set1_epi16(max);
+		for (; i + 16 <= count; i += 16)
+		{
+			__m256i v = _mm256_loadu_si256((const __m256i*) (data + i));
+			vMin = _mm256_min_epi16(vMin, v);
+			vMax = _mm256_max_epi16(vMax, v);
+		}
+		short lanesMin[16], lanesMax[16];
+		_mm256_storeu_si256((__m256i*) lanesMin, vMin);
+		_mm256_storeu_si256((__m256i*) lanesMax, vMax);
+		reduceLanes(lanesMin, lanesMax, 16, min, max);
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	if (count >= 8)
+	{
+		__m128i vMin = _mm_set1_epi16(min);
+		__m128i vMax = _mm_set1_epi16(max);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*) (data + i));
+			vMin = _mm_min_epi16(vMin, v);
+			vMax = _mm_max_epi16(vMax, v);
+		}
+		short lanesMin[8], lanesMax[8];
+		_mm_storeu_si128((__m128i*) lanesMin, vMin);
+		_mm_storeu_si128((__m128i*) lanesMax, vMax);
+		reduceLanes(lanesMin, lanesMax, 8, min, max);
+	}
+#endif
+	updateMinMax<short>(data + i, count - i, min, max);
+}
+
+inline void SimdTools::updateMinMax(const unsigned short* data, size_t count, unsigned short& min, unsigned short& max)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	if (count >= 16)
+	{
+		__m256i vMin = _mm256_set1_epi16((short) min);
+		__m256i vMax = _mm256_set1_epi16((short) max);
+		for (; i + 16 <= count; i += 16)
+		{
+			__m256i v = _mm256_loadu_si256((const __m256i*) (data + i));
+			vMin = _mm256_min_epu16(vMin, v);
+			vMax = _mm256_max_epu16(vMax, v);
+		}
+		unsigned short lanesMin[16], lanesMax[16];
+		_mm256_storeu_si256((__m256i*) lanesMin, vMin);
+		_mm256_storeu_si256((__m256i*) lanesMax, vMax);
+		reduceLanes(lanesMin, lanesMax, 16, min, max);
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	if (count >= 8)
+	{
+		// SSE2 only knows signed 16 bit min/max: flip the sign bit to preserve unsigned order
+		const __m128i bias = _mm_set1_epi16((short) 0x8000);
+		__m128i vMin = _mm_xor_si128(_mm_set1_epi16((short) min), bias);
+		__m128i vMax = _mm_xor_si128(_mm_set1_epi16((short) max), bias);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (data + i)), bias);
+			vMin = _mm_min_epi16(vMin, v);
+			vMax = _mm_max_epi16(vMax, v);
+		}
+		unsigned short lanesMin[8], lanesMax[8];
+		_mm_storeu_si128((__m128i*) lanesMin, _mm_xor_si128(vMin, bias));
+		_mm_storeu_si128((__m128i*) lanesMax, _mm_xor_si128(vMax, bias));
+		reduceLanes(lanesMin, lanesMax, 8, min, max);
+	}
+#endif
+	updateMinMax<unsigned short>(data + i, count - i, min, max);
+}
+
+inline void SimdTools::updateMinMax(const signed char* data, size_t count, signed char& min, signed char& max)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	if (count >= 32)
+	{
+		__m256i vMin = _mm256_set1_epi8(min);
+		__m256i vMax = _mm256_set1_epi8(max);
+		for (; i + 32 <= count; i += 32)
+		{
+			__m256i v = _mm256_loadu_si256((const __m256i*) (data + i));
+			vMin = _mm256_min_epi8(vMin, v);
+			vMax = _mm256_max_epi8(vMax, v);
+		}
+		signed char lanesMin[32], lanesMax[32];
+		_mm256_storeu_si256((__m256i*) lanesMin, vMin);
+		_mm256_storeu_si256((__m256i*) lanesMax, vMax);
+		reduceLanes(lanesMin, lanesMax, 32, min, max);
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	if (count >= 16)
+	{
+		// SSE2 only knows unsigned 8 bit min/max: flip the sign bit to preserve signed order
+		const __m128i bias = _mm_set1_epi8((char) 0x80);
+		__m128i vMin = _mm_xor_si128(_mm_set1_epi8(min), bias);
+		__m128i vMax = _mm_xor_si128(_mm_set1_epi8(max), bias);
+		for (; i + 16 <= count; i += 16)
+		{
+			__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (data + i)), bias);
+			vMin = _mm_min_epu8(vMin, v);
+			vMax = _mm_max_epu8(vMax, v);
+		}
+		signed char lanesMin[16], lanesMax[16];
+		_mm_storeu_si128((__m128i*) lanesMin, _mm_xor_si128(vMin, bias));
+		_mm_storeu_si128((__m128i*) lanesMax, _mm_xor_si128(vMax, bias));
+		reduceLanes(lanesMin, lanesMax, 16, min, max);
+	}
+#endif
+	updateMinMax<signed char>(data + i, count - i, min, max);
+}
+
+inline void SimdTools::updateMinMax(const unsigned char* data, size_t count, unsigned char& min, unsigned char& max)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	if (count >= 32)
+	{
+		__m256i vMin = _mm256_set1_epi8((char) min);
+		__m256i vMax = _mm256_set1_epi8((char) max);
+		for (; i + 32 <= count; i += 32)
+		{
+			__m256i v = _mm256_loadu_si256((const __m256i*) (data + i));
+			vMin = _mm256_min_epu8(vMin, v);
+			vMax = _mm256_max_epu8(vMax, v);
+		}
+		unsigned char lanesMin[32], lanesMax[32];
+		_mm256_storeu_si256((__m256i*) lanesMin, vMin);
+		_mm256_storeu_si256((__m256i*) lanesMax, vMax);
+		reduceLanes(lanesMin, lanesMax, 32, min, max);
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	if (count >= 16)
+	{
+		__m128i vMin = _mm_set1_epi8((char) min);
+		__m128i vMax = _mm_set1_epi8((char) max);
+		for (; i + 16 <= count; i += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*) (data + i));
+			vMin = _mm_min_epu8(vMin, v);
+			vMax = _mm_max_epu8(vMax, v);
+		}
+		unsigned char lanesMin[16], lanesMax[16];
+		_mm_storeu_si128((__m128i*) lanesMin, vMin);
+		_mm_storeu_si128((__m128i*) lanesMax, vMax);
+		reduceLanes(lanesMin, lanesMax, 16, min, max);
+	}
+#endif
+	updateMinMax<unsigned char>(data + i, count - i, min, max);
+}
+
+inline void SimdTools::updateMinMax(const float* data, size_t count, float& min, float& max)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	if (count >= 8)
+	{
+		__m256 vMin = _mm256_set1_ps(min);
+		__m256 vMax = _mm256_set1_ps(max);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 v = _mm256_loadu_ps(data + i);
+			vMin = _mm256_min_ps(vMin, v);
+			vMax = _mm256_max_ps(vMax, v);
+		}
+		float lanesMin[8], lanesMax[8];
+		_mm256_storeu_ps(lanesMin, vMin);
+		_mm256_storeu_ps(lanesMax, vMax);
+		reduceLanes(lanesMin, lanesMax, 8, min, max);
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	if (count >= 4)
+	{
+		__m128 vMin = _mm_set1_ps(min);
+		__m128 vMax = _mm_set1_ps(max);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 v = _mm_loadu_ps(data + i);
+			vMin = _mm_min_ps(vMin, v);
+			vMax = _mm_max_ps(vMax, v);
+		}
+		float lanesMin[4], lanesMax[4];
+		_mm_storeu_ps(lanesMin, vMin);
+		_mm_storeu_ps(lanesMax, vMax);
+		reduceLanes(lanesMin, lanesMax, 4, min, max);
+	}
+#endif
+	updateMinMax<float>(data + i, count - i, min, max);
+}
+
+inline void SimdTools::updateMinMaxPerElement(const short* data, size_t count, short* min, short* max)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*) (data + i));
+		_mm256_storeu_si256((__m256i*) (min + i), _mm256_min_epi16(_mm256_loadu_si256((const __m256i*) (min + i)), v));
+		_mm256_storeu_si256((__m256i*) (max + i), _mm256_max_epi16(_mm256_loadu_si256((const __m256i*) (max + i)), v));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) (data + i));
+		_mm_storeu_si128((__m128i*) (min + i), _mm_min_epi16(_mm_loadu_si128((const __m128i*) (min + i)), v));
+		_mm_storeu_si128((__m128i*) (max + i), _mm_max_epi16(_mm_loadu_si128((const __m128i*) (max + i)), v));
+	}
+#endif
+	updateMinMaxPerElement<short>(data + i, count - i, min + i, max + i);
+}
+
+inline void SimdTools::updateMinMaxPerElement(const unsigned short* data, size_t count, unsigned short* min, unsigned short* max)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*) (data + i));
+		_mm256_storeu_si256((__m256i*) (min + i), _mm256_min_epu16(_mm256_loadu_si256((const __m256i*) (min + i)), v));
+		_mm256_storeu_si256((__m256i*) (max + i), _mm256_max_epu16(_mm256_loadu_si256((const __m256i*) (max + i)), v));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	// signed 16 bit min/max with flipped sign bits, see updateMinMax()
+	const __m128i bias = _mm_set1_epi16((short) 0x8000);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (data + i)), bias);
+		__m128i vMin = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (min + i)), bias);
+		__m128i vMax = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (max + i)), bias);
+		_mm_storeu_si128((__m128i*) (min + i), _mm_xor_si128(_mm_min_epi16(vMin, v), bias));
+		_mm_storeu_si128((__m128i*) (max + i), _mm_xor_si128(_mm_max_epi16(vMax, v), bias));
+	}
+#endif
+	updateMinMaxPerElement<unsigned short>(data + i, count - i, min + i, max + i);
+}
+
+inline void SimdTools::updateMinMaxPerElement(const unsigned char* data, size_t count, unsigned char* min, unsigned char* max)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	for (; i + 32 <= count; i += 32)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*) (data + i));
+		_mm256_storeu_si256((__m256i*) (min + i), _mm256_min_epu8(_mm256_loadu_si256((const __m256i*) (min + i)), v));
+		_mm256_storeu_si256((__m256i*) (max + i), _mm256_max_epu8(_mm256_loadu_si256((const __m256i*) (max + i)), v));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) (data + i));
+		_mm_storeu_si128((__m128i*) (min + i), _mm_min_epu8(_mm_loadu_si128((const __m128i*) (min + i)), v));
+		_mm_storeu_si128((__m128i*) (max + i), _mm_max_epu8(_mm_loadu_si128((const __m128i*) (max + i)), v));
+	}
+#endif
+	updateMinMaxPerElement<unsigned char>(data + i, count - i, min + i, max + i);
+}
+
+inline void SimdTools::updateMinMaxPerElement(const float* data, size_t count, float* min, float* max)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 v = _mm256_loadu_ps(data + i);
+		_mm256_storeu_ps(min + i, _mm256_min_ps(_mm256_loadu_ps(min + i), v));
+		_mm256_storeu_ps(max + i, _mm256_max_ps(_mm256_loadu_ps(max + i), v));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 v = _mm_loadu_ps(data + i);
+		_mm_storeu_ps(min + i, _mm_min_ps(_mm_loadu_ps(min + i), v));
+		_mm_storeu_ps(max + i, _mm_max_ps(_mm_loadu_ps(max + i), v));
+	}
+#endif
+	updateMinMaxPerElement<float>(data + i, count - i, min + i, max + i);
+}
+
+#endif
@@ -0,0 +1,229 @@
+#ifndef CORE_SWIZZLEDVOLUME_H_
+#define CORE_SWIZZLEDVOLUME_H_
+
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+#include "AlignedMemory.h"
+#include "ThreadPool.h"
+#include "VolumeData.h"
+
+/**
+ * @brief CPU volume storage tiled into bricks of 8^3 voxels: bricks are x-fastest, voxels inside a brick are x-fastest.
+ *        A brick of 8 bit or 16 bit voxels spans 8 or 16 cache lines, so neighbourhood kernels touch about the same number of lines
+ *        whether they step along x, y or z, while x-fastest linear memory touches a new line (and soon a new page) per step along z.
+ *        Extents are padded to whole bricks by repeating the border voxels. The address of a voxel is the sum of three
+ *        per axis offsets, see SwizzledVolumeAccessor.
+ */
+template<class T>
+struct SwizzledVolumeData
+{
+	static const unsigned int BRICK_SHIFT = 3;
+	static const unsigned int BRICK_SIZE = 1 << BRICK_SHIFT;      //!< voxels per brick edge
+	static const unsigned int BRICK_MASK = BRICK_SIZE - 1;
+	static const unsigned int BRICK_VOXELS = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE;
+
+	unsigned int size_x; //!< x: left
+	unsigned int size_y; //!< y: forward
+	unsigned int size_z; //!< z: up
+
+	unsigned int bricks_x; //!< number of bricks per axis
+	unsigned int bricks_y;
+	unsigned int bricks_z;
+
+	AlignedVector<T> data; //!< size: bricks_x * bricks_y * bricks_z * BRICK_VOXELS
+
+	std::vector<size_t> offset_x; //!< element offset of every x coordinate, the address of (x, y, z) is offset_x[x] + offset_y[y] + offset_z[z]
+	std::vector<size_t> offset_y;
+	std::vector<size_t> offset_z;
+
+	float real_size_x; // actual step size in mm
+	float real_size_y; // actual step size in mm
+	float real_size_z; // actual step size in mm
+
+	T min;
+	T max;
+
+	SwizzledVolumeData<T>()
+		: size_x(0), size_y(0), size_z(0), bricks_x(0), bricks_y(0), bricks_z(0)
+		, real_size_x(1.0f), real_size_y(1.0f), real_size_z(1.0f), min(T()), max(T())
+	{}
+
+	/** @brief (re)allocate storage and offset tables for the given extents, voxels are value initialized */
+	void allocate(unsigned int x, unsigned int y, unsigned int z)
+	{
+		size_x = x; size_y = y; size_z = z;
+		bricks_x = (x + BRICK_MASK) >> BRICK_SHIFT;
+		bricks_y = (y + BRICK_MASK) >> BRICK_SHIFT;
+		bricks_z = (z + BRICK_MASK) >> BRICK_SHIFT;
+		data.assign((size_t) bricks_x * bricks_y * bricks_z * BRICK_VOXELS, T());
+
+		offset_x.resize((size_t) bricks_x * BRICK_SIZE);
+		offset_y.resize((size_t) bricks_y * BRICK_SIZE);
+		offset_z.resize((size_t) bricks_z * BRICK_SIZE);
+		for (size_t i = 0; i < offset_x.size(); i++) { offset_x[i] = (i >> BRICK_SHIFT) * BRICK_VOXELS + (i & BRICK_MASK); }
+		for (size_t i = 0; i < offset_y.size(); i++) { offset_y[i] = (i >> BRICK_SHIFT) * bricks_x * BRICK_VOXELS + (i & BRICK_MASK) * BRICK_SIZE; }
+		for (size_t i = 0; i < offset_z.size(); i++) { offset_z[i] = (i >> BRICK_SHIFT) * bricks_x * bricks_y * BRICK_VOXELS + (i & BRICK_MASK) * BRICK_SIZE * BRICK_SIZE; }
+	}
+
+	inline size_t index(unsigned int x, unsigned int y, unsigned int z) const { return offset_x[x] + offset_y[y] + offset_z[z]; }
+	inline T& at(unsigned int x, unsigned int y, unsigned int z) { return data[index(x, y, z)]; }
+	inline const T& at(unsigned int x, unsigned int y, unsigned int z) const { return data[index(x, y, z)]; }
+
+	/** @brief first voxel of brick (bx, by, bz), BRICK_VOXELS x-fastest voxels */
+	inline const T* brick(unsigned int bx, unsigned int by, unsigned int bz) const { return &data[(((size_t) bz * bricks_y + by) * bricks_x + bx) * BRICK_VOXELS]; }
+	inline size_t getNumBricks() const { return (size_t) bricks_x * bricks_y * bricks_z; }
+};
+
+/**
+ * @brief voxel access with the same interface for both layouts, so neighbourhood kernels can be written once as a template
+ *        over the accessor. Coordinates of clamped() may lie outside the volume and are clamped to the border like a texture.
+ */
+template<class T>
+struct LinearVolumeAccessor
+{
+	const T* data;
+	int size_x, size_y, size_z;
+	size_t stride_y, stride_z;
+
+	LinearVolumeAccessor(const VolumeData<T>& volume)
+		: data(volume.data.empty() ? nullptr : &volume.data[0])
+		, size_x((int) volume.size_x), size_y((int) volume.size_y), size_z((int) volume.size_z)
+		, stride_y(volume.size_x), stride_z((size_t) volume.size_x * volume.size_y)
+	{}
+
+	inline T at(int x, int y, int z) const { return data[(size_t) z * stride_z + (size_t) y * stride_y + (size_t) x]; }
+	inline T clamped(int x, int y, int z) const
+	{
+		return at(std::max(0, std::min(x, size_x - 1)), std::max(0, std::min(y, size_y - 1)), std::max(0, std::min(z, size_z - 1)));
+	}
+};
+
+template<class T>
+struct SwizzledVolumeAccessor
+{
+	const T* data;
+	const size_t* offset_x;
+	const size_t* offset_y;
+	const size_t* offset_z;
+	int size_x, size_y, size_z;
+
+	SwizzledVolumeAccessor(const SwizzledVolumeData<T>& volume)
+		: data(volume.data.empty() ? nullptr : &volume.data[0])
+		, offset_x(volume.offset_x.empty() ? nullptr : &volume.offset_x[0])
+		, offset_y(volume.offset_y.empty() ? nullptr : &volume.offset_y[0])
+		, offset_z(volume.offset_z.empty() ? nullptr : &volume.offset_z[0])
+		, size_x((int) volume.size_x), size_y((int) volume.size_y), size_z((int) volume.size_z)
+	{}
+
+	inline T at(int x, int y, int z) const { return data[offset_x[x] + offset_y[y] + offset_z[z]]; }
+	inline T clamped(int x, int y, int z) const
+	{
+		return at(std::max(0, std::min(x, size_x - 1)), std::max(0, std::min(y, size_y - 1)), std::max(0, std::min(z, size_z - 1)));
+	}
+};
+
+namespace SwizzledVolume
+{
+	/** @brief brick the voxels of a linear volume on the thread pool, one task per row of bricks */
+	template<class T>
+	void fromLinear(const VolumeData<T>& volume, SwizzledVolumeData<T>& result);
+
+	/** @brief voxels of a swizzled volume in x-fastest linear order, on the thread pool */
+	template<class T>
+	void toLinear(const SwizzledVolumeData<T>& volume, VolumeData<T>& result);
+
+	/**
+	 * @brief visit the volume brick by brick on the thread pool, func(x0, y0, z0, x1, y1, z1) with the voxel box [x0, x1) x [y0, y1) x [z0, z1)
+	 *        of a brick. Neighbourhood kernels that traverse this way keep the neighbour bricks in cache with either layout
+	 */
+	template<class Func>
+	void forEachBrick(unsigned int size_x, unsigned int size_y, unsigned int size_z, Func func);
+}
+
+////// IMPLEMENTATION
+template<class T>
+void SwizzledVolume::fromLinear(const VolumeData<T>& volume, SwizzledVolumeData<T>& result)
+{
+	typedef SwizzledVolumeData<T> S;
+	result.allocate(volume.size_x, volume.size_y, volume.size_z);
+	result.real_size_x = volume.real_size_x;
+	result.real_size_y = volume.real_size_y;
+	result.real_size_z = volume.real_size_z;
+	result.min = volume.min;
+	result.max = volume.max;
+	if (volume.data.empty() || volume.data.size() != (size_t) volume.size_x * volume.size_y * volume.size_z) { return; }
+
+	// every brick row reads 8 x 8 whole source rows, which are split into the bricks 8 voxels at a time
+	const size_t sx = volume.size_x, sy = volume.size_y, sz = volume.size_z;
+	THREADPOOL->parallelFor(0, (size_t) result.bricks_y * result.bricks_z, [&](size_t begin, size_t end)
+	{
+		for (size_t brickRow = begin; brickRow < end; brickRow++)
+		{
+			const size_t by = brickRow % result.bricks_y, bz = brickRow / result.bricks_y;
+			T* bricks = &result.data[brickRow * result.bricks_x * S::BRICK_VOXELS];
+			for (size_t k = 0; k < S::BRICK_SIZE; k++) { for (size_t j = 0; j < S::BRICK_SIZE; j++)
+			{
+				const size_t y = std::min(by * S::BRICK_SIZE + j, sy - 1), z = std::min(bz * S::BRICK_SIZE + k, sz - 1); // border repeated
+				const T* src = &volume.data[(z * sy + y) * sx];
+				T* dst = bricks + (k * S::BRICK_SIZE + j) * S::BRICK_SIZE;
+				size_t x = 0;
+				for (; x + S::BRICK_SIZE <= sx; x += S::BRICK_SIZE, dst += S::BRICK_VOXELS) { memcpy(dst, src + x, S::BRICK_SIZE * sizeof(T)); }
+				if (x < sx)
+				{
+					for (size_t i = 0; i < S::BRICK_SIZE; i++) { dst[i] = src[std::min(x + i, sx - 1)]; }
+				}
+			}}
+		}
+	}, 1);
+}
+
+template<class T>
+void SwizzledVolume::toLinear(const SwizzledVolumeData<T>& volume, VolumeData<T>& result)
+{
+	typedef SwizzledVolumeData<T> S;
+	result.size_x = volume.size_x;
+	result.size_y = volume.size_y;
+	result.size_z = volume.size_z;
+	result.real_size_x = volume.real_size_x;
+	result.real_size_y = volume.real_size_y;
+	result.real_size_z = volume.real_size_z;
+	result.min = volume.min;
+	result.max = volume.max;
+	const size_t sx = volume.size_x, sy = volume.size_y, sz = volume.size_z;
+	result.data.resize(sx * sy * sz);
+	if (volume.data.empty()) { return; }
+
+	THREADPOOL->parallelFor(0, sz * sy, [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; row++)
+		{
+			const size_t y = row % sy, z = row / sy;
+			const T* src = &volume.data[volume.offset_y[y] + volume.offset_z[z]];
+			T* dst = &result.data[row * sx];
+			size_t x = 0;
+			for (; x + S::BRICK_SIZE <= sx; x += S::BRICK_SIZE, src += S::BRICK_VOXELS) { memcpy(dst + x, src, S::BRICK_SIZE * sizeof(T)); }
+			if (x < sx) { memcpy(dst + x, src, (sx - x) * sizeof(T)); }
+		}
+	}, 64);
+}
+
+template<class Func>
+void SwizzledVolume::forEachBrick(unsigned int size_x, unsigned int size_y, unsigned int size_z, Func func)
+{
+	const unsigned int brick = SwizzledVolumeData<unsigned char>::BRICK_SIZE;
+	const size_t bricks_x = (size_x + brick - 1) / brick, bricks_y = (size_y + brick - 1) / brick, bricks_z = (size_z + brick - 1) / brick;
+	THREADPOOL->parallelFor(0, bricks_x * bricks_y * bricks_z, [&](size_t begin, size_t end)
+	{
+		for (size_t b = begin; b < end; b++)
+		{
+			unsigned int x0 = (unsigned int) (b % bricks_x) * brick;
+			unsigned int y0 = (unsigned int) ((b / bricks_x) % bricks_y) * brick;
+			unsigned int z0 = (unsigned int) (b / (bricks_x * bricks_y)) * brick;
+			func(x0, y0, z0, std::min(x0 + brick, size_x), std::min(y0 + brick, size_y), std::min(z0 + brick, size_z));
+		}
+	});
+}
+
+#endif
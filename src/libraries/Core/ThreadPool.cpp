@@ -0,0 +1,142 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int numThreads)
+	: m_numActive(0),
+	m_stop(false)
+{
+	if (numThreads == 0)
+	{
+		numThreads = std::max<unsigned int>(1, getHardwareConcurrency() - 1);
+	}
+
+	for (unsigned int i = 0; i < numThreads; i++)
+	{
+		m_workers.push_back(std::thread(&ThreadPool::workerLoop, this));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_taskAvailable.notify_all();
+
+	for (auto& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+unsigned int ThreadPool::getHardwareConcurrency()
+{
+	return std::max<unsigned int>(1, std::thread::hardware_concurrency());
+}
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_taskAvailable.wait(lock, [this](){ return m_stop || !m_tasks.empty(); });
+
+			if (m_stop && m_tasks.empty())
+			{
+				return;
+			}
+
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+			m_numActive++;
+		}
+
+		task();
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_numActive--;
+			if (m_numActive == 0 && m_tasks.empty())
+			{
+				m_allFinished.notify_all();
+			}
+		}
+	}
+}
+
+void ThreadPool::enqueue(std::function<void()> task)
+{
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_taskAvailable.notify_one();
+}
+
+void ThreadPool::waitForAll()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_allFinished.wait(lock, [this](){ return m_numActive == 0 && m_tasks.empty(); });
+}
+
+namespace {
+struct ParallelForState
+{
+	std::atomic<size_t> nextChunk;
+	std::atomic<size_t> finishedChunks;
+	std::mutex mutex;
+	std::condition_variable finished;
+};
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, std::function<void(size_t, size_t)> func, size_t grainSize)
+{
+	if (end <= begin)
+	{
+		return;
+	}
+
+	size_t count = end - begin;
+	if (grainSize == 0)
+	{
+		grainSize = std::max<size_t>(1, count / (4 * (m_workers.size() + 1))); // a few chunks per thread for load balancing
+	}
+	size_t numChunks = (count + grainSize - 1) / grainSize;
+
+	// shared, since helpers may be dequeued after all chunks were processed and the caller returned
+	std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+	state->nextChunk = 0;
+	state->finishedChunks = 0;
+
+	auto work = [state, begin, end, grainSize, numChunks, func]()
+	{
+		size_t chunk;
+		while ((chunk = state->nextChunk++) < numChunks)
+		{
+			size_t chunkBegin = begin + chunk * grainSize;
+			func(chunkBegin, std::min(end, chunkBegin + grainSize));
+
+			if (++state->finishedChunks == numChunks)
+			{
+				std::unique_lock<std::mutex> lock(state->mutex);
+				state->finished.notify_all();
+			}
+		}
+	};
+
+	size_t numHelpers = std::min<size_t>(m_workers.size(), numChunks - 1);
+	for (size_t i = 0; i < numHelpers; i++)
+	{
+		enqueue(work);
+	}
+
+	work(); // calling thread participates
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&state, numChunks](){ return state->finishedChunks == numChunks; });
+}
@@ -0,0 +1,62 @@
+#ifndef CORE_THREADPOOL_H_
+#define CORE_THREADPOOL_H_
+
+#ifdef MINGW_THREADS
+	#include <mingw-std-threads/mingw.thread.h>
+	#include <mingw-std-threads/mingw.mutex.h>
+	#include <mingw-std-threads/mingw.condition_variable.h>
+#else
+	#include <thread>
+	#include <mutex>
+	#include <condition_variable>
+#endif
+
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <functional>
+
+#include "Singleton.h"
+
+/** @brief fixed set of worker threads that execute queued tasks in FIFO order */
+class ThreadPool : public Singleton<ThreadPool>
+{
+friend class Singleton< ThreadPool >;
+protected:
+	std::vector<std::thread> m_workers;
+	std::deque< std::function<void()> > m_tasks;
+
+	std::mutex m_mutex;
+	std::condition_variable m_taskAvailable; //!< notified when a task was queued or the pool stops
+	std::condition_variable m_allFinished;   //!< notified when the queue ran empty and no task is executing
+	int  m_numActive; //!< number of tasks currently executing
+	bool m_stop;
+
+	void workerLoop();
+
+public:
+	/** @param numThreads number of worker threads, 0: one per hardware thread minus the calling thread */
+	ThreadPool(unsigned int numThreads = 0);
+	virtual ~ThreadPool();
+
+	void enqueue(std::function<void()> task); //!< queue a task for execution on any worker
+	void waitForAll(); //!< block until every queued task has finished
+
+	/**
+	 * @brief split [begin, end) into chunks and process them on the workers and the calling thread, returns when all chunks are done.
+	 *        Safe to call from within a task, since the caller works on the chunks itself if all workers are busy.
+	 * @param begin first index
+	 * @param end one past the last index
+	 * @param func called with a sub range [chunkBegin, chunkEnd)
+	 * @param grainSize (optional) number of indices per chunk, 0: pick automatically
+	 */
+	void parallelFor(size_t begin, size_t end, std::function<void(size_t, size_t)> func, size_t grainSize = 0);
+
+	inline unsigned int getNumThreads() const { return (unsigned int) m_workers.size(); }
+	static unsigned int getHardwareConcurrency(); //!< number of hardware threads, at least 1
+};
+
+// for convenient access to a shared pool
+#define THREADPOOL ThreadPool::getInstance()
+
+#endif
@@ -2,6 +2,9 @@
 #define CORE_VOLUMEDATA_H_
 
 #include <vector>
+#include <cstddef>
+
+#include "AlignedMemory.h"
 
 template<class T>
 struct VolumeData
@@ -10,7 +13,7 @@ struct VolumeData
 	unsigned int size_y; //!< y: forward
 	unsigned int size_z; //!< z: up
 
-	std::vector<T> data; //!< size: x
+	AlignedVector<T> data; //!< size: x * y * z, 64 byte aligned so LargeVolumeData can adopt it
 
 	//std::vector<T> midSlice;
 
@@ -21,7 +24,38 @@ struct VolumeData
 	T min;
 	T max;
 
-	VolumeData<T>(){ data = std::vector<T>(); }
+	VolumeData<T>(){ data = AlignedVector<T>(); }
+};
+
+/** @brief non-owning, read-only counterpart of VolumeData, i.e. for memory mapped voxels. Whoever provides data must keep it alive. */
+template<class T>
+struct VolumeDataView
+{
+	unsigned int size_x; //!< x: left
+	unsigned int size_y; //!< y: forward
+	unsigned int size_z; //!< z: up
+
+	const T* data; //!< size: x * y * z
+
+	float real_size_x; // actual step size in mm
+	float real_size_y; // acutal step size in mm
+	float real_size_z; // acutal step size in mm
+
+	T min;
+	T max;
+
+	VolumeDataView<T>()
+		: size_x(0), size_y(0), size_z(0), data(nullptr), real_size_x(1.0f), real_size_y(1.0f), real_size_z(1.0f), min(T()), max(T())
+	{}
+
+	VolumeDataView<T>(const VolumeData<T>& volumeData)
+		: size_x(volumeData.size_x), size_y(volumeData.size_y), size_z(volumeData.size_z)
+		, data(volumeData.data.empty() ? nullptr : &volumeData.data[0])
+		, real_size_x(volumeData.real_size_x), real_size_y(volumeData.real_size_y), real_size_z(volumeData.real_size_z)
+		, min(volumeData.min), max(volumeData.max)
+	{}
+
+	inline size_t getNumVoxels() const { return (size_t) size_x * (size_t) size_y * (size_t) size_z; }
 };
 
 #endif
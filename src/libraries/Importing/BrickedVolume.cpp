@@ -0,0 +1,55 @@
+#include "BrickedVolume.h"
+
+bool BrickedVolume::seek(FILE* file, unsigned long long offset)
+{
+#ifdef _WIN32
+	return _fseeki64(file, (__int64) offset, SEEK_SET) == 0;
+#else
+	return fseeko(file, (off_t) offset, SEEK_SET) == 0;
+#endif
+}
+
+unsigned long long BrickedVolume::tell(FILE* file)
+{
+#ifdef _WIN32
+	return (unsigned long long) _ftelli64(file);
+#else
+	return (unsigned long long) ftello(file);
+#endif
+}
+
+void BrickedVolume::computeLayout(Header& header, unsigned long long size_x, unsigned long long size_y, unsigned long long size_z, unsigned int brickSize, unsigned int numLevels)
+{
+	header.brickSize = brickSize;
+	if (numLevels == 0 || numLevels > MAX_LEVELS) { numLevels = MAX_LEVELS; }
+
+	unsigned long long size[3] = { size_x, size_y, size_z };
+	unsigned long long offset = sizeof(Header);
+	header.numLevels = 0;
+	for (unsigned int l = 0; l < numLevels; l++)
+	{
+		for (int a = 0; a < 3; a++)
+		{
+			header.levelSize[l][a] = size[a];
+			header.numBricks[l][a] = (unsigned int) ((size[a] + brickSize - 1) / brickSize);
+		}
+		header.indexOffset[l] = offset;
+		offset += getNumBricks(header, l) * sizeof(unsigned long long);
+		header.numLevels++;
+
+		// stop at the first level that fits into a single brick, or at a single voxel
+		if (getNumBricks(header, l) == 1 || (size[0] == 1 && size[1] == 1 && size[2] == 1)) { break; }
+		for (int a = 0; a < 3; a++) { size[a] = std::max<unsigned long long>(1, size[a] / 2); }
+	}
+}
+
+unsigned long long BrickedVolume::getNumBricks(const Header& header, unsigned int level)
+{
+	return (unsigned long long) header.numBricks[level][0] * header.numBricks[level][1] * header.numBricks[level][2];
+}
+
+unsigned long long BrickedVolume::getDataOffset(const Header& header)
+{
+	unsigned int last = header.numLevels - 1;
+	return header.indexOffset[last] + getNumBricks(header, last) * sizeof(unsigned long long);
+}
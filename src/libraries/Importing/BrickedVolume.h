@@ -0,0 +1,577 @@
+#ifndef IMPORTING_BRICKEDVOLUME_H_
+#define IMPORTING_BRICKEDVOLUME_H_
+
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <list>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <unordered_map>
+
+#ifdef MINGW_THREADS
+	#include <mingw-std-threads/mingw.mutex.h>
+#else
+	#include <mutex>
+#endif
+
+#include <Core/DebugLog.h>
+#include <Core/SimdTools.h>
+
+/**
+ * On-disk volume split into cubic bricks (64^3 voxels by default), for volumes larger than RAM or 4G voxels.
+ * Every level of a mip pyramid is stored alongside level 0, each with its own brick index.
+ *
+ * File layout:
+ *   BrickedVolume::Header
+ *   per level: 64 bit file offset per brick, x-fastest, 0 for bricks that were never written (all zero)
+ *   bricks of brickSize^3 voxels, x-fastest, bricks at the border are padded with zeros
+ */
+namespace BrickedVolume
+{
+	static const unsigned int VERSION = 1;
+	static const unsigned int MAX_LEVELS = 16;
+	static const unsigned int DEFAULT_BRICK_SIZE = 64;
+	static const unsigned int BRICK_ALIGNMENT = 4096; //!< of every brick in the file, one page
+
+	struct Header
+	{
+		char magic[8];
+		unsigned int version;
+		unsigned int byteOrderMark; //!< 0x01020304 in native byte order
+
+		unsigned int elementSize;
+		unsigned int isInteger;
+		unsigned int isSigned;
+
+		unsigned int brickSize;
+		unsigned int numLevels;
+		unsigned long long levelSize[MAX_LEVELS][3];
+		unsigned int numBricks[MAX_LEVELS][3];
+		unsigned long long indexOffset[MAX_LEVELS]; //!< bytes from start of file
+
+		double min, max; //!< of level 0
+	};
+
+	template<class T>
+	void fillHeader(Header& header)
+	{
+		memset(&header, 0, sizeof(Header));
+		memcpy(header.magic, "VRVBRICK", 8);
+		header.version = VERSION;
+		header.byteOrderMark = 0x01020304;
+		header.elementSize = sizeof(T);
+		header.isInteger = std::numeric_limits<T>::is_integer ? 1 : 0;
+		header.isSigned = std::numeric_limits<T>::is_signed ? 1 : 0;
+	}
+
+	bool seek(FILE* file, unsigned long long offset); //!< 64 bit fseek from start of file
+	unsigned long long tell(FILE* file); //!< 64 bit ftell
+
+	/**
+	 * @brief fill level sizes, brick counts and index offsets
+	 * @param numLevels 0: down to the first level that fits into a single brick
+	 */
+	void computeLayout(Header& header, unsigned long long size_x, unsigned long long size_y, unsigned long long size_z, unsigned int brickSize, unsigned int numLevels);
+	unsigned long long getNumBricks(const Header& header, unsigned int level); //!< of one level
+	unsigned long long getDataOffset(const Header& header); //!< first byte after the last index
+}
+
+/**
+ * @brief creates a bricked volume file. Voxels are streamed in either as whole slices in z order (appendSlices),
+ *        i.e. straight from an importer, or as individual bricks. Lower levels are derived from level 0 on finish().
+ */
+template<class T>
+class BrickedVolumeWriter
+{
+protected:
+	FILE* m_file;
+	std::string m_path;
+	BrickedVolume::Header m_header;
+	std::vector< std::vector<unsigned long long> > m_index; //!< per level, brick file offsets
+
+	std::vector<T> m_slab; //!< brickSize slices of level 0 that are not written yet
+	unsigned long long m_numSlabSlices;
+	unsigned long long m_nextSlice; //!< z of the first slice in m_slab
+	bool m_hasMinMax;
+
+	bool writeSlab();
+	bool readRegion(unsigned int level, unsigned long long x0, unsigned long long y0, unsigned long long z0, unsigned long long sx, unsigned long long sy, unsigned long long sz, T* result);
+	bool buildLevel(unsigned int level);
+
+public:
+	BrickedVolumeWriter() : m_file(NULL), m_numSlabSlices(0), m_nextSlice(0), m_hasMinMax(false) { BrickedVolume::fillHeader<T>(m_header); }
+	virtual ~BrickedVolumeWriter() { if (m_file != NULL) { finish(); } }
+
+	/**
+	 * @brief create (or overwrite) a bricked volume file
+	 * @param numLevels (optional) number of levels including level 0, 0: down to a level that fits into a single brick
+	 */
+	bool create(std::string path, unsigned long long size_x, unsigned long long size_y, unsigned long long size_z,
+		unsigned int brickSize = BrickedVolume::DEFAULT_BRICK_SIZE, unsigned int numLevels = 0);
+
+	/** @brief write a brick of level 0 (or a lower level, which finish() will then not overwrite), data holds brickSize^3 voxels */
+	bool writeBrick(unsigned int level, unsigned int bx, unsigned int by, unsigned int bz, const T* data);
+
+	/** @brief stream whole slices of level 0 in z order, only brickSize slices are held in memory at any time */
+	bool appendSlices(const T* slices, unsigned long long numSlices);
+
+	/** @brief flush remaining slices, derive the lower levels by 2x2x2 box filtering, write the index and close the file */
+	bool finish();
+
+	inline const BrickedVolume::Header& getHeader() const { return m_header; }
+};
+
+/**
+ * @brief paged reader of a bricked volume file. Only the header and the brick index are read on open, bricks are read
+ *        from their byte range in the file on request and kept in an LRU cache that stays below a memory budget,
+ *        so memory use is bounded by the budget plus the index, independent of the file size. Thread-safe.
+ */
+template<class T>
+class BrickedVolumeReader
+{
+public:
+	typedef std::shared_ptr< const std::vector<T> > BrickPtr; //!< stays valid while held, even if the brick was evicted
+
+protected:
+	FILE* m_file;
+	std::mutex m_fileMutex; //!< one seek and read at a time
+	BrickedVolume::Header m_header;
+	std::vector<unsigned long long> m_index[BrickedVolume::MAX_LEVELS]; //!< per level, brick file offsets
+	unsigned long long m_levelKeyOffset[BrickedVolume::MAX_LEVELS]; //!< brick keys are unique across levels
+
+	std::mutex m_mutex;
+	size_t m_memoryBudget;
+	size_t m_residentBytes;
+	std::list<unsigned long long> m_lru; //!< most recently used first
+	std::unordered_map<unsigned long long, std::pair<BrickPtr, std::list<unsigned long long>::iterator> > m_bricks;
+	BrickPtr m_emptyBrick;
+
+	void evict(); //!< drop least recently used bricks until below budget, requires m_mutex
+	bool read(unsigned long long offset, void* data, size_t bytes); //!< from the file, serialized by m_fileMutex
+
+public:
+	BrickedVolumeReader() : m_file(NULL), m_memoryBudget(512u << 20), m_residentBytes(0) { BrickedVolume::fillHeader<T>(m_header); }
+	virtual ~BrickedVolumeReader() { close(); }
+
+	/**
+	 * @brief open a bricked volume file, reads header and brick index
+	 * @param memoryBudget (optional) bytes of resident bricks
+	 */
+	bool open(std::string path, size_t memoryBudget = 512u << 20);
+	void close();
+
+	/** @brief voxels of a brick, loaded from disk if not resident, nullptr if out of range */
+	BrickPtr getBrick(unsigned int level, unsigned int bx, unsigned int by, unsigned int bz);
+
+	/**
+	 * @brief copy an arbitrary box of voxels, assembled from all bricks it touches
+	 * @param result must hold sx * sy * sz voxels, x-fastest. Voxels outside the volume are set to 0
+	 */
+	bool readRegion(unsigned int level, unsigned long long x0, unsigned long long y0, unsigned long long z0,
+		unsigned long long sx, unsigned long long sy, unsigned long long sz, T* result);
+
+	void setMemoryBudget(size_t bytes);
+	size_t getResidentBytes();
+
+	inline bool isOpen() const { return m_file != NULL; }
+	inline unsigned int getNumLevels() const { return m_header.numLevels; }
+	inline unsigned int getBrickSize() const { return m_header.brickSize; }
+	inline const unsigned long long* getLevelSize(unsigned int level) const { return m_header.levelSize[level]; } //!< x, y, z
+	inline const unsigned int* getNumBricks(unsigned int level) const { return m_header.numBricks[level]; } //!< x, y, z
+	inline T getMin() const { return (T) m_header.min; }
+	inline T getMax() const { return (T) m_header.max; }
+};
+
+////// IMPLEMENTATION
+template<class T>
+bool BrickedVolumeWriter<T>::create(std::string path, unsigned long long size_x, unsigned long long size_y, unsigned long long size_z, unsigned int brickSize, unsigned int numLevels)
+{
+	if (m_file != NULL) { finish(); }
+	if (size_x == 0 || size_y == 0 || size_z == 0 || brickSize == 0)
+	{
+		DEBUGLOG->log("ERROR: invalid bricked volume size: " + path);
+		return false;
+	}
+
+	BrickedVolume::fillHeader<T>(m_header);
+	BrickedVolume::computeLayout(m_header, size_x, size_y, size_z, brickSize, numLevels);
+
+	m_file = fopen(path.c_str(), "w+b");
+	if (m_file == NULL)
+	{
+		DEBUGLOG->log("ERROR: could not create bricked volume: " + path);
+		return false;
+	}
+	m_path = path;
+
+	m_index.assign(m_header.numLevels, std::vector<unsigned long long>());
+	for (unsigned int l = 0; l < m_header.numLevels; l++)
+	{
+		m_index[l].assign((size_t) BrickedVolume::getNumBricks(m_header, l), 0);
+	}
+
+	m_slab.assign((size_t) (brickSize * size_x * size_y), T());
+	m_numSlabSlices = 0;
+	m_nextSlice = 0;
+	m_hasMinMax = false;
+
+	// reserve header and index, bricks are appended after them
+	std::vector<unsigned char> zeros((size_t) BrickedVolume::getDataOffset(m_header), 0);
+	return fwrite(&zeros[0], 1, zeros.size(), m_file) == zeros.size();
+}
+
+template<class T>
+bool BrickedVolumeWriter<T>::writeBrick(unsigned int level, unsigned int bx, unsigned int by, unsigned int bz, const T* data)
+{
+	if (m_file == NULL || level >= m_header.numLevels
+		|| bx >= m_header.numBricks[level][0] || by >= m_header.numBricks[level][1] || bz >= m_header.numBricks[level][2])
+	{
+		return false;
+	}
+
+	const unsigned long long brickVoxels = (unsigned long long) m_header.brickSize * m_header.brickSize * m_header.brickSize;
+	unsigned long long& offset = m_index[level][((size_t) bz * m_header.numBricks[level][1] + by) * m_header.numBricks[level][0] + bx];
+	if (offset == 0)
+	{
+		// append, page aligned
+		fseek(m_file, 0, SEEK_END);
+		offset = (BrickedVolume::tell(m_file) + BrickedVolume::BRICK_ALIGNMENT - 1) / BrickedVolume::BRICK_ALIGNMENT * BrickedVolume::BRICK_ALIGNMENT;
+	}
+	if (!BrickedVolume::seek(m_file, offset) || fwrite(data, sizeof(T), (size_t) brickVoxels, m_file) != brickVoxels)
+	{
+		DEBUGLOG->log("ERROR: could not write brick to " + m_path);
+		return false;
+	}
+
+	if (level == 0)
+	{
+		// padding voxels are 0 and must not affect the range, so only scan the valid part
+		const unsigned int B = m_header.brickSize;
+		unsigned long long vx = std::min<unsigned long long>(B, m_header.levelSize[0][0] - (unsigned long long) bx * B);
+		unsigned long long vy = std::min<unsigned long long>(B, m_header.levelSize[0][1] - (unsigned long long) by * B);
+		unsigned long long vz = std::min<unsigned long long>(B, m_header.levelSize[0][2] - (unsigned long long) bz * B);
+		T min = m_hasMinMax ? (T) m_header.min : data[0];
+		T max = m_hasMinMax ? (T) m_header.max : data[0];
+		for (unsigned long long z = 0; z < vz; z++) { for (unsigned long long y = 0; y < vy; y++)
+		{
+			SimdTools::updateMinMax(data + (z * B + y) * B, (size_t) vx, min, max);
+		}}
+		m_header.min = (double) min;
+		m_header.max = (double) max;
+		m_hasMinMax = true;
+	}
+	return true;
+}
+
+template<class T>
+bool BrickedVolumeWriter<T>::writeSlab()
+{
+	if (m_numSlabSlices == 0) { return true; }
+
+	const unsigned int B = m_header.brickSize;
+	const unsigned long long size_x = m_header.levelSize[0][0];
+	const unsigned long long size_y = m_header.levelSize[0][1];
+	const unsigned int bz = (unsigned int) (m_nextSlice / B);
+	std::vector<T> brick((size_t) B * B * B);
+
+	bool success = true;
+	for (unsigned int by = 0; by < m_header.numBricks[0][1]; by++) { for (unsigned int bx = 0; bx < m_header.numBricks[0][0]; bx++)
+	{
+		std::fill(brick.begin(), brick.end(), T());
+		unsigned long long x0 = (unsigned long long) bx * B, y0 = (unsigned long long) by * B;
+		unsigned long long vx = std::min<unsigned long long>(B, size_x - x0);
+		unsigned long long vy = std::min<unsigned long long>(B, size_y - y0);
+		for (unsigned long long z = 0; z < m_numSlabSlices; z++) { for (unsigned long long y = 0; y < vy; y++)
+		{
+			memcpy(&brick[(size_t) ((z * B + y) * B)], &m_slab[(size_t) ((z * size_y + y0 + y) * size_x + x0)], (size_t) vx * sizeof(T));
+		}}
+		success &= writeBrick(0, bx, by, bz, &brick[0]);
+	}}
+
+	m_nextSlice += m_numSlabSlices;
+	m_numSlabSlices = 0;
+	return success;
+}
+
+template<class T>
+bool BrickedVolumeWriter<T>::appendSlices(const T* slices, unsigned long long numSlices)
+{
+	if (m_file == NULL || m_nextSlice + m_numSlabSlices + numSlices > m_header.levelSize[0][2])
+	{
+		DEBUGLOG->log("ERROR: too many slices for bricked volume " + m_path);
+		return false;
+	}
+
+	const unsigned long long sliceSize = m_header.levelSize[0][0] * m_header.levelSize[0][1];
+	while (numSlices > 0)
+	{
+		unsigned long long count = std::min<unsigned long long>(numSlices, m_header.brickSize - m_numSlabSlices);
+		memcpy(&m_slab[(size_t) (m_numSlabSlices * sliceSize)], slices, (size_t) (count * sliceSize) * sizeof(T));
+		m_numSlabSlices += count;
+		slices += count * sliceSize;
+		numSlices -= count;
+
+		if (m_numSlabSlices == m_header.brickSize && !writeSlab()) { return false; }
+	}
+	return true;
+}
+
+template<class T>
+bool BrickedVolumeWriter<T>::readRegion(unsigned int level, unsigned long long x0, unsigned long long y0, unsigned long long z0, unsigned long long sx, unsigned long long sy, unsigned long long sz, T* result)
+{
+	const unsigned int B = m_header.brickSize;
+	std::vector<T> brick((size_t) B * B * B);
+	fflush(m_file);
+
+	for (unsigned long long bz = z0 / B; bz * B < z0 + sz; bz++) { for (unsigned long long by = y0 / B; by * B < y0 + sy; by++) { for (unsigned long long bx = x0 / B; bx * B < x0 + sx; bx++)
+	{
+		unsigned long long offset = m_index[level][(size_t) ((bz * m_header.numBricks[level][1] + by) * m_header.numBricks[level][0] + bx)];
+		if (offset == 0) { std::fill(brick.begin(), brick.end(), T()); }
+		else if (!BrickedVolume::seek(m_file, offset) || fread(&brick[0], sizeof(T), brick.size(), m_file) != brick.size()) { return false; }
+
+		// intersection of brick and region
+		unsigned long long bx0 = std::max(x0, bx * B), bx1 = std::min(x0 + sx, (bx + 1) * B);
+		unsigned long long by0 = std::max(y0, by * B), by1 = std::min(y0 + sy, (by + 1) * B);
+		unsigned long long bz0 = std::max(z0, bz * B), bz1 = std::min(z0 + sz, (bz + 1) * B);
+		for (unsigned long long z = bz0; z < bz1; z++) { for (unsigned long long y = by0; y < by1; y++)
+		{
+			memcpy(result + ((z - z0) * sy + (y - y0)) * sx + (bx0 - x0), &brick[(size_t) ((((z - bz * B) * B) + (y - by * B)) * B + (bx0 - bx * B))], (size_t) (bx1 - bx0) * sizeof(T));
+		}}
+	}}}
+	return true;
+}
+
+template<class T>
+bool BrickedVolumeWriter<T>::buildLevel(unsigned int level)
+{
+	const unsigned int B = m_header.brickSize;
+	const unsigned long long* fineSize = m_header.levelSize[level - 1];
+	std::vector<T> fine((size_t) 8 * B * B * B);
+	std::vector<T> brick((size_t) B * B * B);
+
+	for (unsigned int bz = 0; bz < m_header.numBricks[level][2]; bz++) { for (unsigned int by = 0; by < m_header.numBricks[level][1]; by++) { for (unsigned int bx = 0; bx < m_header.numBricks[level][0]; bx++)
+	{
+		if (m_index[level][((size_t) bz * m_header.numBricks[level][1] + by) * m_header.numBricks[level][0] + bx] != 0) { continue; } // written explicitly
+
+		// fine region covered by this brick, clamped to the fine level
+		unsigned long long f0[3] = { 2ULL * bx * B, 2ULL * by * B, 2ULL * bz * B };
+		unsigned long long fs[3];
+		for (int a = 0; a < 3; a++) { fs[a] = std::min<unsigned long long>(2 * B, fineSize[a] - f0[a]); }
+		if (!readRegion(level - 1, f0[0], f0[1], f0[2], fs[0], fs[1], fs[2], &fine[0])) { return false; }
+
+		std::fill(brick.begin(), brick.end(), T());
+		unsigned long long vx = std::min<unsigned long long>(B, m_header.levelSize[level][0] - (unsigned long long) bx * B);
+		unsigned long long vy = std::min<unsigned long long>(B, m_header.levelSize[level][1] - (unsigned long long) by * B);
+		unsigned long long vz = std::min<unsigned long long>(B, m_header.levelSize[level][2] - (unsigned long long) bz * B);
+		for (unsigned long long z = 0; z < vz; z++) { for (unsigned long long y = 0; y < vy; y++) { for (unsigned long long x = 0; x < vx; x++)
+		{
+			double sum = 0.0;
+			for (int dz = 0; dz < 2; dz++) { for (int dy = 0; dy < 2; dy++) { for (int dx = 0; dx < 2; dx++)
+			{
+				unsigned long long fx = std::min(2 * x + dx, fs[0] - 1), fy = std::min(2 * y + dy, fs[1] - 1), fz = std::min(2 * z + dz, fs[2] - 1);
+				sum += (double) fine[(size_t) ((fz * fs[1] + fy) * fs[0] + fx)];
+			}}}
+			brick[(size_t) ((z * B + y) * B + x)] = std::numeric_limits<T>::is_integer ? (T) std::floor(sum / 8.0 + 0.5) : (T) (sum / 8.0);
+		}}}
+
+		if (!writeBrick(level, bx, by, bz, &brick[0])) { return false; }
+	}}}
+	return true;
+}
+
+template<class T>
+bool BrickedVolumeWriter<T>::finish()
+{
+	if (m_file == NULL) { return false; }
+
+	bool success = writeSlab();
+	for (unsigned int l = 1; l < m_header.numLevels && success; l++)
+	{
+		success = buildLevel(l);
+	}
+
+	// header and index
+	success = success && BrickedVolume::seek(m_file, 0) && fwrite(&m_header, sizeof(BrickedVolume::Header), 1, m_file) == 1;
+	for (unsigned int l = 0; l < m_header.numLevels && success; l++)
+	{
+		success = BrickedVolume::seek(m_file, m_header.indexOffset[l]) && fwrite(&m_index[l][0], sizeof(unsigned long long), m_index[l].size(), m_file) == m_index[l].size();
+	}
+	success = (fclose(m_file) == 0) && success;
+	m_file = NULL;
+	m_slab = std::vector<T>();
+
+	if (!success)
+	{
+		DEBUGLOG->log("ERROR: could not finish bricked volume " + m_path);
+	}
+	return success;
+}
+
+template<class T>
+bool BrickedVolumeReader<T>::open(std::string path, size_t memoryBudget)
+{
+	close();
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_memoryBudget = memoryBudget;
+	}
+
+	BrickedVolume::Header expected;
+	BrickedVolume::fillHeader<T>(expected);
+	m_file = fopen(path.c_str(), "rb");
+	if (m_file == NULL) { return false; }
+
+	if (!read(0, &m_header, sizeof(BrickedVolume::Header))) { close(); return false; }
+	if (memcmp(m_header.magic, expected.magic, 8) != 0
+		|| m_header.version != expected.version
+		|| m_header.byteOrderMark != expected.byteOrderMark
+		|| m_header.elementSize != expected.elementSize
+		|| m_header.isInteger != expected.isInteger
+		|| m_header.isSigned != expected.isSigned
+		|| m_header.numLevels == 0 || m_header.numLevels > BrickedVolume::MAX_LEVELS)
+	{
+		DEBUGLOG->log("ERROR: not a compatible bricked volume: " + path);
+		close();
+		return false;
+	}
+
+	unsigned long long key = 0;
+	for (unsigned int l = 0; l < m_header.numLevels; l++)
+	{
+		m_index[l].resize((size_t) BrickedVolume::getNumBricks(m_header, l));
+		if (!read(m_header.indexOffset[l], &m_index[l][0], m_index[l].size() * sizeof(unsigned long long)))
+		{
+			DEBUGLOG->log("ERROR: truncated bricked volume index: " + path);
+			close();
+			return false;
+		}
+		m_levelKeyOffset[l] = key;
+		key += m_index[l].size();
+	}
+
+	m_emptyBrick = std::make_shared< const std::vector<T> >((size_t) m_header.brickSize * m_header.brickSize * m_header.brickSize, T());
+	return true;
+}
+
+template<class T>
+void BrickedVolumeReader<T>::close()
+{
+	if (m_file != NULL) { fclose(m_file); }
+	m_file = NULL;
+	for (unsigned int l = 0; l < BrickedVolume::MAX_LEVELS; l++) { m_index[l].clear(); }
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_bricks.clear();
+	m_lru.clear();
+	m_residentBytes = 0;
+}
+
+template<class T>
+bool BrickedVolumeReader<T>::read(unsigned long long offset, void* data, size_t bytes)
+{
+	std::unique_lock<std::mutex> lock(m_fileMutex);
+	return BrickedVolume::seek(m_file, offset) && fread(data, 1, bytes, m_file) == bytes;
+}
+
+template<class T>
+void BrickedVolumeReader<T>::evict()
+{
+	while (m_residentBytes > m_memoryBudget && !m_lru.empty())
+	{
+		auto it = m_bricks.find(m_lru.back());
+		m_residentBytes -= it->second.first->size() * sizeof(T);
+		m_bricks.erase(it);
+		m_lru.pop_back();
+	}
+}
+
+template<class T>
+typename BrickedVolumeReader<T>::BrickPtr BrickedVolumeReader<T>::getBrick(unsigned int level, unsigned int bx, unsigned int by, unsigned int bz)
+{
+	if (!isOpen() || level >= m_header.numLevels
+		|| bx >= m_header.numBricks[level][0] || by >= m_header.numBricks[level][1] || bz >= m_header.numBricks[level][2])
+	{
+		return nullptr;
+	}
+
+	unsigned long long brickIndex = ((unsigned long long) bz * m_header.numBricks[level][1] + by) * m_header.numBricks[level][0] + bx;
+	unsigned long long offset = m_index[level][brickIndex];
+	if (offset == 0) { return m_emptyBrick; }
+
+	unsigned long long key = m_levelKeyOffset[level] + brickIndex;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		auto it = m_bricks.find(key);
+		if (it != m_bricks.end())
+		{
+			m_lru.splice(m_lru.begin(), m_lru, it->second.second); // mark as most recently used
+			return it->second.first;
+		}
+	}
+
+	// read outside of the cache lock, so other threads can hit the cache meanwhile
+	size_t brickVoxels = m_emptyBrick->size();
+	std::shared_ptr< std::vector<T> > brick = std::make_shared< std::vector<T> >(brickVoxels);
+	if (!read(offset, &(*brick)[0], brickVoxels * sizeof(T))) { return nullptr; }
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	auto it = m_bricks.find(key);
+	if (it != m_bricks.end()) { return it->second.first; } // loaded by another thread meanwhile
+
+	m_lru.push_front(key);
+	m_bricks[key] = std::make_pair(BrickPtr(brick), m_lru.begin());
+	m_residentBytes += brickVoxels * sizeof(T);
+	evict();
+	return brick;
+}
+
+template<class T>
+bool BrickedVolumeReader<T>::readRegion(unsigned int level, unsigned long long x0, unsigned long long y0, unsigned long long z0,
+	unsigned long long sx, unsigned long long sy, unsigned long long sz, T* result)
+{
+	if (!isOpen() || level >= m_header.numLevels) { return false; }
+
+	const unsigned long long B = m_header.brickSize;
+	const unsigned long long* size = m_header.levelSize[level];
+	std::fill(result, result + sx * sy * sz, T());
+
+	// clamp to the volume, the rest stays 0
+	unsigned long long ex = std::min(x0 + sx, size[0]), ey = std::min(y0 + sy, size[1]), ez = std::min(z0 + sz, size[2]);
+	if (x0 >= ex || y0 >= ey || z0 >= ez) { return true; }
+
+	for (unsigned long long bz = z0 / B; bz * B < ez; bz++) { for (unsigned long long by = y0 / B; by * B < ey; by++) { for (unsigned long long bx = x0 / B; bx * B < ex; bx++)
+	{
+		BrickPtr brick = getBrick(level, (unsigned int) bx, (unsigned int) by, (unsigned int) bz);
+		if (!brick) { return false; }
+
+		unsigned long long bx0 = std::max(x0, bx * B), bx1 = std::min(ex, (bx + 1) * B);
+		unsigned long long by0 = std::max(y0, by * B), by1 = std::min(ey, (by + 1) * B);
+		unsigned long long bz0 = std::max(z0, bz * B), bz1 = std::min(ez, (bz + 1) * B);
+		for (unsigned long long z = bz0; z < bz1; z++) { for (unsigned long long y = by0; y < by1; y++)
+		{
+			memcpy(result + ((z - z0) * sy + (y - y0)) * sx + (bx0 - x0), &(*brick)[(size_t) (((z - bz * B) * B + (y - by * B)) * B + (bx0 - bx * B))], (size_t) (bx1 - bx0) * sizeof(T));
+		}}
+	}}}
+	return true;
+}
+
+template<class T>
+void BrickedVolumeReader<T>::setMemoryBudget(size_t bytes)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_memoryBudget = bytes;
+	evict();
+}
+
+template<class T>
+size_t BrickedVolumeReader<T>::getResidentBytes()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	return m_residentBytes;
+}
+
+#endif
@@ -0,0 +1,243 @@
+#include "ChunkedPVM.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+
+#include <Core/DebugLog.h>
+#include <Core/MappedFile.h>
+#include <Core/ThreadPool.h>
+
+#include "ddsbase.h"
+#include "ImportProgress.h"
+#include "VolumeExport.h"
+
+namespace {
+const char* CHUNKED_PVM_ID = "PVMC\n";
+const unsigned int NUM_HEADER_LINES = 4; //!< lines after the id, see ChunkedPVM.h
+const size_t MAX_HEADER_SIZE = 256;
+
+void writeUInt64(std::ofstream& file, unsigned long long value)
+{
+	unsigned char bytes[8];
+	for (int i = 0; i < 8; i++) { bytes[i] = (unsigned char) (value >> (56 - 8 * i)); }
+	file.write((const char*) bytes, 8);
+}
+
+unsigned long long readUInt64(const unsigned char* bytes)
+{
+	unsigned long long value = 0;
+	for (int i = 0; i < 8; i++) { value = (value << 8) | bytes[i]; }
+	return value;
+}
+}
+
+bool ChunkedPVM::writeVolume(std::string path, const unsigned char* volume,
+	unsigned int width, unsigned int height, unsigned int depth, unsigned int components,
+	float scalex, float scaley, float scalez,
+	unsigned int slabDepth)
+{
+	const size_t sliceBytes = (size_t) width * height * components;
+	return writeVolume(path, [volume, sliceBytes](unsigned int firstSlice, unsigned int, std::vector<unsigned char>&)
+	{
+		return volume + firstSlice * sliceBytes;
+	}, width, height, depth, components, scalex, scaley, scalez, slabDepth);
+}
+
+bool ChunkedPVM::writeVolume(std::string path, SlabFunc getSlab,
+	unsigned int width, unsigned int height, unsigned int depth, unsigned int components,
+	float scalex, float scaley, float scalez,
+	unsigned int slabDepth)
+{
+	if (width == 0 || height == 0 || depth == 0 || components == 0 || components > 4)
+	{
+		DEBUGLOG->log("ERROR: invalid volume dimensions for " + path);
+		return false;
+	}
+
+	const size_t sliceBytes = (size_t) width * height * components;
+	if (slabDepth == 0)
+	{
+		slabDepth = (unsigned int) std::max<size_t>(1, DEFAULT_SLAB_BYTES / sliceBytes);
+	}
+	slabDepth = std::min(slabDepth, depth);
+	if (sliceBytes * slabDepth > 0xFFFFFFFFu)
+	{
+		DEBUGLOG->log("ERROR: slabs too large for a DDS stream: " + path);
+		return false;
+	}
+	const unsigned int numSlabs = (depth + slabDepth - 1) / slabDepth;
+
+	std::ofstream file(path.c_str(), std::ofstream::binary | std::ofstream::trunc);
+	if (!file.is_open())
+	{
+		DEBUGLOG->log("ERROR: could not write " + path);
+		return false;
+	}
+
+	char header[MAX_HEADER_SIZE];
+	sprintf(header, "%s%u %u %u\n%g %g %g\n%u\n%u %u\n", CHUNKED_PVM_ID, width, height, depth, scalex, scaley, scalez, components, slabDepth, numSlabs);
+	file.write(header, strlen(header));
+
+	// the offset index is written once the stream sizes are known
+	const std::streamoff indexPosition = (std::streamoff) strlen(header);
+	for (unsigned int i = 0; i <= numSlabs; i++) { writeUInt64(file, 0); }
+
+	std::vector<unsigned long long> streamSizes;
+	bool success = VolumeExport::writeSlabs(file, depth, slabDepth, [&](unsigned int firstSlice, unsigned int numSlices, std::vector<unsigned char>& bytes)
+	{
+		std::vector<unsigned char> scratch;
+		const unsigned char* slab = getSlab(firstSlice, numSlices, scratch);
+		unsigned char* stream = NULL;
+		unsigned int streamSize = 0;
+		encodeDDSstream(slab, (unsigned int) (numSlices * sliceBytes), components, width, &stream, &streamSize);
+		bytes.assign(stream, stream + streamSize);
+		free(stream);
+	}, &streamSizes);
+
+	if (success)
+	{
+		file.seekp(indexPosition);
+		unsigned long long offset = 0;
+		for (unsigned int i = 0; i <= numSlabs; i++)
+		{
+			writeUInt64(file, offset);
+			if (i < numSlabs) { offset += streamSizes[i]; }
+		}
+		success = file.good();
+	}
+	file.close();
+
+	if (!success)
+	{
+		DEBUGLOG->log("ERROR: could not write " + path);
+		remove(path.c_str());
+	}
+	return success;
+}
+
+bool ChunkedPVM::isChunked(std::string path)
+{
+	char id[8] = {0};
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == NULL) { return false; }
+	size_t read = fread(id, 1, strlen(CHUNKED_PVM_ID), file);
+	fclose(file);
+	return read == strlen(CHUNKED_PVM_ID) && strncmp(id, CHUNKED_PVM_ID, strlen(CHUNKED_PVM_ID)) == 0;
+}
+
+unsigned char* ChunkedPVM::readVolume(std::string path,
+	unsigned int* width, unsigned int* height, unsigned int* depth, unsigned int* components,
+	float* scalex, float* scaley, float* scalez)
+{
+	if (!isChunked(path))
+	{
+		// legacy single stream PVM
+		return readPVMvolume(path.c_str(), width, height, depth, components, scalex, scaley, scalez);
+	}
+
+	MappedFile file;
+	if (!file.open(path))
+	{
+		return NULL;
+	}
+
+	// parse header
+	const unsigned char* data = file.getData();
+	size_t headerSize = strlen(CHUNKED_PVM_ID);
+	unsigned int lines = 0;
+	for (; lines < NUM_HEADER_LINES && headerSize < file.getSize() && headerSize < MAX_HEADER_SIZE; headerSize++)
+	{
+		if (data[headerSize] == '\n') { lines++; }
+	}
+	char header[MAX_HEADER_SIZE + 1];
+	memcpy(header, data, headerSize);
+	header[headerSize] = '\0';
+
+	unsigned int w, h, d, c, slabDepth, numSlabs;
+	float sx, sy, sz;
+	if (lines != NUM_HEADER_LINES
+		|| sscanf(header + strlen(CHUNKED_PVM_ID), "%u %u %u\n%g %g %g\n%u\n%u %u\n", &w, &h, &d, &sx, &sy, &sz, &c, &slabDepth, &numSlabs) != 9
+		|| w == 0 || h == 0 || d == 0 || c == 0 || slabDepth == 0 || numSlabs != (d + slabDepth - 1) / slabDepth)
+	{
+		DEBUGLOG->log("ERROR: invalid chunked PVM header: " + path);
+		return NULL;
+	}
+
+	// read and check offset index
+	const unsigned long long indexSize = 8ULL * (numSlabs + 1);
+	if (file.getSize() < headerSize + indexSize)
+	{
+		DEBUGLOG->log("ERROR: chunked PVM file is truncated: " + path);
+		return NULL;
+	}
+	const unsigned char* streamBase = data + headerSize + indexSize;
+	const unsigned long long streamBytes = file.getSize() - headerSize - indexSize;
+	std::vector<unsigned long long> offsets(numSlabs + 1);
+	for (unsigned int i = 0; i <= numSlabs; i++)
+	{
+		offsets[i] = readUInt64(data + headerSize + 8 * i);
+		if (offsets[i] > streamBytes || (i > 0 && offsets[i] < offsets[i - 1]))
+		{
+			DEBUGLOG->log("ERROR: invalid chunked PVM offset index: " + path);
+			return NULL;
+		}
+	}
+
+	const size_t sliceBytes = (size_t) w * h * c;
+	unsigned char* volume = (unsigned char*) malloc(sliceBytes * d);
+	if (volume == NULL)
+	{
+		DEBUGLOG->log("ERROR: out of memory while reading " + path);
+		return NULL;
+	}
+
+	// decode all slabs concurrently, straight into their place
+	std::atomic<bool> success(true);
+	ImportProgress* progress = ImportProgress::getCurrent();
+	if (progress) { progress->addWork(numSlabs); }
+	THREADPOOL->parallelFor(0, numSlabs, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			if (progress && progress->isCancelled()) { success = false; continue; }
+
+			unsigned int slices = std::min(slabDepth, d - (unsigned int) i * slabDepth);
+			unsigned int slabBytes = (unsigned int) (slices * sliceBytes);
+			if (decodeDDSstream(streamBase + offsets[i], (unsigned int) (offsets[i + 1] - offsets[i]), volume + i * slabDepth * sliceBytes, slabBytes) != slabBytes)
+			{
+				success = false;
+			}
+			if (progress) { progress->advance(); }
+		}
+	}, 1);
+
+	if (progress && progress->isCancelled())
+	{
+		free(volume);
+		return NULL;
+	}
+	if (!success)
+	{
+		DEBUGLOG->log("ERROR: corrupt slab in chunked PVM file: " + path);
+		free(volume);
+		return NULL;
+	}
+
+	*width = w;
+	*height = h;
+	*depth = d;
+	if (components != NULL) { *components = c; }
+	if (scalex != NULL && scaley != NULL && scalez != NULL)
+	{
+		*scalex = sx;
+		*scaley = sy;
+		*scalez = sz;
+	}
+
+	return volume;
+}
@@ -0,0 +1,65 @@
+#ifndef IMPORTING_CHUNKEDPVM_H_
+#define IMPORTING_CHUNKEDPVM_H_
+
+#include <string>
+#include <vector>
+#include <functional>
+
+/**
+ * Chunked variant of the PVM format: the volume is split into slabs of whole slices along z,
+ * each of which is an independent DDS stream, so encoding and decoding run in parallel on the THREADPOOL.
+ * Other PVM readers do not understand it, hence the extension .pvmc (see VolumeExport::getFormat()).
+ *
+ * File layout:
+ *   "PVMC\n"
+ *   "<width> <height> <depth>\n<scalex> <scaley> <scalez>\n<components>\n<slab depth> <number of slabs>\n"
+ *   (number of slabs + 1) x 64 bit big endian offsets of the slab streams, relative to the first stream
+ *   slab streams
+ */
+namespace ChunkedPVM
+{
+	static const unsigned int DEFAULT_SLAB_BYTES = 1 << 20; //!< default uncompressed size of a slab, independent of the core count so files are reproducible
+
+	/**
+	 * @brief write a volume as chunked PVM file
+	 * @param path of the file to be written
+	 * @param volume voxels, x-fastest, components interleaved (16 bit values msb first, as in PVM)
+	 * @param slabDepth (optional) number of slices per slab, 0: about DEFAULT_SLAB_BYTES per slab
+	 * @return true if the file was written
+	 */
+	bool writeVolume(std::string path, const unsigned char* volume,
+		unsigned int width, unsigned int height, unsigned int depth, unsigned int components = 1,
+		float scalex = 1.0f, float scaley = 1.0f, float scalez = 1.0f,
+		unsigned int slabDepth = 0);
+
+	/**
+	 * @brief provides the bytes of a slab, called concurrently from the thread pool
+	 * @param firstSlice, numSlices of the slab
+	 * @param scratch (optional) buffer to convert the slab into
+	 * @return numSlices * width * height * components bytes, i.e. into the volume or scratch
+	 */
+	typedef std::function<const unsigned char*(unsigned int firstSlice, unsigned int numSlices, std::vector<unsigned char>& scratch)> SlabFunc;
+
+	/**
+	 * @brief write a volume as chunked PVM file while it is converted and encoded slab by slab,
+	 *        so only a few slabs are held in memory at any time (see VolumeExport::writeSlabs())
+	 */
+	bool writeVolume(std::string path, SlabFunc getSlab,
+		unsigned int width, unsigned int height, unsigned int depth, unsigned int components = 1,
+		float scalex = 1.0f, float scaley = 1.0f, float scalez = 1.0f,
+		unsigned int slabDepth = 0);
+
+	/**
+	 * @brief read a chunked PVM file, or any PVM file readPVMvolume understands
+	 * @param path of the file to be read
+	 * @param components (optional) bytes per voxel
+	 * @return volume allocated with malloc (release with free), NULL on failure
+	 */
+	unsigned char* readVolume(std::string path,
+		unsigned int* width, unsigned int* height, unsigned int* depth, unsigned int* components = NULL,
+		float* scalex = NULL, float* scaley = NULL, float* scalez = NULL);
+
+	bool isChunked(std::string path); //!< true if the file starts with the chunked PVM header
+}
+
+#endif
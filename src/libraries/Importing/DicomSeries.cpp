@@ -0,0 +1,514 @@
+#include "DicomSeries.h"
+
+#include "VoxelConversion.h"
+
+#include <Core/DebugLog.h>
+#include <Core/MappedFile.h>
+#include <Core/ThreadPool.h>
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <map>
+#include <algorithm>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+	#define NOMINMAX
+	#endif
+	#include <windows.h>
+#else
+	#include <dirent.h>
+#endif
+
+namespace {
+const unsigned int UNDEFINED_LENGTH = 0xFFFFFFFF;
+const unsigned int TAG_ITEM = 0xFFFEE000;
+const unsigned int TAG_ITEM_DELIMITER = 0xFFFEE00D;
+const unsigned int TAG_SEQUENCE_DELIMITER = 0xFFFEE0DD;
+const unsigned int TAG_PIXEL_DATA = 0x7FE00010;
+
+/** @brief read position in a mapped file, in the byte order and VR encoding of the current transfer syntax */
+struct Cursor
+{
+	const unsigned char* data;
+	size_t size;
+	size_t pos;
+	bool bigEndian;
+	bool explicitVR;
+
+	inline bool has(size_t n) const { return size - pos >= n; }
+
+	inline unsigned short get16(size_t at) const
+	{
+		return bigEndian ? (unsigned short) ((data[at] << 8) | data[at + 1]) : (unsigned short) (data[at] | (data[at + 1] << 8));
+	}
+	inline unsigned int get32(size_t at) const
+	{
+		return bigEndian ? ((unsigned int) get16(at) << 16) | get16(at + 2) : get16(at) | ((unsigned int) get16(at + 2) << 16);
+	}
+	inline unsigned short read16() { pos += 2; return get16(pos - 2); }
+	inline unsigned int read32() { pos += 4; return get32(pos - 4); }
+};
+
+struct Element
+{
+	unsigned int tag;
+	unsigned int length; //!< UNDEFINED_LENGTH for sequences and encapsulated pixel data that end with a delimiter
+	size_t valuePos;
+};
+
+bool hasLongLength(const unsigned char* vr)
+{
+	static const char* vrs[] = { "OB", "OD", "OF", "OL", "OV", "OW", "SQ", "SV", "UC", "UN", "UR", "UT", "UV" };
+	for (size_t i = 0; i < sizeof(vrs) / sizeof(vrs[0]); i++)
+	{
+		if (vr[0] == vrs[i][0] && vr[1] == vrs[i][1]) { return true; }
+	}
+	return false;
+}
+
+bool readElement(Cursor& c, Element& e)
+{
+	if (!c.has(8)) { return false; }
+	unsigned short group = c.read16();
+	unsigned short element = c.read16();
+	e.tag = ((unsigned int) group << 16) | element;
+	if (group == 0xFFFE || !c.explicitVR)
+	{
+		e.length = c.read32();
+	}
+	else
+	{
+		const unsigned char* vr = c.data + c.pos;
+		c.pos += 2;
+		if (hasLongLength(vr))
+		{
+			if (!c.has(6)) { return false; }
+			c.pos += 2;
+			e.length = c.read32();
+		}
+		else
+		{
+			e.length = c.read16();
+		}
+	}
+	e.valuePos = c.pos;
+	return true;
+}
+
+bool skipValue(Cursor& c, const Element& e);
+
+/** @brief skip the items of a sequence with undefined length, up to and including the sequence delimiter */
+bool skipItems(Cursor& c)
+{
+	Element e;
+	while (readElement(c, e))
+	{
+		if (e.tag == TAG_SEQUENCE_DELIMITER) { return true; }
+		if (e.tag != TAG_ITEM) { return false; }
+		if (e.length != UNDEFINED_LENGTH)
+		{
+			if (!skipValue(c, e)) { return false; }
+			continue;
+		}
+
+		// item with undefined length: elements up to the item delimiter, the file must not end before it
+		Element nested;
+		for (;;)
+		{
+			if (!readElement(c, nested)) { return false; }
+			if (nested.tag == TAG_ITEM_DELIMITER) { break; }
+			if (!skipValue(c, nested)) { return false; }
+		}
+	}
+	return false;
+}
+
+bool skipValue(Cursor& c, const Element& e)
+{
+	if (e.length == UNDEFINED_LENGTH) { return skipItems(c); }
+	if (!c.has(e.length)) { return false; }
+	c.pos += e.length;
+	return true;
+}
+
+std::string getString(const Cursor& c, const Element& e)
+{
+	std::string value((const char*) c.data + e.valuePos, e.length);
+	size_t end = value.find_last_not_of(std::string(" \0", 2));
+	size_t begin = value.find_first_not_of(' ');
+	return (end == std::string::npos) ? std::string() : value.substr(begin, end - begin + 1);
+}
+
+/** @brief parse a backslash separated list of decimal strings into values, returns the number of values found */
+int getDecimals(const Cursor& c, const Element& e, double* values, int maxValues)
+{
+	std::string s = getString(c, e);
+	int count = 0;
+	size_t pos = 0;
+	while (count < maxValues && pos <= s.size())
+	{
+		size_t end = s.find('\\', pos);
+		if (end == std::string::npos) { end = s.size(); }
+		if (end > pos) { values[count++] = atof(s.substr(pos, end - pos).c_str()); }
+		pos = end + 1;
+	}
+	return count;
+}
+
+/** @brief top level elements up to the pixel data */
+bool parseDataset(Cursor& c, DicomSeries::Slice& slice, unsigned int& samplesPerPixel, int& numFrames)
+{
+	Element e;
+	while (readElement(c, e))
+	{
+		if (e.tag == TAG_PIXEL_DATA)
+		{
+			slice.pixelDataOffset = e.valuePos;
+			slice.pixelDataLength = (e.length == UNDEFINED_LENGTH) ? 0 : e.length;
+			return (e.length == UNDEFINED_LENGTH) == (slice.compression != DicomSeries::NONE);
+		}
+		if (e.length == UNDEFINED_LENGTH)
+		{
+			if (!skipItems(c)) { return false; }
+			continue;
+		}
+		if (!c.has(e.length)) { return false; }
+
+		double values[6];
+		switch (e.tag)
+		{
+			case 0x00280010: slice.rows = c.get16(e.valuePos); break;
+			case 0x00280011: slice.columns = c.get16(e.valuePos); break;
+			case 0x00280100: slice.bitsAllocated = c.get16(e.valuePos); break;
+			case 0x00280103: slice.isSigned = c.get16(e.valuePos) == 1; break;
+			case 0x00280002: samplesPerPixel = c.get16(e.valuePos); break;
+			case 0x00280008: numFrames = atoi(getString(c, e).c_str()); break;
+			case 0x00200013: slice.instanceNumber = atoi(getString(c, e).c_str()); break;
+			case 0x0020000E: slice.seriesUID = getString(c, e); break;
+			case 0x00280030: getDecimals(c, e, slice.pixelSpacing, 2); break;
+			case 0x00180050: getDecimals(c, e, &slice.sliceThickness, 1); break;
+			case 0x00180088: getDecimals(c, e, &slice.spacingBetweenSlices, 1); break;
+			case 0x00200032: slice.hasPosition = getDecimals(c, e, slice.position, 3) == 3; break;
+			case 0x00200037: getDecimals(c, e, slice.orientation, 6); break;
+			case 0x00281053: if (getDecimals(c, e, values, 1) == 1) { slice.rescaleSlope = (float) values[0]; } break;
+			case 0x00281052: if (getDecimals(c, e, values, 1) == 1) { slice.rescaleIntercept = (float) values[0]; } break;
+		}
+		c.pos += e.length;
+	}
+	return false;
+}
+
+std::vector<std::string> listFiles(const std::string& directory)
+{
+	std::vector<std::string> result;
+	std::string prefix = directory;
+	if (!prefix.empty() && prefix[prefix.size() - 1] != '/' && prefix[prefix.size() - 1] != '\\') { prefix += "/"; }
+#ifdef _WIN32
+	WIN32_FIND_DATAA findData;
+	HANDLE find = FindFirstFileA((prefix + "*").c_str(), &findData);
+	if (find == INVALID_HANDLE_VALUE) { return result; }
+	do
+	{
+		if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) { result.push_back(prefix + findData.cFileName); }
+	} while (FindNextFileA(find, &findData));
+	FindClose(find);
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (dir == NULL) { return result; }
+	while (struct dirent* entry = readdir(dir))
+	{
+		if (entry->d_type == DT_DIR || entry->d_name[0] == '.') { continue; }
+		result.push_back(prefix + entry->d_name);
+	}
+	closedir(dir);
+#endif
+	std::sort(result.begin(), result.end());
+	return result;
+}
+}
+
+DicomSeries::Slice::Slice()
+	: instanceNumber(0)
+	, rows(0), columns(0), bitsAllocated(0)
+	, isSigned(false), bigEndian(false), compression(NONE)
+	, pixelDataOffset(0), pixelDataLength(0)
+	, hasPosition(false)
+	, sliceThickness(0.0), spacingBetweenSlices(0.0)
+	, rescaleSlope(1.0f), rescaleIntercept(0.0f)
+{
+	position[0] = position[1] = position[2] = 0.0;
+	orientation[0] = 1.0; orientation[1] = 0.0; orientation[2] = 0.0;
+	orientation[3] = 0.0; orientation[4] = 1.0; orientation[5] = 0.0;
+	pixelSpacing[0] = pixelSpacing[1] = 1.0;
+}
+
+DicomSeries::Series::Series()
+	: size_x(0), size_y(0), spacing_x(1.0f), spacing_y(1.0f), spacing_z(1.0f)
+{
+}
+
+bool DicomSeries::readSlice(const std::string& path, Slice& slice)
+{
+	MappedFile file;
+	if (!file.open(path)) { return false; }
+
+	slice = Slice();
+	slice.path = path;
+	Cursor c = { file.getData(), (size_t) file.getSize(), 0, false, true };
+
+	std::string transferSyntax = "1.2.840.10008.1.2"; // implicit VR little endian, the default without file meta information
+	if (c.size >= 132 && memcmp(c.data + 128, "DICM", 4) == 0)
+	{
+		// file meta information, always explicit VR little endian
+		c.pos = 132;
+		Element e;
+		while (c.has(8) && c.get16(c.pos) == 0x0002 && readElement(c, e))
+		{
+			if (e.tag == 0x00020010 && c.has(e.length)) { transferSyntax = getString(c, e); }
+			if (!skipValue(c, e)) { return false; }
+		}
+	}
+	else if (c.size < 8 || c.get16(0) != 0x0008)
+	{
+		return false;
+	}
+	else if (isupper(c.data[4]) && isupper(c.data[5]))
+	{
+		transferSyntax = "1.2.840.10008.1.2.1"; // bare dataset with explicit VRs
+	}
+
+	if (transferSyntax == "1.2.840.10008.1.2") { c.explicitVR = false; }
+	else if (transferSyntax == "1.2.840.10008.1.2.2") { c.bigEndian = true; }
+	else if (transferSyntax == "1.2.840.10008.1.2.5") { slice.compression = RLE; }
+	else if (transferSyntax != "1.2.840.10008.1.2.1") { return false; }
+	slice.bigEndian = c.bigEndian;
+
+	unsigned int samplesPerPixel = 1;
+	int numFrames = 1;
+	if (!parseDataset(c, slice, samplesPerPixel, numFrames)
+		|| samplesPerPixel != 1 || numFrames > 1 || slice.rows == 0 || slice.columns == 0
+		|| (slice.bitsAllocated != 8 && slice.bitsAllocated != 16 && slice.bitsAllocated != 32))
+	{
+		return false;
+	}
+
+	unsigned long long pixelBytes = (unsigned long long) slice.rows * slice.columns * (slice.bitsAllocated / 8);
+	return slice.compression != NONE || (slice.pixelDataLength >= pixelBytes && slice.pixelDataOffset + pixelBytes <= file.getSize());
+}
+
+bool DicomSeries::scanDirectory(const std::string& directory, Series& series, const std::string& seriesUID)
+{
+	std::vector<std::string> files = listFiles(directory);
+	if (files.empty())
+	{
+		DEBUGLOG->log("ERROR: no files in DICOM directory: " + directory);
+		return false;
+	}
+
+	// headers of thousands of small files, latency bound
+	std::vector<Slice> slices(files.size());
+	std::vector<char> valid(files.size(), 0);
+	THREADPOOL->parallelFor(0, files.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			valid[i] = readSlice(files[i], slices[i]) ? 1 : 0;
+		}
+	}, 16);
+
+	std::map<std::string, std::vector<size_t> > seriesSlices;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		if (valid[i]) { seriesSlices[slices[i].seriesUID].push_back(i); }
+	}
+	if (seriesSlices.size() == 0)
+	{
+		DEBUGLOG->log("ERROR: no supported DICOM files in directory: " + directory);
+		return false;
+	}
+	int numSkipped = (int) std::count(valid.begin(), valid.end(), 0);
+	if (numSkipped > 0)
+	{
+		DEBUGLOG->log("Skipped files that are no DICOM files or use unsupported transfer syntaxes: ", numSkipped);
+	}
+
+	std::map<std::string, std::vector<size_t> >::const_iterator chosen = seriesSlices.begin();
+	for (auto it = seriesSlices.begin(); it != seriesSlices.end(); ++it)
+	{
+		if (seriesUID.empty() ? it->second.size() > chosen->second.size() : it->first == seriesUID) { chosen = it; }
+	}
+	if (!seriesUID.empty() && chosen->first != seriesUID)
+	{
+		DEBUGLOG->log("ERROR: DICOM series not found: " + seriesUID);
+		return false;
+	}
+
+	// all slices must share the layout of the first one
+	const Slice& reference = slices[chosen->second[0]];
+	series = Series();
+	series.seriesUID = chosen->first;
+	bool allPositions = true;
+	for (size_t i = 0; i < chosen->second.size(); i++)
+	{
+		const Slice& slice = slices[chosen->second[i]];
+		if (slice.rows != reference.rows || slice.columns != reference.columns || slice.bitsAllocated != reference.bitsAllocated)
+		{
+			DEBUGLOG->log("WARNING: skipping DICOM slice with different dimensions: " + slice.path);
+			continue;
+		}
+		allPositions = allPositions && slice.hasPosition;
+		series.slices.push_back(slice);
+	}
+
+	// sort along the slice normal, the cross product of row and column direction
+	const double* o = reference.orientation;
+	const double normal[3] = { o[1] * o[5] - o[2] * o[4], o[2] * o[3] - o[0] * o[5], o[0] * o[4] - o[1] * o[3] };
+	auto distance = [&normal](const Slice& s) { return s.position[0] * normal[0] + s.position[1] * normal[1] + s.position[2] * normal[2]; };
+	if (allPositions)
+	{
+		std::stable_sort(series.slices.begin(), series.slices.end(), [&distance](const Slice& a, const Slice& b) { return distance(a) < distance(b); });
+	}
+	else
+	{
+		std::stable_sort(series.slices.begin(), series.slices.end(), [](const Slice& a, const Slice& b) { return a.instanceNumber < b.instanceNumber; });
+	}
+
+	series.size_x = reference.columns;
+	series.size_y = reference.rows;
+	series.spacing_x = (float) reference.pixelSpacing[1];
+	series.spacing_y = (float) reference.pixelSpacing[0];
+
+	// median gap between slice positions is robust against a few missing slices, the tags are a fallback
+	double spacing_z = 0.0;
+	if (allPositions && series.slices.size() > 1)
+	{
+		std::vector<double> gaps;
+		for (size_t i = 1; i < series.slices.size(); i++) { gaps.push_back(distance(series.slices[i]) - distance(series.slices[i - 1])); }
+		std::nth_element(gaps.begin(), gaps.begin() + gaps.size() / 2, gaps.end());
+		spacing_z = gaps[gaps.size() / 2];
+	}
+	if (spacing_z <= 0.0) { spacing_z = (reference.spacingBetweenSlices > 0.0) ? reference.spacingBetweenSlices : reference.sliceThickness; }
+	series.spacing_z = (spacing_z > 0.0) ? (float) spacing_z : 1.0f;
+
+	DEBUGLOG->log("DICOM series " + series.seriesUID + ", slices: ", (int) series.slices.size());
+	return true;
+}
+
+bool DicomSeries::decodeRle(const unsigned char* src, size_t size, size_t bytesPerSample, unsigned char* dst, size_t numSamples)
+{
+	// header: number of segments and 15 segment offsets, little endian
+	if (size < 64) { return false; }
+	unsigned int offsets[16];
+	for (int i = 0; i < 16; i++) { offsets[i] = src[4 * i] | (src[4 * i + 1] << 8) | (src[4 * i + 2] << 16) | ((unsigned int) src[4 * i + 3] << 24); }
+	if (offsets[0] != bytesPerSample) { return false; }
+
+	// one segment per byte of a sample, most significant first
+	for (size_t s = 0; s < bytesPerSample; s++)
+	{
+		size_t p = offsets[s + 1];
+		size_t end = (s + 1 < bytesPerSample) ? offsets[s + 2] : size;
+		if (p < 64 || end > size || p > end) { return false; }
+
+		unsigned char* out = dst + s;
+		size_t j = 0;
+		while (j < numSamples && p < end)
+		{
+			int n = (signed char) src[p++];
+			if (n >= 0)
+			{
+				size_t count = std::min<size_t>(n + 1, numSamples - j);
+				if (end - p < count) { return false; }
+				for (size_t k = 0; k < count; k++) { out[(j + k) * bytesPerSample] = src[p + k]; }
+				p += n + 1;
+				j += count;
+			}
+			else if (n != -128)
+			{
+				if (p >= end) { return false; }
+				size_t count = std::min<size_t>(1 - n, numSamples - j);
+				unsigned char value = src[p++];
+				for (size_t k = 0; k < count; k++) { out[(j + k) * bytesPerSample] = value; }
+				j += count;
+			}
+		}
+		if (j < numSamples) { return false; }
+	}
+	return true;
+}
+
+const char* DicomSeries::getErrorMessage(DecodeResult result)
+{
+	switch (result)
+	{
+		case DECODED: return "decoded";
+		case UNREADABLE_FILE: return "could not open file";
+		case CORRUPT_ENCAPSULATION: return "corrupt encapsulated pixel data";
+		default: return "corrupt RLE pixel data";
+	}
+}
+
+DicomSeries::DecodeResult DicomSeries::decodeSlice(const Slice& slice, float* dst)
+{
+	MappedFile file;
+	if (!file.open(slice.path)) { return UNREADABLE_FILE; }
+
+	const size_t numSamples = (size_t) slice.rows * slice.columns;
+	const size_t bytesPerSample = slice.bitsAllocated / 8;
+	VoxelConversion::VoxelType type;
+	switch (bytesPerSample)
+	{
+		case 1: type = slice.isSigned ? VoxelConversion::INT8 : VoxelConversion::UINT8; break;
+		case 2: type = slice.isSigned ? VoxelConversion::INT16 : VoxelConversion::UINT16; break;
+		default: type = slice.isSigned ? VoxelConversion::INT32 : VoxelConversion::UINT32; break;
+	}
+
+	float min = 0.0f, max = 0.0f; // range is taken after rescaling
+	if (slice.compression == NONE)
+	{
+		VoxelConversion::convert(file.getData() + slice.pixelDataOffset, type, slice.bigEndian, dst, numSamples, min, max);
+	}
+	else
+	{
+		// encapsulated: basic offset table item, then fragments of the single frame
+		Cursor c = { file.getData(), (size_t) file.getSize(), (size_t) slice.pixelDataOffset, false, false };
+		Element e;
+		if (!readElement(c, e) || e.tag != TAG_ITEM || !skipValue(c, e)) { return CORRUPT_ENCAPSULATION; }
+
+		std::vector<unsigned char> fragments;
+		const unsigned char* frame = nullptr;
+		size_t frameSize = 0;
+		while (readElement(c, e) && e.tag == TAG_ITEM && c.has(e.length))
+		{
+			if (frame != nullptr)
+			{
+				// rare: more than one fragment, join them
+				if (fragments.empty()) { fragments.assign(frame, frame + frameSize); }
+				fragments.insert(fragments.end(), c.data + e.valuePos, c.data + e.valuePos + e.length);
+				frame = &fragments[0];
+				frameSize = fragments.size();
+			}
+			else
+			{
+				frame = c.data + e.valuePos;
+				frameSize = e.length;
+			}
+			c.pos += e.length;
+		}
+
+		std::vector<unsigned char> samples(numSamples * bytesPerSample);
+		if (frame == nullptr || !decodeRle(frame, frameSize, bytesPerSample, &samples[0], numSamples))
+		{
+			return CORRUPT_RLE;
+		}
+		VoxelConversion::convert(&samples[0], type, true, dst, numSamples, min, max);
+	}
+
+	if (slice.rescaleSlope != 1.0f || slice.rescaleIntercept != 0.0f)
+	{
+		VoxelConversion::rescale(dst, numSamples, slice.rescaleSlope, slice.rescaleIntercept);
+	}
+	return DECODED;
+}
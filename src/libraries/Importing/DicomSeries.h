@@ -0,0 +1,95 @@
+#ifndef IMPORTING_DICOMSERIES_H_
+#define IMPORTING_DICOMSERIES_H_
+
+#include <string>
+#include <vector>
+
+/**
+ * Minimal DICOM reader for directories of single-frame grayscale slices (CT, MR).
+ * Supported transfer syntaxes: implicit / explicit VR little endian, explicit VR big endian and RLE lossless.
+ * Headers are parsed from memory mapped files up to the pixel data, everything else is skipped.
+ * Loading into VolumeData is done by Importer::loadDicomSeries().
+ */
+namespace DicomSeries
+{
+	enum Compression {
+		NONE,
+		RLE
+	};
+
+	struct Slice
+	{
+		std::string path;
+		std::string seriesUID;
+		int instanceNumber;
+
+		unsigned int rows;
+		unsigned int columns;
+		unsigned int bitsAllocated; //!< 8, 16 or 32
+		bool isSigned;              //!< PixelRepresentation 1
+		bool bigEndian;             //!< of the pixel data
+		Compression compression;
+
+		unsigned long long pixelDataOffset; //!< first byte of native pixel data, first item of encapsulated pixel data
+		unsigned long long pixelDataLength; //!< bytes of native pixel data
+
+		bool hasPosition;
+		double position[3];    //!< ImagePositionPatient of the first voxel, mm
+		double orientation[6]; //!< ImageOrientationPatient, direction cosines of rows and columns
+		double pixelSpacing[2]; //!< between rows (y) and columns (x), mm
+		double sliceThickness;
+		double spacingBetweenSlices; //!< 0 if not given
+
+		float rescaleSlope;
+		float rescaleIntercept;
+
+		Slice();
+	};
+
+	struct Series
+	{
+		std::string seriesUID;
+		std::vector<Slice> slices; //!< sorted along the slice normal (or by instance number)
+
+		unsigned int size_x;
+		unsigned int size_y;
+		float spacing_x; //!< mm
+		float spacing_y;
+		float spacing_z; //!< from the slice positions if available
+
+		Series();
+	};
+
+	/** @brief parse the header of a DICOM file, false if it is no DICOM file or an unsupported one */
+	bool readSlice(const std::string& path, Slice& slice);
+
+	/**
+	 * @brief parse all files of a directory on the thread pool, pick a series and sort its slices
+	 * @param seriesUID (optional) SeriesInstanceUID to load, the series with most slices if empty
+	 */
+	bool scanDirectory(const std::string& directory, Series& series, const std::string& seriesUID = "");
+
+	enum DecodeResult {
+		DECODED,
+		UNREADABLE_FILE,        //!< file can not be opened
+		CORRUPT_ENCAPSULATION,  //!< no offset table item before the fragments
+		CORRUPT_RLE             //!< missing fragments or RLE segments that do not fill the slice
+	};
+
+	const char* getErrorMessage(DecodeResult result);
+
+	/**
+	 * @brief decode the pixel data of slice into rows * columns floats, with rescale slope and intercept applied.
+	 *        Called from the thread pool, so errors are returned rather than logged
+	 */
+	DecodeResult decodeSlice(const Slice& slice, float* dst);
+
+	/**
+	 * @brief decode PackBits-style RLE segments into big endian samples
+	 * @param src first byte of the RLE header (number of segments, segment offsets)
+	 * @param bytesPerSample number of segments, most significant byte first
+	 */
+	bool decodeRle(const unsigned char* src, size_t size, size_t bytesPerSample, unsigned char* dst, size_t numSamples);
+}
+
+#endif
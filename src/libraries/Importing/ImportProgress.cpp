@@ -0,0 +1,56 @@
+#include "ImportProgress.h"
+
+#include <algorithm>
+
+namespace {
+thread_local ImportProgress* s_current = nullptr;
+}
+
+ImportProgress::ImportProgress()
+	: m_done(0), m_total(0), m_cancelled(false)
+{
+}
+
+void ImportProgress::reset()
+{
+	m_done = 0;
+	m_total = 0;
+	m_cancelled = false;
+}
+
+void ImportProgress::addWork(unsigned long long units)
+{
+	m_total += units;
+}
+
+void ImportProgress::advance(unsigned long long units)
+{
+	m_done += units;
+}
+
+float ImportProgress::get() const
+{
+	unsigned long long total = m_total;
+	if (total == 0) { return 0.0f; }
+	return std::min(1.0f, (float) ((double) m_done / (double) total));
+}
+
+void ImportProgress::cancel()
+{
+	m_cancelled = true;
+}
+
+bool ImportProgress::isCancelled() const
+{
+	return m_cancelled;
+}
+
+ImportProgress* ImportProgress::getCurrent()
+{
+	return s_current;
+}
+
+void ImportProgress::setCurrent(ImportProgress* progress)
+{
+	s_current = progress;
+}
@@ -0,0 +1,33 @@
+#ifndef IMPORTING_IMPORTPROGRESS_H_
+#define IMPORTING_IMPORTPROGRESS_H_
+
+#include <atomic>
+
+/**
+ * @brief progress and cancellation of an import running on another thread.
+ *        The thread that runs the import installs it with setCurrent(), importers pick it up with getCurrent()
+ *        (before fanning out to the thread pool) and report their work in arbitrary units.
+ */
+class ImportProgress
+{
+protected:
+	std::atomic<unsigned long long> m_done;
+	std::atomic<unsigned long long> m_total;
+	std::atomic<bool> m_cancelled;
+
+public:
+	ImportProgress();
+
+	void reset();
+	void addWork(unsigned long long units); //!< announce units of work that will be advanced later
+	void advance(unsigned long long units = 1);
+	float get() const; //!< done / total in [0, 1], 0 while no work is announced
+
+	void cancel();
+	bool isCancelled() const;
+
+	static ImportProgress* getCurrent(); //!< of the calling thread, nullptr if none
+	static void setCurrent(ImportProgress* progress); //!< of the calling thread, nullptr to remove
+};
+
+#endif
@@ -9,102 +9,142 @@
 #include <glm/glm.hpp>
 
 #include <Core/DebugLog.h>
+#include <Core/MappedFile.h>
+#include <Core/SimdTools.h>
+#include <Core/ThreadPool.h>
 #include <Core/VolumeData.h>
 
 #include <algorithm>
+#include <type_traits>
+
+#include "MappedVolume.h"
+#include "VoxelConversion.h"
+#include "ChunkedPVM.h"
+#include "BrickedVolume.h"
+#include "ImportProgress.h"
+#include "VolumeFile.h"
+#include "Inflater.h"
+#include "DicomSeries.h"
 
 #include "ddsbase.h"
 
 namespace Importer {
 	/**
+	 * @brief load a slice stack, slices are decoded concurrently on the THREADPOOL straight into their final place
 	 * @param path to file prefix relative to resources folder file suffix is assumed to be .1 .2 .. .num_files
 	 * @param size_x of slice file
 	 * @param size_y of slice file
-	 * @param num_files of slice files. will be loaded in ascending order
-	 * @return data from files
+	 * @param num_files of slice files
+	 * @param num_bytes_per_entry of a voxel, stored big endian, signed
+	 * @return data from files, missing slices are filled with 0
 	 */
 	template<class T>
-	VolumeData<T> load3DData(std::string path, unsigned size_x, unsigned size_y, unsigned int num_files, unsigned int num_bytes_per_entry = 1)
+	VolumeData<T> load3DDataParallel(std::string path, unsigned int size_x, unsigned int size_y, unsigned int num_files, unsigned int num_bytes_per_entry = 1)
 	{
 		DEBUGLOG->log("Loading files with prefix :" + path);
-		DEBUGLOG->log("Reading slice data...");
+		DEBUGLOG->log("Reading slice data in parallel...");
 
 		VolumeData<T> result;
 		result.size_x = size_x;
 		result.size_y = size_y;
 		result.size_z = num_files;
-		result.data.clear();
-
-		T min = SHRT_MAX;
-		T max = SHRT_MIN;
-
-		//result.midSlice.resize(size_x*size_y);
-
-		DEBUGLOG->indent();
-		for (unsigned int i = 1; i <= num_files; i++)
-		{
-			std::string current_file_path = path + "." + DebugLog::to_string(i);
-
-			std::cout << ".";
-
-//			DEBUGLOG->log("current file:" + current_file_path);
+		result.real_size_x = 1.0f / (float) size_x;
+		result.real_size_y = 1.0f / (float) size_y;
+		result.real_size_z = 1.0f / (float) num_files;
 
-			// read file into input vector
-			std::ifstream file( current_file_path.c_str(), std::ifstream::binary);	
-			std::vector<char> input;
+		const size_t sliceSize = (size_t) size_x * (size_t) size_y;
+		result.data.resize(sliceSize * num_files); // preallocate full volume, no reallocation while decoding
 
-			if (file.is_open()) {
-				// get length of file:
-				file.seekg (0, file.end);
-				int length = (int) file.tellg();
-				file.seekg (0, file.beg);
+		// per slice range, merged after all slices are done
+		std::vector<T> sliceMin(num_files, T());
+		std::vector<T> sliceMax(num_files, T());
+		std::vector<char> sliceValid(num_files, 0);
+		std::vector<char> sliceMissing(num_files, 0); // logged afterwards, DEBUGLOG is not thread safe
 
-				// allocate memory:
-				input.resize(length);
+		ImportProgress* progress = ImportProgress::getCurrent(); // workers run on other threads
+		if (progress) { progress->addWork(num_files); }
 
-				// read data as a block:
-				file.read( &input[0], length );
-
-				file.close();
-			}
+		THREADPOOL->parallelFor(0, num_files, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				std::string current_file_path = path + "." + DebugLog::to_string(i + 1);
+				T* slice = &result.data[i * sliceSize];
+				if (progress && progress->isCancelled()) { continue; }
 
-			// create data vector for this slice
-			std::vector<T> slice(size_x * size_y, 0);
+				MappedFile file;
+				if (!file.open(current_file_path) || file.getSize() < sliceSize * num_bytes_per_entry)
+				{
+					sliceMissing[i] = 1;
+					std::fill(slice, slice + sliceSize, T());
+					continue;
+				}
 
-			for(unsigned int j = 0 ; j < slice.size(); j++)
-			{
-				int val = input[num_bytes_per_entry*j];
-				for (unsigned int k = 1; k < num_bytes_per_entry; k++)
+				const unsigned char* input = file.getData();
+				sliceMin[i] = std::numeric_limits<T>::max();
+				sliceMax[i] = std::numeric_limits<T>::lowest();
+				if (num_bytes_per_entry <= 2)
+				{
+					VoxelConversion::convert(input, (num_bytes_per_entry == 1) ? VoxelConversion::INT8 : VoxelConversion::INT16, true, slice, sliceSize, sliceMin[i], sliceMax[i]);
+				}
+				else
 				{
-					val = (val << 8) + input[ num_bytes_per_entry*j + k];
+					for (size_t j = 0; j < sliceSize; j++)
+					{
+						// most significant byte carries the sign, the rest is unsigned
+						int val = (signed char) input[num_bytes_per_entry * j];
+						for (unsigned int k = 1; k < num_bytes_per_entry; k++)
+						{
+							val = (val << 8) | input[num_bytes_per_entry * j + k];
+						}
+						slice[j] = (T) val;
+					}
+					SimdTools::updateMinMax(slice, sliceSize, sliceMin[i], sliceMax[i]);
 				}
-	    		
-				slice[j] = (T) val;
-				
-				//if ( i == num_files / 2)
-				//{
-				//	result.midSlice[j] = val;
-				//	//DEBUGLOG->log("x: ", j - (j / size_x)*size_x);
-				//	//DEBUGLOG->log("y: ", j / size_x);
-				//	//DEBUGLOG->log("MidSlice: ", val);
-				//}
-
-				min = std::min<T>((T) val, min);
-				max = std::max<T>((T) val, max);
+				sliceValid[i] = 1;
+				if (progress) { progress->advance(); }
 			}
+		}, 1);
 
-			// push slice to data vector
-			result.data.insert(result.data.end(), slice.begin(), slice.end());
+		if (progress && progress->isCancelled())
+		{
+			result.data.clear();
+			return result;
 		}
-		std::cout << std::endl;
-		DEBUGLOG->outdent();
 
-		result.min = min;		
-		result.max = max;
+		for (unsigned int i = 0; i < num_files; i++)
+		{
+			if (sliceMissing[i]) { DEBUGLOG->log("ERROR: missing or incomplete slice file: " + path + "." + DebugLog::to_string(i + 1)); }
+		}
+
+		result.min = T();
+		result.max = T();
+		bool first = true;
+		for (unsigned int i = 0; i < num_files; i++)
+		{
+			if (!sliceValid[i]) { continue; }
+			result.min = first ? sliceMin[i] : std::min<T>(result.min, sliceMin[i]);
+			result.max = first ? sliceMax[i] : std::max<T>(result.max, sliceMax[i]);
+			first = false;
+		}
 
 		return result;
 	}
 
+	/**
+	 * @param path to file prefix relative to resources folder file suffix is assumed to be .1 .2 .. .num_files
+	 * @param size_x of slice file
+	 * @param size_y of slice file
+	 * @param num_files of slice files. will be loaded in ascending order
+	 * @param num_bytes_per_entry of a voxel, stored big endian, signed
+	 * @return data from files, decoded by load3DDataParallel
+	 */
+	template<class T>
+	VolumeData<T> load3DData(std::string path, unsigned size_x, unsigned size_y, unsigned int num_files, unsigned int num_bytes_per_entry = 1)
+	{
+		return load3DDataParallel<T>(path, size_x, size_y, num_files, num_bytes_per_entry);
+	}
+
 	template <class T> 
 	VolumeData<T> load3DDataPVM(std::string path)
 	{
@@ -123,7 +163,8 @@ namespace Importer {
 		// read and uncompress PVM volume
 		VolumeData<T> volData;
 
-		if ((volume=readPVMvolume(path.c_str(),
+		// accepts chunked and legacy PVM files
+		if ((volume=ChunkedPVM::readVolume(path,
 								&width,&height,&depth,&components,
 								&scalex,&scaley,&scalez))==NULL)
 		{
@@ -141,39 +182,26 @@ namespace Importer {
 		volData.size_y = height;
 
 		//volData.data.resize(width * height * depth * sizeof(char));
-		volData.data.resize(width * height * depth);
+		volData.data.resize((size_t) width * height * depth);
+		volData.min = std::numeric_limits<T>::max();
+		volData.max = std::numeric_limits<T>::lowest();
 		if (components == 1)
 		{
-			std::copy(volume, volume + width * height * depth * sizeof(char), volData.data.begin());
-			volData.min = CHAR_MAX;
-			volData.max = CHAR_MIN;
+			VoxelConversion::convert(volume, VoxelConversion::UINT8, true, &volData.data[0], volData.data.size(), volData.min, volData.max);
 		}
 		else if (components == 2)
 		{
-			for (unsigned int i = 0; i < width * height * depth; i++)
-			{
-				int val = volume[ 2 * i];
-				val = (val << 8) + volume[ 2 * i + 1];
-				volData.data[i] = (T) val;
-			}
-
-			//std::copy((short*) volume, (short*) volume + width * height * depth, volData.data.begin());
-			volData.min = SHRT_MAX;
-			volData.max = SHRT_MIN;
+			// 16 bit PVM data is stored unsigned, most significant byte first
+			VoxelConversion::convert(volume, VoxelConversion::UINT16, true, &volData.data[0], volData.data.size(), volData.min, volData.max);
 		}
-
-		for (auto v : volData.data)
+		else
 		{
-			volData.min = std::min<T>(v, volData.min);
-			volData.max = std::max<T>(v, volData.max);
+			DEBUGLOG->log("ERROR: unsupported number of components: ", components);
+			volData.min = T();
+			volData.max = T();
 		}
 
-		if (volData.min > volData.max) // swap
-		{
-			T tmp = volData.min;
-			volData.min = volData.max;
-			volData.max = tmp;
-		}
+		free(volume);
 
 		return volData;
 	}
@@ -184,23 +212,298 @@ namespace Importer {
 	template<class T>
 	VolumeData<T> loadBruder(std::string path = std::string(RESOURCES_PATH "/volumes/Bruder/psirInt16Signed.raw"))
 	{
-		VolumeData<short> result_ = loadBruder(path);
+		DEBUGLOG->log("Loading file: " + path);
+
+		VolumeData<T> result;
+		result.size_x = 240;
+		result.size_y = 240;
+		result.size_z = 190;
+
+		// map int16 file, convert to T in a single copy
+		MappedVolume<short> mapping = mapRawVolume<short>(path, result.size_x, result.size_y, result.size_z);
+		if (!mapping.isValid())
+		{
+			return result;
+		}
+
+		result.real_size_x = mapping.view.real_size_x;
+		result.real_size_y = mapping.view.real_size_y;
+		result.real_size_z = mapping.view.real_size_z;
+		result.min = (T) mapping.view.min;
+		result.max = (T) mapping.view.max;
+		result.data.assign(mapping.view.data, mapping.view.data + mapping.view.getNumVoxels());
+
+		return result;
+	}
+
+	/**
+	 * @brief load a MetaImage (.mhd, .mha) or NRRD (.nrrd, .nhdr) volume. Raw payloads are mapped and converted slice-parallel,
+	 *        compressed payloads are inflated chunk by chunk straight into the result, without a decompressed copy of the file
+	 * @param path to header file, detached payloads are looked up relative to it
+	 * @return data from file, real_size_* follows the voxel spacing with the longest extent scaled to 1. Empty on failure
+	 */
+	template<class T>
+	VolumeData<T> loadVolumeFile(std::string path)
+	{
+		DEBUGLOG->log("Loading volume file: " + path);
+
+		VolumeData<T> result;
+		result.size_x = result.size_y = result.size_z = 0;
+		result.min = result.max = T();
+
+		VolumeFile::Header header;
+		MappedFile file;
+		const unsigned char* payload = nullptr;
+		unsigned long long payloadSize = 0;
+		if (!VolumeFile::readHeader(path, header) || !VolumeFile::mapPayload(header, file, payload, payloadSize))
+		{
+			return result;
+		}
+
+		const float extent = std::max(std::max(header.size_x * header.spacing_x, header.size_y * header.spacing_y), header.size_z * header.spacing_z);
+		result.real_size_x = header.spacing_x / extent;
+		result.real_size_y = header.spacing_y / extent;
+		result.real_size_z = header.spacing_z / extent;
+
+		const size_t sliceSize = (size_t) header.size_x * (size_t) header.size_y;
+		const size_t voxelBytes = VoxelConversion::getNumBytes(header.type);
+		result.data.resize(sliceSize * header.size_z);
+
+		ImportProgress* progress = ImportProgress::getCurrent(); // workers run on other threads
+		if (progress) { progress->addWork(header.size_z); }
+
+		T min = std::numeric_limits<T>::max();
+		T max = std::numeric_limits<T>::lowest();
+		if (header.encoding == VolumeFile::RAW)
+		{
+			file.adviseSequential();
+
+			// per slice range, merged after all slices are done
+			std::vector<T> sliceMin(header.size_z, min);
+			std::vector<T> sliceMax(header.size_z, max);
+			THREADPOOL->parallelFor(0, header.size_z, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					if (progress && progress->isCancelled()) { continue; }
+					VoxelConversion::convert(payload + i * sliceSize * voxelBytes, header.type, header.bigEndian, &result.data[i * sliceSize], sliceSize, sliceMin[i], sliceMax[i]);
+					if (progress) { progress->advance(); }
+				}
+			}, 1);
+
+			for (unsigned int i = 0; i < header.size_z; i++)
+			{
+				min = std::min<T>(min, sliceMin[i]);
+				max = std::max<T>(max, sliceMax[i]);
+			}
+		}
+		else
+		{
+			Inflater inflater(payload, (size_t) payloadSize, (header.encoding == VolumeFile::GZIP) ? Inflater::GZIP : Inflater::ZLIB);
+
+			// decompressed bytes pass through a slab sized buffer that stays in cache while it is converted
+			const size_t slabSlices = std::max<size_t>(1, (1 << 20) / std::max<size_t>(1, sliceSize * voxelBytes));
+			std::vector<unsigned char> slab(slabSlices * sliceSize * voxelBytes);
+			for (unsigned long long skipped = 0; skipped < header.decodedSkip;)
+			{
+				size_t n = inflater.read(&slab[0], (size_t) std::min<unsigned long long>(slab.size(), header.decodedSkip - skipped));
+				if (n == 0) { break; }
+				skipped += n;
+			}
+
+			for (unsigned int z = 0; z < header.size_z; z += (unsigned int) slabSlices)
+			{
+				if (progress && progress->isCancelled()) { break; }
+				size_t numSlices = std::min<size_t>(slabSlices, header.size_z - z);
+				size_t numBytes = numSlices * sliceSize * voxelBytes;
+				if (inflater.read(&slab[0], numBytes) != numBytes)
+				{
+					DEBUGLOG->log("ERROR: compressed payload is truncated or corrupt: " + header.dataPath);
+					result.data.clear();
+					return result;
+				}
+				VoxelConversion::convert(&slab[0], header.type, header.bigEndian, &result.data[z * sliceSize], numSlices * sliceSize, min, max);
+				if (progress) { progress->advance(numSlices); }
+			}
+		}
+
+		if (progress && progress->isCancelled())
+		{
+			result.data.clear();
+			return result;
+		}
+
+		result.size_x = header.size_x;
+		result.size_y = header.size_y;
+		result.size_z = header.size_z;
+		result.min = min;
+		result.max = max;
+		return result;
+	}
+
+	/**
+	 * @brief load a directory of DICOM slices. Headers are scanned and slices decoded on the thread pool, straight into the result
+	 * @param directory holding the slice files
+	 * @param seriesUID (optional) SeriesInstanceUID to load, the series with most slices if empty
+	 * @return rescaled (i.e. Hounsfield) values, real_size_* follows pixel spacing and slice distance with the longest extent scaled to 1. Empty on failure
+	 */
+	template<class T>
+	VolumeData<T> loadDicomSeries(std::string directory, std::string seriesUID = "")
+	{
+		DEBUGLOG->log("Loading DICOM series from: " + directory);
+
 		VolumeData<T> result;
-		result.size_x = (T) result_.size_x;
-		result.size_y = (T) result_.size_y;
-		result.size_z = (T) result_.size_z;
-		result.max = (T) result_.max;
-		result.min = (T) result_.min;
-		result.real_size_x = (T) result_.real_size_x;
-		result.real_size_y = (T) result_.real_size_y;
-		result.real_size_z = (T) result_.real_size_z;
-		
-		result.data.clear();
-		result.data = std::vector<T>(result_.data.begin(), result_.data.end()); 
+		result.size_x = result.size_y = result.size_z = 0;
+		result.min = result.max = T();
+
+		DicomSeries::Series series;
+		if (!DicomSeries::scanDirectory(directory, series, seriesUID))
+		{
+			return result;
+		}
+		const unsigned int numSlices = (unsigned int) series.slices.size();
+
+		const float extent = std::max(std::max(series.size_x * series.spacing_x, series.size_y * series.spacing_y), numSlices * series.spacing_z);
+		result.real_size_x = series.spacing_x / extent;
+		result.real_size_y = series.spacing_y / extent;
+		result.real_size_z = series.spacing_z / extent;
+
+		const size_t sliceSize = (size_t) series.size_x * (size_t) series.size_y;
+		result.data.resize(sliceSize * numSlices); // preallocate full volume, no reallocation while decoding
+
+		// per slice range, merged after all slices are done
+		std::vector<T> sliceMin(numSlices, std::numeric_limits<T>::max());
+		std::vector<T> sliceMax(numSlices, std::numeric_limits<T>::lowest());
+		std::vector<char> sliceValid(numSlices, 0);
+		std::vector<DicomSeries::DecodeResult> sliceResult(numSlices, DicomSeries::DECODED); // logged afterwards, from this thread
+
+		ImportProgress* progress = ImportProgress::getCurrent(); // workers run on other threads
+		if (progress) { progress->addWork(numSlices); }
+
+		THREADPOOL->parallelFor(0, numSlices, [&](size_t begin, size_t end)
+		{
+			std::vector<float> decoded;
+			for (size_t i = begin; i < end; i++)
+			{
+				T* slice = &result.data[i * sliceSize];
+				if (progress && progress->isCancelled()) { continue; }
+
+				// floats are decoded in place, other types pass through a slice of floats to apply the rescale exactly
+				float* target = (float*) slice;
+				if (!std::is_same<T, float>::value)
+				{
+					decoded.resize(sliceSize);
+					target = &decoded[0];
+				}
+				sliceResult[i] = DicomSeries::decodeSlice(series.slices[i], target);
+				if (sliceResult[i] != DicomSeries::DECODED)
+				{
+					std::fill(slice, slice + sliceSize, T());
+					continue;
+				}
+				if (std::is_same<T, float>::value) { SimdTools::updateMinMax(slice, sliceSize, sliceMin[i], sliceMax[i]); }
+				else { VoxelConversion::convert(target, VoxelConversion::FLOAT32, !VoxelConversion::isLittleEndianMachine(), slice, sliceSize, sliceMin[i], sliceMax[i]); }
+				sliceValid[i] = 1;
+				if (progress) { progress->advance(); }
+			}
+		}, 1);
 
+		if (progress && progress->isCancelled())
+		{
+			result.data.clear();
+			return result;
+		}
+
+		for (unsigned int i = 0; i < numSlices; i++)
+		{
+			if (sliceResult[i] != DicomSeries::DECODED)
+			{
+				DEBUGLOG->log("ERROR: could not decode DICOM slice (" + std::string(DicomSeries::getErrorMessage(sliceResult[i])) + "): " + series.slices[i].path);
+			}
+		}
+
+		bool first = true;
+		for (unsigned int i = 0; i < numSlices; i++)
+		{
+			if (!sliceValid[i]) { continue; }
+			result.min = first ? sliceMin[i] : std::min<T>(result.min, sliceMin[i]);
+			result.max = first ? sliceMax[i] : std::max<T>(result.max, sliceMax[i]);
+			first = false;
+		}
+
+		result.size_x = series.size_x;
+		result.size_y = series.size_y;
+		result.size_z = numSlices;
 		return result;
 	}
 
+	/**
+	 * @brief convert a raw volume file into a bricked volume file without holding more than a brick layer of slices in memory
+	 * @param path of raw file, voxels x-fastest
+	 * @param srcType element type of the raw file
+	 * @param bigEndian true if multi-byte elements are stored most significant byte first
+	 * @param brickPath of bricked volume file to create
+	 * @param headerBytes (optional) to skip at the beginning of the raw file
+	 * @param brickSize (optional) edge length of a brick in voxels
+	 * @return true if all slices were converted and the file was finished
+	 */
+	template<class T>
+	bool convertRawToBricks(std::string path, unsigned long long size_x, unsigned long long size_y, unsigned long long size_z, VoxelConversion::VoxelType srcType, bool bigEndian,
+		std::string brickPath, unsigned long long headerBytes = 0, unsigned int brickSize = BrickedVolume::DEFAULT_BRICK_SIZE)
+	{
+		DEBUGLOG->log("Converting raw file to bricks: " + path);
+
+		MappedFile file;
+		if (!file.open(path))
+		{
+			return false;
+		}
+		const unsigned long long sliceSize = size_x * size_y;
+		const size_t voxelBytes = VoxelConversion::getNumBytes(srcType);
+		if (file.getSize() < headerBytes + sliceSize * size_z * voxelBytes)
+		{
+			DEBUGLOG->log("ERROR: raw file is smaller than expected: " + path);
+			return false;
+		}
+		file.adviseSequential();
+
+		BrickedVolumeWriter<T> writer;
+		if (!writer.create(brickPath, size_x, size_y, size_z, brickSize))
+		{
+			return false;
+		}
+
+		ImportProgress* progress = ImportProgress::getCurrent();
+		if (progress) { progress->addWork(size_z); }
+
+		// one brick layer at a time, converted in parallel
+		std::vector<T> slab((size_t) (sliceSize * brickSize));
+		for (unsigned long long z = 0; z < size_z; z += brickSize)
+		{
+			if (progress && progress->isCancelled())
+			{
+				return false;
+			}
+			unsigned long long numSlices = std::min<unsigned long long>(brickSize, size_z - z);
+			const unsigned char* src = file.getData() + headerBytes + z * sliceSize * voxelBytes;
+			THREADPOOL->parallelFor(0, (size_t) numSlices, [&](size_t begin, size_t end)
+			{
+				for (size_t i = begin; i < end; i++)
+				{
+					T min = std::numeric_limits<T>::max(), max = std::numeric_limits<T>::lowest(); // range is tracked by the writer
+					VoxelConversion::convert(src + i * sliceSize * voxelBytes, srcType, bigEndian, &slab[(size_t) (i * sliceSize)], (size_t) sliceSize, min, max);
+				}
+			}, 1);
+			if (!writer.appendSlices(&slab[0], numSlices))
+			{
+				return false;
+			}
+			if (progress) { progress->advance(numSlices); }
+		}
+
+		return writer.finish();
+	}
+
 } // namespace Importer
 
 
@@ -0,0 +1,355 @@
+#include "Inflater.h"
+
+#include <cstring>
+#include <algorithm>
+
+namespace {
+const unsigned short LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const unsigned char LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const unsigned short DISTANCE_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const unsigned char DISTANCE_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+const unsigned char CODE_LENGTH_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+}
+
+Inflater::Inflater()
+	: m_in(nullptr)
+	, m_inEnd(nullptr)
+	, m_bitBuffer(0)
+	, m_numBits(0)
+	, m_finalBlock(false)
+	, m_blockType(-1)
+	, m_storedRemaining(0)
+	, m_matchLength(0)
+	, m_matchDistance(0)
+	, m_windowPos(0)
+	, m_totalOut(0)
+	, m_done(true)
+	, m_error(false)
+{
+}
+
+Inflater::Inflater(const void* src, size_t size, Format format)
+	: Inflater()
+{
+	init(src, size, format);
+}
+
+bool Inflater::init(const void* src, size_t size, Format format)
+{
+	m_in = (const unsigned char*) src;
+	m_inEnd = m_in + size;
+	m_bitBuffer = 0;
+	m_numBits = 0;
+	m_finalBlock = false;
+	m_blockType = -1;
+	m_storedRemaining = 0;
+	m_matchLength = 0;
+	m_matchDistance = 0;
+	m_window.assign(WINDOW_SIZE, 0);
+	m_windowPos = 0;
+	m_totalOut = 0;
+	m_done = false;
+	m_error = !skipHeader(format);
+	return !m_error;
+}
+
+bool Inflater::skipHeader(Format format)
+{
+	size_t size = (size_t) (m_inEnd - m_in);
+	if (format == AUTO)
+	{
+		if (size >= 2 && m_in[0] == 0x1f && m_in[1] == 0x8b) { format = GZIP; }
+		else if (size >= 2 && (m_in[0] & 0x0f) == 8 && ((m_in[0] << 8) | m_in[1]) % 31 == 0) { format = ZLIB; }
+		else { format = RAW; }
+	}
+
+	if (format == ZLIB)
+	{
+		// CMF, FLG. A preset dictionary is never used for volume data
+		if (size < 2 || (m_in[0] & 0x0f) != 8 || ((m_in[0] << 8) | m_in[1]) % 31 != 0 || (m_in[1] & 0x20) != 0) { return false; }
+		m_in += 2;
+	}
+	else if (format == GZIP)
+	{
+		// ID1, ID2, CM, FLG, MTIME, XFL, OS followed by the optional fields announced in FLG
+		if (size < 10 || m_in[0] != 0x1f || m_in[1] != 0x8b || m_in[2] != 8) { return false; }
+		unsigned char flags = m_in[3];
+		const unsigned char* p = m_in + 10;
+		if (flags & 4) // FEXTRA
+		{
+			if (m_inEnd - p < 2) { return false; }
+			size_t extraSize = p[0] | (p[1] << 8);
+			if ((size_t) (m_inEnd - p) < 2 + extraSize) { return false; }
+			p += 2 + extraSize;
+		}
+		for (int field = 8; field <= 16; field *= 2) // FNAME, FCOMMENT: zero terminated
+		{
+			if (!(flags & field)) { continue; }
+			while (p < m_inEnd && *p != 0) { p++; }
+			if (p == m_inEnd) { return false; }
+			p++;
+		}
+		if (flags & 2) { p += 2; } // FHCRC
+		if (p > m_inEnd) { return false; }
+		m_in = p;
+	}
+	return true;
+}
+
+void Inflater::refill()
+{
+	while (m_numBits <= 56 && m_in < m_inEnd)
+	{
+		m_bitBuffer |= (unsigned long long) (*m_in++) << m_numBits;
+		m_numBits += 8;
+	}
+}
+
+bool Inflater::getBits(int n, unsigned int& value)
+{
+	if (m_numBits < n) { refill(); }
+	if (m_numBits < n) { m_error = true; return false; }
+	value = (unsigned int) (m_bitBuffer & ((1ull << n) - 1));
+	m_bitBuffer >>= n;
+	m_numBits -= n;
+	return true;
+}
+
+int Inflater::decodeSymbol(const Huffman& huffman)
+{
+	refill();
+	unsigned int entry = huffman.fast[m_bitBuffer & ((1 << FAST_BITS) - 1)];
+	int length = entry & 15;
+	if (entry != 0 && length <= m_numBits)
+	{
+		m_bitBuffer >>= length;
+		m_numBits -= length;
+		return (int) (entry >> 4);
+	}
+
+	// long code (or end of input), walk the canonical code bit by bit
+	int code = 0, first = 0, index = 0;
+	for (int len = 1; len <= 15; len++)
+	{
+		if (m_numBits == 0) { return -1; }
+		code |= (int) (m_bitBuffer & 1);
+		m_bitBuffer >>= 1;
+		m_numBits--;
+		int count = huffman.counts[len];
+		if (code - count < first) { return huffman.symbols[index + (code - first)]; }
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+bool Inflater::buildHuffman(Huffman& huffman, const unsigned char* lengths, int numSymbols)
+{
+	memset(huffman.counts, 0, sizeof(huffman.counts));
+	for (int s = 0; s < numSymbols; s++) { huffman.counts[lengths[s]]++; }
+	huffman.counts[0] = 0;
+
+	// reject over-subscribed codes, incomplete ones are legal (i.e. a single distance code)
+	int left = 1;
+	for (int len = 1; len <= 15; len++)
+	{
+		left = (left << 1) - huffman.counts[len];
+		if (left < 0) { return false; }
+	}
+
+	unsigned short offsets[16];
+	unsigned short nextCode[16];
+	offsets[1] = 0;
+	nextCode[1] = 0;
+	for (int len = 1; len < 15; len++)
+	{
+		offsets[len + 1] = offsets[len] + huffman.counts[len];
+		nextCode[len + 1] = (unsigned short) ((nextCode[len] + huffman.counts[len]) << 1);
+	}
+
+	memset(huffman.fast, 0, sizeof(huffman.fast));
+	for (int s = 0; s < numSymbols; s++)
+	{
+		int len = lengths[s];
+		if (len == 0) { continue; }
+		huffman.symbols[offsets[len]++] = (unsigned short) s;
+
+		unsigned int code = nextCode[len]++;
+		if (len > FAST_BITS) { continue; }
+
+		// codes are stored most significant bit first, the bit buffer is read least significant bit first
+		unsigned int reversed = 0;
+		for (int b = 0; b < len; b++) { reversed |= ((code >> b) & 1) << (len - 1 - b); }
+		for (unsigned int i = reversed; i < (1u << FAST_BITS); i += (1u << len))
+		{
+			huffman.fast[i] = (unsigned short) ((s << 4) | len);
+		}
+	}
+	return true;
+}
+
+bool Inflater::readDynamicCodes()
+{
+	unsigned int numLiterals, numDistances, numCodeLengths;
+	if (!getBits(5, numLiterals) || !getBits(5, numDistances) || !getBits(4, numCodeLengths)) { return false; }
+	numLiterals += 257;
+	numDistances += 1;
+	numCodeLengths += 4;
+	if (numLiterals > 286 || numDistances > 30) { return false; }
+
+	unsigned char lengths[286 + 30];
+	memset(lengths, 0, 19);
+	for (unsigned int i = 0; i < numCodeLengths; i++)
+	{
+		unsigned int length;
+		if (!getBits(3, length)) { return false; }
+		lengths[CODE_LENGTH_ORDER[i]] = (unsigned char) length;
+	}
+
+	Huffman& codeLengths = m_distances; // reused, the distance code is built afterwards
+	if (!buildHuffman(codeLengths, lengths, 19)) { return false; }
+
+	unsigned int index = 0;
+	while (index < numLiterals + numDistances)
+	{
+		int symbol = decodeSymbol(codeLengths);
+		if (symbol < 0) { return false; }
+		if (symbol < 16) { lengths[index++] = (unsigned char) symbol; continue; }
+
+		unsigned int repeat;
+		unsigned char value = 0;
+		if (symbol == 16)
+		{
+			if (index == 0 || !getBits(2, repeat)) { return false; }
+			value = lengths[index - 1];
+			repeat += 3;
+		}
+		else if (symbol == 17)
+		{
+			if (!getBits(3, repeat)) { return false; }
+			repeat += 3;
+		}
+		else
+		{
+			if (!getBits(7, repeat)) { return false; }
+			repeat += 11;
+		}
+		if (index + repeat > numLiterals + numDistances) { return false; }
+		while (repeat-- > 0) { lengths[index++] = value; }
+	}
+
+	if (lengths[256] == 0) { return false; } // no end of block code
+	return buildHuffman(m_literals, lengths, numLiterals)
+		&& buildHuffman(m_distances, lengths + numLiterals, numDistances);
+}
+
+bool Inflater::beginBlock()
+{
+	unsigned int finalBlock, blockType;
+	if (!getBits(1, finalBlock) || !getBits(2, blockType)) { return false; }
+	m_finalBlock = finalBlock != 0;
+
+	if (blockType == 0)
+	{
+		unsigned int length, complement;
+		m_bitBuffer >>= (m_numBits & 7); // stored blocks start at a byte boundary
+		m_numBits -= (m_numBits & 7);
+		if (!getBits(16, length) || !getBits(16, complement) || length != (~complement & 0xffff)) { return false; }
+		m_storedRemaining = length;
+	}
+	else if (blockType == 1)
+	{
+		unsigned char lengths[288];
+		memset(lengths, 8, 144);
+		memset(lengths + 144, 9, 112);
+		memset(lengths + 256, 7, 24);
+		memset(lengths + 280, 8, 8);
+		buildHuffman(m_literals, lengths, 288);
+		memset(lengths, 5, 30);
+		buildHuffman(m_distances, lengths, 30);
+	}
+	else if (blockType != 2 || !readDynamicCodes())
+	{
+		return false;
+	}
+	m_blockType = (int) blockType;
+	return true;
+}
+
+size_t Inflater::read(void* dst, size_t size)
+{
+	unsigned char* out = (unsigned char*) dst;
+	size_t produced = 0;
+	while (produced < size && !m_error)
+	{
+		if (m_matchLength > 0)
+		{
+			size_t n = std::min((size_t) m_matchLength, size - produced);
+			for (size_t i = 0; i < n; i++)
+			{
+				put(m_window[(m_windowPos - m_matchDistance) & (WINDOW_SIZE - 1)], out + produced++);
+			}
+			m_matchLength -= (int) n;
+			continue;
+		}
+
+		if (m_blockType < 0)
+		{
+			if (m_done) { break; }
+			if (!beginBlock()) { m_error = true; }
+			continue;
+		}
+
+		if (m_blockType == 0)
+		{
+			if (m_storedRemaining == 0)
+			{
+				m_blockType = -1;
+				m_done = m_finalBlock;
+				continue;
+			}
+			if (m_numBits == 0)
+			{
+				// byte aligned and nothing buffered, copy straight from the input
+				size_t n = std::min(std::min(m_storedRemaining, size - produced), (size_t) (m_inEnd - m_in));
+				if (n == 0) { m_error = true; break; }
+				for (size_t i = 0; i < n; i++) { put(*m_in++, out + produced++); }
+				m_storedRemaining -= n;
+			}
+			else
+			{
+				unsigned int byte;
+				if (!getBits(8, byte)) { break; }
+				put((unsigned char) byte, out + produced++);
+				m_storedRemaining--;
+			}
+			continue;
+		}
+
+		int symbol = decodeSymbol(m_literals);
+		if (symbol < 0) { m_error = true; break; }
+		if (symbol < 256)
+		{
+			put((unsigned char) symbol, out + produced++);
+		}
+		else if (symbol == 256)
+		{
+			m_blockType = -1;
+			m_done = m_finalBlock;
+		}
+		else
+		{
+			symbol -= 257;
+			unsigned int extra;
+			if (symbol >= 29 || !getBits(LENGTH_EXTRA[symbol], extra)) { m_error = true; break; }
+			m_matchLength = LENGTH_BASE[symbol] + extra;
+
+			symbol = decodeSymbol(m_distances);
+			if (symbol < 0 || symbol >= 30 || !getBits(DISTANCE_EXTRA[symbol], extra)) { m_error = true; break; }
+			m_matchDistance = DISTANCE_BASE[symbol] + extra;
+			if ((unsigned long long) m_matchDistance > m_totalOut) { m_error = true; break; }
+		}
+	}
+	return produced;
+}
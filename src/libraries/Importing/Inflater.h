@@ -0,0 +1,89 @@
+#ifndef IMPORTING_INFLATER_H_
+#define IMPORTING_INFLATER_H_
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief streaming DEFLATE decoder (RFC 1950/1951/1952) over an in-memory (i.e. mapped) compressed stream.
+ *        Decompressed bytes are pulled in chunks of arbitrary size, so a payload can be converted into its target
+ *        while it is being inflated instead of being decompressed into a temporary copy first.
+ *        Only a 32 KB window is kept. Checksums are not verified, truncated or corrupt streams are reported by hasError().
+ */
+class Inflater
+{
+public:
+	enum Format {
+		RAW,  //!< bare deflate stream
+		ZLIB, //!< 2 byte zlib header, i.e. MetaImage CompressedData
+		GZIP, //!< gzip member, i.e. NRRD encoding gzip
+		AUTO  //!< detect gzip or zlib header, bare deflate otherwise
+	};
+
+	static const int FAST_BITS = 10; //!< codes up to this length are decoded with a single table lookup
+	static const size_t WINDOW_SIZE = 32768;
+
+protected:
+	struct Huffman
+	{
+		unsigned short fast[1 << FAST_BITS]; //!< (symbol << 4) | length, 0 if the code is longer than FAST_BITS
+		unsigned short counts[16];           //!< number of codes per length
+		unsigned short symbols[288];         //!< ordered by code
+	};
+
+	const unsigned char* m_in;
+	const unsigned char* m_inEnd;
+	unsigned long long m_bitBuffer; //!< least significant bit is the next one
+	int m_numBits;
+
+	bool m_finalBlock; //!< the current block is the last one
+	int m_blockType;   //!< -1: between blocks, 0: stored, 1: fixed, 2: dynamic Huffman codes
+	size_t m_storedRemaining;
+	int m_matchLength;   //!< bytes left to copy of the current match
+	int m_matchDistance;
+
+	std::vector<unsigned char> m_window;
+	size_t m_windowPos;
+	unsigned long long m_totalOut;
+
+	Huffman m_literals;
+	Huffman m_distances;
+
+	bool m_done;
+	bool m_error;
+
+	void refill();
+	bool getBits(int n, unsigned int& value);
+	int decodeSymbol(const Huffman& huffman);
+	bool buildHuffman(Huffman& huffman, const unsigned char* lengths, int numSymbols);
+	bool beginBlock();
+	bool readDynamicCodes();
+	bool skipHeader(Format format);
+
+	inline void put(unsigned char byte, unsigned char* dst)
+	{
+		*dst = byte;
+		m_window[m_windowPos] = byte;
+		m_windowPos = (m_windowPos + 1) & (WINDOW_SIZE - 1);
+		m_totalOut++;
+	}
+
+public:
+	Inflater();
+	Inflater(const void* src, size_t size, Format format = AUTO);
+
+	/** @brief start decoding a new stream, src must stay valid while reading */
+	bool init(const void* src, size_t size, Format format = AUTO);
+
+	/**
+	 * @brief decompress the next bytes
+	 * @return number of bytes written to dst, less than size only at the end of the stream or on error
+	 */
+	size_t read(void* dst, size_t size);
+
+	inline bool isDone() const { return m_done; } //!< the final block was decoded completely
+	inline bool hasError() const { return m_error; }
+	inline unsigned long long getTotalOut() const { return m_totalOut; }
+};
+
+#endif
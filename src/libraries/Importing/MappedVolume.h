@@ -0,0 +1,86 @@
+#ifndef IMPORTING_MAPPEDVOLUME_H_
+#define IMPORTING_MAPPEDVOLUME_H_
+
+#include <string>
+#include <memory>
+
+#include <Core/DebugLog.h>
+#include <Core/MappedFile.h>
+#include <Core/SimdTools.h>
+#include <Core/VolumeData.h>
+
+namespace Importer {
+
+	/** @brief a headerless raw volume that stays on disk and is paged in by the OS on access */
+	template<class T>
+	struct MappedVolume
+	{
+		std::shared_ptr<MappedFile> file; //!< keeps the mapping alive while the view is in use
+		VolumeDataView<T> view; //!< voxels point straight into the mapping
+
+		inline bool isValid() const { return view.data != nullptr; }
+	};
+
+	/**
+	 * @brief memory map a headerless raw volume of any element type, no copy is made
+	 * @param path to raw file, voxels are expected in native byte order, x-fastest
+	 * @param size_x of volume
+	 * @param size_y of volume
+	 * @param size_z of volume
+	 * @param headerBytes (optional) number of bytes to skip at the beginning of the file
+	 * @param computeMinMax (optional) if false, min and max are left at T() and the file is not touched
+	 * @return mapping, check isValid()
+	 */
+	template<class T>
+	MappedVolume<T> mapRawVolume(std::string path, unsigned int size_x, unsigned int size_y, unsigned int size_z, unsigned long long headerBytes = 0, bool computeMinMax = true)
+	{
+		DEBUGLOG->log("Mapping raw file: " + path);
+
+		MappedVolume<T> result;
+		result.file = std::make_shared<MappedFile>();
+
+		if (!result.file->open(path))
+		{
+			return result;
+		}
+
+		unsigned long long numVoxels = (unsigned long long) size_x * size_y * size_z;
+		if (result.file->getSize() < headerBytes + numVoxels * sizeof(T))
+		{
+			DEBUGLOG->log("ERROR: raw file is smaller than expected: " + path);
+			result.file->close();
+			return result;
+		}
+		if (headerBytes % sizeof(T) != 0)
+		{
+			DEBUGLOG->log("ERROR: header size must be a multiple of the element size: " + path);
+			result.file->close();
+			return result;
+		}
+
+		result.view.size_x = size_x;
+		result.view.size_y = size_y;
+		result.view.size_z = size_z;
+		result.view.real_size_x = 1.0f / (float) size_x;
+		result.view.real_size_y = 1.0f / (float) size_y;
+		result.view.real_size_z = 1.0f / (float) size_z;
+		result.view.data = reinterpret_cast<const T*>(result.file->getData() + headerBytes);
+
+		if (computeMinMax && numVoxels > 0)
+		{
+			result.file->adviseSequential();
+
+			// single pass over the mapping
+			T min = result.view.data[0];
+			T max = result.view.data[0];
+			SimdTools::updateMinMax(result.view.data, (size_t) numVoxels, min, max);
+			result.view.min = min;
+			result.view.max = max;
+		}
+
+		return result;
+	}
+
+} // namespace Importer
+
+#endif
@@ -0,0 +1,120 @@
+#include "Quantization.h"
+
+using namespace Quantization;
+
+namespace {
+
+// widen 16 bit blocks to float with the vectorized conversion, then quantize the block while it is in L1
+template<class T>
+void quantize16(const T* src, VoxelConversion::VoxelType type, size_t count, float scale, float offset, unsigned char* dst)
+{
+	float block[VoxelConversion::BLOCK_SIZE];
+	for (size_t i = 0; i < count; i += VoxelConversion::BLOCK_SIZE)
+	{
+		size_t blockSize = std::min(VoxelConversion::BLOCK_SIZE, count - i);
+		float min = 0.0f, max = 0.0f;
+		VoxelConversion::convert(src + i, type, !VoxelConversion::isLittleEndianMachine(), block, blockSize, min, max);
+		quantizeLinear(block, blockSize, scale, offset, dst + i);
+	}
+}
+
+} // namespace
+
+Quantization::Mapping::Mapping()
+	: mode(LINEAR)
+	, min(0.0f)
+	, max(1.0f)
+{
+}
+
+float Quantization::Mapping::toNormalized(float value) const
+{
+	if (mode != EQUALIZED || values.size() != NUM_CODES)
+	{
+		return (value - min) / std::max(max - min, std::numeric_limits<float>::min());
+	}
+
+	// piecewise linear between the values of neighbouring codes
+	if (value <= values.front()) { return 0.0f; }
+	if (value >= values.back()) { return 1.0f; }
+	int upper = (int) (std::upper_bound(values.begin(), values.end(), value) - values.begin());
+	int lower = upper - 1;
+	float span = values[upper] - values[lower];
+	float t = (span > 0.0f) ? (value - values[lower]) / span : 0.0f;
+	return ((float) lower + t) / 255.0f;
+}
+
+float Quantization::Mapping::fromNormalized(float sample) const
+{
+	if (mode != EQUALIZED || values.size() != NUM_CODES)
+	{
+		return min + sample * (max - min);
+	}
+
+	float code = std::max(0.0f, std::min(sample * 255.0f, 255.0f));
+	int lower = std::min((int) code, NUM_CODES - 2);
+	float t = code - (float) lower;
+	return values[lower] + t * (values[lower + 1] - values[lower]);
+}
+
+void Quantization::Mapping::mapWindow(float windowMin, float windowMax, float& windowingMinVal, float& windowingRange) const
+{
+	windowingMinVal = toNormalized(windowMin);
+	windowingRange = std::max(toNormalized(windowMax) - windowingMinVal, 1.0f / 255.0f);
+}
+
+void Quantization::quantizeLinear(const float* src, size_t count, float scale, float offset, unsigned char* dst)
+{
+	// + 0.5 and truncation round to nearest, since the value is clamped to be non-negative first
+	offset += 0.5f;
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	const __m256 vScale = _mm256_set1_ps(scale);
+	const __m256 vOffset = _mm256_set1_ps(offset);
+	const __m256 vZero = _mm256_setzero_ps();
+	const __m256 vMax = _mm256_set1_ps(255.0f);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i), vScale), vOffset), vZero), vMax);
+		__m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(src + i + 8), vScale), vOffset), vZero), vMax);
+
+		// packs works per 128 bit lane, the permute restores the order before the final pack
+		__m256i packed16 = _mm256_packs_epi32(_mm256_cvttps_epi32(a), _mm256_cvttps_epi32(b));
+		packed16 = _mm256_permute4x64_epi64(packed16, 0xD8);
+		__m128i packed8 = _mm_packus_epi16(_mm256_castsi256_si128(packed16), _mm256_extracti128_si256(packed16, 1));
+		_mm_storeu_si128((__m128i*) (dst + i), packed8);
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	const __m128 vScale = _mm_set1_ps(scale);
+	const __m128 vOffset = _mm_set1_ps(offset);
+	const __m128 vZero = _mm_setzero_ps();
+	const __m128 vMax = _mm_set1_ps(255.0f);
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i quantized[4];
+		for (int j = 0; j < 4; j++)
+		{
+			__m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(src + i + 4 * j), vScale), vOffset);
+			quantized[j] = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(v, vZero), vMax));
+		}
+		__m128i lo = _mm_packs_epi32(quantized[0], quantized[1]);
+		__m128i hi = _mm_packs_epi32(quantized[2], quantized[3]);
+		_mm_storeu_si128((__m128i*) (dst + i), _mm_packus_epi16(lo, hi));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float v = std::max(0.0f, std::min(src[i] * scale + offset, 255.0f));
+		dst[i] = (unsigned char) v;
+	}
+}
+
+void Quantization::quantizeLinear(const short* src, size_t count, float scale, float offset, unsigned char* dst)
+{
+	quantize16(src, VoxelConversion::INT16, count, scale, offset, dst);
+}
+
+void Quantization::quantizeLinear(const unsigned short* src, size_t count, float scale, float offset, unsigned char* dst)
+{
+	quantize16(src, VoxelConversion::UINT16, count, scale, offset, dst);
+}
@@ -0,0 +1,202 @@
+#ifndef IMPORTING_QUANTIZATION_H_
+#define IMPORTING_QUANTIZATION_H_
+
+#ifdef MINGW_THREADS
+	#include <mingw-std-threads/mingw.mutex.h>
+#else
+	#include <mutex>
+#endif
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include <Core/ThreadPool.h>
+#include <Core/VolumeData.h>
+
+#include "VoxelConversion.h"
+
+/**
+ * Multi-threaded reduction of volumes to 8 bit, halving (16 bit) or quartering (float) texture memory.
+ * The Mapping of every quantization is recorded, so windowing and transfer functions that were set up
+ * for the source values can be moved into the [0, 1] sample range of a normalized 8 bit texture (GL_R8).
+ */
+namespace Quantization
+{
+	enum Mode {
+		LINEAR,   //!< [min, max] of the volume to [0, 255]
+		WINDOWED, //!< [windowMin, windowMax] to [0, 255], values outside are clamped
+		EQUALIZED //!< histogram equalization, spends the 256 codes where most voxels are
+	};
+
+	/** @brief how 8 bit codes relate to source values */
+	struct Mapping
+	{
+		Mode mode;
+		float min; //!< source value of code 0 (LINEAR, WINDOWED), smallest source value (EQUALIZED)
+		float max; //!< source value of code 255 (LINEAR, WINDOWED), largest source value (EQUALIZED)
+		std::vector<float> values; //!< 256 source values represented by each code, non-decreasing
+
+		Mapping();
+
+		/** @brief source value to sample value of a normalized 8 bit texture in [0, 1], i.e. for uWindowingMinVal */
+		float toNormalized(float value) const;
+
+		/** @brief sample value of a normalized 8 bit texture to source value */
+		float fromNormalized(float sample) const;
+
+		/**
+		 * @brief window on source values to the uWindowingMinVal / uWindowingRange uniforms for the quantized texture.
+		 *        Exact for LINEAR and WINDOWED, the ramp between the mapped bounds stays linear in code space for EQUALIZED
+		 */
+		void mapWindow(float windowMin, float windowMax, float& windowingMinVal, float& windowingRange) const;
+	};
+
+	static const int NUM_CODES = 256;
+	static const int NUM_FLOAT_BINS = 4096; //!< histogram resolution for sources other than 8/16 bit integers
+	static const size_t CHUNK_SIZE = 1 << 18; //!< voxels per task
+
+	/** @brief dst = clamp(src * scale + offset, 0, 255), rounded to nearest. Vectorized for float, short and unsigned short */
+	void quantizeLinear(const float* src, size_t count, float scale, float offset, unsigned char* dst);
+	void quantizeLinear(const short* src, size_t count, float scale, float offset, unsigned char* dst);
+	void quantizeLinear(const unsigned short* src, size_t count, float scale, float offset, unsigned char* dst);
+
+	template<class T>
+	void quantizeLinear(const T* src, size_t count, float scale, float offset, unsigned char* dst);
+
+	/**
+	 * @brief reduce a volume to 8 bit on the thread pool
+	 * @param mapping will describe how the codes relate to source values
+	 * @param windowMin, windowMax (optional) source window for WINDOWED, the volume range if empty
+	 * @return codes in [0, 255], same extents and real_size_* as volume
+	 */
+	template<class T>
+	VolumeData<unsigned char> quantize(const VolumeData<T>& volume, Mode mode, Mapping& mapping, float windowMin = 0.0f, float windowMax = 0.0f);
+}
+
+////// IMPLEMENTATION
+template<class T>
+void Quantization::quantizeLinear(const T* src, size_t count, float scale, float offset, unsigned char* dst)
+{
+	float block[VoxelConversion::BLOCK_SIZE];
+	for (size_t i = 0; i < count; i += VoxelConversion::BLOCK_SIZE)
+	{
+		size_t blockSize = std::min(VoxelConversion::BLOCK_SIZE, count - i);
+		for (size_t j = 0; j < blockSize; j++) { block[j] = (float) src[i + j]; }
+		quantizeLinear(block, blockSize, scale, offset, dst + i);
+	}
+}
+
+template<class T>
+VolumeData<unsigned char> Quantization::quantize(const VolumeData<T>& volume, Mode mode, Mapping& mapping, float windowMin, float windowMax)
+{
+	VolumeData<unsigned char> result;
+	result.size_x = volume.size_x;
+	result.size_y = volume.size_y;
+	result.size_z = volume.size_z;
+	result.real_size_x = volume.real_size_x;
+	result.real_size_y = volume.real_size_y;
+	result.real_size_z = volume.real_size_z;
+	result.data.resize(volume.data.size());
+	result.min = 0;
+	result.max = 0;
+
+	mapping = Mapping();
+	mapping.mode = mode;
+	mapping.min = (float) volume.min;
+	mapping.max = (float) volume.max;
+	if (mode == WINDOWED && windowMax > windowMin)
+	{
+		mapping.min = windowMin;
+		mapping.max = windowMax;
+	}
+	if (volume.data.empty()) { return result; }
+
+	const T* src = &volume.data[0];
+	unsigned char* dst = &result.data[0];
+	const size_t count = volume.data.size();
+	const float range = std::max(mapping.max - mapping.min, std::numeric_limits<float>::min());
+
+	if (mode != EQUALIZED)
+	{
+		const float scale = 255.0f / range;
+		const float offset = -mapping.min * scale;
+		THREADPOOL->parallelFor(0, count, [&](size_t begin, size_t end)
+		{
+			quantizeLinear(src + begin, end - begin, scale, offset, dst + begin);
+		}, CHUNK_SIZE);
+
+		mapping.values.resize(NUM_CODES);
+		for (int c = 0; c < NUM_CODES; c++) { mapping.values[c] = mapping.min + range * (float) c / 255.0f; }
+	}
+	else
+	{
+		// 8/16 bit integers get one bin per value, everything else a fixed number of bins over [min, max]
+		const bool exactBins = std::numeric_limits<T>::is_integer && sizeof(T) <= 2;
+		const int numBins = exactBins ? (int) (mapping.max - mapping.min) + 1 : NUM_FLOAT_BINS;
+		const float binScale = exactBins ? 1.0f : (float) numBins / range;
+		auto binOf = [&](T v) { return std::max(0, std::min(numBins - 1, (int) (((float) v - mapping.min) * binScale))); };
+
+		// per chunk histograms, merged under a lock
+		std::vector<unsigned long long> histogram(numBins, 0);
+		std::mutex histogramMutex;
+		THREADPOOL->parallelFor(0, count, [&](size_t begin, size_t end)
+		{
+			std::vector<unsigned int> local(numBins, 0);
+			for (size_t i = begin; i < end; i++) { local[binOf(src[i])]++; }
+			std::lock_guard<std::mutex> lock(histogramMutex);
+			for (int b = 0; b < numBins; b++) { histogram[b] += local[b]; }
+		}, CHUNK_SIZE);
+
+		// classic equalization: code proportional to the cumulative count, the first occupied bin maps to 0
+		std::vector<unsigned char> lut(numBins, 0);
+		unsigned long long cumulative = 0, first = 0;
+		for (int b = 0; b < numBins; b++)
+		{
+			cumulative += histogram[b];
+			if (first == 0) { first = cumulative; }
+			double denominator = (double) (count - first);
+			lut[b] = (denominator > 0.0) ? (unsigned char) std::floor(255.0 * (double) (cumulative - first) / denominator + 0.5) : 0;
+		}
+
+		THREADPOOL->parallelFor(0, count, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++) { dst[i] = lut[binOf(src[i])]; }
+		}, CHUNK_SIZE);
+
+		// every code represents the center of the source values mapped to it, unused codes are interpolated
+		std::vector<int> firstBin(NUM_CODES, -1), lastBin(NUM_CODES, -1);
+		for (int b = 0; b < numBins; b++)
+		{
+			if (histogram[b] == 0) { continue; }
+			if (firstBin[lut[b]] < 0) { firstBin[lut[b]] = b; }
+			lastBin[lut[b]] = b;
+		}
+		const float binOffset = exactBins ? 0.0f : 0.5f;
+		mapping.values.assign(NUM_CODES, std::numeric_limits<float>::quiet_NaN());
+		for (int c = 0; c < NUM_CODES; c++)
+		{
+			if (firstBin[c] < 0) { continue; }
+			mapping.values[c] = mapping.min + (0.5f * (float) (firstBin[c] + lastBin[c]) + binOffset) / binScale;
+		}
+		int previous = -1;
+		for (int c = 0; c < NUM_CODES; c++)
+		{
+			if (mapping.values[c] != mapping.values[c]) { continue; }
+			for (int u = previous + 1; u < c; u++)
+			{
+				mapping.values[u] = (previous < 0) ? mapping.values[c] : mapping.values[previous] + (mapping.values[c] - mapping.values[previous]) * (float) (u - previous) / (float) (c - previous);
+			}
+			previous = c;
+		}
+		for (int u = previous + 1; u < NUM_CODES; u++) { mapping.values[u] = (previous < 0) ? mapping.min : mapping.values[previous]; }
+	}
+
+	result.min = std::numeric_limits<unsigned char>::max();
+	result.max = std::numeric_limits<unsigned char>::lowest();
+	SimdTools::updateMinMax(dst, count, result.min, result.max);
+	return result;
+}
+
+#endif
@@ -0,0 +1,81 @@
+#include "VolumeCache.h"
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <functional>
+
+std::string VolumeCache::getCachePath(std::string sourcePath)
+{
+	return sourcePath + ".vcache";
+}
+
+std::string VolumeCache::getTempPath(std::string cachePath)
+{
+	static std::atomic<unsigned int> counter(0);
+	unsigned long long thread = (unsigned long long) std::hash<std::thread::id>()(std::this_thread::get_id());
+	return cachePath + "." + DebugLog::to_string(thread) + "." + DebugLog::to_string(counter++) + ".tmp";
+}
+
+bool VolumeCache::replaceCache(std::string tempPath, std::string cachePath)
+{
+	// rename does not replace existing files everywhere, so removing and renaming must not interleave with another writer
+	static std::mutex replaceMutex;
+	std::lock_guard<std::mutex> lock(replaceMutex);
+	remove(cachePath.c_str());
+	if (rename(tempPath.c_str(), cachePath.c_str()) != 0)
+	{
+		DEBUGLOG->log("ERROR: could not rename volume cache: " + tempPath);
+		remove(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+namespace {
+bool statFile(const std::string& path, unsigned long long& size, long long& modificationTime)
+{
+#ifdef _WIN32
+	struct _stat64 info;
+	if (_stat64(path.c_str(), &info) != 0) { return false; }
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0) { return false; }
+#endif
+	size = (unsigned long long) info.st_size;
+	modificationTime = (long long) info.st_mtime;
+	return true;
+}
+}
+
+bool VolumeCache::getSourceStamp(std::string sourcePath, unsigned long long& size, long long& modificationTime)
+{
+	if (statFile(sourcePath, size, modificationTime)) { return true; }
+
+	// slice stack: total size, modification times of all slices folded FNV-1a style, so editing, adding or removing any slice changes the stamp
+	unsigned long long sliceSize;
+	long long sliceTime;
+	unsigned long long hash = 14695981039346656037ULL;
+	unsigned int numSlices = 0;
+	size = 0;
+	while (statFile(sourcePath + "." + DebugLog::to_string(numSlices + 1), sliceSize, sliceTime))
+	{
+		size += sliceSize;
+		hash = (hash ^ sliceSize) * 1099511628211ULL;
+		hash = (hash ^ (unsigned long long) sliceTime) * 1099511628211ULL;
+		numSlices++;
+	}
+	modificationTime = (long long) hash;
+	return numSlices > 0;
+}
+
+unsigned long long VolumeCache::hashPath(std::string path)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < path.size(); i++)
+	{
+		hash ^= (unsigned char) path[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
@@ -0,0 +1,406 @@
+#ifndef IMPORTING_VOLUMECACHE_H_
+#define IMPORTING_VOLUMECACHE_H_
+
+#ifdef MINGW_THREADS
+	#include <mingw-std-threads/mingw.mutex.h>
+#else
+	#include <mutex>
+#endif
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <limits>
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <Core/DebugLog.h>
+#include <Core/MappedFile.h>
+#include <Core/ThreadPool.h>
+#include <Core/SimdTools.h>
+#include <Core/VolumeData.h>
+
+/**
+ * Preprocessed volume written next to the source file (<source>.vcache), so later launches can map it instead of importing again.
+ * Holds the voxels in upload-ready layout (x-fastest, element type T), min/max, a histogram, the full mip pyramid
+ * and a grid of min/max per macro cell. The cache is keyed by source path, size and modification time
+ * and is machine-local (native byte order).
+ */
+namespace VolumeCache
+{
+	static const unsigned int VERSION = 1;
+	static const unsigned int MAX_LEVELS = 16;
+	static const unsigned int NUM_HISTOGRAM_BINS = 256;
+	static const unsigned int MACRO_CELL_SIZE = 8; //!< voxels per macro cell edge
+	static const unsigned int ALIGNMENT = 64; //!< of every section in the file
+
+	struct Header
+	{
+		char magic[8];
+		unsigned int version;
+		unsigned int byteOrderMark; //!< 0x01020304 in native byte order
+
+		// element type
+		unsigned int elementSize;
+		unsigned int isInteger;
+		unsigned int isSigned;
+
+		// key
+		unsigned long long sourcePathHash;
+		unsigned long long sourceSize;
+		long long sourceModificationTime;
+
+		unsigned int size_x, size_y, size_z;
+		float real_size_x, real_size_y, real_size_z;
+		double min, max;
+
+		unsigned int numLevels;
+		unsigned int levelSize[MAX_LEVELS][3];
+		unsigned long long levelOffset[MAX_LEVELS]; //!< bytes from start of file
+
+		unsigned int numHistogramBins;
+		unsigned long long histogramOffset; //!< unsigned int counts over [min, max]
+
+		unsigned int macroCellSize;
+		unsigned int macroCellGridSize[3];
+		unsigned long long macroCellOffset; //!< pairs of T (min, max) per cell, x-fastest
+
+		unsigned long long fileSize;
+	};
+
+	/** @brief a mapped cache file, all pointers reference the mapping */
+	template<class T>
+	struct CachedVolume
+	{
+		std::shared_ptr<MappedFile> file;
+		std::vector< VolumeDataView<T> > levels; //!< level 0 is the full resolution volume
+		const unsigned int* histogram;
+		unsigned int numHistogramBins;
+		const T* macroCells; //!< min, max per cell
+		unsigned int macroCellSize;
+		unsigned int macroCellGridSize[3];
+
+		CachedVolume() : histogram(nullptr), numHistogramBins(0), macroCells(nullptr), macroCellSize(0) { macroCellGridSize[0] = macroCellGridSize[1] = macroCellGridSize[2] = 0; }
+
+		inline bool isValid() const { return !levels.empty(); }
+
+		/** @brief metadata of level 0 without voxels, i.e. for code that expects a VolumeData */
+		VolumeData<T> getInfo() const
+		{
+			VolumeData<T> info;
+			if (!isValid()) { return info; }
+			info.size_x = levels[0].size_x;
+			info.size_y = levels[0].size_y;
+			info.size_z = levels[0].size_z;
+			info.real_size_x = levels[0].real_size_x;
+			info.real_size_y = levels[0].real_size_y;
+			info.real_size_z = levels[0].real_size_z;
+			info.min = levels[0].min;
+			info.max = levels[0].max;
+			return info;
+		}
+	};
+
+	std::string getCachePath(std::string sourcePath); //!< <source>.vcache
+	std::string getTempPath(std::string cachePath); //!< unique per call, so concurrent writes of the same cache never share a file
+
+	/** @brief move a finished temporary file onto cachePath, serialized with the other writers of this process */
+	bool replaceCache(std::string tempPath, std::string cachePath);
+
+	/**
+	 * @brief size and modification time of a source. Slice stacks (<prefix>.1 .. .n) are stamped by their total size and a hash over size and modification time of every slice
+	 * @return false if neither sourcePath nor sourcePath.1 exists
+	 */
+	bool getSourceStamp(std::string sourcePath, unsigned long long& size, long long& modificationTime);
+	unsigned long long hashPath(std::string path); //!< FNV-1a
+
+	/**
+	 * @brief map the cache file of a source, if it is present and up to date
+	 * @return mapping, check isValid()
+	 */
+	template<class T>
+	CachedVolume<T> open(std::string sourcePath);
+
+	/**
+	 * @brief derive mips, histogram and macro cells from a volume and write the cache file next to its source
+	 * @return true on success
+	 */
+	template<class T>
+	bool write(std::string sourcePath, const VolumeData<T>& volume);
+
+	/** @brief 2x2x2 box filtered next mip level, sizes are halved and rounded down like OpenGL mip levels */
+	template<class T>
+	void downsample(const VolumeDataView<T>& level, std::vector<T>& result, unsigned int& size_x, unsigned int& size_y, unsigned int& size_z);
+}
+
+////// IMPLEMENTATION
+namespace VolumeCache
+{
+	template<class T>
+	void fillHeader(Header& header)
+	{
+		memset(&header, 0, sizeof(Header));
+		memcpy(header.magic, "VRVCACHE", 8);
+		header.version = VERSION;
+		header.byteOrderMark = 0x01020304;
+		header.elementSize = sizeof(T);
+		header.isInteger = std::numeric_limits<T>::is_integer ? 1 : 0;
+		header.isSigned = std::numeric_limits<T>::is_signed ? 1 : 0;
+	}
+
+	inline unsigned long long alignOffset(unsigned long long offset)
+	{
+		return (offset + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	}
+}
+
+template<class T>
+void VolumeCache::downsample(const VolumeDataView<T>& level, std::vector<T>& result, unsigned int& size_x, unsigned int& size_y, unsigned int& size_z)
+{
+	size_x = std::max(1u, level.size_x / 2);
+	size_y = std::max(1u, level.size_y / 2);
+	size_z = std::max(1u, level.size_z / 2);
+	result.resize((size_t) size_x * size_y * size_z);
+
+	const unsigned int sx = size_x, sy = size_y;
+	THREADPOOL->parallelFor(0, size_z, [&](size_t zBegin, size_t zEnd)
+	{
+		for (size_t z = zBegin; z < zEnd; z++)
+		{
+			size_t z0 = std::min<size_t>(2 * z, level.size_z - 1), z1 = std::min<size_t>(2 * z + 1, level.size_z - 1);
+			for (size_t y = 0; y < sy; y++)
+			{
+				size_t y0 = std::min<size_t>(2 * y, level.size_y - 1), y1 = std::min<size_t>(2 * y + 1, level.size_y - 1);
+				const T* rows[4] = {
+					level.data + (z0 * level.size_y + y0) * level.size_x,
+					level.data + (z0 * level.size_y + y1) * level.size_x,
+					level.data + (z1 * level.size_y + y0) * level.size_x,
+					level.data + (z1 * level.size_y + y1) * level.size_x };
+				T* target = &result[(z * sy + y) * sx];
+				for (size_t x = 0; x < sx; x++)
+				{
+					size_t x0 = std::min<size_t>(2 * x, level.size_x - 1), x1 = std::min<size_t>(2 * x + 1, level.size_x - 1);
+					double sum = 0.0;
+					for (int r = 0; r < 4; r++) { sum += (double) rows[r][x0] + (double) rows[r][x1]; }
+					target[x] = std::numeric_limits<T>::is_integer ? (T) std::floor(sum / 8.0 + 0.5) : (T) (sum / 8.0);
+				}
+			}
+		}
+	});
+}
+
+template<class T>
+bool VolumeCache::write(std::string sourcePath, const VolumeData<T>& volume)
+{
+	Header header;
+	fillHeader<T>(header);
+	if (!getSourceStamp(sourcePath, header.sourceSize, header.sourceModificationTime) || volume.data.empty())
+	{
+		return false;
+	}
+	DEBUGLOG->log("Writing volume cache: " + getCachePath(sourcePath));
+
+	header.sourcePathHash = hashPath(sourcePath);
+	header.size_x = volume.size_x;
+	header.size_y = volume.size_y;
+	header.size_z = volume.size_z;
+	header.real_size_x = volume.real_size_x;
+	header.real_size_y = volume.real_size_y;
+	header.real_size_z = volume.real_size_z;
+	header.min = (double) volume.min;
+	header.max = (double) volume.max;
+
+	// mip pyramid down to a single voxel
+	std::vector< std::vector<T> > mips;
+	std::vector< VolumeDataView<T> > levels(1, VolumeDataView<T>(volume));
+	mips.reserve(MAX_LEVELS); // views into mips must stay valid
+	while (levels.size() < MAX_LEVELS && (levels.back().size_x > 1 || levels.back().size_y > 1 || levels.back().size_z > 1))
+	{
+		mips.push_back(std::vector<T>());
+		VolumeDataView<T> next = levels.back();
+		downsample(levels.back(), mips.back(), next.size_x, next.size_y, next.size_z);
+		next.data = &mips.back()[0];
+		levels.push_back(next);
+	}
+
+	// histogram over [min, max], per chunk and merged
+	std::vector<unsigned int> histogram(NUM_HISTOGRAM_BINS, 0);
+	double range = std::max(header.max - header.min, std::numeric_limits<double>::min());
+	std::mutex histogramMutex;
+	THREADPOOL->parallelFor(0, volume.data.size(), [&](size_t begin, size_t end)
+	{
+		std::vector<unsigned int> local(NUM_HISTOGRAM_BINS, 0);
+		for (size_t i = begin; i < end; i++)
+		{
+			int bin = (int) (((double) volume.data[i] - header.min) / range * NUM_HISTOGRAM_BINS);
+			local[std::min(std::max(bin, 0), (int) NUM_HISTOGRAM_BINS - 1)]++;
+		}
+		std::lock_guard<std::mutex> lock(histogramMutex);
+		for (unsigned int b = 0; b < NUM_HISTOGRAM_BINS; b++) { histogram[b] += local[b]; }
+	}, 1 << 18);
+
+	// macro cells, each including the first voxel of its neighbours, since samples are interpolated
+	unsigned int gridSize[3] = {
+		(volume.size_x + MACRO_CELL_SIZE - 1) / MACRO_CELL_SIZE,
+		(volume.size_y + MACRO_CELL_SIZE - 1) / MACRO_CELL_SIZE,
+		(volume.size_z + MACRO_CELL_SIZE - 1) / MACRO_CELL_SIZE };
+	std::vector<T> macroCells(2 * (size_t) gridSize[0] * gridSize[1] * gridSize[2]);
+	THREADPOOL->parallelFor(0, gridSize[2], [&](size_t cBegin, size_t cEnd)
+	{
+		for (size_t cz = cBegin; cz < cEnd; cz++) { for (size_t cy = 0; cy < gridSize[1]; cy++) { for (size_t cx = 0; cx < gridSize[0]; cx++)
+		{
+			T cellMin = std::numeric_limits<T>::max();
+			T cellMax = std::numeric_limits<T>::lowest();
+			size_t xBegin = cx * MACRO_CELL_SIZE, xEnd = std::min<size_t>(xBegin + MACRO_CELL_SIZE + 1, volume.size_x);
+			size_t yEnd = std::min<size_t>((cy + 1) * MACRO_CELL_SIZE + 1, volume.size_y);
+			size_t zEnd = std::min<size_t>((cz + 1) * MACRO_CELL_SIZE + 1, volume.size_z);
+			for (size_t z = cz * MACRO_CELL_SIZE; z < zEnd; z++) { for (size_t y = cy * MACRO_CELL_SIZE; y < yEnd; y++)
+			{
+				SimdTools::updateMinMax(&volume.data[(z * volume.size_y + y) * volume.size_x + xBegin], xEnd - xBegin, cellMin, cellMax);
+			}}
+			size_t cell = (cz * gridSize[1] + cy) * gridSize[0] + cx;
+			macroCells[2 * cell] = cellMin;
+			macroCells[2 * cell + 1] = cellMax;
+		}}}
+	});
+
+	// layout
+	unsigned long long offset = alignOffset(sizeof(Header));
+	header.numLevels = (unsigned int) levels.size();
+	for (unsigned int i = 0; i < header.numLevels; i++)
+	{
+		header.levelSize[i][0] = levels[i].size_x;
+		header.levelSize[i][1] = levels[i].size_y;
+		header.levelSize[i][2] = levels[i].size_z;
+		header.levelOffset[i] = offset;
+		offset = alignOffset(offset + levels[i].getNumVoxels() * sizeof(T));
+	}
+	header.numHistogramBins = NUM_HISTOGRAM_BINS;
+	header.histogramOffset = offset;
+	offset = alignOffset(offset + NUM_HISTOGRAM_BINS * sizeof(unsigned int));
+	header.macroCellSize = MACRO_CELL_SIZE;
+	memcpy(header.macroCellGridSize, gridSize, sizeof(gridSize));
+	header.macroCellOffset = offset;
+	offset += macroCells.size() * sizeof(T);
+	header.fileSize = offset;
+
+	// write to a temporary file first, so an interrupted write never leaves a valid looking cache
+	std::string cachePath = getCachePath(sourcePath);
+	std::string tempPath = getTempPath(cachePath);
+	{
+		std::ofstream file(tempPath.c_str(), std::ofstream::binary | std::ofstream::trunc);
+		if (!file.is_open())
+		{
+			DEBUGLOG->log("ERROR: could not write volume cache: " + tempPath);
+			return false;
+		}
+
+		auto writeAt = [&file](unsigned long long position, const void* data, size_t bytes)
+		{
+			static const char zeros[ALIGNMENT] = {0};
+			unsigned long long current = (unsigned long long) file.tellp();
+			if (position > current) { file.write(zeros, (std::streamsize) (position - current)); }
+			file.write((const char*) data, (std::streamsize) bytes);
+		};
+
+		writeAt(0, &header, sizeof(Header));
+		for (unsigned int i = 0; i < header.numLevels; i++)
+		{
+			writeAt(header.levelOffset[i], levels[i].data, levels[i].getNumVoxels() * sizeof(T));
+		}
+		writeAt(header.histogramOffset, &histogram[0], histogram.size() * sizeof(unsigned int));
+		writeAt(header.macroCellOffset, &macroCells[0], macroCells.size() * sizeof(T));
+
+		if (!file.good())
+		{
+			DEBUGLOG->log("ERROR: could not write volume cache: " + tempPath);
+			file.close();
+			remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+	return replaceCache(tempPath, cachePath);
+}
+
+template<class T>
+VolumeCache::CachedVolume<T> VolumeCache::open(std::string sourcePath)
+{
+	CachedVolume<T> result;
+
+	Header expected;
+	fillHeader<T>(expected);
+	if (!getSourceStamp(sourcePath, expected.sourceSize, expected.sourceModificationTime))
+	{
+		return result;
+	}
+
+	std::string cachePath = getCachePath(sourcePath);
+	std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+	{
+		std::ifstream probe(cachePath.c_str(), std::ifstream::binary); // MappedFile logs missing files as errors
+		if (!probe.is_open() || !file->open(cachePath)) { return result; }
+	}
+
+	if (file->getSize() < sizeof(Header))
+	{
+		return result;
+	}
+	const Header& header = *reinterpret_cast<const Header*>(file->getData());
+	if (memcmp(header.magic, expected.magic, 8) != 0
+		|| header.version != expected.version
+		|| header.byteOrderMark != expected.byteOrderMark
+		|| header.elementSize != expected.elementSize
+		|| header.isInteger != expected.isInteger
+		|| header.isSigned != expected.isSigned
+		|| header.fileSize != file->getSize()
+		|| header.numLevels == 0 || header.numLevels > MAX_LEVELS)
+	{
+		DEBUGLOG->log("Volume cache is incompatible, ignoring: " + cachePath);
+		return result;
+	}
+	if (header.sourcePathHash != hashPath(sourcePath)
+		|| header.sourceSize != expected.sourceSize
+		|| header.sourceModificationTime != expected.sourceModificationTime)
+	{
+		DEBUGLOG->log("Volume cache is outdated, ignoring: " + cachePath);
+		return result;
+	}
+
+	DEBUGLOG->log("Mapping volume cache: " + cachePath);
+	for (unsigned int i = 0; i < header.numLevels; i++)
+	{
+		VolumeDataView<T> level;
+		level.size_x = header.levelSize[i][0];
+		level.size_y = header.levelSize[i][1];
+		level.size_z = header.levelSize[i][2];
+		if (header.levelOffset[i] + level.getNumVoxels() * sizeof(T) > header.fileSize) { return CachedVolume<T>(); }
+		level.data = reinterpret_cast<const T*>(file->getData() + header.levelOffset[i]);
+		level.real_size_x = header.real_size_x * (float) header.size_x / (float) level.size_x;
+		level.real_size_y = header.real_size_y * (float) header.size_y / (float) level.size_y;
+		level.real_size_z = header.real_size_z * (float) header.size_z / (float) level.size_z;
+		level.min = (T) header.min; // range of the full resolution volume, so windowing stays consistent across levels
+		level.max = (T) header.max;
+		result.levels.push_back(level);
+	}
+
+	if (header.histogramOffset + header.numHistogramBins * sizeof(unsigned int) <= header.fileSize)
+	{
+		result.histogram = reinterpret_cast<const unsigned int*>(file->getData() + header.histogramOffset);
+		result.numHistogramBins = header.numHistogramBins;
+	}
+	unsigned long long numCells = (unsigned long long) header.macroCellGridSize[0] * header.macroCellGridSize[1] * header.macroCellGridSize[2];
+	if (header.macroCellOffset + 2 * numCells * sizeof(T) <= header.fileSize)
+	{
+		result.macroCells = reinterpret_cast<const T*>(file->getData() + header.macroCellOffset);
+		result.macroCellSize = header.macroCellSize;
+		memcpy(result.macroCellGridSize, header.macroCellGridSize, sizeof(result.macroCellGridSize));
+	}
+
+	result.file = file;
+	return result;
+}
+
+#endif
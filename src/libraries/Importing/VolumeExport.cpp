@@ -0,0 +1,103 @@
+#include "VolumeExport.h"
+
+#ifdef MINGW_THREADS
+	#include <mingw-std-threads/mingw.thread.h>
+#else
+	#include <thread>
+#endif
+
+#include <Core/ThreadPool.h>
+
+#include "ImportProgress.h"
+#include "ddsbase.h"
+
+bool VolumeExport::writeSlabs(std::ostream& stream, unsigned int depth, unsigned int slabDepth, EncodeFunc encode, std::vector<unsigned long long>* slabSizes)
+{
+	slabDepth = std::max(1u, std::min(slabDepth, depth));
+	const unsigned int numSlabs = (depth + slabDepth - 1) / slabDepth;
+	const unsigned int window = THREADPOOL->getNumThreads() + 1; // one slab per worker and the calling thread
+
+	ImportProgress* progress = ImportProgress::getCurrent();
+	if (progress) { progress->addWork(numSlabs); }
+	if (slabSizes) { slabSizes->clear(); }
+
+	// two windows of slabs: one is encoded while the other one is written
+	std::vector< std::vector<unsigned char> > windows[2];
+	windows[0].resize(window);
+	windows[1].resize(window);
+	std::thread writer;
+	bool cancelled = false;
+
+	for (unsigned int first = 0, w = 0; first < numSlabs; first += window, w = 1 - w)
+	{
+		if (progress && progress->isCancelled())
+		{
+			cancelled = true;
+			break;
+		}
+
+		const unsigned int count = std::min(window, numSlabs - first);
+		std::vector< std::vector<unsigned char> >& slabs = windows[w];
+		THREADPOOL->parallelFor(0, count, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				unsigned int firstSlice = (first + (unsigned int) i) * slabDepth;
+				encode(firstSlice, std::min(slabDepth, depth - firstSlice), slabs[i]);
+			}
+		}, 1);
+
+		// slabs are appended in order, so the previous window has to be written first
+		if (writer.joinable()) { writer.join(); }
+		if (!stream.good()) { break; }
+
+		if (slabSizes) { for (unsigned int i = 0; i < count; i++) { slabSizes->push_back(slabs[i].size()); } }
+		writer = std::thread([&stream, &slabs, count, progress]()
+		{
+			for (unsigned int i = 0; i < count; i++)
+			{
+				if (!slabs[i].empty()) { stream.write((const char*) &slabs[i][0], (std::streamsize) slabs[i].size()); }
+				if (progress) { progress->advance(); }
+			}
+		});
+	}
+	if (writer.joinable()) { writer.join(); }
+
+	return !cancelled && stream.good();
+}
+
+unsigned int VolumeExport::getSlabDepth(size_t sliceBytes, unsigned int depth, size_t slabBytes)
+{
+	size_t slabDepth = std::max<size_t>(1, slabBytes / std::max<size_t>(1, sliceBytes));
+	return (unsigned int) std::max<size_t>(1, std::min<size_t>(slabDepth, depth));
+}
+
+bool VolumeExport::writePVM(std::string path, const unsigned char* volume,
+	unsigned int width, unsigned int height, unsigned int depth, unsigned int components,
+	float scalex, float scaley, float scalez)
+{
+	// writePVMvolume() aborts on errors instead of returning them
+	if ((unsigned long long) width * height * depth * components + 256 > 0xFFFFFFFFull) // voxels and header
+	{
+		DEBUGLOG->log("ERROR: volume too large for a single DDS stream, use a chunked PVM (.pvmc): " + path);
+		return false;
+	}
+	std::ofstream file(path.c_str(), std::ofstream::binary | std::ofstream::trunc);
+	if (!file.is_open())
+	{
+		DEBUGLOG->log("ERROR: could not write " + path);
+		return false;
+	}
+	file.close();
+
+	writePVMvolume(path.c_str(), const_cast<unsigned char*>(volume), width, height, depth, components, scalex, scaley, scalez); // only copies volume
+	return true;
+}
+
+VolumeExport::Format VolumeExport::getFormat(const std::string& path)
+{
+	if (VolumeFile::hasExtension(path, ".pvm")) { return PVM; }
+	if (VolumeFile::hasExtension(path, ".pvmc")) { return CHUNKED_PVM; }
+	if (VolumeFile::hasExtension(path, ".mha") || VolumeFile::hasExtension(path, ".mhd")) { return META_IMAGE; }
+	return RAW;
+}
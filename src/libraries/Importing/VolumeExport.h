@@ -0,0 +1,302 @@
+#ifndef IMPORTING_VOLUMEEXPORT_H_
+#define IMPORTING_VOLUMEEXPORT_H_
+
+#include <string>
+#include <vector>
+#include <limits>
+#include <ostream>
+#include <fstream>
+#include <functional>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+#include <Core/DebugLog.h>
+#include <Core/VolumeData.h>
+
+#include "ChunkedPVM.h"
+#include "VolumeFile.h"
+#include "VoxelConversion.h"
+
+/**
+ * Writing preprocessed volumes back to disk: headerless raw, MetaImage (.mha/.mhd, read back by Importer::loadVolumeFile()),
+ * PVM and chunked PVM (both read back by Importer::load3DDataPVM()). For the mapped cache of a source file see VolumeCache::write().
+ * Except for PVM, which is a single DDS stream, volumes are converted and encoded in slabs of slices on the thread pool while
+ * the previous slabs are being written, so no second copy of the volume is ever held in memory. Exports report to the
+ * ImportProgress of the calling thread.
+ */
+namespace VolumeExport
+{
+	enum Format {
+		RAW,        //!< voxels only
+		META_IMAGE, //!< .mha with attached, .mhd with detached (.raw) voxels
+		PVM,        //!< PVM as written by writePVMvolume(), 8 or 16 bit unsigned
+		CHUNKED_PVM //!< ChunkedPVM, only readable by ChunkedPVM::readVolume()
+	};
+
+	static const size_t DEFAULT_SLAB_BYTES = 4 << 20; //!< uncompressed size of the slabs raw and MetaImage files are written in
+
+	/** @brief fill bytes with the encoded slices [firstSlice, firstSlice + numSlices), called concurrently from the thread pool */
+	typedef std::function<void(unsigned int firstSlice, unsigned int numSlices, std::vector<unsigned char>& bytes)> EncodeFunc;
+
+	/**
+	 * @brief encode slabs in parallel and append them to stream in order. While a window of slabs is written on a separate thread,
+	 *        the next window is encoded, so at most two windows (of one slab per thread) are held in memory
+	 * @param slabSizes (optional) will receive the encoded size of every slab, i.e. to write an index
+	 * @return false if writing failed or the ImportProgress was cancelled
+	 */
+	bool writeSlabs(std::ostream& stream, unsigned int depth, unsigned int slabDepth, EncodeFunc encode, std::vector<unsigned long long>* slabSizes = nullptr);
+
+	/** @brief number of slices per slab of about slabBytes */
+	unsigned int getSlabDepth(size_t sliceBytes, unsigned int depth, size_t slabBytes = DEFAULT_SLAB_BYTES);
+
+	/** @brief by extension: .pvm is PVM, .pvmc is CHUNKED_PVM, .mha/.mhd is META_IMAGE, anything else RAW */
+	Format getFormat(const std::string& path);
+
+	/** @brief voxel spacing that reproduces the aspect ratio of volume.real_size_*, the smallest one is 1 */
+	template<class T>
+	void getSpacing(const VolumeData<T>& volume, float& spacing_x, float& spacing_y, float& spacing_z);
+
+	/** @brief append the voxels of volume to stream, x-fastest, multi-byte values in the requested byte order */
+	template<class T>
+	bool writeVoxels(std::ostream& stream, const VolumeData<T>& volume, bool bigEndian = !VoxelConversion::isLittleEndianMachine());
+
+	/** @brief headerless raw file, multi-byte values in the requested byte order */
+	template<class T>
+	bool writeRaw(std::string path, const VolumeData<T>& volume, bool bigEndian = !VoxelConversion::isLittleEndianMachine());
+
+	/** @brief MetaImage in native byte order, the voxels go to a .raw file next to .mhd headers */
+	template<class T>
+	bool writeMetaImage(std::string path, const VolumeData<T>& volume);
+
+	/**
+	 * @brief slices of volume as PVM voxels: unsigned 8 and 16 bit volumes are stored as they are,
+	 *        any other range [min, max] is mapped linearly onto 16 bit, most significant byte first
+	 * @param components will receive the bytes per voxel
+	 */
+	template<class T>
+	ChunkedPVM::SlabFunc getPVMSlabs(const VolumeData<T>& volume, unsigned int& components);
+
+	/** @brief writePVMvolume() for voxels in memory, after checking that the file can be written and the volume fits into a DDS stream */
+	bool writePVM(std::string path, const unsigned char* volume,
+		unsigned int width, unsigned int height, unsigned int depth, unsigned int components,
+		float scalex, float scaley, float scalez);
+
+	/** @brief PVM file any PVM reader understands, the converted volume is encoded as a whole (see getPVMSlabs()) */
+	template<class T>
+	bool writePVM(std::string path, const VolumeData<T>& volume);
+
+	/**
+	 * @brief chunked PVM file (.pvmc), slabs are converted and encoded on the thread pool (see getPVMSlabs())
+	 * @param slabDepth (optional) see ChunkedPVM::writeVolume()
+	 */
+	template<class T>
+	bool writeChunkedPVM(std::string path, const VolumeData<T>& volume, unsigned int slabDepth = 0);
+
+	/** @brief write volume in the format given by getFormat(path) */
+	template<class T>
+	bool writeVolume(std::string path, const VolumeData<T>& volume);
+}
+
+////// IMPLEMENTATION
+template<class T>
+void VolumeExport::getSpacing(const VolumeData<T>& volume, float& spacing_x, float& spacing_y, float& spacing_z)
+{
+	float smallest = std::min(volume.real_size_x, std::min(volume.real_size_y, volume.real_size_z));
+	if (!(smallest > 0.0f))
+	{
+		spacing_x = spacing_y = spacing_z = 1.0f;
+		return;
+	}
+	spacing_x = volume.real_size_x / smallest;
+	spacing_y = volume.real_size_y / smallest;
+	spacing_z = volume.real_size_z / smallest;
+}
+
+template<class T>
+bool VolumeExport::writeVoxels(std::ostream& stream, const VolumeData<T>& volume, bool bigEndian)
+{
+	const size_t sliceVoxels = (size_t) volume.size_x * volume.size_y;
+	const bool swap = sizeof(T) > 1 && bigEndian == VoxelConversion::isLittleEndianMachine();
+	const unsigned char* voxels = reinterpret_cast<const unsigned char*>(&volume.data[0]);
+
+	return writeSlabs(stream, volume.size_z, getSlabDepth(sliceVoxels * sizeof(T), volume.size_z), [&](unsigned int firstSlice, unsigned int numSlices, std::vector<unsigned char>& bytes)
+	{
+		const unsigned char* src = voxels + firstSlice * sliceVoxels * sizeof(T);
+		const size_t numBytes = numSlices * sliceVoxels * sizeof(T);
+		bytes.resize(numBytes);
+		if (!swap)
+		{
+			memcpy(&bytes[0], src, numBytes);
+			return;
+		}
+		for (size_t i = 0; i < numBytes; i += sizeof(T))
+		{
+			for (size_t b = 0; b < sizeof(T); b++) { bytes[i + b] = src[i + sizeof(T) - 1 - b]; }
+		}
+	});
+}
+
+template<class T>
+bool VolumeExport::writeRaw(std::string path, const VolumeData<T>& volume, bool bigEndian)
+{
+	if (volume.data.empty() || volume.data.size() != (size_t) volume.size_x * volume.size_y * volume.size_z)
+	{
+		DEBUGLOG->log("ERROR: no voxels to export to " + path);
+		return false;
+	}
+	DEBUGLOG->log("Writing raw volume: " + path);
+
+	std::ofstream file(path.c_str(), std::ofstream::binary | std::ofstream::trunc);
+	bool success = file.is_open() && writeVoxels(file, volume, bigEndian);
+	file.close();
+	if (!success)
+	{
+		DEBUGLOG->log("ERROR: could not write " + path);
+		remove(path.c_str());
+	}
+	return success;
+}
+
+template<class T>
+bool VolumeExport::writeMetaImage(std::string path, const VolumeData<T>& volume)
+{
+	if (volume.data.empty() || volume.data.size() != (size_t) volume.size_x * volume.size_y * volume.size_z)
+	{
+		DEBUGLOG->log("ERROR: no voxels to export to " + path);
+		return false;
+	}
+	DEBUGLOG->log("Writing MetaImage: " + path);
+
+	VolumeFile::Header header;
+	header.size_x = volume.size_x;
+	header.size_y = volume.size_y;
+	header.size_z = volume.size_z;
+	getSpacing(volume, header.spacing_x, header.spacing_y, header.spacing_z);
+	header.type = VoxelConversion::getVoxelType<T>();
+	header.bigEndian = !VoxelConversion::isLittleEndianMachine();
+	header.encoding = VolumeFile::RAW;
+
+	// attached voxels for .mha, a .raw file next to the header otherwise
+	const bool attached = VolumeFile::hasExtension(path, ".mha");
+	if (!attached)
+	{
+		header.dataPath = path.substr(0, path.find_last_of('.')) + ".raw";
+	}
+
+	std::ofstream file(path.c_str(), std::ofstream::binary | std::ofstream::trunc);
+	bool success = file.is_open() && VolumeFile::writeMetaImageHeader(file, header);
+	if (success && attached)
+	{
+		success = writeVoxels(file, volume);
+	}
+	file.close();
+	if (!success)
+	{
+		DEBUGLOG->log("ERROR: could not write " + path);
+		remove(path.c_str());
+		return false;
+	}
+
+	if (!attached && !writeRaw(header.dataPath, volume))
+	{
+		remove(path.c_str());
+		return false;
+	}
+	return true;
+}
+
+template<class T>
+ChunkedPVM::SlabFunc VolumeExport::getPVMSlabs(const VolumeData<T>& volume, unsigned int& components)
+{
+	const double min = (double) volume.min;
+	const double max = (double) volume.max;
+	const bool isInteger = std::numeric_limits<T>::is_integer;
+	components = (isInteger && sizeof(T) == 1 && min >= 0.0) ? 1 : 2;
+	const bool exact = isInteger && min >= 0.0 && max <= ((components == 1) ? 255.0 : 65535.0);
+	const double offset = exact ? 0.0 : min;
+	const double scale = exact ? 1.0 : 65535.0 / std::max(max - min, std::numeric_limits<double>::min());
+	if (!exact)
+	{
+		DEBUGLOG->log("Mapping volume range onto 16 bit, min: ", min);
+		DEBUGLOG->log("                                  max: ", max);
+	}
+
+	const size_t sliceVoxels = (size_t) volume.size_x * volume.size_y;
+	const T* voxels = &volume.data[0];
+	const unsigned int bytes = components;
+	return [=](unsigned int firstSlice, unsigned int numSlices, std::vector<unsigned char>& scratch) -> const unsigned char*
+	{
+		const T* src = voxels + firstSlice * sliceVoxels;
+		const size_t count = numSlices * sliceVoxels;
+		if (bytes == 1 && exact && sizeof(T) == 1)
+		{
+			return reinterpret_cast<const unsigned char*>(src);
+		}
+
+		scratch.resize(count * bytes);
+		for (size_t i = 0; i < count; i++)
+		{
+			if (bytes == 1)
+			{
+				scratch[i] = (unsigned char) src[i];
+				continue;
+			}
+			unsigned short value = exact ? (unsigned short) src[i] : VoxelConversion::saturate<unsigned short>(((double) src[i] - offset) * scale);
+			scratch[2 * i] = (unsigned char) (value >> 8);
+			scratch[2 * i + 1] = (unsigned char) (value & 0xFF);
+		}
+		return &scratch[0];
+	};
+}
+
+template<class T>
+bool VolumeExport::writePVM(std::string path, const VolumeData<T>& volume)
+{
+	if (volume.data.empty() || volume.data.size() != (size_t) volume.size_x * volume.size_y * volume.size_z)
+	{
+		DEBUGLOG->log("ERROR: no voxels to export to " + path);
+		return false;
+	}
+	DEBUGLOG->log("Writing PVM file: " + path);
+
+	unsigned int components;
+	ChunkedPVM::SlabFunc getSlab = getPVMSlabs(volume, components);
+	std::vector<unsigned char> scratch;
+	const unsigned char* voxels = getSlab(0, volume.size_z, scratch);
+	float scalex, scaley, scalez;
+	getSpacing(volume, scalex, scaley, scalez);
+	return writePVM(path, voxels, volume.size_x, volume.size_y, volume.size_z, components, scalex, scaley, scalez);
+}
+
+template<class T>
+bool VolumeExport::writeChunkedPVM(std::string path, const VolumeData<T>& volume, unsigned int slabDepth)
+{
+	if (volume.data.empty() || volume.data.size() != (size_t) volume.size_x * volume.size_y * volume.size_z)
+	{
+		DEBUGLOG->log("ERROR: no voxels to export to " + path);
+		return false;
+	}
+	DEBUGLOG->log("Writing chunked PVM file: " + path);
+
+	unsigned int components;
+	ChunkedPVM::SlabFunc getSlab = getPVMSlabs(volume, components);
+	float scalex, scaley, scalez;
+	getSpacing(volume, scalex, scaley, scalez);
+	return ChunkedPVM::writeVolume(path, getSlab, volume.size_x, volume.size_y, volume.size_z, components, scalex, scaley, scalez, slabDepth);
+}
+
+template<class T>
+bool VolumeExport::writeVolume(std::string path, const VolumeData<T>& volume)
+{
+	switch (getFormat(path))
+	{
+		case PVM:         return writePVM(path, volume);
+		case CHUNKED_PVM: return writeChunkedPVM(path, volume);
+		case META_IMAGE: return writeMetaImage(path, volume);
+		default:         return writeRaw(path, volume);
+	}
+}
+
+#endif
@@ -0,0 +1,409 @@
+#include "VolumeFile.h"
+
+#include <Core/DebugLog.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+std::string trim(const std::string& s)
+{
+	size_t begin = s.find_first_not_of(" \t\r\n");
+	if (begin == std::string::npos) { return std::string(); }
+	size_t end = s.find_last_not_of(" \t\r\n");
+	return s.substr(begin, end - begin + 1);
+}
+
+std::string toLower(std::string s)
+{
+	std::transform(s.begin(), s.end(), s.begin(), [](char c) { return (char) ((c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c); });
+	return s;
+}
+
+template<class V>
+std::vector<V> parseList(const std::string& s)
+{
+	std::vector<V> result;
+	std::istringstream stream(s);
+	V value;
+	while (stream >> value) { result.push_back(value); }
+	return result;
+}
+
+std::string getDirectory(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return (slash == std::string::npos) ? std::string() : path.substr(0, slash + 1);
+}
+
+bool isAbsolute(const std::string& path)
+{
+	return !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+}
+
+/** @brief fill extents and spacing from per-axis lists, 2D images get a single slice */
+bool setExtents(VolumeFile::Header& header, const std::vector<unsigned int>& sizes, const std::vector<float>& spacings)
+{
+	if (sizes.size() < 2 || sizes.size() > 3) { return false; }
+	header.size_x = sizes[0];
+	header.size_y = sizes[1];
+	header.size_z = (sizes.size() > 2) ? sizes[2] : 1;
+
+	float* spacing[3] = { &header.spacing_x, &header.spacing_y, &header.spacing_z };
+	for (size_t i = 0; i < 3; i++)
+	{
+		// NRRD writes nan for axes without spacing
+		*spacing[i] = (i < spacings.size() && spacings[i] > 0.0f && spacings[i] == spacings[i]) ? spacings[i] : 1.0f;
+	}
+	return header.getNumVoxels() > 0;
+}
+
+bool parseMetaImageType(const std::string& value, VoxelConversion::VoxelType& type)
+{
+	if (value == "MET_CHAR")   { type = VoxelConversion::INT8; return true; }
+	if (value == "MET_UCHAR")  { type = VoxelConversion::UINT8; return true; }
+	if (value == "MET_SHORT")  { type = VoxelConversion::INT16; return true; }
+	if (value == "MET_USHORT") { type = VoxelConversion::UINT16; return true; }
+	if (value == "MET_INT")    { type = VoxelConversion::INT32; return true; }
+	if (value == "MET_UINT")   { type = VoxelConversion::UINT32; return true; }
+	if (value == "MET_FLOAT")  { type = VoxelConversion::FLOAT32; return true; }
+	if (value == "MET_DOUBLE") { type = VoxelConversion::FLOAT64; return true; }
+	return false;
+}
+
+bool parseNrrdType(const std::string& value, VoxelConversion::VoxelType& type)
+{
+	static const struct { const char* name; VoxelConversion::VoxelType type; } types[] = {
+		{ "signed char", VoxelConversion::INT8 }, { "int8", VoxelConversion::INT8 }, { "int8_t", VoxelConversion::INT8 },
+		{ "uchar", VoxelConversion::UINT8 }, { "unsigned char", VoxelConversion::UINT8 }, { "uint8", VoxelConversion::UINT8 }, { "uint8_t", VoxelConversion::UINT8 },
+		{ "short", VoxelConversion::INT16 }, { "short int", VoxelConversion::INT16 }, { "signed short", VoxelConversion::INT16 },
+		{ "signed short int", VoxelConversion::INT16 }, { "int16", VoxelConversion::INT16 }, { "int16_t", VoxelConversion::INT16 },
+		{ "ushort", VoxelConversion::UINT16 }, { "unsigned short", VoxelConversion::UINT16 }, { "unsigned short int", VoxelConversion::UINT16 },
+		{ "uint16", VoxelConversion::UINT16 }, { "uint16_t", VoxelConversion::UINT16 },
+		{ "int", VoxelConversion::INT32 }, { "signed int", VoxelConversion::INT32 }, { "int32", VoxelConversion::INT32 }, { "int32_t", VoxelConversion::INT32 },
+		{ "uint", VoxelConversion::UINT32 }, { "unsigned int", VoxelConversion::UINT32 }, { "uint32", VoxelConversion::UINT32 }, { "uint32_t", VoxelConversion::UINT32 },
+		{ "float", VoxelConversion::FLOAT32 }, { "double", VoxelConversion::FLOAT64 }
+	};
+	for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+	{
+		if (value == types[i].name) { type = types[i].type; return true; }
+	}
+	return false;
+}
+
+/** @brief lengths of NRRD space direction vectors "(x,y,z) (x,y,z) none" */
+std::vector<float> parseSpaceDirections(const std::string& value)
+{
+	std::vector<float> result;
+	size_t pos = 0;
+	while (pos < value.size())
+	{
+		size_t begin = value.find_first_not_of(" \t", pos);
+		if (begin == std::string::npos) { break; }
+		if (value.compare(begin, 4, "none") == 0)
+		{
+			result.push_back(0.0f);
+			pos = begin + 4;
+			continue;
+		}
+		size_t end = value.find(')', begin);
+		if (value[begin] != '(' || end == std::string::npos) { break; }
+
+		std::string vector = value.substr(begin + 1, end - begin - 1);
+		std::replace(vector.begin(), vector.end(), ',', ' ');
+		std::vector<double> components = parseList<double>(vector);
+		double lengthSquared = 0.0;
+		for (size_t i = 0; i < components.size(); i++) { lengthSquared += components[i] * components[i]; }
+		result.push_back((float) std::sqrt(lengthSquared));
+		pos = end + 1;
+	}
+	return result;
+}
+}
+
+VolumeFile::Header::Header()
+	: size_x(0), size_y(0), size_z(0)
+	, spacing_x(1.0f), spacing_y(1.0f), spacing_z(1.0f)
+	, type(VoxelConversion::UINT8)
+	, bigEndian(false)
+	, encoding(RAW)
+	, dataOffset(0)
+	, lineSkip(0)
+	, decodedSkip(0)
+	, compressedSize(0)
+{
+}
+
+bool VolumeFile::hasExtension(const std::string& path, const std::string& extension)
+{
+	return path.size() >= extension.size() && toLower(path.substr(path.size() - extension.size())) == toLower(extension);
+}
+
+bool VolumeFile::readMetaImageHeader(const std::string& path, Header& header)
+{
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		DEBUGLOG->log("ERROR: could not open MetaImage header: " + path);
+		return false;
+	}
+
+	header = Header();
+	std::vector<unsigned int> sizes;
+	std::vector<float> spacings;
+	std::vector<float> elementSizes;
+	int numDims = 0;
+	long long headerSize = 0;
+	bool typeValid = false;
+	bool dataFileFound = false;
+
+	// key = value, ElementDataFile is always the last one
+	std::string line;
+	while (std::getline(file, line))
+	{
+		size_t separator = line.find('=');
+		if (separator == std::string::npos) { continue; }
+		std::string key = trim(line.substr(0, separator));
+		std::string value = trim(line.substr(separator + 1));
+
+		if (key == "NDims") { numDims = atoi(value.c_str()); }
+		else if (key == "DimSize") { sizes = parseList<unsigned int>(value); }
+		else if (key == "ElementSpacing") { spacings = parseList<float>(value); }
+		else if (key == "ElementSize") { elementSizes = parseList<float>(value); }
+		else if (key == "ElementType") { typeValid = parseMetaImageType(value, header.type); }
+		else if (key == "ElementByteOrderMSB" || key == "BinaryDataByteOrderMSB") { header.bigEndian = (toLower(value) == "true"); }
+		else if (key == "CompressedData") { header.encoding = (toLower(value) == "true") ? ZLIB : RAW; }
+		else if (key == "CompressedDataSize") { header.compressedSize = strtoull(value.c_str(), NULL, 10); }
+		else if (key == "HeaderSize") { headerSize = atoll(value.c_str()); }
+		else if (key == "ElementNumberOfChannels" && atoi(value.c_str()) != 1)
+		{
+			DEBUGLOG->log("ERROR: only scalar MetaImages are supported: " + path);
+			return false;
+		}
+		else if (key == "ElementDataFile")
+		{
+			if (value == "LOCAL")
+			{
+				header.dataPath = path;
+				header.dataOffset = (long long) file.tellg();
+				if (header.dataOffset < 0) // no payload after the header line
+				{
+					file.clear();
+					header.dataOffset = (long long) file.seekg(0, std::ios::end).tellg();
+				}
+			}
+			else if (value == "LIST" || value.find('%') != std::string::npos || value.find(' ') != std::string::npos)
+			{
+				DEBUGLOG->log("ERROR: MetaImage slice file lists are not supported: " + path);
+				return false;
+			}
+			else
+			{
+				header.dataPath = isAbsolute(value) ? value : getDirectory(path) + value;
+				header.dataOffset = headerSize;
+			}
+			dataFileFound = true;
+			break;
+		}
+	}
+
+	if (numDims != (int) sizes.size() || !setExtents(header, sizes, spacings.empty() ? elementSizes : spacings))
+	{
+		DEBUGLOG->log("ERROR: only 2D and 3D MetaImages are supported: " + path);
+		return false;
+	}
+	if (!typeValid || !dataFileFound)
+	{
+		DEBUGLOG->log("ERROR: MetaImage header lacks a supported ElementType or ElementDataFile: " + path);
+		return false;
+	}
+	if (header.dataOffset < 0 && header.encoding != RAW)
+	{
+		DEBUGLOG->log("ERROR: HeaderSize -1 requires an uncompressed MetaImage: " + path);
+		return false;
+	}
+	return true;
+}
+
+bool VolumeFile::readNrrdHeader(const std::string& path, Header& header)
+{
+	std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+	std::string line;
+	if (!file.is_open() || !std::getline(file, line) || line.compare(0, 4, "NRRD") != 0)
+	{
+		DEBUGLOG->log("ERROR: not a NRRD file: " + path);
+		return false;
+	}
+
+	header = Header();
+	std::vector<unsigned int> sizes;
+	std::vector<float> spacings;
+	std::vector<float> directions;
+	int dimension = 0;
+	long long byteSkip = 0;
+	bool typeValid = false;
+	bool encodingValid = false;
+
+	// "field: value" until an empty line, which is followed by the attached payload
+	while (std::getline(file, line))
+	{
+		if (!line.empty() && line[line.size() - 1] == '\r') { line.erase(line.size() - 1); }
+		if (line.empty()) { break; }
+		if (line[0] == '#') { continue; }
+
+		size_t separator = line.find(": ");
+		if (separator == std::string::npos || line.find(":=") < separator) { continue; } // key/value pairs are not needed
+		std::string key = toLower(trim(line.substr(0, separator)));
+		std::string value = trim(line.substr(separator + 2));
+
+		if (key == "dimension") { dimension = atoi(value.c_str()); }
+		else if (key == "sizes") { sizes = parseList<unsigned int>(value); }
+		else if (key == "spacings") { spacings = parseList<float>(value); }
+		else if (key == "space directions") { directions = parseSpaceDirections(value); }
+		else if (key == "type") { typeValid = parseNrrdType(toLower(value), header.type); }
+		else if (key == "endian") { header.bigEndian = (toLower(value) == "big"); }
+		else if (key == "byte skip") { byteSkip = atoll(value.c_str()); }
+		else if (key == "line skip") { header.lineSkip = (unsigned int) atoi(value.c_str()); }
+		else if (key == "encoding")
+		{
+			value = toLower(value);
+			if (value == "raw") { header.encoding = RAW; encodingValid = true; }
+			else if (value == "gzip" || value == "gz") { header.encoding = GZIP; encodingValid = true; }
+		}
+		else if (key == "data file" || key == "datafile")
+		{
+			if (value.compare(0, 4, "LIST") == 0 || value.find('%') != std::string::npos)
+			{
+				DEBUGLOG->log("ERROR: NRRD data file lists are not supported: " + path);
+				return false;
+			}
+			header.dataPath = isAbsolute(value) ? value : getDirectory(path) + value;
+		}
+	}
+
+	if (dimension != (int) sizes.size() || !setExtents(header, sizes, spacings.empty() ? directions : spacings))
+	{
+		DEBUGLOG->log("ERROR: only scalar 2D and 3D NRRD files are supported: " + path);
+		return false;
+	}
+	if (!typeValid || !encodingValid)
+	{
+		DEBUGLOG->log("ERROR: NRRD file has an unsupported type or encoding: " + path);
+		return false;
+	}
+
+	if (header.dataPath.empty())
+	{
+		header.dataPath = path;
+		header.dataOffset = (long long) file.tellg();
+		if (header.dataOffset < 0 || header.lineSkip > 0)
+		{
+			DEBUGLOG->log("ERROR: NRRD file has no attached data: " + path);
+			return false;
+		}
+	}
+
+	// byte skip counts raw bytes of the file, but decompressed bytes of compressed payloads
+	if (header.encoding == RAW)
+	{
+		header.dataOffset = (byteSkip < 0) ? -1 : header.dataOffset + byteSkip;
+	}
+	else if (byteSkip < 0)
+	{
+		DEBUGLOG->log("ERROR: byte skip -1 requires raw encoding: " + path);
+		return false;
+	}
+	else
+	{
+		header.decodedSkip = (unsigned long long) byteSkip;
+	}
+	return true;
+}
+
+bool VolumeFile::readHeader(const std::string& path, Header& header)
+{
+	if (hasExtension(path, ".mhd") || hasExtension(path, ".mha"))
+	{
+		return readMetaImageHeader(path, header);
+	}
+	if (hasExtension(path, ".nrrd") || hasExtension(path, ".nhdr"))
+	{
+		return readNrrdHeader(path, header);
+	}
+	DEBUGLOG->log("ERROR: unknown volume file extension: " + path);
+	return false;
+}
+
+bool VolumeFile::mapPayload(const Header& header, MappedFile& file, const unsigned char*& payload, unsigned long long& payloadSize)
+{
+	if (!file.open(header.dataPath))
+	{
+		DEBUGLOG->log("ERROR: could not map volume payload: " + header.dataPath);
+		return false;
+	}
+
+	const unsigned char* data = file.getData();
+	unsigned long long size = file.getSize();
+	unsigned long long offset = 0;
+	for (unsigned int i = 0; i < header.lineSkip && offset < size; i++)
+	{
+		const void* newline = memchr(data + offset, '\n', (size_t) (size - offset));
+		offset = (newline == nullptr) ? size : (unsigned long long) ((const unsigned char*) newline - data) + 1;
+	}
+
+	if (header.dataOffset < 0)
+	{
+		offset = (size >= header.getPayloadBytes()) ? size - header.getPayloadBytes() : size + 1;
+	}
+	else
+	{
+		offset += (unsigned long long) header.dataOffset;
+	}
+	if (offset > size || (header.encoding == RAW && size - offset < header.getPayloadBytes()))
+	{
+		DEBUGLOG->log("ERROR: volume payload is smaller than expected: " + header.dataPath);
+		file.close();
+		return false;
+	}
+
+	payload = data + offset;
+	payloadSize = size - offset;
+	if (header.encoding != RAW && header.compressedSize > 0)
+	{
+		payloadSize = std::min(payloadSize, header.compressedSize);
+	}
+	return true;
+}
+
+bool VolumeFile::writeMetaImageHeader(std::ostream& stream, const Header& header)
+{
+	static const char* typeNames[] = { "MET_CHAR", "MET_UCHAR", "MET_SHORT", "MET_USHORT", "MET_FLOAT", "MET_INT", "MET_UINT", "MET_DOUBLE" };
+	if (header.encoding != RAW || (size_t) header.type >= sizeof(typeNames) / sizeof(typeNames[0]))
+	{
+		DEBUGLOG->log("ERROR: only raw MetaImage payloads can be written");
+		return false;
+	}
+
+	std::string dataFile = "LOCAL";
+	if (!header.dataPath.empty())
+	{
+		size_t separator = header.dataPath.find_last_of("/\\");
+		dataFile = (separator == std::string::npos) ? header.dataPath : header.dataPath.substr(separator + 1);
+	}
+
+	stream << "ObjectType = Image\n"
+		<< "NDims = 3\n"
+		<< "BinaryData = True\n"
+		<< "BinaryDataByteOrderMSB = " << (header.bigEndian ? "True" : "False") << "\n"
+		<< "CompressedData = False\n"
+		<< "DimSize = " << header.size_x << " " << header.size_y << " " << header.size_z << "\n"
+		<< "ElementSpacing = " << header.spacing_x << " " << header.spacing_y << " " << header.spacing_z << "\n"
+		<< "ElementType = " << typeNames[header.type] << "\n"
+		<< "ElementDataFile = " << dataFile << "\n";
+	return stream.good();
+}
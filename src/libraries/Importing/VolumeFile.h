@@ -0,0 +1,74 @@
+#ifndef IMPORTING_VOLUMEFILE_H_
+#define IMPORTING_VOLUMEFILE_H_
+
+#include <string>
+#include <ostream>
+
+#include <Core/MappedFile.h>
+
+#include "VoxelConversion.h"
+
+/**
+ * Headers of self-describing volume formats: MetaImage (.mhd with detached or .mha with attached payload)
+ * and NRRD (.nrrd attached, .nhdr detached). Only scalar 2D/3D images with a single payload file are supported.
+ * Loading into VolumeData is done by Importer::loadVolumeFile().
+ */
+namespace VolumeFile
+{
+	enum Encoding {
+		RAW,
+		ZLIB, //!< MetaImage CompressedData
+		GZIP  //!< NRRD encoding gzip
+	};
+
+	struct Header
+	{
+		unsigned int size_x;
+		unsigned int size_y;
+		unsigned int size_z; //!< 1 for 2D images
+
+		float spacing_x; //!< distance between voxel centers, 1 if not given
+		float spacing_y;
+		float spacing_z;
+
+		VoxelConversion::VoxelType type;
+		bool bigEndian;
+		Encoding encoding;
+
+		std::string dataPath;             //!< file holding the payload, the header file itself for attached payloads
+		long long dataOffset;             //!< bytes to skip in dataPath, -1: the (raw) payload is the tail of the file
+		unsigned int lineSkip;            //!< lines to skip in dataPath before dataOffset (NRRD line skip)
+		unsigned long long decodedSkip;   //!< bytes to drop after decompression (NRRD byte skip of compressed payloads)
+		unsigned long long compressedSize; //!< of the payload in dataPath, 0 if unknown
+
+		Header();
+
+		inline unsigned long long getNumVoxels() const { return (unsigned long long) size_x * size_y * size_z; }
+		inline unsigned long long getPayloadBytes() const { return getNumVoxels() * VoxelConversion::getNumBytes(type); }
+	};
+
+	bool readMetaImageHeader(const std::string& path, Header& header);
+	bool readNrrdHeader(const std::string& path, Header& header);
+
+	/** @brief case insensitive, extension including the dot */
+	bool hasExtension(const std::string& path, const std::string& extension);
+
+	/** @brief choose the reader by extension (.mhd, .mha, .nrrd, .nhdr) */
+	bool readHeader(const std::string& path, Header& header);
+
+	/**
+	 * @brief map the file holding the payload and locate it
+	 * @param payload will point to the first (compressed) payload byte in file
+	 * @param payloadSize bytes from payload to the end of the file or of the compressed payload.
+	 *        Raw payloads are checked to be complete
+	 */
+	bool mapPayload(const Header& header, MappedFile& file, const unsigned char*& payload, unsigned long long& payloadSize);
+
+	/**
+	 * @brief write a MetaImage header for raw voxels, ElementDataFile is LOCAL if header.dataPath is empty
+	 *        (the voxels follow the header) and the file name of dataPath otherwise
+	 */
+	bool writeMetaImageHeader(std::ostream& stream, const Header& header);
+}
+
+#endif
@@ -0,0 +1,222 @@
+#include "VoxelConversion.h"
+
+using namespace VoxelConversion;
+
+namespace {
+
+// 16 bit to float, optionally swapping bytes and sign-extending
+void convert16ToFloat(const unsigned char* src, bool swap, bool isSigned, float* dst, size_t count)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*) (src + 2 * i));
+		if (swap) { v = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8)); }
+
+		__m128i lo = _mm256_castsi256_si128(v);
+		__m128i hi = _mm256_extracti128_si256(v, 1);
+		__m256i lo32 = isSigned ? _mm256_cvtepi16_epi32(lo) : _mm256_cvtepu16_epi32(lo);
+		__m256i hi32 = isSigned ? _mm256_cvtepi16_epi32(hi) : _mm256_cvtepu16_epi32(hi);
+		_mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(lo32));
+		_mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(hi32));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + 2 * i));
+		if (swap) { v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)); }
+
+		__m128i lo32, hi32;
+		if (isSigned)
+		{
+			// duplicate each value into the upper half, then shift back arithmetically
+			lo32 = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			hi32 = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		}
+		else
+		{
+			lo32 = _mm_unpacklo_epi16(v, zero);
+			hi32 = _mm_unpackhi_epi16(v, zero);
+		}
+		_mm_storeu_ps(dst + i, _mm_cvtepi32_ps(lo32));
+		_mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(hi32));
+	}
+#endif
+	if (isSigned) { convertScalar<short, float>(src + 2 * i, swap, dst + i, count - i); }
+	else { convertScalar<unsigned short, float>(src + 2 * i, swap, dst + i, count - i); }
+}
+
+// 8 bit to float
+void convert8ToFloat(const unsigned char* src, bool isSigned, float* dst, size_t count)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		__m256i lo32 = isSigned ? _mm256_cvtepi8_epi32(v) : _mm256_cvtepu8_epi32(v);
+		__m256i hi32 = isSigned ? _mm256_cvtepi8_epi32(_mm_srli_si128(v, 8)) : _mm256_cvtepu8_epi32(_mm_srli_si128(v, 8));
+		_mm256_storeu_ps(dst + i, _mm256_cvtepi32_ps(lo32));
+		_mm256_storeu_ps(dst + i + 8, _mm256_cvtepi32_ps(hi32));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	for (; i + 16 <= count; i += 16)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+		__m128i v16[2];
+		if (isSigned)
+		{
+			v16[0] = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+			v16[1] = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+		}
+		else
+		{
+			v16[0] = _mm_unpacklo_epi8(v, zero);
+			v16[1] = _mm_unpackhi_epi8(v, zero);
+		}
+		for (int h = 0; h < 2; h++)
+		{
+			__m128i lo32 = _mm_srai_epi32(_mm_unpacklo_epi16(v16[h], v16[h]), 16);
+			__m128i hi32 = _mm_srai_epi32(_mm_unpackhi_epi16(v16[h], v16[h]), 16);
+			_mm_storeu_ps(dst + i + 8 * h, _mm_cvtepi32_ps(lo32));
+			_mm_storeu_ps(dst + i + 8 * h + 4, _mm_cvtepi32_ps(hi32));
+		}
+	}
+#endif
+	if (isSigned) { convertScalar<signed char, float>(src + i, false, dst + i, count - i); }
+	else { convertScalar<unsigned char, float>(src + i, false, dst + i, count - i); }
+}
+
+// float to float with 32 bit byte swap
+void swapFloat(const unsigned char* src, float* dst, size_t count)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	const __m256i shuffle = _mm256_setr_epi8(3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12, 3,2,1,0, 7,6,5,4, 11,10,9,8, 15,14,13,12);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*) (src + 4 * i));
+		_mm256_storeu_si256((__m256i*) (dst + i), _mm256_shuffle_epi8(v, shuffle));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + 4 * i));
+		v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)); // swap bytes within 16 bit halves
+		v = _mm_or_si128(_mm_slli_epi32(v, 16), _mm_srli_epi32(v, 16)); // swap halves
+		_mm_storeu_si128((__m128i*) (dst + i), v);
+	}
+#endif
+	convertScalar<float, float>(src + 4 * i, true, dst + i, count - i);
+}
+
+// 16 bit to 16 bit of the same signedness, optionally swapping bytes
+void swap16(const unsigned char* src, bool swap, unsigned char* dst, size_t count)
+{
+	if (!swap)
+	{
+		std::memcpy(dst, src, 2 * count);
+		return;
+	}
+
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	for (; i + 16 <= count; i += 16)
+	{
+		__m256i v = _mm256_loadu_si256((const __m256i*) (src + 2 * i));
+		_mm256_storeu_si256((__m256i*) (dst + 2 * i), _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8)));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i*) (src + 2 * i));
+		_mm_storeu_si128((__m128i*) (dst + 2 * i), _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		dst[2 * i] = src[2 * i + 1];
+		dst[2 * i + 1] = src[2 * i];
+	}
+}
+
+} // namespace
+
+void VoxelConversion::convert(const void* src, VoxelType srcType, bool bigEndian, float* dst, size_t count, float& min, float& max)
+{
+	const unsigned char* bytes = (const unsigned char*) src;
+	bool swap = (getNumBytes(srcType) > 1) && (bigEndian == isLittleEndianMachine());
+	for (size_t i = 0; i < count; i += BLOCK_SIZE)
+	{
+		size_t blockSize = std::min(BLOCK_SIZE, count - i);
+		const unsigned char* blockSrc = bytes + i * getNumBytes(srcType);
+		switch (srcType)
+		{
+			case INT8:    convert8ToFloat(blockSrc, true, dst + i, blockSize); break;
+			case UINT8:   convert8ToFloat(blockSrc, false, dst + i, blockSize); break;
+			case INT16:   convert16ToFloat(blockSrc, swap, true, dst + i, blockSize); break;
+			case UINT16:  convert16ToFloat(blockSrc, swap, false, dst + i, blockSize); break;
+			case FLOAT32:
+				if (swap) { swapFloat(blockSrc, dst + i, blockSize); }
+				else { std::memcpy(dst + i, blockSrc, 4 * blockSize); }
+				break;
+			default:      convertScalar<float>(blockSrc, srcType, swap, dst + i, blockSize); break;
+		}
+		SimdTools::updateMinMax(dst + i, blockSize, min, max);
+	}
+}
+
+void VoxelConversion::convert(const void* src, VoxelType srcType, bool bigEndian, short* dst, size_t count, short& min, short& max)
+{
+	const unsigned char* bytes = (const unsigned char*) src;
+	bool swap = (getNumBytes(srcType) > 1) && (bigEndian == isLittleEndianMachine());
+	for (size_t i = 0; i < count; i += BLOCK_SIZE)
+	{
+		size_t blockSize = std::min(BLOCK_SIZE, count - i);
+		const unsigned char* blockSrc = bytes + i * getNumBytes(srcType);
+		if (srcType == INT16) { swap16(blockSrc, swap, (unsigned char*) (dst + i), blockSize); }
+		else { convertScalar<short>(blockSrc, srcType, swap, dst + i, blockSize); }
+		SimdTools::updateMinMax(dst + i, blockSize, min, max);
+	}
+}
+
+void VoxelConversion::convert(const void* src, VoxelType srcType, bool bigEndian, unsigned short* dst, size_t count, unsigned short& min, unsigned short& max)
+{
+	const unsigned char* bytes = (const unsigned char*) src;
+	bool swap = (getNumBytes(srcType) > 1) && (bigEndian == isLittleEndianMachine());
+	for (size_t i = 0; i < count; i += BLOCK_SIZE)
+	{
+		size_t blockSize = std::min(BLOCK_SIZE, count - i);
+		const unsigned char* blockSrc = bytes + i * getNumBytes(srcType);
+		if (srcType == UINT16) { swap16(blockSrc, swap, (unsigned char*) (dst + i), blockSize); }
+		else { convertScalar<unsigned short>(blockSrc, srcType, swap, dst + i, blockSize); }
+		SimdTools::updateMinMax(dst + i, blockSize, min, max);
+	}
+}
+
+void VoxelConversion::rescale(float* data, size_t count, float slope, float intercept)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	const __m256 vSlope = _mm256_set1_ps(slope);
+	const __m256 vIntercept = _mm256_set1_ps(intercept);
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_ps(data + i, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(data + i), vSlope), vIntercept));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	const __m128 vSlope = _mm_set1_ps(slope);
+	const __m128 vIntercept = _mm_set1_ps(intercept);
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(data + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(data + i), vSlope), vIntercept));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		data[i] = data[i] * slope + intercept;
+	}
+}
@@ -0,0 +1,147 @@
+#ifndef IMPORTING_VOXELCONVERSION_H_
+#define IMPORTING_VOXELCONVERSION_H_
+
+#include <cstddef>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <Core/SimdTools.h>
+
+/**
+ * Conversion of raw voxel bytes as found in volume files to the element type of a VolumeData.
+ * Byte swapping, widening and (saturating) narrowing happen in one pass, min/max are found on the way.
+ * Hot paths (16 bit and 8 bit to float, 16 bit byte swapping) use SSE2/AVX2, everything else falls back to scalar code.
+ */
+namespace VoxelConversion
+{
+	enum VoxelType {
+		INT8,
+		UINT8,
+		INT16,
+		UINT16,
+		FLOAT32,
+		INT32,
+		UINT32,
+		FLOAT64
+	};
+
+	inline size_t getNumBytes(VoxelType type)
+	{
+		switch (type)
+		{
+			case INT8: case UINT8: return 1;
+			case INT16: case UINT16: return 2;
+			case FLOAT32: case INT32: case UINT32: return 4;
+			case FLOAT64: return 8;
+			default: return 0;
+		}
+	}
+
+	/** @brief element type of T, i.e. to describe exported voxels */
+	template<class T> inline VoxelType getVoxelType();
+	template<> inline VoxelType getVoxelType<signed char>()    { return INT8; }
+	template<> inline VoxelType getVoxelType<unsigned char>()  { return UINT8; }
+	template<> inline VoxelType getVoxelType<short>()          { return INT16; }
+	template<> inline VoxelType getVoxelType<unsigned short>() { return UINT16; }
+	template<> inline VoxelType getVoxelType<float>()          { return FLOAT32; }
+	template<> inline VoxelType getVoxelType<int>()            { return INT32; }
+	template<> inline VoxelType getVoxelType<unsigned int>()   { return UINT32; }
+	template<> inline VoxelType getVoxelType<double>()         { return FLOAT64; }
+
+	/**
+	 * @brief convert count voxels and extend [min, max] by the converted values
+	 * @param src raw voxel bytes, no alignment required
+	 * @param srcType element type of src
+	 * @param bigEndian true if multi-byte elements of src are stored most significant byte first
+	 * @param dst target, may not overlap src
+	 * @param count number of voxels
+	 * @param min will be lowered to the smallest converted value (initialize it, i.e. with std::numeric_limits<T>::max())
+	 * @param max will be raised to the largest converted value
+	 */
+	template<class T>
+	void convert(const void* src, VoxelType srcType, bool bigEndian, T* dst, size_t count, T& min, T& max);
+
+	void convert(const void* src, VoxelType srcType, bool bigEndian, float* dst, size_t count, float& min, float& max);
+	void convert(const void* src, VoxelType srcType, bool bigEndian, short* dst, size_t count, short& min, short& max);
+	void convert(const void* src, VoxelType srcType, bool bigEndian, unsigned short* dst, size_t count, unsigned short& min, unsigned short& max);
+
+	/** @brief data = data * slope + intercept in place, i.e. DICOM rescale to Hounsfield units */
+	void rescale(float* data, size_t count, float slope, float intercept);
+
+	/** @brief true if the machine stores multi-byte values least significant byte first */
+	inline bool isLittleEndianMachine()
+	{
+		const unsigned short probe = 1;
+		return *((const unsigned char*) &probe) == 1;
+	}
+
+	/** @brief clamp and (for float to integer) round a value into the range of T */
+	template<class T, class S>
+	inline T saturate(S value)
+	{
+		if (!std::numeric_limits<T>::is_integer) { return (T) value; }
+		double v = (double) value;
+		if (!std::numeric_limits<S>::is_integer) { v = std::floor(v + 0.5); }
+		v = std::max<double>(v, (double) std::numeric_limits<T>::lowest());
+		v = std::min<double>(v, (double) std::numeric_limits<T>::max());
+		return (T) v;
+	}
+
+	/** @brief read one element of type S from unaligned memory, optionally swapping its bytes */
+	template<class S>
+	inline S load(const unsigned char* src, bool swap)
+	{
+		unsigned char bytes[sizeof(S)];
+		if (swap) { for (size_t b = 0; b < sizeof(S); b++) { bytes[b] = src[sizeof(S) - 1 - b]; } }
+		else { std::memcpy(bytes, src, sizeof(S)); }
+		S value;
+		std::memcpy(&value, bytes, sizeof(S));
+		return value;
+	}
+
+	/** @brief scalar reference path for any source / target type combination */
+	template<class S, class T>
+	inline void convertScalar(const unsigned char* src, bool swap, T* dst, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			dst[i] = saturate<T>(load<S>(src + i * sizeof(S), swap));
+		}
+	}
+
+	template<class T>
+	inline void convertScalar(const unsigned char* src, VoxelType srcType, bool swap, T* dst, size_t count)
+	{
+		switch (srcType)
+		{
+			case INT8:    convertScalar<signed char, T>(src, swap, dst, count); break;
+			case UINT8:   convertScalar<unsigned char, T>(src, swap, dst, count); break;
+			case INT16:   convertScalar<short, T>(src, swap, dst, count); break;
+			case UINT16:  convertScalar<unsigned short, T>(src, swap, dst, count); break;
+			case FLOAT32: convertScalar<float, T>(src, swap, dst, count); break;
+			case INT32:   convertScalar<int, T>(src, swap, dst, count); break;
+			case UINT32:  convertScalar<unsigned int, T>(src, swap, dst, count); break;
+			case FLOAT64: convertScalar<double, T>(src, swap, dst, count); break;
+		}
+	}
+
+	static const size_t BLOCK_SIZE = 4096; //!< voxels converted before min/max are updated, keeps the block in L1
+}
+
+////// IMPLEMENTATION
+template<class T>
+void VoxelConversion::convert(const void* src, VoxelType srcType, bool bigEndian, T* dst, size_t count, T& min, T& max)
+{
+	const unsigned char* bytes = (const unsigned char*) src;
+	bool swap = (getNumBytes(srcType) > 1) && (bigEndian == isLittleEndianMachine());
+	for (size_t i = 0; i < count; i += BLOCK_SIZE)
+	{
+		size_t blockSize = std::min(BLOCK_SIZE, count - i);
+		convertScalar<T>(bytes + i * getNumBytes(srcType), srcType, swap, dst + i, blockSize);
+		SimdTools::updateMinMax(dst + i, blockSize, min, max);
+	}
+}
+
+#endif
@@ -93,6 +93,20 @@ inline void DDS_swapuint(unsigned int *x)
       ((tmp&0xff000000)>>24);
    }
 
+inline void DDS_swapuint64(unsigned long long *x)
+   {
+   unsigned long long tmp=*x;
+
+   *x=((tmp&0xffULL)<<56)|
+      ((tmp&0xff00ULL)<<40)|
+      ((tmp&0xff0000ULL)<<24)|
+      ((tmp&0xff000000ULL)<<8)|
+      ((tmp&0xff00000000ULL)>>8)|
+      ((tmp&0xff0000000000ULL)>>24)|
+      ((tmp&0xff000000000000ULL)>>40)|
+      ((tmp&0xff00000000000000ULL)>>56);
+   }
+
 void DDS_initbuffer()
    {
    DDS_buffer=0;
@@ -106,58 +120,78 @@ inline void DDS_clearbits()
    DDS_cachesize=0;
    }
 
-inline void DDS_writebits(unsigned int value,unsigned int bits)
+// bit writer state of one encoder, so that several streams can be encoded concurrently
+struct DDS_bitwriter
+   {
+   unsigned char *cache;
+   unsigned int cachepos,cachesize;
+
+   unsigned int buffer;
+   unsigned int bufsize;
+   };
+
+inline void DDS_initwriter(DDS_bitwriter *writer)
+   {
+   writer->cache=NULL;
+   writer->cachepos=0;
+   writer->cachesize=0;
+
+   writer->buffer=0;
+   writer->bufsize=0;
+   }
+
+inline void DDS_writebits(DDS_bitwriter *writer,unsigned int value,unsigned int bits)
    {
    value&=DDS_shiftl(1,bits)-1;
 
-   if (DDS_bufsize+bits<32)
+   if (writer->bufsize+bits<32)
       {
-      DDS_buffer=DDS_shiftl(DDS_buffer,bits)|value;
-      DDS_bufsize+=bits;
+      writer->buffer=DDS_shiftl(writer->buffer,bits)|value;
+      writer->bufsize+=bits;
       }
    else
       {
-      DDS_buffer=DDS_shiftl(DDS_buffer,32-DDS_bufsize);
-      DDS_bufsize-=32-bits;
-      DDS_buffer|=DDS_shiftr(value,DDS_bufsize);
+      writer->buffer=DDS_shiftl(writer->buffer,32-writer->bufsize);
+      writer->bufsize-=32-bits;
+      writer->buffer|=DDS_shiftr(value,writer->bufsize);
 
-      if (DDS_cachepos+4>DDS_cachesize)
-         if (DDS_cache==NULL)
+      if (writer->cachepos+4>writer->cachesize)
+         if (writer->cache==NULL)
             {
-            if ((DDS_cache=(unsigned char *)malloc(DDS_BLOCKSIZE))==NULL) MEMERROR();
-            DDS_cachesize=DDS_BLOCKSIZE;
+            if ((writer->cache=(unsigned char *)malloc(DDS_BLOCKSIZE))==NULL) MEMERROR();
+            writer->cachesize=DDS_BLOCKSIZE;
             }
          else
             {
-            if ((DDS_cache=(unsigned char *)realloc(DDS_cache,DDS_cachesize+DDS_BLOCKSIZE))==NULL) MEMERROR();
-            DDS_cachesize+=DDS_BLOCKSIZE;
+            if ((writer->cache=(unsigned char *)realloc(writer->cache,writer->cachesize+DDS_BLOCKSIZE))==NULL) MEMERROR();
+            writer->cachesize+=DDS_BLOCKSIZE;
             }
 
-      if (DDS_ISINTEL) DDS_swapuint(&DDS_buffer);
-      *((unsigned int *)&DDS_cache[DDS_cachepos])=DDS_buffer;
-      DDS_cachepos+=4;
+      if (DDS_ISINTEL) DDS_swapuint(&writer->buffer);
+      *((unsigned int *)&writer->cache[writer->cachepos])=writer->buffer;
+      writer->cachepos+=4;
 
-      DDS_buffer=value&(DDS_shiftl(1,DDS_bufsize)-1);
+      writer->buffer=value&(DDS_shiftl(1,writer->bufsize)-1);
       }
    }
 
-inline void DDS_flushbits()
+inline void DDS_flushbits(DDS_bitwriter *writer)
    {
    unsigned int bufsize;
 
-   bufsize=DDS_bufsize;
+   bufsize=writer->bufsize;
 
    if (bufsize>0)
       {
-      DDS_writebits(0,32-bufsize);
-      DDS_cachepos-=(32-bufsize)/8;
+      DDS_writebits(writer,0,32-bufsize);
+      writer->cachepos-=(32-bufsize)/8;
       }
    }
 
-inline void DDS_savebits(unsigned char **data,unsigned int *size)
+inline void DDS_savebits(DDS_bitwriter *writer,unsigned char **data,unsigned int *size)
    {
-   *data=DDS_cache;
-   *size=DDS_cachepos;
+   *data=writer->cache;
+   *size=writer->cachepos;
    }
 
 inline void DDS_loadbits(unsigned char *data,unsigned int size)
@@ -291,6 +325,8 @@ void DDS_encode(unsigned char *data,unsigned int bytes,unsigned int skip,unsigne
    unsigned int cnt,cnt1,cnt2;
    int bits,bits1,bits2;
 
+   DDS_bitwriter writer;
+
    if (bytes<1) ERRORMSG();
 
    if (skip<1 || skip>4) skip=1;
@@ -308,12 +344,10 @@ void DDS_encode(unsigned char *data,unsigned int bytes,unsigned int skip,unsigne
       lookup[i+128]=bits;
       }
 
-   DDS_initbuffer();
+   DDS_initwriter(&writer);
 
-   DDS_clearbits();
-
-   DDS_writebits(skip-1,2);
-   DDS_writebits(strip-1,16);
+   DDS_writebits(&writer,skip-1,2);
+   DDS_writebits(&writer,strip-1,16);
 
    ptr1=ptr2=data;
    pre1=pre2=0;
@@ -356,8 +390,8 @@ void DDS_encode(unsigned char *data,unsigned int bytes,unsigned int skip,unsigne
          }
       else
          {
-         DDS_writebits(cnt2,DDS_RL);
-         DDS_writebits(DDS_code(bits2),3);
+         DDS_writebits(&writer,cnt2,DDS_RL);
+         DDS_writebits(&writer,DDS_code(bits2),3);
 
          while (cnt2-->0)
             {
@@ -370,7 +404,7 @@ void DDS_encode(unsigned char *data,unsigned int bytes,unsigned int skip,unsigne
             while (act2<-128) act2+=256;
             while (act2>127) act2-=256;
 
-            DDS_writebits(act2+(1<<bits2)/2,bits2);
+            DDS_writebits(&writer,act2+(1<<bits2)/2,bits2);
             }
 
          cnt2=cnt1;
@@ -388,8 +422,8 @@ void DDS_encode(unsigned char *data,unsigned int bytes,unsigned int skip,unsigne
       }
    else
       {
-      DDS_writebits(cnt2,DDS_RL);
-      DDS_writebits(DDS_code(bits2),3);
+      DDS_writebits(&writer,cnt2,DDS_RL);
+      DDS_writebits(&writer,DDS_code(bits2),3);
 
       while (cnt2-->0)
          {
@@ -402,7 +436,7 @@ void DDS_encode(unsigned char *data,unsigned int bytes,unsigned int skip,unsigne
          while (act2<-128) act2+=256;
          while (act2>127) act2-=256;
 
-         DDS_writebits(act2+(1<<bits2)/2,bits2);
+         DDS_writebits(&writer,act2+(1<<bits2)/2,bits2);
          }
 
       cnt2=cnt1;
@@ -411,8 +445,8 @@ void DDS_encode(unsigned char *data,unsigned int bytes,unsigned int skip,unsigne
 
    if (cnt2!=0)
       {
-      DDS_writebits(cnt2,DDS_RL);
-      DDS_writebits(DDS_code(bits2),3);
+      DDS_writebits(&writer,cnt2,DDS_RL);
+      DDS_writebits(&writer,DDS_code(bits2),3);
 
       while (cnt2-->0)
          {
@@ -425,12 +459,12 @@ void DDS_encode(unsigned char *data,unsigned int bytes,unsigned int skip,unsigne
          while (act2<-128) act2+=256;
          while (act2>127) act2-=256;
 
-         DDS_writebits(act2+(1<<bits2)/2,bits2);
+         DDS_writebits(&writer,act2+(1<<bits2)/2,bits2);
          }
       }
 
-   DDS_flushbits();
-   DDS_savebits(chunk,size);
+   DDS_flushbits(&writer);
+   DDS_savebits(&writer,chunk,size);
 
    DDS_interleave(data,bytes,skip,block);
    }
@@ -496,6 +530,282 @@ void DDS_decode(unsigned char *chunk,unsigned int size,
    *bytes=cnt;
    }
 
+// fast decoder for Differential Data Streams:
+// state-free, reads 64 bits at a time, looks up the code lengths in tables
+// and restores the interleaved byte planes in a single sequential pass
+
+BOOLINT DDS_fastdecoder=TRUE;
+
+// select the decoder used by readDDSfile and readPVMvolume
+void setDDSdecoder(BOOLINT fast)
+   {DDS_fastdecoder=fast;}
+
+static const int DDS_bitstable[8]={0,2,3,4,5,6,7,8}; // DDS_decode(code) for each 3 bit code
+static const int DDS_halftable[9]={0,1,2,4,8,16,32,64,128}; // (1<<bits)/2 for each bit count
+
+// 64 bit msb-first bit buffer, bits beyond avail are already loaded stream bits or zero
+// the state is passed by reference so that it stays in registers within the decoding loop
+inline void DDS_fillbuffer(const unsigned char *data,unsigned int size,unsigned int &pos,
+                           unsigned long long &buffer,unsigned int &avail)
+   {
+   unsigned long long word;
+   unsigned int n;
+
+   if (avail>56) return;
+
+   if (pos+8<=size)
+      {
+      memcpy(&word,&data[pos],8);
+      if (DDS_ISINTEL) DDS_swapuint64(&word);
+
+      buffer|=word>>avail;
+      n=(63-avail)>>3;
+      pos+=n;
+      avail+=8*n;
+      }
+   else // the stream is padded with zeros
+      while (avail<=56)
+         {
+         if (pos<size) buffer|=(unsigned long long)data[pos]<<(56-avail);
+         pos++;
+         avail+=8;
+         }
+   }
+
+// read up to 32 bits, at least 56 bits are available after DDS_fillbuffer
+inline unsigned int DDS_getbits(unsigned long long &buffer,unsigned int &avail,unsigned int bits)
+   {
+   unsigned int value;
+
+   value=(unsigned int)((buffer>>1)>>(63-bits)); // no branch for bits==0
+   buffer<<=bits;
+   avail-=bits;
+
+   return(value);
+   }
+
+// restore the interleaved byte planes of one block
+inline void DDS_interleaveblock(const unsigned char *planes,unsigned char *data,unsigned int bytes,unsigned int skip)
+   {
+   const unsigned char *plane[4];
+   unsigned int i,j,n,r;
+
+   n=bytes/skip;
+   r=bytes%skip;
+
+   // planes with index below r carry one extra byte
+   for (plane[0]=planes,i=1; i<skip; i++) plane[i]=plane[i-1]+n+((i-1<r)?1:0);
+
+   switch (skip)
+      {
+      case 2:
+         for (j=0; j<n; j++,data+=2)
+            {
+            data[0]=plane[0][j];
+            data[1]=plane[1][j];
+            }
+         break;
+      case 3:
+         for (j=0; j<n; j++,data+=3)
+            {
+            data[0]=plane[0][j];
+            data[1]=plane[1][j];
+            data[2]=plane[2][j];
+            }
+         break;
+      case 4:
+         for (j=0; j<n; j++,data+=4)
+            {
+            data[0]=plane[0][j];
+            data[1]=plane[1][j];
+            data[2]=plane[2][j];
+            data[3]=plane[3][j];
+            }
+         break;
+      }
+
+   for (i=0; i<r; i++) data[i]=plane[i][n];
+   }
+
+// interleave a byte stream into a new buffer, same result as DDS_interleave
+// each block is read plane by plane and written sequentially, the input is freed
+unsigned char *DDS_interleavefast(unsigned char *data,unsigned int bytes,unsigned int skip,unsigned int block=0)
+   {
+   unsigned int k,blocksize;
+
+   unsigned char *data2;
+
+   if (skip<=1 || bytes==0) return(data);
+
+   blocksize=(block==0)?bytes:skip*block;
+   if (blocksize>bytes) blocksize=bytes;
+
+   if ((data2=(unsigned char *)malloc(bytes))==NULL) MEMERROR();
+
+   for (k=0; k<bytes; k+=blocksize)
+      {
+      if (blocksize>bytes-k) blocksize=bytes-k;
+      DDS_interleaveblock(data+k,data2+k,blocksize,skip);
+      }
+
+   free(data);
+
+   return(data2);
+   }
+
+// decode a Differential Data Stream without restoring the interleaved byte planes
+unsigned char *DDS_decodeplanes(const unsigned char *chunk,unsigned int size,
+                                unsigned int *skipout,unsigned int *bytes)
+   {
+   unsigned int pos,avail;
+   unsigned long long buffer;
+
+   unsigned int skip,strip;
+
+   unsigned char *ptr,*end,*start;
+   unsigned char *out;
+   unsigned int cnt,capacity;
+
+   unsigned int cnt1;
+   int bits,half,act;
+
+   pos=avail=0;
+   buffer=0;
+
+   DDS_fillbuffer(chunk,size,pos,buffer,avail);
+   skip=DDS_getbits(buffer,avail,2)+1;
+   strip=DDS_getbits(buffer,avail,16)+1;
+
+   out=NULL;
+   cnt=capacity=0;
+   act=0;
+
+   for (;;)
+      {
+      DDS_fillbuffer(chunk,size,pos,buffer,avail);
+
+      if ((cnt1=DDS_getbits(buffer,avail,DDS_RL))==0) break;
+
+      bits=DDS_bitstable[DDS_getbits(buffer,avail,3)];
+      half=DDS_halftable[bits];
+
+      // grow geometrically instead of one block at a time
+      if (cnt+cnt1>capacity)
+         {
+         if (capacity==0) capacity=DDS_BLOCKSIZE;
+         else if (capacity<(1u<<31)) capacity*=2;
+         else capacity+=DDS_BLOCKSIZE;
+         if ((out=(unsigned char *)realloc(out,capacity))==NULL) MEMERROR();
+         }
+
+      ptr=out+cnt;
+      end=ptr+cnt1;
+
+      // the first strip+1 bytes are differences relative to the previous byte only
+      start=(strip==1)?end:std::min(end,out+strip+1);
+      if (ptr<start)
+         {
+         if (bits==0) // constant run
+            {
+            memset(ptr,act,start-ptr);
+            ptr=start;
+            }
+         else
+            while (ptr<start)
+               {
+               if (avail<(unsigned int)bits) DDS_fillbuffer(chunk,size,pos,buffer,avail);
+               act=(act+(int)DDS_getbits(buffer,avail,bits)-half)&255;
+               *ptr++=act;
+               }
+         }
+
+      // remaining bytes are predicted from the previous row
+      while (ptr<end)
+         {
+         if (avail<(unsigned int)bits) DDS_fillbuffer(chunk,size,pos,buffer,avail);
+         act=(act+*(ptr-strip)-*(ptr-strip-1)+(int)DDS_getbits(buffer,avail,bits)-half)&255;
+         *ptr++=act;
+         }
+
+      cnt+=cnt1;
+      }
+
+   if (out!=NULL)
+      if ((out=(unsigned char *)realloc(out,cnt))==NULL) MEMERROR();
+
+   *skipout=skip;
+   *bytes=cnt;
+
+   return(out);
+   }
+
+// decode a Differential Data Stream, output is identical to DDS_decode
+void DDS_decodefast(unsigned char *chunk,unsigned int size,
+                    unsigned char **data,unsigned int *bytes,
+                    unsigned int block=0)
+   {
+   unsigned int skip;
+
+   *data=DDS_decodeplanes(chunk,size,&skip,bytes);
+   *data=DDS_interleavefast(*data,*bytes,skip,block);
+   }
+
+// encode a Differential Data Stream held in memory, reentrant
+void encodeDDSstream(const unsigned char *data,unsigned int bytes,unsigned int skip,unsigned int strip,
+                     unsigned char **chunk,unsigned int *size)
+   {
+   unsigned char *data2;
+
+   *chunk=NULL;
+   *size=0;
+
+   if (bytes<1) return;
+
+   // DDS_encode deinterleaves in place, so work on a copy
+   if ((data2=(unsigned char *)malloc(bytes))==NULL) MEMERROR();
+   memcpy(data2,data,bytes);
+
+   DDS_encode(data2,bytes,skip,strip,chunk,size,(bytes>DDS_INTERLEAVE)?DDS_INTERLEAVE:0);
+
+   free(data2);
+   }
+
+// decode a Differential Data Stream held in memory into a buffer of known size, reentrant
+// returns the number of decoded bytes or 0 if the stream does not decode to exactly that size
+unsigned int decodeDDSstream(const unsigned char *chunk,unsigned int size,
+                             unsigned char *data,unsigned int bytes)
+   {
+   unsigned char *planes;
+   unsigned int skip,cnt,block,k,blocksize;
+
+   if ((planes=DDS_decodeplanes(chunk,size,&skip,&cnt))==NULL) return(0);
+
+   if (cnt!=bytes)
+      {
+      free(planes);
+      return(0);
+      }
+
+   block=(cnt>DDS_INTERLEAVE)?DDS_INTERLEAVE:0;
+
+   if (skip<=1) memcpy(data,planes,cnt);
+   else
+      {
+      blocksize=(block==0)?cnt:skip*block;
+      if (blocksize>cnt) blocksize=cnt;
+
+      for (k=0; k<cnt; k+=blocksize)
+         {
+         if (blocksize>cnt-k) blocksize=cnt-k;
+         DDS_interleaveblock(planes+k,data+k,blocksize,skip);
+         }
+      }
+
+   free(planes);
+
+   return(cnt);
+   }
+
 // write a RAW file
 void writeRAWfile(const char *filename,unsigned char *data,unsigned int bytes,BOOLINT nofree)
    {
@@ -631,7 +941,8 @@ unsigned char *readDDSfile(const char *filename,unsigned int *bytes)
 
    fclose(file);
 
-   DDS_decode(chunk,size,&data,bytes,version==1?0:DDS_INTERLEAVE);
+   if (DDS_fastdecoder) DDS_decodefast(chunk,size,&data,bytes,version==1?0:DDS_INTERLEAVE);
+   else DDS_decode(chunk,size,&data,bytes,version==1?0:DDS_INTERLEAVE);
 
    free(chunk);
 
@@ -764,13 +1075,14 @@ void writePVMvolume(const char *filename,unsigned char *volume,
 
    if (width<1 || height<1 || depth<1 || components<1) ERRORMSG();
 
+   // sprintf instead of snprintf, the header is far below DDS_MAXSTR
    if (description==NULL && courtesy==NULL && parameter==NULL && comment==NULL)
-	   if (scalex==1.0f && scaley==1.0f && scalez==1.0f) scalex = scalex; // NOP
-         //snprintf(str,DDS_MAXSTR,"PVM\n%d %d %d\n%d\n",width,height,depth,components);
-      //else
-         //snprintf(str,DDS_MAXSTR,"PVM2\n%d %d %d\n%g %g %g\n%d\n",width,height,depth,scalex,scaley,scalez,components);
-   //else
-      //snprintf(str,DDS_MAXSTR,"PVM3\n%d %d %d\n%g %g %g\n%d\n",width,height,depth,scalex,scaley,scalez,components);
+      if (scalex==1.0f && scaley==1.0f && scalez==1.0f)
+         sprintf(str,"PVM\n%d %d %d\n%d\n",width,height,depth,components);
+      else
+         sprintf(str,"PVM2\n%d %d %d\n%g %g %g\n%d\n",width,height,depth,scalex,scaley,scalez,components);
+   else
+      sprintf(str,"PVM3\n%d %d %d\n%g %g %g\n%d\n",width,height,depth,scalex,scaley,scalez,components);
 
    if (description==NULL && courtesy==NULL && parameter==NULL && comment==NULL)
       {
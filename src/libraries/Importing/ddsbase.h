@@ -19,9 +19,15 @@
 #define FALSE (0)
 #endif
 
+void setDDSdecoder(BOOLINT fast=TRUE); // TRUE: table-driven 64 bit decoder (default), FALSE: original bitwise decoder
+
 void writeDDSfile(const char *filename,unsigned char *data,unsigned int bytes,unsigned int skip=0,unsigned int strip=0,BOOLINT nofree=FALSE);
 unsigned char *readDDSfile(const char *filename,unsigned int *bytes);
 
+// reentrant in-memory codec for a single stream without file header, i.e. for independently encoded chunks
+void encodeDDSstream(const unsigned char *data,unsigned int bytes,unsigned int skip,unsigned int strip,unsigned char **chunk,unsigned int *size);
+unsigned int decodeDDSstream(const unsigned char *chunk,unsigned int size,unsigned char *data,unsigned int bytes);
+
 void writeRAWfile(const char *filename,unsigned char *data,unsigned int bytes,BOOLINT nofree=FALSE);
 unsigned char *readRAWfile(const char *filename,unsigned int *bytes);
 
@@ -0,0 +1,217 @@
+#ifndef MISC_ASYNCVOLUMELOADER_H
+#define MISC_ASYNCVOLUMELOADER_H
+
+#ifdef MINGW_THREADS
+	#include <mingw-std-threads/mingw.thread.h>
+	#include <mingw-std-threads/mingw.mutex.h>
+	#include <mingw-std-threads/mingw.condition_variable.h>
+#else
+	#include <thread>
+	#include <mutex>
+	#include <condition_variable>
+#endif
+
+#include <atomic>
+#include <memory>
+#include <functional>
+
+#include <Importing/ImportProgress.h>
+#include <Misc/VolumePresets.h>
+#include <Volume/VolumeHistogram.h>
+
+/** @brief result of a background load, the voxels are either mapped from a volume cache or held in volumeData */
+template<class T>
+struct LoadedVolume
+{
+	VolumePresets::Preset preset;
+	VolumeData<T> volumeData; //!< voxels if no cache could be mapped
+	VolumeCache::CachedVolume<T> cached;
+	VolumeHistogram histogram; //!< value histogram, taken from the cache or counted by the loader
+
+	/** @brief mip levels to upload, level 0 only if not cached. Valid while this LoadedVolume is alive */
+	std::vector< VolumeDataView<T> > getLevels() const
+	{
+		if (cached.isValid()) { return cached.levels; }
+		return std::vector< VolumeDataView<T> >(1, VolumeDataView<T>(volumeData));
+	}
+
+	/** @brief sizes and range, without voxels */
+	VolumeData<T> getInfo() const
+	{
+		if (cached.isValid()) { return cached.getInfo(); }
+		VolumeData<T> info;
+		info.size_x = volumeData.size_x; info.size_y = volumeData.size_y; info.size_z = volumeData.size_z;
+		info.real_size_x = volumeData.real_size_x; info.real_size_y = volumeData.real_size_y; info.real_size_z = volumeData.real_size_z;
+		info.min = volumeData.min; info.max = volumeData.max;
+		return info;
+	}
+
+	inline bool isEmpty() const { return !cached.isValid() && volumeData.data.empty(); }
+};
+
+/**
+ * @brief loads volume presets on a background thread, so the render thread keeps rendering the current volume meanwhile.
+ *        Other work that produces a volume (i.e. cropping) can be queued as a task instead of a preset.
+ *        A single worker thread runs the requests one after another. A new request cancels the running one and replaces a
+ *        queued one that has not started yet, only the latest finished request is handed out by poll().
+ */
+template<class T>
+class AsyncVolumeLoader
+{
+protected:
+	struct Job
+	{
+		VolumePresets::Preset preset;
+		std::string directory;
+		std::function<void(LoadedVolume<T>&)> task; //!< runs instead of loading the preset, if set
+		ImportProgress progress;
+		std::atomic<bool> done;
+		LoadedVolume<T> result;
+	};
+
+	std::thread m_thread; //!< started with the first request
+	std::mutex m_mutex;
+	std::condition_variable m_jobQueued; //!< notified when m_pending is set or the loader is destroyed
+	std::condition_variable m_jobDone;
+	std::shared_ptr<Job> m_pending; //!< requested, not yet started by the worker
+	bool m_quit;
+
+	std::shared_ptr<Job> m_latest; //!< latest request, render thread only
+
+	void run()
+	{
+		for (;;)
+		{
+			std::shared_ptr<Job> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_jobQueued.wait(lock, [this]() { return m_quit || m_pending; });
+				if (m_quit) { return; }
+				job = std::move(m_pending);
+			}
+
+			if (!job->progress.isCancelled())
+			{
+				ImportProgress::setCurrent(&job->progress);
+				job->result.preset = job->preset;
+				if (job->task)
+				{
+					job->task(job->result);
+				}
+				else
+				{
+					job->result.cached = VolumePresets::loadPresetCached(job->result.volumeData, job->preset, job->directory);
+
+					const VolumeCache::CachedVolume<T>& cached = job->result.cached;
+					if (cached.isValid() && cached.histogram != nullptr)
+					{
+						job->result.histogram.setCounts(cached.histogram, cached.numHistogramBins, (double) cached.levels[0].min, (double) cached.levels[0].max);
+					}
+					else if (!job->progress.isCancelled())
+					{
+						job->result.histogram.build(job->result.volumeData, false); // values only, like the cache
+					}
+				}
+				ImportProgress::setCurrent(nullptr);
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			job->done = true;
+			m_jobDone.notify_all();
+		}
+	}
+
+	/** @brief replace the latest request, its worker is started on demand */
+	void queue(std::shared_ptr<Job> job)
+	{
+		cancel();
+
+		job->done = false;
+		m_latest = job;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_pending = job; // a stale queued job is never started
+		}
+		if (!m_thread.joinable()) { m_thread = std::thread(&AsyncVolumeLoader<T>::run, this); }
+		m_jobQueued.notify_one();
+	}
+
+public:
+	AsyncVolumeLoader() : m_quit(false) {}
+	virtual ~AsyncVolumeLoader()
+	{
+		cancel();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+			m_pending.reset();
+		}
+		m_jobQueued.notify_all();
+		if (m_thread.joinable()) { m_thread.join(); }
+	}
+
+	/** @brief queue loading a preset, cancels the running request and drops a queued one */
+	void request(VolumePresets::Preset preset, std::string directory = RESOURCES_PATH)
+	{
+		std::shared_ptr<Job> job = std::make_shared<Job>();
+		job->preset = preset;
+		job->directory = directory;
+		queue(job);
+	}
+
+	/**
+	 * @brief queue a task that fills the result on the worker thread instead of loading a preset, i.e. cropping the active volume.
+	 *        It replaces and is cancelled like a request, the task may report to and check the ImportProgress of its thread.
+	 *        Whatever it references must outlive the loader, since a cancelled task may still be running
+	 * @param preset handed out with the result
+	 */
+	void requestTask(std::function<void(LoadedVolume<T>&)> task, VolumePresets::Preset preset)
+	{
+		std::shared_ptr<Job> job = std::make_shared<Job>();
+		job->preset = preset;
+		job->task = task;
+		queue(job);
+	}
+
+	/** @brief cancel the latest request, its result will never be handed out */
+	void cancel()
+	{
+		if (m_latest) { m_latest->progress.cancel(); }
+		m_latest.reset();
+	}
+
+	/**
+	 * @brief hand out the result of the latest request once it is done, non-blocking
+	 * @return true if result was filled
+	 */
+	bool poll(LoadedVolume<T>& result)
+	{
+		if (!m_latest || !m_latest->done)
+		{
+			return false;
+		}
+
+		std::shared_ptr<Job> job = m_latest;
+		m_latest.reset();
+		result = std::move(job->result);
+		return !result.isEmpty();
+	}
+
+	/** @brief block until the latest request is done, i.e. on startup */
+	bool wait(LoadedVolume<T>& result)
+	{
+		if (!m_latest) { return false; }
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			std::shared_ptr<Job> job = m_latest;
+			m_jobDone.wait(lock, [&job]() { return (bool) job->done; });
+		}
+		return poll(result);
+	}
+
+	inline bool isLoading() const { return (bool) m_latest; }
+	inline float getProgress() const { return isLoading() ? m_latest->progress.get() : 0.0f; }
+	inline VolumePresets::Preset getRequestedPreset() const { return m_latest->preset; } //!< only while isLoading()
+};
+
+#endif
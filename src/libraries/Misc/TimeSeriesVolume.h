@@ -0,0 +1,202 @@
+#ifndef MISC_TIMESERIESVOLUME_H
+#define MISC_TIMESERIESVOLUME_H
+
+#ifdef MINGW_THREADS
+	#include <mingw-std-threads/mingw.thread.h>
+#else
+	#include <thread>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <Core/ThreadPool.h>
+#include <Core/VolumeData.h>
+
+/** @brief wall clock driven position in a sequence of timesteps */
+class PlaybackClock
+{
+protected:
+	double m_time; //!< in timesteps
+	double m_rate; //!< timesteps per second
+	int m_numTimesteps;
+	bool m_playing;
+	bool m_loop;
+
+public:
+	PlaybackClock(int numTimesteps = 1, double rate = 10.0)
+		: m_time(0.0), m_rate(rate), m_numTimesteps(std::max(1, numTimesteps)), m_playing(false), m_loop(true)
+	{}
+
+	/** @brief move on by the duration of the last frame */
+	void advance(double seconds)
+	{
+		if (!m_playing) { return; }
+		seek(m_time + seconds * m_rate);
+		if (!m_loop && m_time >= (double) (m_numTimesteps - 1)) { m_playing = false; }
+	}
+
+	/** @brief jump to a (fractional) timestep, wrapped or clamped into the sequence */
+	void seek(double timestep)
+	{
+		if (m_loop) { m_time = timestep - std::floor(timestep / (double) m_numTimesteps) * (double) m_numTimesteps; }
+		else { m_time = std::max(0.0, std::min(timestep, (double) (m_numTimesteps - 1))); }
+	}
+
+	inline int getTimestep() const { return std::min((int) m_time, m_numTimesteps - 1); }
+
+	/** @brief timestep reached after offset further steps, wrapped or clamped like seek() */
+	inline int getNextTimestep(int offset = 1) const
+	{
+		int next = getTimestep() + ((m_rate < 0.0) ? -offset : offset);
+		if (m_loop) { return ((next % m_numTimesteps) + m_numTimesteps) % m_numTimesteps; }
+		return std::max(0, std::min(next, m_numTimesteps - 1));
+	}
+
+	inline double getTime() const { return m_time; }
+	inline int getNumTimesteps() const { return m_numTimesteps; }
+	inline void setNumTimesteps(int numTimesteps) { m_numTimesteps = std::max(1, numTimesteps); seek(m_time); }
+	inline double getRate() const { return m_rate; }
+	inline void setRate(double rate) { m_rate = rate; } //!< timesteps per second, negative plays backwards
+	inline void setLoop(bool loop) { m_loop = loop; }
+	inline bool isLooping() const { return m_loop; }
+	inline void play() { m_playing = true; }
+	inline void pause() { m_playing = false; }
+	inline bool isPlaying() const { return m_playing; }
+};
+
+/**
+ * @brief source of a sequence of volumes that do not have to fit into memory together. A ring of decoded timesteps is kept in RAM,
+ *        requested timesteps and the ones following them are decoded on the thread pool while the current one is rendered.
+ *        Volumes are handed out as shared pointers, a slot is only reused once nobody holds it anymore.
+ */
+template<class T>
+class TimeSeriesVolume
+{
+public:
+	/** @brief decode a timestep into result (which may hold voxels of an older timestep to reuse), called on worker threads */
+	typedef std::function<bool(int timestep, VolumeData<T>& result)> LoadFunc;
+
+protected:
+	struct Slot
+	{
+		std::atomic<int> timestep; //!< -1 if empty
+		std::atomic<bool> ready;   //!< volumeData holds timestep
+		std::atomic<bool> failed;
+		unsigned long long lastUsed;
+		VolumeData<T> volumeData;
+	};
+
+	LoadFunc m_load;
+	int m_numTimesteps;
+	int m_prefetch; //!< timesteps following a requested one to decode ahead
+	std::vector< std::shared_ptr<Slot> > m_slots;
+	unsigned long long m_useCounter;
+
+	std::shared_ptr<Slot> find(int timestep) const
+	{
+		for (auto slot : m_slots) { if (slot->timestep == timestep) { return slot; } }
+		return std::shared_ptr<Slot>();
+	}
+
+	/** @brief start decoding timestep into the least recently used slot that is neither wanted nor held, false if all are busy */
+	bool load(int timestep, const std::vector<int>& wanted)
+	{
+		std::shared_ptr<Slot> victim;
+		for (auto slot : m_slots)
+		{
+			if (slot.use_count() > 2) { continue; } // m_slots and this loop hold one each, anything more is a reader or a worker
+			if (std::find(wanted.begin(), wanted.end(), slot->timestep.load()) != wanted.end()) { continue; }
+			if (!victim || slot->lastUsed < victim->lastUsed) { victim = slot; }
+		}
+		if (!victim) { return false; }
+
+		victim->timestep = timestep;
+		victim->ready = false;
+		victim->failed = false;
+		victim->lastUsed = ++m_useCounter;
+		LoadFunc loadFunc = m_load;
+		THREADPOOL->enqueue([victim, loadFunc, timestep]()
+		{
+			bool success = loadFunc(timestep, victim->volumeData);
+			victim->failed = !success;
+			victim->ready = success;
+		});
+		return true;
+	}
+
+public:
+	/**
+	 * @param load decodes one timestep
+	 * @param numTimesteps in the sequence
+	 * @param ringSize (optional) timesteps held in RAM, at least prefetch + 2: the current, the prefetched and the one being uploaded
+	 * @param prefetch (optional) timesteps after the requested one to decode ahead
+	 */
+	TimeSeriesVolume(LoadFunc load, int numTimesteps, int ringSize = 4, int prefetch = 2)
+		: m_load(load), m_numTimesteps(numTimesteps), m_prefetch(prefetch), m_useCounter(0)
+	{
+		for (int i = 0; i < std::max(ringSize, prefetch + 2); i++)
+		{
+			std::shared_ptr<Slot> slot = std::make_shared<Slot>();
+			slot->timestep = -1;
+			slot->ready = false;
+			slot->failed = false;
+			slot->lastUsed = 0;
+			m_slots.push_back(slot);
+		}
+	}
+
+	virtual ~TimeSeriesVolume()
+	{
+		// workers may still use the load function and its captures
+		for (auto slot : m_slots)
+		{
+			while (slot.use_count() > 2) { std::this_thread::yield(); }
+		}
+	}
+
+	/**
+	 * @brief make sure timestep and the next ones are decoded or being decoded, call once per frame with the clock position
+	 * @param nextTimesteps (optional) the ones to prefetch, i.e. from PlaybackClock::getNextTimestep(). Consecutive ones if empty
+	 */
+	void request(int timestep, std::vector<int> nextTimesteps = std::vector<int>())
+	{
+		if (nextTimesteps.empty())
+		{
+			for (int i = 1; i <= m_prefetch; i++) { nextTimesteps.push_back((timestep + i) % m_numTimesteps); }
+		}
+		std::vector<int> wanted(1, timestep);
+		wanted.insert(wanted.end(), nextTimesteps.begin(), nextTimesteps.begin() + std::min((size_t) m_prefetch, nextTimesteps.size()));
+
+		for (size_t i = 0; i < wanted.size(); i++)
+		{
+			std::shared_ptr<Slot> slot = find(wanted[i]);
+			if (slot)
+			{
+				slot->lastUsed = ++m_useCounter;
+				continue;
+			}
+			if (!load(wanted[i], wanted)) { break; }
+		}
+	}
+
+	/** @brief decoded timestep, nullptr while it is being decoded or not requested. The slot stays untouched while the result is held */
+	std::shared_ptr<const VolumeData<T> > get(int timestep)
+	{
+		std::shared_ptr<Slot> slot = find(timestep);
+		if (!slot || !slot->ready) { return std::shared_ptr<const VolumeData<T> >(); }
+		slot->lastUsed = ++m_useCounter;
+		return std::shared_ptr<const VolumeData<T> >(slot, &slot->volumeData);
+	}
+
+	inline bool isReady(int timestep) const { std::shared_ptr<Slot> slot = find(timestep); return slot && slot->ready; }
+	inline bool hasFailed(int timestep) const { std::shared_ptr<Slot> slot = find(timestep); return slot && slot->failed; }
+	inline int getNumTimesteps() const { return m_numTimesteps; }
+	inline int getRingSize() const { return (int) m_slots.size(); }
+};
+
+#endif
@@ -2,6 +2,7 @@
 #define MISC_VOLUMEPRESETS_H
 
 #include <Importing/Importer.h>
+#include <Importing/VolumeCache.h>
 #include <Volume/SyntheticVolume.h>
 
 namespace VolumePresets
@@ -62,6 +63,14 @@ namespace VolumePresets
 
 	template<class T>
 	void loadPreset(VolumeData<T>& volData, Preset preset, std::string directory = RESOURCES_PATH);
+
+	/**
+	 * @brief map the preset's volume cache, importing the preset and writing the cache first if it is missing or outdated
+	 * @param volData receives the imported volume if no cache could be mapped (i.e. synthetic presets or read-only directories), stays empty otherwise
+	 * @return mapped cache, check isValid()
+	 */
+	template<class T>
+	VolumeCache::CachedVolume<T> loadPresetCached(VolumeData<T>& volData, Preset preset, std::string directory = RESOURCES_PATH);
 }
 
 
@@ -102,10 +111,10 @@ void VolumePresets::loadPreset(VolumeData<T>& volData, Preset preset, std::strin
 	switch(preset)
 	{
 		case CT_Head:
-			volData = Importer::load3DData<T>(file + getPath(preset), 256, 256, 113, 2);
+			volData = Importer::load3DDataParallel<T>(file + getPath(preset), 256, 256, 113, 2);
 			break;
 		case MRT_Brain_Stanford:
-			volData = Importer::load3DData<T>(file + getPath(preset), 256, 256, 109, 2);
+			volData = Importer::load3DDataParallel<T>(file + getPath(preset), 256, 256, 109, 2);
 			break;
 		case MRT_Brain:
 			volData = Importer::loadBruder<T>(file + getPath(preset));
@@ -122,6 +131,40 @@ void VolumePresets::loadPreset(VolumeData<T>& volData, Preset preset, std::strin
 	}
 }
 
+template<class T>
+VolumeCache::CachedVolume<T> VolumePresets::loadPresetCached(VolumeData<T>& volData, Preset preset, std::string directory)
+{
+	volData = VolumeData<T>();
+	std::string path = getPath(preset);
+	if (path.empty())
+	{
+		loadPreset(volData, preset, directory); // synthetic
+		return VolumeCache::CachedVolume<T>();
+	}
+
+	VolumeCache::CachedVolume<T> cached = VolumeCache::open<T>(directory + path);
+	if (cached.isValid())
+	{
+		return cached;
+	}
+
+	loadPreset(volData, preset, directory);
+	ImportProgress* progress = ImportProgress::getCurrent();
+	if (progress && progress->isCancelled())
+	{
+		volData = VolumeData<T>(); // incomplete, must not end up in the cache
+		return cached;
+	}
+	if (VolumeCache::write(directory + path, volData))
+	{
+		cached = VolumeCache::open<T>(directory + path);
+		if (cached.isValid())
+		{
+			volData = VolumeData<T>(); // set free
+		}
+	}
+	return cached;
+}
 
 #include <glm/gtx/transform.hpp>
 glm::mat4 VolumePresets::getRotation(Preset preset)
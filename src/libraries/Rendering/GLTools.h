@@ -99,9 +99,9 @@ double log_2( double n )
     return log( n ) / log( 2 );      // log(n)/log(2) is log_2. 
 }}
 
-/** upload the provided volume data to a 3D OpenGL texture object, i.e. CT-Data*/
+/** upload the provided volume data view (i.e. a memory mapped volume) to a 3D OpenGL texture object*/
 template <typename T>
-GLuint loadTo3DTexture(VolumeData<T>& volumeData, int levels = 1, GLenum internalFormat = GL_R16I, GLenum format = GL_RED_INTEGER, GLenum type = GL_SHORT)
+GLuint loadTo3DTexture(const VolumeDataView<T>& volumeData, int levels = 1, GLenum internalFormat = GL_R16I, GLenum format = GL_RED_INTEGER, GLenum type = GL_SHORT)
 {
 	GLuint volumeTexture;
 
@@ -138,7 +138,7 @@ GLuint loadTo3DTexture(VolumeData<T>& volumeData, int levels = 1, GLenum interna
 		, volumeData.size_z
 		, format
 		, type
-		, &(volumeData.data[0])
+		, volumeData.data
 	);
 
 	if (levels > 1)
@@ -149,4 +149,46 @@ GLuint loadTo3DTexture(VolumeData<T>& volumeData, int levels = 1, GLenum interna
 	return volumeTexture;
 }
 
+/** upload a precomputed mip pyramid (i.e. from a VolumeCache) to a 3D OpenGL texture object, level sizes must halve like OpenGL mip levels*/
+template <typename T>
+GLuint loadTo3DTexture(const std::vector< VolumeDataView<T> >& levels, int numLevels = 1, GLenum internalFormat = GL_R16I, GLenum format = GL_RED_INTEGER, GLenum type = GL_SHORT)
+{
+	if (levels.empty())
+	{
+		return 0;
+	}
+	numLevels = std::max(1, std::min(numLevels, (int) levels.size()));
+
+	GLuint volumeTexture;
+
+	glEnable(GL_TEXTURE_3D);
+	OPENGLCONTEXT->activeTexture(GL_TEXTURE0);
+	glGenTextures(1, &volumeTexture);
+	OPENGLCONTEXT->bindTexture(volumeTexture, GL_TEXTURE_3D);
+
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
+
+	// allocate GPU memory
+	glTexStorage3D(GL_TEXTURE_3D, numLevels, internalFormat, levels[0].size_x, levels[0].size_y, levels[0].size_z);
+
+	// upload every level, no glGenerateMipmap
+	for (int i = 0; i < numLevels; i++)
+	{
+		glTexSubImage3D(GL_TEXTURE_3D, i, 0, 0, 0, levels[i].size_x, levels[i].size_y, levels[i].size_z, format, type, levels[i].data);
+	}
+
+	return volumeTexture;
+}
+
+/** upload the provided volume data to a 3D OpenGL texture object, i.e. CT-Data*/
+template <typename T>
+GLuint loadTo3DTexture(VolumeData<T>& volumeData, int levels = 1, GLenum internalFormat = GL_R16I, GLenum format = GL_RED_INTEGER, GLenum type = GL_SHORT)
+{
+	return loadTo3DTexture<T>(VolumeDataView<T>(volumeData), levels, internalFormat, format, type);
+}
+
 #endif
\ No newline at end of file
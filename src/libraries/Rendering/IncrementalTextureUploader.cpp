@@ -0,0 +1,285 @@
+#include "IncrementalTextureUploader.h"
+
+#include "Rendering/OpenGLContext.h"
+
+#include <cstring>
+#include <chrono>
+
+namespace {
+// units 0..31 are taken by the renderers, binding there would swap the volume under their feet
+const GLenum UPLOAD_TEXTURE_UNIT = GL_TEXTURE0 + 47;
+
+// bind to the upload unit and make it active, returns the unit that was active before
+GLenum bindForUpload(GLuint texture)
+{
+	GLenum previousUnit = OPENGLCONTEXT->cacheActiveTexture;
+	OPENGLCONTEXT->bindTextureToUnit(texture, UPLOAD_TEXTURE_UNIT, GL_TEXTURE_3D);
+	OPENGLCONTEXT->activeTexture(UPLOAD_TEXTURE_UNIT);
+	return previousUnit;
+}
+}
+
+IncrementalTextureUploader::IncrementalTextureUploader()
+	: m_numSourceLevels(0)
+	, m_numLevels(0)
+	, m_bytesPerVoxel(0)
+	, m_format(GL_RED)
+	, m_type(GL_FLOAT)
+	, m_downsample(nullptr)
+	, m_texture(0)
+	, m_ownsTexture(true)
+	, m_currentLevel(0)
+	, m_currentSlice(0)
+	, m_uploadedBytes(0)
+	, m_totalBytes(0)
+	, m_currentBuffer(0)
+	, m_bufferSize(0)
+{
+	for (int i = 0; i < NUM_BUFFERS; i++)
+	{
+		m_buffers[i] = 0;
+		m_fences[i] = 0;
+	}
+}
+
+IncrementalTextureUploader::~IncrementalTextureUploader()
+{
+	cancel();
+	releaseBuffers();
+}
+
+bool IncrementalTextureUploader::begin(const std::vector<Level>& levels, int numLevels, GLenum internalFormat, GLenum format, GLenum type, size_t bytesPerVoxel, DownsampleFunc downsample)
+{
+	cancel();
+	if (levels.empty() || levels[0].data == nullptr)
+	{
+		return false;
+	}
+
+	// clamp to the full mip chain
+	int maxSize = std::max(std::max(levels[0].size_x, levels[0].size_y), levels[0].size_z);
+	int maxLevels = 1;
+	while ((maxSize >> maxLevels) > 0) { maxLevels++; }
+	m_numLevels = std::max(1, std::min(numLevels, maxLevels));
+
+	m_numSourceLevels = (int) std::min((size_t) m_numLevels, levels.size());
+	m_levels.assign(levels.begin(), levels.begin() + m_numSourceLevels);
+	m_bytesPerVoxel = bytesPerVoxel;
+	m_format = format;
+	m_type = type;
+	m_downsample = downsample;
+
+	// storage for the levels that are filtered while uploading
+	m_generatedLevels.assign(m_numLevels, std::vector<unsigned char>());
+	m_numGeneratedSlices.assign(m_numLevels, 0);
+	if (m_downsample != nullptr)
+	{
+		for (int l = m_numSourceLevels; l < m_numLevels; l++)
+		{
+			const Level& previous = m_levels.back();
+			Level level = { nullptr, std::max(1, previous.size_x / 2), std::max(1, previous.size_y / 2), std::max(1, previous.size_z / 2) };
+			m_generatedLevels[l].resize((size_t) level.size_x * level.size_y * level.size_z * bytesPerVoxel);
+			level.data = &m_generatedLevels[l][0];
+			m_levels.push_back(level);
+		}
+	}
+
+	glGenTextures(1, &m_texture);
+	m_ownsTexture = true;
+	GLenum previousUnit = bindForUpload(m_texture);
+
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
+
+	glTexStorage3D(GL_TEXTURE_3D, m_numLevels, internalFormat, levels[0].size_x, levels[0].size_y, levels[0].size_z);
+	OPENGLCONTEXT->activeTexture(previousUnit);
+
+	beginUpload(bytesPerVoxel);
+	return true;
+}
+
+bool IncrementalTextureUploader::beginInto(GLuint texture, const std::vector<Level>& levels, GLenum format, GLenum type, size_t bytesPerVoxel)
+{
+	cancel();
+	if (texture == 0 || levels.empty() || levels[0].data == nullptr)
+	{
+		return false;
+	}
+
+	m_levels = levels;
+	m_numSourceLevels = m_numLevels = (int) levels.size();
+	m_generatedLevels.assign(m_numLevels, std::vector<unsigned char>());
+	m_numGeneratedSlices.assign(m_numLevels, 0);
+	m_bytesPerVoxel = bytesPerVoxel;
+	m_format = format;
+	m_type = type;
+	m_downsample = nullptr;
+	m_texture = texture;
+	m_ownsTexture = false;
+
+	beginUpload(bytesPerVoxel);
+	return true;
+}
+
+void IncrementalTextureUploader::beginUpload(size_t bytesPerVoxel)
+{
+	m_currentLevel = 0;
+	m_currentSlice = 0;
+	m_uploadedBytes = 0;
+	m_totalBytes = 0;
+	for (size_t i = 0; i < m_levels.size(); i++)
+	{
+		m_totalBytes += (unsigned long long) m_levels[i].size_x * m_levels[i].size_y * m_levels[i].size_z * bytesPerVoxel;
+	}
+
+	// ring of unpack buffers, each large enough for a slab of level 0. Kept while consecutive uploads fit into them
+	size_t sliceBytes = (size_t) m_levels[0].size_x * m_levels[0].size_y * bytesPerVoxel;
+	size_t bufferSize = std::max(sliceBytes, SLAB_BYTES / sliceBytes * sliceBytes);
+	if (m_buffers[0] != 0 && m_bufferSize == bufferSize)
+	{
+		return;
+	}
+	releaseBuffers();
+	m_bufferSize = bufferSize;
+	glGenBuffers(NUM_BUFFERS, m_buffers);
+	for (int i = 0; i < NUM_BUFFERS; i++)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffers[i]);
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, m_bufferSize, NULL, GL_STREAM_DRAW);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	m_currentBuffer = 0;
+}
+
+void IncrementalTextureUploader::generateSlices(int level, int availableSlices)
+{
+	int next = level + 1;
+	if (m_downsample == nullptr || next >= (int) m_levels.size() || next < m_numSourceLevels)
+	{
+		return;
+	}
+
+	const Level& source = m_levels[level];
+	const Level& target = m_levels[next];
+	size_t sourceSliceBytes = (size_t) source.size_x * source.size_y * m_bytesPerVoxel;
+	size_t targetSliceBytes = (size_t) target.size_x * target.size_y * m_bytesPerVoxel;
+
+	// a slice of the next level needs source slices 2k and 2k + 1 (clamped)
+	int& k = m_numGeneratedSlices[next];
+	while (k < target.size_z && std::min(2 * k + 1, source.size_z - 1) < availableSlices)
+	{
+		const unsigned char* src = (const unsigned char*) source.data;
+		m_downsample(src + (size_t) (2 * k) * sourceSliceBytes, src + (size_t) std::min(2 * k + 1, source.size_z - 1) * sourceSliceBytes,
+			source.size_x, source.size_y, &m_generatedLevels[next][(size_t) k * targetSliceBytes]);
+		k++;
+	}
+}
+
+bool IncrementalTextureUploader::step(double budgetMs, size_t budgetBytes)
+{
+	if (!isActive()) { return false; }
+	if (isComplete()) { return true; }
+
+	auto start = std::chrono::high_resolution_clock::now();
+	GLenum previousUnit = bindForUpload(m_texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	size_t uploadedBytes = 0;
+	do
+	{
+		// the GPU may still read from the next buffer of the ring, try again next frame instead of stalling
+		GLsync& fence = m_fences[m_currentBuffer];
+		if (fence != 0)
+		{
+			if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) { break; }
+			glDeleteSync(fence);
+			fence = 0;
+		}
+
+		const Level& level = m_levels[m_currentLevel];
+		const size_t sliceBytes = (size_t) level.size_x * level.size_y * m_bytesPerVoxel;
+		int numSlices = std::min(level.size_z - m_currentSlice, std::max(1, (int) (m_bufferSize / sliceBytes)));
+		size_t slabBytes = (size_t) numSlices * sliceBytes;
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_buffers[m_currentBuffer]);
+		void* target = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, slabBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+		if (target == nullptr) { break; }
+		memcpy(target, (const unsigned char*) level.data + (size_t) m_currentSlice * sliceBytes, slabBytes);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		glTexSubImage3D(GL_TEXTURE_3D, m_currentLevel, 0, 0, m_currentSlice, level.size_x, level.size_y, numSlices, m_format, m_type, 0);
+		fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		m_currentBuffer = (m_currentBuffer + 1) % NUM_BUFFERS;
+
+		m_currentSlice += numSlices;
+		m_uploadedBytes += slabBytes;
+		uploadedBytes += slabBytes;
+		generateSlices(m_currentLevel, m_currentSlice);
+
+		if (m_currentSlice >= level.size_z)
+		{
+			m_currentSlice = 0;
+			m_currentLevel++;
+		}
+	} while (!isComplete()
+		&& (budgetBytes == 0 || uploadedBytes < budgetBytes)
+		&& std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() < budgetMs);
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	if (isComplete())
+	{
+		finish();
+	}
+	OPENGLCONTEXT->activeTexture(previousUnit);
+	return isComplete();
+}
+
+void IncrementalTextureUploader::finish()
+{
+	if ((int) m_levels.size() < m_numLevels)
+	{
+		glGenerateMipmap(GL_TEXTURE_3D);
+	}
+	if (m_ownsTexture) { releaseBuffers(); } // streaming into caller textures reuses the ring for the next upload
+	m_generatedLevels.clear();
+}
+
+void IncrementalTextureUploader::releaseBuffers()
+{
+	for (int i = 0; i < NUM_BUFFERS; i++)
+	{
+		if (m_fences[i] != 0) { glDeleteSync(m_fences[i]); m_fences[i] = 0; }
+	}
+	if (m_buffers[0] != 0)
+	{
+		glDeleteBuffers(NUM_BUFFERS, m_buffers);
+		for (int i = 0; i < NUM_BUFFERS; i++) { m_buffers[i] = 0; }
+	}
+}
+
+void IncrementalTextureUploader::cancel()
+{
+	if (m_texture != 0)
+	{
+		OPENGLCONTEXT->activeTexture(bindForUpload(0));
+		if (m_ownsTexture) { glDeleteTextures(1, &m_texture); }
+		m_texture = 0;
+	}
+	if (m_ownsTexture) { releaseBuffers(); }
+	m_levels.clear();
+	m_generatedLevels.clear();
+}
+
+GLuint IncrementalTextureUploader::release()
+{
+	if (!isComplete()) { return 0; }
+	GLuint texture = m_texture;
+	OPENGLCONTEXT->activeTexture(bindForUpload(0)); // the caller binds it wherever needed
+	m_texture = 0;
+	m_levels.clear();
+	return texture;
+}
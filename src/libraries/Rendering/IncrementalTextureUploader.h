@@ -0,0 +1,140 @@
+#ifndef INCREMENTALTEXTUREUPLOADER_H
+#define INCREMENTALTEXTUREUPLOADER_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <Core/VolumeData.h>
+
+/**
+ * @brief uploads a 3D texture slab by slab through a ring of pixel unpack buffers, so no single frame stalls on a large volume.
+ *        Mip levels that are not provided are box filtered on the CPU as soon as the slices they depend on are uploaded.
+ *        The texture is only handed out once all levels are complete, the caller keeps rendering its old one meanwhile.
+ *        The voxels must stay alive until the upload is finished or cancelled.
+ */
+class IncrementalTextureUploader
+{
+public:
+	struct Level {
+		const void* data;
+		int size_x;
+		int size_y;
+		int size_z;
+	};
+
+	static const int NUM_BUFFERS = 3; //!< pixel unpack buffers in flight
+	static const size_t SLAB_BYTES = 4 << 20; //!< target size of a slab, at least one slice is uploaded at once
+
+	/** @brief 2x2x2 box filter of two source slices into one slice of the next level */
+	typedef void (*DownsampleFunc)(const void* slice0, const void* slice1, int size_x, int size_y, void* result);
+
+protected:
+	std::vector<Level> m_levels; //!< source data of every level, generated levels point into m_generatedLevels
+	std::vector< std::vector<unsigned char> > m_generatedLevels;
+	std::vector<int> m_numGeneratedSlices; //!< per level, only meaningful for generated levels
+	int m_numSourceLevels; //!< levels provided by the caller
+	int m_numLevels;
+	size_t m_bytesPerVoxel;
+	GLenum m_format;
+	GLenum m_type;
+	DownsampleFunc m_downsample; //!< nullptr: missing levels are filled by glGenerateMipmap at the end
+
+	GLuint m_texture;
+	bool m_ownsTexture; //!< false if uploading into a texture of the caller, which is never deleted here
+	int m_currentLevel;
+	int m_currentSlice;
+	unsigned long long m_uploadedBytes;
+	unsigned long long m_totalBytes;
+
+	GLuint m_buffers[NUM_BUFFERS];
+	GLsync m_fences[NUM_BUFFERS];
+	int m_currentBuffer;
+	size_t m_bufferSize;
+
+	void generateSlices(int level, int availableSlices); //!< of level + 1 from the first availableSlices slices of level
+	void beginUpload(size_t bytesPerVoxel); //!< reset progress and create the buffer ring for m_levels
+	void finish();
+	void releaseBuffers();
+
+public:
+	IncrementalTextureUploader();
+	virtual ~IncrementalTextureUploader();
+
+	/**
+	 * @brief allocate the texture and start an upload, cancels any previous one
+	 * @param levels of source data, level sizes must halve like OpenGL mip levels
+	 * @param numLevels of the texture. Levels missing in levels are generated with downsample, or by glGenerateMipmap if it is nullptr
+	 * @param bytesPerVoxel of the source data in format and type
+	 */
+	bool begin(const std::vector<Level>& levels, int numLevels, GLenum internalFormat, GLenum format, GLenum type, size_t bytesPerVoxel, DownsampleFunc downsample = nullptr);
+
+	template<class T>
+	bool begin(const std::vector< VolumeDataView<T> >& levels, int numLevels, GLenum internalFormat, GLenum format, GLenum type)
+	{
+		std::vector<Level> sourceLevels;
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			Level level = { levels[i].data, (int) levels[i].size_x, (int) levels[i].size_y, (int) levels[i].size_z };
+			sourceLevels.push_back(level);
+		}
+		return begin(sourceLevels, numLevels, internalFormat, format, type, sizeof(T), &downsampleSlices<T>);
+	}
+
+	/**
+	 * @brief start an upload into an existing texture, i.e. the back buffer of a TimeSeriesTexture. Cancels any previous upload
+	 * @param texture with immutable storage matching the extents of levels, stays owned by the caller
+	 * @param levels of source data, uploaded to the same mip levels. Further levels of texture are left untouched
+	 */
+	bool beginInto(GLuint texture, const std::vector<Level>& levels, GLenum format, GLenum type, size_t bytesPerVoxel);
+
+	/**
+	 * @brief upload slabs until the time or byte budget is used up. At least one slab per call, unless the GPU still reads all buffers
+	 * @param budgetMs time to spend, i.e. the slack left by ChunkedAdaptiveRenderPass
+	 * @param budgetBytes (optional) bytes to upload, 0 for no limit
+	 * @return true once the texture is complete
+	 */
+	bool step(double budgetMs, size_t budgetBytes = 0);
+
+	void cancel(); //!< delete the incomplete texture
+
+	GLuint release(); //!< hand out the completed texture, 0 if not complete. The caller owns it afterwards
+
+	inline bool isActive() const { return m_texture != 0; }
+	inline bool isComplete() const { return m_texture != 0 && m_currentLevel >= (int) m_levels.size(); }
+	inline float getProgress() const { return (m_totalBytes == 0) ? 0.0f : (float) ((double) m_uploadedBytes / (double) m_totalBytes); }
+
+	template<class T>
+	static void downsampleSlices(const void* slice0, const void* slice1, int size_x, int size_y, void* result);
+};
+
+////// IMPLEMENTATION
+template<class T>
+void IncrementalTextureUploader::downsampleSlices(const void* slice0, const void* slice1, int size_x, int size_y, void* result)
+{
+	const T* src[2] = { (const T*) slice0, (const T*) slice1 };
+	T* dst = (T*) result;
+	int result_x = std::max(1, size_x / 2);
+	int result_y = std::max(1, size_y / 2);
+
+	for (int y = 0; y < result_y; y++)
+	{
+		int y0 = std::min(2 * y, size_y - 1), y1 = std::min(2 * y + 1, size_y - 1);
+		for (int x = 0; x < result_x; x++)
+		{
+			int x0 = std::min(2 * x, size_x - 1), x1 = std::min(2 * x + 1, size_x - 1);
+			double sum = 0.0;
+			for (int s = 0; s < 2; s++)
+			{
+				sum += (double) src[s][y0 * size_x + x0] + (double) src[s][y0 * size_x + x1]
+				     + (double) src[s][y1 * size_x + x0] + (double) src[s][y1 * size_x + x1];
+			}
+			dst[y * result_x + x] = std::numeric_limits<T>::is_integer ? (T) std::floor(sum / 8.0 + 0.5) : (T) (sum / 8.0);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,119 @@
+#include "TimeSeriesTexture.h"
+
+#include "Rendering/OpenGLContext.h"
+
+TimeSeriesTexture::TimeSeriesTexture()
+	: m_front(0)
+	, m_backComplete(false)
+	, m_size_x(0)
+	, m_size_y(0)
+	, m_size_z(0)
+	, m_format(GL_RED)
+	, m_type(GL_FLOAT)
+	, m_bytesPerVoxel(0)
+{
+	m_textures[0] = m_textures[1] = 0;
+	m_timesteps[0] = m_timesteps[1] = -1;
+}
+
+TimeSeriesTexture::~TimeSeriesTexture()
+{
+	release();
+}
+
+bool TimeSeriesTexture::allocate(int size_x, int size_y, int size_z, GLenum internalFormat, GLenum format, GLenum type, size_t bytesPerVoxel)
+{
+	release();
+	if (size_x <= 0 || size_y <= 0 || size_z <= 0 || bytesPerVoxel == 0)
+	{
+		return false;
+	}
+
+	m_size_x = size_x;
+	m_size_y = size_y;
+	m_size_z = size_z;
+	m_format = format;
+	m_type = type;
+	m_bytesPerVoxel = bytesPerVoxel;
+
+	glGenTextures(2, m_textures);
+	for (int i = 0; i < 2; i++)
+	{
+		OPENGLCONTEXT->bindTexture(m_textures[i], GL_TEXTURE_3D);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP);
+		glTexStorage3D(GL_TEXTURE_3D, 1, internalFormat, size_x, size_y, size_z);
+	}
+	OPENGLCONTEXT->bindTexture(0, GL_TEXTURE_3D);
+	return true;
+}
+
+void TimeSeriesTexture::release()
+{
+	m_uploader.cancel();
+	m_uploadSource.reset();
+	if (m_textures[0] != 0)
+	{
+		glDeleteTextures(2, m_textures);
+	}
+	m_textures[0] = m_textures[1] = 0;
+	m_timesteps[0] = m_timesteps[1] = -1;
+	m_front = 0;
+	m_backComplete = false;
+}
+
+bool TimeSeriesTexture::beginUpload(int timestep, std::shared_ptr<const void> voxels)
+{
+	if (m_textures[0] == 0 || !voxels)
+	{
+		return false;
+	}
+
+	std::vector<IncrementalTextureUploader::Level> levels(1);
+	levels[0].data = voxels.get();
+	levels[0].size_x = m_size_x;
+	levels[0].size_y = m_size_y;
+	levels[0].size_z = m_size_z;
+
+	// the back texture is overwritten from now on, even if the upload is cancelled later
+	m_timesteps[back()] = -1;
+	m_backComplete = false;
+	if (!m_uploader.beginInto(m_textures[back()], levels, m_format, m_type, m_bytesPerVoxel))
+	{
+		m_uploadSource.reset();
+		return false;
+	}
+	m_uploadSource = voxels;
+	m_timesteps[back()] = timestep;
+	return true;
+}
+
+bool TimeSeriesTexture::step(double budgetMs)
+{
+	if (m_uploader.isActive() && m_uploader.step(budgetMs))
+	{
+		m_uploader.release();
+		m_uploadSource.reset();
+		m_backComplete = true;
+	}
+	return m_backComplete;
+}
+
+bool TimeSeriesTexture::present(int timestep)
+{
+	if (m_timesteps[m_front] == timestep)
+	{
+		return true;
+	}
+	if (!m_backComplete || m_timesteps[back()] != timestep)
+	{
+		return false;
+	}
+
+	// the former front texture is complete as well, it may be presented again or overwritten
+	m_front = back();
+	return true;
+}
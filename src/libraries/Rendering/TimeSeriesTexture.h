@@ -0,0 +1,102 @@
+#ifndef TIMESERIESTEXTURE_H
+#define TIMESERIESTEXTURE_H
+
+#include <GL/glew.h>
+
+#include <memory>
+
+#include <Core/VolumeData.h>
+
+#include "IncrementalTextureUploader.h"
+
+/**
+ * @brief pair of 3D textures for playing back a sequence of equally sized volumes. The front texture is rendered while the next
+ *        timestep streams into the back texture within the frame budget. They are swapped once the back texture is complete and
+ *        the playback clock reached its timestep, so neither playback nor rendering ever waits for an upload.
+ */
+class TimeSeriesTexture
+{
+protected:
+	GLuint m_textures[2];
+	int m_timesteps[2]; //!< held (or being uploaded) by each texture, -1 if none
+	int m_front;        //!< index of the texture to render
+	bool m_backComplete;
+
+	int m_size_x;
+	int m_size_y;
+	int m_size_z;
+	GLenum m_format;
+	GLenum m_type;
+	size_t m_bytesPerVoxel;
+
+	IncrementalTextureUploader m_uploader;
+	std::shared_ptr<const void> m_uploadSource; //!< keeps the voxels alive until the upload is finished
+
+	inline int back() const { return 1 - m_front; }
+
+public:
+	TimeSeriesTexture();
+	virtual ~TimeSeriesTexture();
+
+	/** @brief (re)create both textures, single mip level */
+	bool allocate(int size_x, int size_y, int size_z, GLenum internalFormat, GLenum format, GLenum type, size_t bytesPerVoxel);
+	void release(); //!< delete both textures
+
+	/**
+	 * @brief start streaming a timestep into the back texture, cancels an upload in progress
+	 * @param voxels size_x * size_y * size_z voxels in format and type, held until the upload is finished
+	 */
+	bool beginUpload(int timestep, std::shared_ptr<const void> voxels);
+
+	template<class T>
+	bool beginUpload(int timestep, std::shared_ptr<const VolumeData<T> > volume)
+	{
+		if (!volume || (int) volume->size_x != m_size_x || (int) volume->size_y != m_size_y || (int) volume->size_z != m_size_z || sizeof(T) != m_bytesPerVoxel)
+		{
+			return false;
+		}
+		return beginUpload(timestep, std::shared_ptr<const void>(volume, volume->data.data()));
+	}
+
+	/** @brief upload slabs within the budget, see IncrementalTextureUploader::step(). True once the back texture is complete */
+	bool step(double budgetMs);
+
+	/** @brief swap if the back texture holds timestep completely. True if the front texture holds timestep afterwards */
+	bool present(int timestep);
+
+	/**
+	 * @brief per frame: show timestep if available and keep the back texture streaming the timestep that is shown next
+	 * @param source provides std::shared_ptr<const VolumeData<T> > get(int timestep), nullptr while not decoded, i.e. a TimeSeriesVolume
+	 * @param timestep of the playback clock
+	 * @param nextTimestep the clock will reach afterwards
+	 * @param budgetMs for uploading, i.e. the slack left by ChunkedAdaptiveRenderPass
+	 */
+	template<class Source>
+	void update(Source& source, int timestep, int nextTimestep, double budgetMs);
+
+	inline GLuint getFront() const { return m_textures[m_front]; }
+	inline int getFrontTimestep() const { return m_timesteps[m_front]; } //!< -1 until the first timestep was presented
+	inline int getBackTimestep() const { return m_timesteps[back()]; }
+	inline bool isUploading() const { return m_uploader.isActive(); }
+	inline float getUploadProgress() const { return m_uploader.getProgress(); }
+};
+
+////// IMPLEMENTATION
+template<class Source>
+void TimeSeriesTexture::update(Source& source, int timestep, int nextTimestep, double budgetMs)
+{
+	present(timestep);
+
+	// the current timestep if it is still missing (i.e. after seeking), the following one otherwise
+	int wanted = (getFrontTimestep() == timestep) ? nextTimestep : timestep;
+	if (getBackTimestep() != wanted)
+	{
+		auto volume = source.get(wanted);
+		if (volume) { beginUpload(wanted, volume); }
+	}
+
+	step(budgetMs);
+	present(timestep);
+}
+
+#endif
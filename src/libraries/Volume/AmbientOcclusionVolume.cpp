@@ -0,0 +1,176 @@
+#include "AmbientOcclusionVolume.h"
+
+#include <cmath>
+
+#include <Rendering/OpenGLContext.h>
+
+#include "TransferFunction.h"
+
+AmbientOcclusionVolume::AmbientOcclusionVolume(unsigned int factor, unsigned int radius)
+	: m_factor(std::max(1u, factor))
+	, m_radius(std::max(1u, radius))
+	, m_windowingMinVal(0.0f)
+	, m_windowingRange(0.0f)
+	, m_texture(0)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		m_size[i] = 0;
+		m_textureSize[i] = 0;
+	}
+}
+
+AmbientOcclusionVolume::~AmbientOcclusionVolume()
+{
+	release();
+}
+
+bool AmbientOcclusionVolume::updateOcclusion(const TransferFunction& transferFunction, float windowingMinVal, float windowingRange)
+{
+	return updateOcclusion(transferFunction.getTexData(), windowingMinVal, windowingRange);
+}
+
+bool AmbientOcclusionVolume::updateOcclusion(const std::vector<float>& rgba, float windowingMinVal, float windowingRange)
+{
+	const int numTexels = (int) rgba.size() / 4;
+	const size_t count = m_values.size();
+	if (numTexels == 0 || count == 0)
+	{
+		return false;
+	}
+	if (rgba == m_rgba && windowingMinVal == m_windowingMinVal && windowingRange == m_windowingRange)
+	{
+		return false;
+	}
+	m_rgba = rgba;
+	m_windowingMinVal = windowingMinVal;
+	m_windowingRange = windowingRange;
+
+	// opacity of every occlusion voxel, filtered like the transfer function texture
+	const float range = (std::abs(windowingRange) > 0.0f) ? windowingRange : 1e-20f;
+	const float texelScale = (float) numTexels / range;
+	const float texelOffset = -windowingMinVal * texelScale - 0.5f;
+	m_opacity.resize(count);
+	m_filtered.resize(count);
+	m_scratch.resize(count);
+	std::vector<float>& opacity = m_opacity;
+	std::vector<float>& filtered = m_filtered;
+	std::vector<float>& scratch = m_scratch;
+	THREADPOOL->parallelFor(0, count, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			float texel = std::max(0.0f, std::min(m_values[i] * texelScale + texelOffset, (float) (numTexels - 1)));
+			int lower = (int) texel;
+			int upper = std::min(lower + 1, numTexels - 1);
+			float t = texel - (float) lower;
+			opacity[i] = rgba[4 * lower + 3] + t * (rgba[4 * upper + 3] - rgba[4 * lower + 3]);
+		}
+	}, 1 << 16);
+
+	// separable box filter with running window sums, borders clamped like the texture.
+	// Along y and z whole rows slide at once, so all passes read memory contiguously
+	const int size[3] = { (int) m_size[0], (int) m_size[1], (int) m_size[2] };
+	const size_t stride[3] = { 1, (size_t) size[0], (size_t) size[0] * size[1] };
+	const int r = (int) m_radius;
+	THREADPOOL->parallelFor(0, (size_t) size[1] * size[2], [&](size_t begin, size_t end)
+	{
+		const int n = size[0];
+		for (size_t row = begin; row < end; row++)
+		{
+			const float* src = &opacity[row * n];
+			float* dst = &filtered[row * n];
+			float sum = 0.0f;
+			for (int i = -r; i <= r; i++) { sum += src[std::max(0, std::min(i, n - 1))]; }
+			dst[0] = sum;
+			for (int i = 1; i < n; i++)
+			{
+				sum += src[std::min(i + r, n - 1)] - src[std::max(i - r - 1, 0)];
+				dst[i] = sum;
+			}
+		}
+	}, 64);
+
+	for (int axis = 1; axis < 3; axis++)
+	{
+		const int other = 3 - axis; // the axis enumerating the planes rows slide in
+		const int n = size[axis];
+		const std::vector<float>& source = (axis == 1) ? filtered : scratch;
+		std::vector<float>& target = (axis == 1) ? scratch : filtered;
+		THREADPOOL->parallelFor(0, (size_t) size[other], [&](size_t begin, size_t end)
+		{
+			std::vector<float> sum(size[0]);
+			for (size_t plane = begin; plane < end; plane++)
+			{
+				auto row = [&](int i) { return &source[plane * stride[other] + std::max(0, std::min(i, n - 1)) * stride[axis]]; };
+				std::fill(sum.begin(), sum.end(), 0.0f);
+				for (int i = -r; i <= r; i++)
+				{
+					const float* add = row(i);
+					for (int x = 0; x < size[0]; x++) { sum[x] += add[x]; }
+				}
+				for (int i = 0; i < n; i++)
+				{
+					if (i > 0)
+					{
+						const float* add = row(i + r);
+						const float* remove = row(i - r - 1);
+						for (int x = 0; x < size[0]; x++) { sum[x] += add[x] - remove[x]; }
+					}
+					std::copy(sum.begin(), sum.end(), target.begin() + plane * stride[other] + i * stride[axis]);
+				}
+			}
+		}, 1);
+	}
+
+	// mean of the neighbourhood without the voxel itself, as the shader does
+	const float scale = 255.0f / (float) ((2 * r + 1) * (2 * r + 1) * (2 * r + 1) - 1);
+	m_occlusion.resize(count);
+	THREADPOOL->parallelFor(0, count, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			float occlusion = std::max(0.0f, std::min((filtered[i] - opacity[i]) * scale, 255.0f));
+			m_occlusion[i] = (unsigned char) (occlusion + 0.5f);
+		}
+	}, 1 << 16);
+	return true;
+}
+
+void AmbientOcclusionVolume::upload()
+{
+	if (m_occlusion.empty())
+	{
+		return;
+	}
+
+	if (m_texture == 0 || m_textureSize[0] != m_size[0] || m_textureSize[1] != m_size[1] || m_textureSize[2] != m_size[2])
+	{
+		release();
+		glGenTextures(1, &m_texture);
+		OPENGLCONTEXT->bindTexture(m_texture, GL_TEXTURE_3D);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexStorage3D(GL_TEXTURE_3D, 1, GL_R8, m_size[0], m_size[1], m_size[2]);
+		for (int i = 0; i < 3; i++) { m_textureSize[i] = m_size[i]; }
+	}
+
+	OPENGLCONTEXT->bindTexture(m_texture, GL_TEXTURE_3D);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, m_size[0], m_size[1], m_size[2], GL_RED, GL_UNSIGNED_BYTE, &m_occlusion[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	OPENGLCONTEXT->bindTexture(0, GL_TEXTURE_3D);
+}
+
+void AmbientOcclusionVolume::release()
+{
+	if (m_texture != 0)
+	{
+		glDeleteTextures(1, &m_texture);
+	}
+	m_texture = 0;
+	for (int i = 0; i < 3; i++) { m_textureSize[i] = 0; }
+}
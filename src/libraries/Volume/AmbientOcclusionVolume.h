@@ -0,0 +1,83 @@
+#ifndef VOLUME_AMBIENTOCCLUSIONVOLUME_H_
+#define VOLUME_AMBIENTOCCLUSIONVOLUME_H_
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <algorithm>
+
+#include <Core/VolumeData.h>
+
+#include "VolumeReduction.h"
+
+class TransferFunction;
+
+/**
+ * @brief local ambient occlusion at reduced resolution: the mean transfer function opacity around every block of voxels.
+ *        build() averages the volume once, transfer function changes only reclassify and filter the reduced grid.
+ *        The raycaster (AMBIENT_OCCLUSION with AMBIENT_OCCLUSION_VOLUME) fetches it once per sample
+ *        instead of classifying 14 neighbour samples.
+ */
+class AmbientOcclusionVolume
+{
+protected:
+	unsigned int m_factor; //!< voxels per occlusion voxel edge
+	unsigned int m_radius; //!< of the neighbourhood, in occlusion voxels
+	unsigned int m_size[3];
+	std::vector<float> m_values;            //!< mean value per block of voxels, x-fastest
+	std::vector<unsigned char> m_occlusion; //!< mean opacity of the neighbourhood without the voxel itself, times 255
+	std::vector<float> m_opacity, m_filtered, m_scratch; //!< kept between updates, so transfer function edits do not allocate
+
+	// what the occlusion was computed for
+	std::vector<float> m_rgba;
+	float m_windowingMinVal;
+	float m_windowingRange;
+
+	GLuint m_texture;
+	unsigned int m_textureSize[3];
+
+public:
+	/**
+	 * @param factor (optional) voxels per occlusion voxel edge
+	 * @param radius (optional) neighbourhood of (2 * radius + 1)^3 occlusion voxels
+	 */
+	AmbientOcclusionVolume(unsigned int factor = 2, unsigned int radius = 1);
+	virtual ~AmbientOcclusionVolume();
+
+	/** @brief average blocks of factor^3 voxels on the thread pool, the occlusion is zero until updateOcclusion() */
+	template<class T>
+	void build(const VolumeDataView<T>& volume);
+	template<class T>
+	inline void build(const VolumeData<T>& volume) { build(VolumeDataView<T>(volume)); }
+
+	/**
+	 * @brief classify the reduced volume and filter the opacity on the thread pool. Nothing is done if neither the
+	 *        transfer function texture nor the windowing changed since the last call
+	 * @param rgba texels of the transfer function over [0, 1] after windowing, 4 floats each
+	 * @return true if the occlusion was recomputed
+	 */
+	bool updateOcclusion(const std::vector<float>& rgba, float windowingMinVal, float windowingRange);
+	bool updateOcclusion(const TransferFunction& transferFunction, float windowingMinVal, float windowingRange);
+
+	void upload(); //!< (re)create and fill the occlusion texture, GL_R8 with linear filtering
+	void release(); //!< delete the texture
+
+	inline GLuint getTexture() const { return m_texture; }
+	inline unsigned int getFactor() const { return m_factor; }
+	inline unsigned int getRadius() const { return m_radius; }
+	inline const std::vector<unsigned char>& getOcclusion() const { return m_occlusion; }
+};
+
+////// IMPLEMENTATION
+template<class T>
+void AmbientOcclusionVolume::build(const VolumeDataView<T>& volume)
+{
+	VolumeReduction::averageBlocks(volume, m_factor, m_values, m_size);
+	m_occlusion.assign(m_values.size(), 0);
+	m_rgba.clear();
+	std::vector<float>().swap(m_opacity);
+	std::vector<float>().swap(m_filtered);
+	std::vector<float>().swap(m_scratch);
+}
+
+#endif
@@ -120,6 +120,7 @@ ChunkedAdaptiveRenderPass::ChunkedAdaptiveRenderPass(RenderPass* pRenderPass, gl
 	m_renderTimeBias(bias),
 	m_targetRenderTime(targetRenderTime),
 	m_autoAdjustRenderTime(false),
+	m_lastPredictedRenderTime(0.0f),
 	m_numChunksBuffer(16),
 	m_currentIterationIdx(0),
 	m_bPrintDebug(true)
@@ -133,14 +134,20 @@ void ChunkedAdaptiveRenderPass::render()
 	//++++++ Predict number of iterations +++++++++++++++
 	int numChunksToRender = 0;
 	float predictedIterationRenderTime = 0.0f;
+	m_lastPredictedRenderTime = 0.0f;
 	for (int i = m_currentChunkIdx; i < m_queryBuffer.size(); i++)
 	{
 		predictedIterationRenderTime += predictChunkRenderTime(i);
 		if ( predictedIterationRenderTime<= m_targetRenderTime )
 		{
 			numChunksToRender++; // good to go
+			m_lastPredictedRenderTime = predictedIterationRenderTime;
 		}
 	}
+	if (numChunksToRender == 0 && m_currentChunkIdx < m_queryBuffer.size())
+	{
+		m_lastPredictedRenderTime = predictChunkRenderTime(m_currentChunkIdx); // over budget anyway
+	}
 	numChunksToRender = std::max( numChunksToRender, 1); // minimum 1 chunk
 
 	m_numChunksBuffer[ m_currentIterationIdx ]=(float) numChunksToRender;
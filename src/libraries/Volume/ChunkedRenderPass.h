@@ -5,6 +5,8 @@
 #include <Rendering/RenderPass.h>
 #include <Core/Timer.h>
 
+#include <algorithm>
+
 class ChunkedRenderPass {
 private:
 	std::vector<GLenum> m_clearBitsTmp;
@@ -57,6 +59,7 @@ protected:
 	float m_targetRenderTime;
 	float m_renderTimeBias;
 	bool m_autoAdjustRenderTime;
+	float m_lastPredictedRenderTime; // predicted time of the chunks rendered in the last call to render()
 
 	//++ for profiling ++//
 	std::vector< float >m_numChunksBuffer; 
@@ -102,6 +105,7 @@ public:
 	inline float& getLastTotalRenderTime() {return m_lastTotalRenderTime;}
 	inline int& getLastNumFramesElapsed() { return m_lastNumFramesElapsed; }
 	inline float& getLastFinishTime() { return m_lastTotalFinishTime;} 
+	inline float getLastSlackTime() { return std::max(0.0f, m_targetRenderTime - m_lastPredictedRenderTime); } //!< time (ms) left in the target render time by the last call to render(), i.e. for background work
 	
 	//++ Setters ++//
 	inline void setRenderTimeBias(float renderTimeBias) {m_renderTimeBias = renderTimeBias;}
@@ -0,0 +1,248 @@
+#include "GradientVolume.h"
+
+#include <Core/SimdTools.h>
+#include <Rendering/OpenGLContext.h>
+
+namespace {
+
+// dst[i] += w * (a[i] - b[i])
+void accumulateDifference(float* dst, const float* a, const float* b, float w, size_t count)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	const __m256 vW = _mm256_set1_ps(w);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 d = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(d, vW)));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	const __m128 vW = _mm_set1_ps(w);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(d, vW)));
+	}
+#endif
+	for (; i < count; i++) { dst[i] += w * (a[i] - b[i]); }
+}
+
+// dst[i] += w * a[i]
+void accumulate(float* dst, const float* a, float w, size_t count)
+{
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	const __m256 vW = _mm256_set1_ps(w);
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(_mm256_loadu_ps(a + i), vW)));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	const __m128 vW = _mm_set1_ps(w);
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(a + i), vW)));
+	}
+#endif
+	for (; i < count; i++) { dst[i] += w * a[i]; }
+}
+
+// dst[i] = (w0 * src[i] + w1 * src[i + 1] + w2 * src[i + 2]) * scale, the stencil along x on a padded row
+void stencil(const float* src, float w0, float w1, float w2, float scale, size_t count, float* dst)
+{
+	w0 *= scale;
+	w1 *= scale;
+	w2 *= scale;
+	size_t i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	const __m256 vW0 = _mm256_set1_ps(w0), vW1 = _mm256_set1_ps(w1), vW2 = _mm256_set1_ps(w2);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 v = _mm256_mul_ps(_mm256_loadu_ps(src + i), vW0);
+		v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_loadu_ps(src + i + 1), vW1));
+		v = _mm256_add_ps(v, _mm256_mul_ps(_mm256_loadu_ps(src + i + 2), vW2));
+		_mm256_storeu_ps(dst + i, v);
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	const __m128 vW0 = _mm_set1_ps(w0), vW1 = _mm_set1_ps(w1), vW2 = _mm_set1_ps(w2);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), vW0);
+		v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(src + i + 1), vW1));
+		v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(src + i + 2), vW2));
+		_mm_storeu_ps(dst + i, v);
+	}
+#endif
+	for (; i < count; i++) { dst[i] = w0 * src[i] + w1 * src[i + 1] + w2 * src[i + 2]; }
+}
+
+inline signed char toSnorm(float v) //!< v in [-1, 1]
+{
+	return (signed char) std::floor(std::max(-1.0f, std::min(v, 1.0f)) * 127.0f + 0.5f);
+}
+
+} // namespace
+
+GradientVolume::GradientVolume()
+	: m_maxMagnitude(0.0f)
+	, m_texture(0)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		m_size[i] = 0;
+		m_textureSize[i] = 0;
+	}
+}
+
+GradientVolume::~GradientVolume()
+{
+	release();
+}
+
+void GradientVolume::computeRow(const float* const rows[3][3], unsigned int width, Operator op, const float* scale, float* gx, float* gy, float* gz, RowBuffers& buffers)
+{
+	const size_t padded = width + 2;
+	if (op != SOBEL)
+	{
+		stencil(rows[1][1], -1.0f, 0.0f, 1.0f, scale[0], width, gx);
+
+		buffers.diffY.assign(padded, 0.0f);
+		buffers.diffZ.assign(padded, 0.0f);
+		accumulateDifference(&buffers.diffY[0], rows[1][2], rows[1][0], 1.0f, padded);
+		accumulateDifference(&buffers.diffZ[0], rows[2][1], rows[0][1], 1.0f, padded);
+		stencil(&buffers.diffY[0], 0.0f, 1.0f, 0.0f, scale[1], width, gy);
+		stencil(&buffers.diffZ[0], 0.0f, 1.0f, 0.0f, scale[2], width, gz);
+		return;
+	}
+
+	// Sobel is separable: smooth the 3x3 rows perpendicular to each axis, then differentiate or smooth along x
+	static const float weights[3] = { 1.0f, 2.0f, 1.0f };
+	buffers.sum.assign(padded, 0.0f);
+	buffers.diffY.assign(padded, 0.0f);
+	buffers.diffZ.assign(padded, 0.0f);
+	for (int d = 0; d < 3; d++)
+	{
+		for (int e = 0; e < 3; e++) { accumulate(&buffers.sum[0], rows[d][e], weights[d] * weights[e], padded); }
+		accumulateDifference(&buffers.diffY[0], rows[d][2], rows[d][0], weights[d], padded);
+		accumulateDifference(&buffers.diffZ[0], rows[2][d], rows[0][d], weights[d], padded);
+	}
+	stencil(&buffers.sum[0], -1.0f, 0.0f, 1.0f, scale[0], width, gx);
+	stencil(&buffers.diffY[0], 1.0f, 2.0f, 1.0f, scale[1], width, gy);
+	stencil(&buffers.diffZ[0], 1.0f, 2.0f, 1.0f, scale[2], width, gz);
+}
+
+float GradientVolume::getMaxMagnitudeSquared(const float* gx, const float* gy, const float* gz, unsigned int count)
+{
+	float result = 0.0f;
+	unsigned int i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	__m256 vMax = _mm256_setzero_ps();
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(gx + i), y = _mm256_loadu_ps(gy + i), z = _mm256_loadu_ps(gz + i);
+		__m256 m = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+		vMax = _mm256_max_ps(vMax, m);
+	}
+	float lanes[8];
+	_mm256_storeu_ps(lanes, vMax);
+	for (int l = 0; l < 8; l++) { result = std::max(result, lanes[l]); }
+#elif defined(SIMDTOOLS_SSE2)
+	__m128 vMax = _mm_setzero_ps();
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(gx + i), y = _mm_loadu_ps(gy + i), z = _mm_loadu_ps(gz + i);
+		__m128 m = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+		vMax = _mm_max_ps(vMax, m);
+	}
+	float lanes[4];
+	_mm_storeu_ps(lanes, vMax);
+	for (int l = 0; l < 4; l++) { result = std::max(result, lanes[l]); }
+#endif
+	for (; i < count; i++) { result = std::max(result, gx[i] * gx[i] + gy[i] * gy[i] + gz[i] * gz[i]); }
+	return result;
+}
+
+void GradientVolume::packRow(const float* gx, const float* gy, const float* gz, unsigned int count, float magnitudeScale, signed char* dst)
+{
+	unsigned int i = 0;
+#if defined(SIMDTOOLS_SSE2)
+	// four voxels at a time: transposed to x, y, z, magnitude per voxel, then saturated down to bytes
+	const __m128 vZero = _mm_setzero_ps();
+	const __m128 vSnorm = _mm_set1_ps(127.0f);
+	const __m128 vMagnitudeScale = _mm_set1_ps(magnitudeScale * 127.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(gx + i), y = _mm_loadu_ps(gy + i), z = _mm_loadu_ps(gz + i);
+		__m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+		__m128 inverse = _mm_and_ps(_mm_div_ps(vSnorm, magnitude), _mm_cmpgt_ps(magnitude, vZero));
+		x = _mm_mul_ps(x, inverse);
+		y = _mm_mul_ps(y, inverse);
+		z = _mm_mul_ps(z, inverse);
+		__m128 a = _mm_min_ps(_mm_mul_ps(magnitude, vMagnitudeScale), vSnorm);
+		_MM_TRANSPOSE4_PS(x, y, z, a);
+
+		// rounds to nearest, the magnitude of the direction never exceeds 127
+		__m128i lo = _mm_packs_epi32(_mm_cvtps_epi32(x), _mm_cvtps_epi32(y));
+		__m128i hi = _mm_packs_epi32(_mm_cvtps_epi32(z), _mm_cvtps_epi32(a));
+		_mm_storeu_si128((__m128i*) (dst + 4 * i), _mm_packs_epi16(lo, hi));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float magnitude = std::sqrt(gx[i] * gx[i] + gy[i] * gy[i] + gz[i] * gz[i]);
+		float inverse = (magnitude > 0.0f) ? 1.0f / magnitude : 0.0f;
+		dst[4 * i]     = toSnorm(gx[i] * inverse);
+		dst[4 * i + 1] = toSnorm(gy[i] * inverse);
+		dst[4 * i + 2] = toSnorm(gz[i] * inverse);
+		dst[4 * i + 3] = toSnorm(magnitude * magnitudeScale);
+	}
+}
+
+void GradientVolume::rescaleMagnitudes(signed char* packed, unsigned int count, float scale)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		packed[4 * i + 3] = (signed char) std::floor((float) packed[4 * i + 3] * scale + 0.5f);
+	}
+}
+
+void GradientVolume::upload()
+{
+	if (m_data.empty())
+	{
+		return;
+	}
+
+	if (m_texture == 0 || m_textureSize[0] != m_size[0] || m_textureSize[1] != m_size[1] || m_textureSize[2] != m_size[2])
+	{
+		release();
+		glGenTextures(1, &m_texture);
+		OPENGLCONTEXT->bindTexture(m_texture, GL_TEXTURE_3D);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexStorage3D(GL_TEXTURE_3D, 1, GL_RGBA8_SNORM, m_size[0], m_size[1], m_size[2]);
+		for (int i = 0; i < 3; i++) { m_textureSize[i] = m_size[i]; }
+	}
+
+	OPENGLCONTEXT->bindTexture(m_texture, GL_TEXTURE_3D);
+	glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, m_size[0], m_size[1], m_size[2], GL_RGBA, GL_BYTE, &m_data[0]);
+	OPENGLCONTEXT->bindTexture(0, GL_TEXTURE_3D);
+}
+
+void GradientVolume::release()
+{
+	if (m_texture != 0)
+	{
+		glDeleteTextures(1, &m_texture);
+	}
+	m_texture = 0;
+	for (int i = 0; i < 3; i++) { m_textureSize[i] = 0; }
+}
+
+void GradientVolume::clearData()
+{
+	std::vector<signed char>().swap(m_data);
+}
@@ -0,0 +1,157 @@
+#ifndef VOLUME_GRADIENTVOLUME_H_
+#define VOLUME_GRADIENTVOLUME_H_
+
+#include <GL/glew.h>
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#include <Core/ThreadPool.h>
+#include <Core/VolumeData.h>
+
+/**
+ * @brief precomputed gradients of a volume, packed per voxel as normalized direction and relative magnitude (RGBA8 snorm).
+ *        The raycaster (GRADIENT_SHADING) fetches it once per sample instead of taking neighbourhood samples.
+ *        Gradients are taken on the thread pool one row at a time, the stencil and packing are vectorized.
+ *        Borders are clamped like the volume texture, anisotropic voxels (real_size_*) are taken into account.
+ */
+class GradientVolume
+{
+public:
+	enum Operator {
+		CENTRAL_DIFFERENCES, //!< 6 neighbours
+		SOBEL                //!< 3x3x3 neighbourhood, smoothed perpendicular to each axis, less noisy
+	};
+
+protected:
+	unsigned int m_size[3];
+	std::vector<signed char> m_data; //!< x, y, z of the unit gradient and magnitude / max magnitude, times 127
+	float m_maxMagnitude; //!< in values per (smallest) voxel spacing
+
+	GLuint m_texture;
+	unsigned int m_textureSize[3];
+
+	struct RowBuffers; //!< per task scratch rows
+
+	/** @brief gradient of a row from its (edge padded) source rows rows[dz + 1][dy + 1], scaled per axis */
+	static void computeRow(const float* const rows[3][3], unsigned int width, Operator op, const float* scale, float* gx, float* gy, float* gz, RowBuffers& buffers);
+	static float getMaxMagnitudeSquared(const float* gx, const float* gy, const float* gz, unsigned int count);
+	static void packRow(const float* gx, const float* gy, const float* gz, unsigned int count, float magnitudeScale, signed char* dst);
+	static void rescaleMagnitudes(signed char* packed, unsigned int count, float scale); //!< alpha of count packed voxels
+
+	/** @brief visit every row of the volume in parallel with its gradient, func(row, gx, gy, gz) */
+	template<class T, class Func>
+	void forEachRow(const VolumeDataView<T>& volume, Operator op, Func func);
+
+public:
+	GradientVolume();
+	virtual ~GradientVolume();
+
+	/** @brief compute and pack the gradients of every voxel on the thread pool */
+	template<class T>
+	void build(const VolumeDataView<T>& volume, Operator op = CENTRAL_DIFFERENCES);
+	template<class T>
+	inline void build(const VolumeData<T>& volume, Operator op = CENTRAL_DIFFERENCES) { build(VolumeDataView<T>(volume), op); }
+
+	void upload(); //!< (re)create and fill the gradient texture, GL_RGBA8_SNORM with linear filtering
+	void release(); //!< delete the texture
+	void clearData(); //!< free the packed gradients in main memory, i.e. after upload()
+
+	inline GLuint getTexture() const { return m_texture; }
+	inline float getMaxMagnitude() const { return m_maxMagnitude; } //!< magnitude of alpha 1 in the texture
+	inline const std::vector<signed char>& getData() const { return m_data; }
+};
+
+struct GradientVolume::RowBuffers
+{
+	std::vector<float> rows[3][3]; //!< source rows around the current one, padded by an edge voxel on both sides
+	std::vector<float> sum, diffY, diffZ; //!< rows combined before the stencil along x
+	std::vector<float> gx, gy, gz;
+};
+
+////// IMPLEMENTATION
+template<class T, class Func>
+void GradientVolume::forEachRow(const VolumeDataView<T>& volume, Operator op, Func func)
+{
+	const unsigned int sx = volume.size_x, sy = volume.size_y, sz = volume.size_z;
+
+	// gradients per spacing of the smallest voxel edge, halved for central differences, Sobel weights sum up to 16
+	float spacing[3] = { volume.real_size_x, volume.real_size_y, volume.real_size_z };
+	float smallest = std::min(spacing[0], std::min(spacing[1], spacing[2]));
+	float scale[3];
+	for (int i = 0; i < 3; i++)
+	{
+		float relative = (smallest > 0.0f) ? spacing[i] / smallest : 1.0f;
+		scale[i] = ((op == SOBEL) ? 1.0f / 32.0f : 0.5f) / relative;
+	}
+
+	THREADPOOL->parallelFor(0, (size_t) sy * sz, [&](size_t begin, size_t end)
+	{
+		RowBuffers buffers;
+		for (int dz = 0; dz < 3; dz++) { for (int dy = 0; dy < 3; dy++) { buffers.rows[dz][dy].resize(sx + 2); } }
+		buffers.gx.resize(sx);
+		buffers.gy.resize(sx);
+		buffers.gz.resize(sx);
+
+		const float* rows[3][3];
+		for (size_t row = begin; row < end; row++)
+		{
+			const unsigned int y = (unsigned int) (row % sy), z = (unsigned int) (row / sy);
+			for (int dz = 0; dz < 3; dz++) { for (int dy = 0; dy < 3; dy++)
+			{
+				// central differences only need the cross around the row
+				rows[dz][dy] = nullptr;
+				if (op != SOBEL && dz != 1 && dy != 1) { continue; }
+
+				unsigned int ny = (unsigned int) std::min<int>(std::max<int>((int) y + dy - 1, 0), (int) sy - 1);
+				unsigned int nz = (unsigned int) std::min<int>(std::max<int>((int) z + dz - 1, 0), (int) sz - 1);
+				const T* src = &volume.data[((size_t) nz * sy + ny) * sx];
+				float* dst = &buffers.rows[dz][dy][0];
+				for (unsigned int x = 0; x < sx; x++) { dst[x + 1] = (float) src[x]; }
+				dst[0] = dst[1];
+				dst[sx + 1] = dst[sx];
+				rows[dz][dy] = dst;
+			}}
+
+			computeRow(rows, sx, op, scale, &buffers.gx[0], &buffers.gy[0], &buffers.gz[0], buffers);
+			func(row, &buffers.gx[0], &buffers.gy[0], &buffers.gz[0]);
+		}
+	}, 8);
+}
+
+template<class T>
+void GradientVolume::build(const VolumeDataView<T>& volume, Operator op)
+{
+	m_size[0] = volume.size_x;
+	m_size[1] = volume.size_y;
+	m_size[2] = volume.size_z;
+	m_maxMagnitude = 0.0f;
+	m_data.clear();
+	if (volume.data == nullptr || volume.getNumVoxels() == 0)
+	{
+		return;
+	}
+
+	// rows are packed relative to their own largest magnitude, then rescaled to the largest one of the volume, so the gradients are
+	// only computed once without holding them as floats. This adds at most one step of rounding error to the magnitude
+	std::vector<float> rowMax((size_t) m_size[1] * m_size[2], 0.0f);
+	m_data.resize(4 * volume.getNumVoxels());
+	forEachRow(volume, op, [&](size_t row, const float* gx, const float* gy, const float* gz)
+	{
+		rowMax[row] = std::sqrt(getMaxMagnitudeSquared(gx, gy, gz, m_size[0]));
+		packRow(gx, gy, gz, m_size[0], (rowMax[row] > 0.0f) ? 1.0f / rowMax[row] : 0.0f, &m_data[4 * row * m_size[0]]);
+	});
+	m_maxMagnitude = *std::max_element(rowMax.begin(), rowMax.end());
+
+	THREADPOOL->parallelFor(0, rowMax.size(), [&](size_t begin, size_t end)
+	{
+		for (size_t row = begin; row < end; row++)
+		{
+			if (rowMax[row] == m_maxMagnitude) { continue; }
+			rescaleMagnitudes(&m_data[4 * row * m_size[0]], m_size[0], rowMax[row] / m_maxMagnitude);
+		}
+	}, 64);
+}
+
+#endif
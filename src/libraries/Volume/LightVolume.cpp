@@ -0,0 +1,250 @@
+#include "LightVolume.h"
+
+#include <cmath>
+#include <algorithm>
+
+#include <Core/DebugLog.h>
+#include <Core/ThreadPool.h>
+#include <Rendering/OpenGLContext.h>
+#include <Rendering/ShaderProgram.h>
+
+#include "TransferFunction.h"
+
+LightVolume::LightVolume(unsigned int factor)
+	: m_factor(std::max(1u, factor))
+	, m_windowingMinVal(0.0f)
+	, m_windowingRange(0.0f)
+	, m_lightDirection(0.0f)
+	, m_alphaScale(0.0f)
+	, m_valid(false)
+	, m_texture(0)
+	, m_computeShader(nullptr)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		m_size[i] = 0;
+		m_textureSize[i] = 0;
+	}
+}
+
+LightVolume::~LightVolume()
+{
+	release();
+}
+
+bool LightVolume::setInputs(const std::vector<float>& rgba, float windowingMinVal, float windowingRange, glm::vec3 lightDirection, float alphaScale, bool& transferFunctionChanged)
+{
+	transferFunctionChanged = !m_valid || rgba != m_rgba || windowingMinVal != m_windowingMinVal || windowingRange != m_windowingRange;
+	if (!transferFunctionChanged && lightDirection == m_lightDirection && alphaScale == m_alphaScale)
+	{
+		return false;
+	}
+	m_rgba = rgba;
+	m_windowingMinVal = windowingMinVal;
+	m_windowingRange = windowingRange;
+	m_lightDirection = lightDirection;
+	m_alphaScale = alphaScale;
+	m_valid = false; // until the sweep is done
+	return true;
+}
+
+void LightVolume::getSweep(glm::vec3 lightDirection, int& axis, int& first, int& sliceStep, glm::vec2& offset, float& stepLength) const
+{
+	// light direction in light voxels
+	glm::vec3 direction = lightDirection * glm::vec3(m_size[0], m_size[1], m_size[2]);
+	axis = 2;
+	if (std::abs(direction.x) > std::abs(direction[axis])) { axis = 0; }
+	if (std::abs(direction.y) > std::abs(direction[axis])) { axis = 1; }
+	if (direction[axis] == 0.0f) { direction[axis] = 1.0f; } // no direction, light from above
+
+	sliceStep = (direction[axis] > 0.0f) ? -1 : 1;
+	first = (direction[axis] > 0.0f) ? (int) m_size[axis] - 1 : 0;
+
+	// one slice towards the light
+	glm::vec3 step = direction / std::abs(direction[axis]);
+	offset = glm::vec2(step[(axis + 1) % 3], step[(axis + 2) % 3]);
+	stepLength = glm::length(step / glm::vec3(m_size[0], m_size[1], m_size[2]));
+}
+
+bool LightVolume::update(const TransferFunction& transferFunction, float windowingMinVal, float windowingRange, glm::vec3 lightDirection, float alphaScale)
+{
+	return update(transferFunction.getTexData(), windowingMinVal, windowingRange, lightDirection, alphaScale);
+}
+
+bool LightVolume::update(const std::vector<float>& rgba, float windowingMinVal, float windowingRange, glm::vec3 lightDirection, float alphaScale)
+{
+	const int numTexels = (int) rgba.size() / 4;
+	const size_t count = m_values.size();
+	bool transferFunctionChanged = false;
+	if (numTexels == 0 || count == 0 || !setInputs(rgba, windowingMinVal, windowingRange, lightDirection, alphaScale, transferFunctionChanged))
+	{
+		return false;
+	}
+
+	// alpha of every light voxel, filtered like the transfer function texture
+	if (transferFunctionChanged || m_opacity.size() != count)
+	{
+		const float range = (std::abs(windowingRange) > 0.0f) ? windowingRange : 1e-20f;
+		const float texelScale = (float) numTexels / range;
+		const float texelOffset = -windowingMinVal * texelScale - 0.5f;
+		m_opacity.resize(count);
+		THREADPOOL->parallelFor(0, count, [&](size_t begin, size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				float texel = std::max(0.0f, std::min(m_values[i] * texelScale + texelOffset, (float) (numTexels - 1)));
+				int lower = (int) texel;
+				int upper = std::min(lower + 1, numTexels - 1);
+				float t = texel - (float) lower;
+				m_opacity[i] = rgba[4 * lower + 3] + t * (rgba[4 * upper + 3] - rgba[4 * lower + 3]);
+			}
+		}, 1 << 16);
+	}
+
+	int axis, first, sliceStep;
+	glm::vec2 offset;
+	float stepLength;
+	getSweep(lightDirection, axis, first, sliceStep, offset, stepLength);
+	const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+	const int nu = (int) m_size[u], nv = (int) m_size[v], n = (int) m_size[axis];
+	const size_t stride[3] = { 1, (size_t) m_size[0], (size_t) m_size[0] * m_size[1] };
+	const float stepOpacity = alphaScale * stepLength;
+	const int ox = (int) std::floor(offset.x), oy = (int) std::floor(offset.y);
+	const float fx = offset.x - (float) ox, fy = offset.y - (float) oy;
+
+	// light leaving every voxel of the previous slice: what reached it, attenuated by the voxel itself. Outside the volume it is 1
+	std::vector<float> previous((size_t) nu * nv), current((size_t) nu * nv);
+	m_shadow.resize(count);
+	for (int k = 0; k < n; k++)
+	{
+		const size_t slice = (size_t) (first + k * sliceStep) * stride[axis];
+		THREADPOOL->parallelFor(0, (size_t) nv, [&](size_t begin, size_t end)
+		{
+			auto leaving = [&](int i, int j) { return (i < 0 || j < 0 || i >= nu || j >= nv) ? 1.0f : previous[(size_t) j * nu + i]; };
+			for (int j = (int) begin; j < (int) end; j++) { for (int i = 0; i < nu; i++)
+			{
+				float transmittance = 1.0f;
+				if (k > 0)
+				{
+					float bottom = leaving(i + ox, j + oy) + fx * (leaving(i + ox + 1, j + oy) - leaving(i + ox, j + oy));
+					float top = leaving(i + ox, j + oy + 1) + fx * (leaving(i + ox + 1, j + oy + 1) - leaving(i + ox, j + oy + 1));
+					transmittance = bottom + fy * (top - bottom);
+				}
+				size_t voxel = slice + i * stride[u] + j * stride[v];
+				m_shadow[voxel] = 1.0f - transmittance;
+				current[(size_t) j * nu + i] = transmittance * (1.0f - std::min(1.0f, m_opacity[voxel] * stepOpacity));
+			}}
+		}, 4);
+		previous.swap(current);
+	}
+
+	m_valid = true;
+	return true;
+}
+
+bool LightVolume::updateOnGpu(GLuint volumeTexture, TransferFunction& transferFunction, float windowingMinVal, float windowingRange, glm::vec3 lightDirection, float alphaScale)
+{
+	if (m_values.empty())
+	{
+		DEBUGLOG->log("ERROR: light volume has no size, call build() first");
+		return false;
+	}
+	bool transferFunctionChanged = false;
+	if (!setInputs(transferFunction.getTexData(), windowingMinVal, windowingRange, lightDirection, alphaScale, transferFunctionChanged))
+	{
+		return false;
+	}
+
+	allocateTexture();
+	if (m_computeShader == nullptr)
+	{
+		m_computeShader = new ShaderProgram("/compute/light_volume.glsl");
+	}
+
+	int axis, first, sliceStep;
+	glm::vec2 offset;
+	float stepLength;
+	getSweep(lightDirection, axis, first, sliceStep, offset, stepLength);
+
+	OPENGLCONTEXT->bindTextureToUnit(volumeTexture, GL_TEXTURE0 + TEXTURE_UNIT_VOLUME, GL_TEXTURE_3D);
+	OPENGLCONTEXT->bindTextureToUnit(transferFunction.getTextureHandle(), GL_TEXTURE0 + TEXTURE_UNIT_TRANSFER_FUNCTION, GL_TEXTURE_1D);
+	OPENGLCONTEXT->bindImageTextureToUnit(m_texture, IMAGE_UNIT_LIGHT, GL_R16F, GL_READ_WRITE, 0, GL_TRUE);
+
+	m_computeShader->update("volume_texture", TEXTURE_UNIT_VOLUME);
+	m_computeShader->update("transferFunctionTex", TEXTURE_UNIT_TRANSFER_FUNCTION);
+	m_computeShader->update("uWindowingMinVal", windowingMinVal);
+	m_computeShader->update("uWindowingRange", windowingRange);
+	m_computeShader->update("uAxis", axis);
+	m_computeShader->update("uOffset", offset);
+	m_computeShader->update("uStepOpacity", alphaScale * stepLength);
+	m_computeShader->use();
+
+	// one dispatch per slice, every slice reads the previous one
+	const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+	const glm::ivec3 localSize(16, 16, 1); // LOCAL_SIZE_X, LOCAL_SIZE_Y of the shader
+	for (int k = 0; k < (int) m_size[axis]; k++)
+	{
+		int slice = first + k * sliceStep;
+		m_computeShader->update("uSlice", slice);
+		m_computeShader->update("uPreviousSlice", (k > 0) ? slice - sliceStep : -1);
+		glDispatchCompute((m_size[u] + localSize.x - 1) / localSize.x, (m_size[v] + localSize.y - 1) / localSize.y, 1);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+	m_valid = true;
+	return true;
+}
+
+void LightVolume::loadShader(std::string shadersPath)
+{
+	delete m_computeShader;
+	m_computeShader = new ShaderProgram("/compute/light_volume.glsl", std::vector<std::string>(), shadersPath);
+}
+
+void LightVolume::allocateTexture()
+{
+	if (m_texture != 0 && m_textureSize[0] == m_size[0] && m_textureSize[1] == m_size[1] && m_textureSize[2] == m_size[2])
+	{
+		return;
+	}
+
+	if (m_texture != 0) { glDeleteTextures(1, &m_texture); }
+	glGenTextures(1, &m_texture);
+	OPENGLCONTEXT->bindTexture(m_texture, GL_TEXTURE_3D);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glTexStorage3D(GL_TEXTURE_3D, 1, GL_R16F, m_size[0], m_size[1], m_size[2]);
+	OPENGLCONTEXT->bindTexture(0, GL_TEXTURE_3D);
+	for (int i = 0; i < 3; i++) { m_textureSize[i] = m_size[i]; }
+}
+
+void LightVolume::upload()
+{
+	if (m_shadow.empty() || m_shadow.size() != m_values.size())
+	{
+		return;
+	}
+
+	allocateTexture();
+	OPENGLCONTEXT->bindTexture(m_texture, GL_TEXTURE_3D);
+	glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, m_size[0], m_size[1], m_size[2], GL_RED, GL_FLOAT, &m_shadow[0]);
+	OPENGLCONTEXT->bindTexture(0, GL_TEXTURE_3D);
+}
+
+void LightVolume::release()
+{
+	if (m_texture != 0)
+	{
+		glDeleteTextures(1, &m_texture);
+	}
+	m_texture = 0;
+	for (int i = 0; i < 3; i++) { m_textureSize[i] = 0; }
+
+	delete m_computeShader;
+	m_computeShader = nullptr;
+	m_valid = false;
+}
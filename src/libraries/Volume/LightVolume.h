@@ -0,0 +1,118 @@
+#ifndef VOLUME_LIGHTVOLUME_H_
+#define VOLUME_LIGHTVOLUME_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <string>
+
+#include <Core/VolumeData.h>
+
+#include "VolumeReduction.h"
+
+class TransferFunction;
+class ShaderProgram;
+
+/**
+ * @brief opacity accumulated towards a directional light, at reduced resolution. Computed by sweeping the slices perpendicular
+ *        to the main axis of the light direction, starting at the face closest to the light: every voxel attenuates the light
+ *        reaching its neighbourhood in the next slice (bilinear), so one slice only depends on the previous one.
+ *        The raycaster (SHADOW_SAMPLING with SHADOW_VOLUME) fetches it once per sample instead of marching towards the light.
+ *        update() is the multi-threaded CPU reference, updateOnGpu() sweeps with compute/light_volume.glsl.
+ *        Both only do work if the light direction, windowing or transfer function changed, and reclassify only in the latter case.
+ */
+class LightVolume
+{
+public:
+	static const int TEXTURE_UNIT_VOLUME = 32;               //!< used by updateOnGpu(), beyond GL_TEXTURE31 so the units of the raycasters stay bound
+	static const int TEXTURE_UNIT_TRANSFER_FUNCTION = 33;    //!< used by updateOnGpu()
+	static const int IMAGE_UNIT_LIGHT = 7;                   //!< used by updateOnGpu(), see compute/light_volume.glsl
+
+protected:
+	unsigned int m_factor; //!< voxels per light voxel edge
+	unsigned int m_size[3];
+	std::vector<float> m_values;  //!< mean value per block of voxels, x-fastest
+	std::vector<float> m_opacity; //!< transfer function alpha per light voxel, kept while only the light moves
+	std::vector<float> m_shadow;  //!< opacity between each light voxel and the light, CPU path only
+
+	// what the light volume was computed for
+	std::vector<float> m_rgba;
+	float m_windowingMinVal;
+	float m_windowingRange;
+	glm::vec3 m_lightDirection;
+	float m_alphaScale;
+	bool m_valid;
+
+	GLuint m_texture;
+	unsigned int m_textureSize[3];
+	ShaderProgram* m_computeShader;
+
+	/** @brief remember the inputs, returns false if they are the ones the volume was computed for. Sets transferFunctionChanged */
+	bool setInputs(const std::vector<float>& rgba, float windowingMinVal, float windowingRange, glm::vec3 lightDirection, float alphaScale, bool& transferFunctionChanged);
+
+	/**
+	 * @brief sweep geometry for a light direction
+	 * @param axis main axis, slices are perpendicular to it
+	 * @param first slice closest to the light
+	 * @param sliceStep +1 or -1, away from the light
+	 * @param offset position of the point towards the light in the previous slice, relative, along (axis + 1) % 3 and (axis + 2) % 3
+	 * @param stepLength distance between a point and its predecessor, in texture space
+	 */
+	void getSweep(glm::vec3 lightDirection, int& axis, int& first, int& sliceStep, glm::vec2& offset, float& stepLength) const;
+
+	void allocateTexture(); //!< (re)create the texture, GL_R16F with linear filtering
+
+public:
+	/** @param factor (optional) voxels per light voxel edge */
+	LightVolume(unsigned int factor = 2);
+	virtual ~LightVolume();
+
+	/** @brief average blocks of factor^3 voxels on the thread pool for the CPU path and set the size of the light volume */
+	template<class T>
+	void build(const VolumeDataView<T>& volume);
+	template<class T>
+	inline void build(const VolumeData<T>& volume) { build(VolumeDataView<T>(volume)); }
+
+	/**
+	 * @brief CPU reference: classify the reduced volume and sweep the slices on the thread pool
+	 * @param rgba texels of the transfer function over [0, 1] after windowing, 4 floats each
+	 * @param lightDirection towards the light, in texture space like uShadowRayDirection
+	 * @param alphaScale (optional) opacity per unit length in texture space of alpha 1, ALPHA_SCALE of the raycaster
+	 * @return true if the light volume was recomputed
+	 */
+	bool update(const std::vector<float>& rgba, float windowingMinVal, float windowingRange, glm::vec3 lightDirection, float alphaScale = 20.0f);
+	bool update(const TransferFunction& transferFunction, float windowingMinVal, float windowingRange, glm::vec3 lightDirection, float alphaScale = 20.0f);
+
+	/**
+	 * @brief compute path: sweep the slices into the texture, one dispatch per slice. Samples volumeTexture at the center of every
+	 *        light voxel (the block mean for factor 2). Binds the textures to TEXTURE_UNIT_VOLUME, TEXTURE_UNIT_TRANSFER_FUNCTION
+	 *        and the light volume to IMAGE_UNIT_LIGHT. Only build() needs to be called before, with any volume of the same size
+	 * @return true if the light volume was recomputed
+	 */
+	bool updateOnGpu(GLuint volumeTexture, TransferFunction& transferFunction, float windowingMinVal, float windowingRange, glm::vec3 lightDirection, float alphaScale = 20.0f);
+
+	/** @brief (re)compile compute/light_volume.glsl from shadersPath, otherwise updateOnGpu() compiles it from SHADERS_PATH on first use */
+	void loadShader(std::string shadersPath);
+
+	void upload(); //!< (re)create and fill the texture from the CPU path
+	void release(); //!< delete the texture and compute shader
+
+	inline GLuint getTexture() const { return m_texture; }
+	inline unsigned int getFactor() const { return m_factor; }
+	inline glm::ivec3 getSize() const { return glm::ivec3(m_size[0], m_size[1], m_size[2]); }
+	inline const std::vector<float>& getShadow() const { return m_shadow; }
+};
+
+////// IMPLEMENTATION
+template<class T>
+void LightVolume::build(const VolumeDataView<T>& volume)
+{
+	VolumeReduction::averageBlocks(volume, m_factor, m_values, m_size);
+	m_opacity.clear();
+	m_shadow.assign(m_values.size(), 0.0f);
+	m_rgba.clear();
+	m_valid = false;
+}
+
+#endif
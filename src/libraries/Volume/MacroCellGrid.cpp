@@ -0,0 +1,222 @@
+#include "MacroCellGrid.h"
+
+#include <cmath>
+
+#include <Rendering/OpenGLContext.h>
+
+#include "TransferFunction.h"
+
+namespace {
+
+// h[i] = min over j of max(|i - j|, g[j]), one line of the separable Chebyshev distance transform. g must not exceed limit + 1.
+// h[i] <= k iff some g[j] <= k with |i - j| <= k; h changes by at most 1 between neighbours, so with window minima from
+// a sparse table every h[i] takes at most three tests. table holds n * (log2(n) + 1) entries
+void chebyshevLine(const unsigned char* g, int n, int limit, unsigned char* h, std::vector<unsigned char>& table)
+{
+	int levels = 1;
+	while ((1 << levels) <= n) { levels++; }
+	table.resize((size_t) levels * n);
+	std::copy(g, g + n, table.begin());
+	for (int l = 1; l < levels; l++)
+	{
+		const unsigned char* previous = &table[(size_t) (l - 1) * n];
+		unsigned char* current = &table[(size_t) l * n];
+		for (int i = 0; i + (1 << l) <= n; i++) { current[i] = std::min(previous[i], previous[i + (1 << (l - 1))]); }
+	}
+	auto windowMin = [&](int first, int last)
+	{
+		first = std::max(first, 0);
+		last = std::min(last, n - 1);
+		int l = 0;
+		while ((2 << l) <= last - first + 1) { l++; }
+		const unsigned char* level = &table[(size_t) l * n];
+		return std::min(level[first], level[last - (1 << l) + 1]);
+	};
+
+	int k = 0;
+	for (int i = 0; i < n; i++)
+	{
+		k = std::max(k - 1, 0);
+		while (k <= limit && windowMin(i - k, i + k) > k) { k++; }
+		h[i] = (unsigned char) k;
+	}
+}
+
+} // namespace
+
+MacroCellGrid::MacroCellGrid(unsigned int cellSize)
+	: m_cellSize(std::max(1u, cellSize))
+	, m_maxDistance(0)
+	, m_texture(0)
+	, m_distanceTexture(0)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		m_volumeSize[i] = 0;
+		m_gridSize[i] = 0;
+		m_textureSize[i] = 0;
+		m_distanceTextureSize[i] = 0;
+	}
+}
+
+MacroCellGrid::~MacroCellGrid()
+{
+	release();
+}
+
+size_t MacroCellGrid::updateVisibility(const TransferFunction& transferFunction, float windowingMinVal, float windowingRange, bool dilate)
+{
+	return updateVisibility(transferFunction.getTexData(), windowingMinVal, windowingRange, dilate);
+}
+
+size_t MacroCellGrid::updateVisibility(const std::vector<float>& rgba, float windowingMinVal, float windowingRange, bool dilate)
+{
+	const int numTexels = (int) rgba.size() / 4;
+	const size_t numCells = m_visible.size();
+	if (numTexels == 0 || numCells == 0)
+	{
+		return numCells;
+	}
+
+	// number of texels with non-zero alpha before each texel, so any range of texels is checked in constant time
+	std::vector<int> opaque(numTexels + 1, 0);
+	for (int i = 0; i < numTexels; i++)
+	{
+		opaque[i + 1] = opaque[i] + ((rgba[4 * i + 3] > 0.0f) ? 1 : 0);
+	}
+
+	const float range = (std::abs(windowingRange) > 0.0f) ? windowingRange : 1e-20f;
+	std::vector<unsigned char> visible(numCells);
+	THREADPOOL->parallelFor(0, numCells, [&](size_t begin, size_t end)
+	{
+		for (size_t cell = begin; cell < end; cell++)
+		{
+			// widened by the precision of half float volume textures
+			float cellMin = m_cells[2 * cell] - std::abs(m_cells[2 * cell]) / 1024.0f;
+			float cellMax = m_cells[2 * cell + 1] + std::abs(m_cells[2 * cell + 1]) / 1024.0f;
+			float relMin = (cellMin - windowingMinVal) / range;
+			float relMax = (cellMax - windowingMinVal) / range;
+			if (relMin > relMax) { std::swap(relMin, relMax); }
+			relMin = std::max(0.0f, std::min(relMin, 1.0f));
+			relMax = std::max(0.0f, std::min(relMax, 1.0f));
+
+			// linear filtering reads the two texels around rel * numTexels - 0.5
+			int first = std::max(0, std::min((int) std::floor(relMin * numTexels - 0.5f), numTexels - 1));
+			int last = std::max(0, std::min((int) std::floor(relMax * numTexels - 0.5f) + 1, numTexels - 1));
+			visible[cell] = (opaque[last + 1] - opaque[first] > 0) ? 255 : 0;
+		}
+	}, 4096);
+
+	if (dilate)
+	{
+		const int gx = (int) m_gridSize[0], gy = (int) m_gridSize[1], gz = (int) m_gridSize[2];
+		THREADPOOL->parallelFor(0, gz, [&](size_t begin, size_t end)
+		{
+			for (int z = (int) begin; z < (int) end; z++) { for (int y = 0; y < gy; y++) { for (int x = 0; x < gx; x++)
+			{
+				unsigned char v = 0;
+				for (int dz = std::max(z - 1, 0); dz <= std::min(z + 1, gz - 1) && !v; dz++) {
+				for (int dy = std::max(y - 1, 0); dy <= std::min(y + 1, gy - 1) && !v; dy++) {
+				for (int dx = std::max(x - 1, 0); dx <= std::min(x + 1, gx - 1) && !v; dx++) {
+					v = visible[((size_t) dz * gy + dy) * gx + dx];
+				}}}
+				m_visible[((size_t) z * gy + y) * gx + x] = v;
+			}}}
+		}, 1);
+	}
+	else
+	{
+		m_visible.swap(visible);
+	}
+
+	return (size_t) std::count(m_visible.begin(), m_visible.end(), (unsigned char) 255);
+}
+
+bool MacroCellGrid::updateDistances(unsigned int maxDistance)
+{
+	maxDistance = std::max(1u, std::min(maxDistance, 254u));
+	if (m_visible.empty() || (maxDistance == m_maxDistance && m_visible == m_distancesVisible))
+	{
+		return false;
+	}
+	m_distancesVisible = m_visible;
+	m_maxDistance = maxDistance;
+
+	// min-max is separable for the Chebyshev metric: one pass along each axis, each line on its own
+	const int size[3] = { (int) m_gridSize[0], (int) m_gridSize[1], (int) m_gridSize[2] };
+	const size_t stride[3] = { 1, (size_t) size[0], (size_t) size[0] * size[1] };
+	const int limit = (int) maxDistance;
+	std::vector<unsigned char> source(m_visible.size());
+	for (size_t i = 0; i < m_visible.size(); i++) { source[i] = m_visible[i] ? 0 : (unsigned char) (limit + 1); }
+	m_distances.resize(m_visible.size());
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const int u = (axis + 1) % 3, v = (axis + 2) % 3; // axes enumerating the lines
+		const int n = size[axis];
+		THREADPOOL->parallelFor(0, (size_t) size[u] * size[v], [&](size_t begin, size_t end)
+		{
+			std::vector<unsigned char> g(n), h(n), table;
+			for (size_t line = begin; line < end; line++)
+			{
+				size_t first = (line % size[u]) * stride[u] + (line / size[u]) * stride[v];
+				for (int i = 0; i < n; i++) { g[i] = source[first + i * stride[axis]]; }
+				chebyshevLine(&g[0], n, limit, &h[0], table);
+				for (int i = 0; i < n; i++) { m_distances[first + i * stride[axis]] = h[i]; }
+			}
+		}, 64);
+		if (axis < 2) { source.swap(m_distances); }
+	}
+	return true;
+}
+
+void MacroCellGrid::upload()
+{
+	uploadTexture(m_texture, m_textureSize, m_visible);
+}
+
+void MacroCellGrid::uploadDistances()
+{
+	uploadTexture(m_distanceTexture, m_distanceTextureSize, m_distances);
+}
+
+void MacroCellGrid::uploadTexture(GLuint& texture, unsigned int* textureSize, const std::vector<unsigned char>& cells)
+{
+	if (cells.size() != (size_t) m_gridSize[0] * m_gridSize[1] * m_gridSize[2] || cells.empty())
+	{
+		return;
+	}
+
+	if (texture == 0 || textureSize[0] != m_gridSize[0] || textureSize[1] != m_gridSize[1] || textureSize[2] != m_gridSize[2])
+	{
+		if (texture != 0) { glDeleteTextures(1, &texture); }
+		glGenTextures(1, &texture);
+		OPENGLCONTEXT->bindTexture(texture, GL_TEXTURE_3D);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexStorage3D(GL_TEXTURE_3D, 1, GL_R8, m_gridSize[0], m_gridSize[1], m_gridSize[2]);
+		for (int i = 0; i < 3; i++) { textureSize[i] = m_gridSize[i]; }
+	}
+
+	OPENGLCONTEXT->bindTexture(texture, GL_TEXTURE_3D);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, 0, m_gridSize[0], m_gridSize[1], m_gridSize[2], GL_RED, GL_UNSIGNED_BYTE, &cells[0]);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	OPENGLCONTEXT->bindTexture(0, GL_TEXTURE_3D);
+}
+
+void MacroCellGrid::release()
+{
+	if (m_texture != 0) { glDeleteTextures(1, &m_texture); }
+	if (m_distanceTexture != 0) { glDeleteTextures(1, &m_distanceTexture); }
+	m_texture = 0;
+	m_distanceTexture = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		m_textureSize[i] = 0;
+		m_distanceTextureSize[i] = 0;
+	}
+}
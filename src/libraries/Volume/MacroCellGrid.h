@@ -0,0 +1,146 @@
+#ifndef VOLUME_MACROCELLGRID_H_
+#define VOLUME_MACROCELLGRID_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <algorithm>
+
+#include <Core/SimdTools.h>
+#include <Core/ThreadPool.h>
+#include <Core/VolumeData.h>
+
+class TransferFunction;
+
+/**
+ * @brief min/max of a volume per block of voxels (macro cell) and whether the current transfer function makes a cell visible.
+ *        The visibility is uploaded as a small 3D texture, so the raycaster (EMPTY_SPACE_SKIPPING) leaps over empty cells.
+ *        Optionally the Chebyshev distance to the nearest visible cell is derived, so the raycaster (DISTANCE_SKIPPING)
+ *        leaps over whole blocks of empty cells at once.
+ *        Cells include the first voxel of their upper neighbours, since samples between two cells interpolate voxels of both.
+ */
+class MacroCellGrid
+{
+protected:
+	unsigned int m_cellSize;
+	unsigned int m_volumeSize[3];
+	unsigned int m_gridSize[3];
+	std::vector<float> m_cells;           //!< min, max per cell in sampled values, x-fastest
+	std::vector<unsigned char> m_visible; //!< 255 if a cell may contribute, 0 if it can be skipped
+	std::vector<unsigned char> m_distances; //!< in cells to the nearest visible cell, 0 for visible cells
+	std::vector<unsigned char> m_distancesVisible; //!< visibility the distances were computed for
+	unsigned int m_maxDistance; //!< the distances were computed for
+
+	GLuint m_texture;
+	unsigned int m_textureSize[3];
+	GLuint m_distanceTexture;
+	unsigned int m_distanceTextureSize[3];
+
+	void uploadTexture(GLuint& texture, unsigned int* textureSize, const std::vector<unsigned char>& cells); //!< GL_R8 per cell
+
+public:
+	MacroCellGrid(unsigned int cellSize = 8);
+	virtual ~MacroCellGrid();
+
+	/** @brief compute min/max of every cell on the thread pool, all cells are visible until updateVisibility() */
+	template<class T>
+	void build(const VolumeDataView<T>& volume);
+	template<class T>
+	inline void build(const VolumeData<T>& volume) { build(VolumeDataView<T>(volume)); }
+
+	/**
+	 * @brief classify the cells for a transfer function texture and the windowing the raycaster maps values with
+	 * @param rgba texels of the transfer function over [0, 1] after windowing, 4 floats each
+	 * @param dilate (optional) keep the neighbours of visible cells as well, needed with LEVEL_OF_DETAIL,
+	 *        where coarser levels average voxels beyond a cell
+	 * @return number of visible cells
+	 */
+	size_t updateVisibility(const std::vector<float>& rgba, float windowingMinVal, float windowingRange, bool dilate = false);
+	size_t updateVisibility(const TransferFunction& transferFunction, float windowingMinVal, float windowingRange, bool dilate = false);
+
+	/**
+	 * @brief Chebyshev distance (in cells) of every cell to the nearest visible cell, from the current visibility.
+	 *        Separable, on the thread pool and over cells only, so it stays interactive while the transfer function is edited.
+	 *        Nothing is done if neither the visibility nor maxDistance changed since the last call
+	 * @param maxDistance (optional) up to 254, cells farther away from any visible cell get maxDistance + 1. Smaller is faster
+	 * @return true if the distances were recomputed
+	 */
+	bool updateDistances(unsigned int maxDistance = 32);
+
+	void upload(); //!< (re)create and fill the visibility texture, GL_R8 with nearest filtering
+	void uploadDistances(); //!< (re)create and fill the distance texture, GL_R8 holding distance / 255
+	void release(); //!< delete the textures
+
+	inline GLuint getTexture() const { return m_texture; }
+	inline GLuint getDistanceTexture() const { return m_distanceTexture; }
+	inline unsigned int getCellSize() const { return m_cellSize; }
+	inline glm::ivec3 getGridSize() const { return glm::ivec3(m_gridSize[0], m_gridSize[1], m_gridSize[2]); }
+	inline glm::vec3 getVolumeSize() const { return glm::vec3(m_volumeSize[0], m_volumeSize[1], m_volumeSize[2]); } //!< for uVolumeSize
+	inline size_t getNumCells() const { return m_visible.size(); }
+	inline const std::vector<float>& getCells() const { return m_cells; }
+	inline const std::vector<unsigned char>& getVisibility() const { return m_visible; }
+	inline const std::vector<unsigned char>& getDistances() const { return m_distances; }
+	inline bool isVisible(unsigned int x, unsigned int y, unsigned int z) const { return m_visible[(z * m_gridSize[1] + y) * m_gridSize[0] + x] != 0; }
+};
+
+////// IMPLEMENTATION
+template<class T>
+void MacroCellGrid::build(const VolumeDataView<T>& volume)
+{
+	const unsigned int cs = m_cellSize;
+	m_volumeSize[0] = volume.size_x;
+	m_volumeSize[1] = volume.size_y;
+	m_volumeSize[2] = volume.size_z;
+	for (int i = 0; i < 3; i++) { m_gridSize[i] = (m_volumeSize[i] + cs - 1) / cs; }
+	const size_t numCells = (size_t) m_gridSize[0] * m_gridSize[1] * m_gridSize[2];
+	m_cells.assign(2 * numCells, 0.0f);
+	m_visible.assign(numCells, 255);
+	m_distancesVisible.clear(); // recompute the distances for the new grid, even if the visibility looks the same
+	if (volume.data == nullptr || volume.getNumVoxels() == 0) { return; }
+
+	// one task per row of cells: per element range of the voxel rows it covers, then per cell along x
+	const size_t sx = volume.size_x, sy = volume.size_y, sz = volume.size_z;
+	THREADPOOL->parallelFor(0, (size_t) m_gridSize[1] * m_gridSize[2], [&](size_t begin, size_t end)
+	{
+		std::vector<T> rowMin(sx), rowMax(sx);
+		for (size_t row = begin; row < end; row++)
+		{
+			const size_t cy = row % m_gridSize[1], cz = row / m_gridSize[1];
+			const size_t yEnd = std::min<size_t>((cy + 1) * cs + 1, sy);
+			const size_t zEnd = std::min<size_t>((cz + 1) * cs + 1, sz);
+
+			bool first = true;
+			for (size_t z = cz * cs; z < zEnd; z++) { for (size_t y = cy * cs; y < yEnd; y++)
+			{
+				const T* voxels = &volume.data[(z * sy + y) * sx];
+				if (first)
+				{
+					std::copy(voxels, voxels + sx, rowMin.begin());
+					std::copy(voxels, voxels + sx, rowMax.begin());
+					first = false;
+				}
+				else
+				{
+					SimdTools::updateMinMaxPerElement(voxels, sx, &rowMin[0], &rowMax[0]);
+				}
+			}}
+
+			for (size_t cx = 0; cx < m_gridSize[0]; cx++)
+			{
+				const size_t xBegin = cx * cs, xEnd = std::min<size_t>(xBegin + cs + 1, sx);
+				T cellMin = rowMin[xBegin], cellMax = rowMax[xBegin];
+				for (size_t x = xBegin + 1; x < xEnd; x++)
+				{
+					cellMin = std::min(cellMin, rowMin[x]);
+					cellMax = std::max(cellMax, rowMax[x]);
+				}
+				size_t cell = row * m_gridSize[0] + cx;
+				m_cells[2 * cell] = (float) cellMin;
+				m_cells[2 * cell + 1] = (float) cellMax;
+			}
+		}
+	}, 1);
+}
+
+#endif
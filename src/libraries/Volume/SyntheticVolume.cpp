@@ -1 +1,239 @@
-#include "SyntheticVolume.h"
\ No newline at end of file
+#include "SyntheticVolume.h"
+
+#include <random>
+
+namespace {
+
+// smootherstep weight of Perlin noise, 6t^5 - 15t^4 + 10t^3
+inline float fade(float t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); }
+
+// the 12 edge directions of a cube, indexed by the low 4 bits of a hash (4 of them repeated)
+const float GRADIENTS[16][3] = {
+	{ 1, 1, 0 }, { -1, 1, 0 }, { 1, -1, 0 }, { -1, -1, 0 },
+	{ 1, 0, 1 }, { -1, 0, 1 }, { 1, 0, -1 }, { -1, 0, -1 },
+	{ 0, 1, 1 }, { 0, -1, 1 }, { 0, 1, -1 }, { 0, -1, -1 },
+	{ 1, 1, 0 }, { 0, -1, 1 }, { -1, 1, 0 }, { 0, -1, -1 } };
+
+/**
+ * Noise of the voxels of a row inside one lattice cell. Along the row only the x offset changes, so the y / z interpolated
+ * corner contributions of both x faces of the cell are linear in it: n = a0 * fx + b0 + fade(fx) * (a1 * (fx - 1) + b1 - a0 * fx - b0)
+ * dst[i] += amplitude * n at fx = fx0 + i * step
+ */
+void addCellSpan(float fx0, float step, unsigned int count, float a0, float b0, float a1, float b1, float amplitude, float* dst)
+{
+	unsigned int i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	const __m256 vA0 = _mm256_set1_ps(a0), vB0 = _mm256_set1_ps(b0), vA1 = _mm256_set1_ps(a1), vB1 = _mm256_set1_ps(b1 - a1);
+	const __m256 vAmplitude = _mm256_set1_ps(amplitude), vStep = _mm256_set1_ps(8.0f * step);
+	const __m256 v6 = _mm256_set1_ps(6.0f), v15 = _mm256_set1_ps(15.0f), v10 = _mm256_set1_ps(10.0f);
+	__m256 fx = _mm256_add_ps(_mm256_set1_ps(fx0), _mm256_mul_ps(_mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0), _mm256_set1_ps(step)));
+	for (; i + 8 <= count; i += 8, fx = _mm256_add_ps(fx, vStep))
+	{
+		__m256 t3 = _mm256_mul_ps(_mm256_mul_ps(fx, fx), fx);
+		__m256 w = _mm256_mul_ps(t3, _mm256_add_ps(_mm256_mul_ps(fx, _mm256_sub_ps(_mm256_mul_ps(fx, v6), v15)), v10));
+		__m256 n0 = _mm256_add_ps(_mm256_mul_ps(vA0, fx), vB0);
+		__m256 n1 = _mm256_add_ps(_mm256_mul_ps(vA1, fx), vB1);
+		__m256 n = _mm256_add_ps(n0, _mm256_mul_ps(w, _mm256_sub_ps(n1, n0)));
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(n, vAmplitude)));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	const __m128 vA0 = _mm_set1_ps(a0), vB0 = _mm_set1_ps(b0), vA1 = _mm_set1_ps(a1), vB1 = _mm_set1_ps(b1 - a1);
+	const __m128 vAmplitude = _mm_set1_ps(amplitude), vStep = _mm_set1_ps(4.0f * step);
+	const __m128 v6 = _mm_set1_ps(6.0f), v15 = _mm_set1_ps(15.0f), v10 = _mm_set1_ps(10.0f);
+	__m128 fx = _mm_add_ps(_mm_set1_ps(fx0), _mm_mul_ps(_mm_set_ps(3, 2, 1, 0), _mm_set1_ps(step)));
+	for (; i + 4 <= count; i += 4, fx = _mm_add_ps(fx, vStep))
+	{
+		__m128 t3 = _mm_mul_ps(_mm_mul_ps(fx, fx), fx);
+		__m128 w = _mm_mul_ps(t3, _mm_add_ps(_mm_mul_ps(fx, _mm_sub_ps(_mm_mul_ps(fx, v6), v15)), v10));
+		__m128 n0 = _mm_add_ps(_mm_mul_ps(vA0, fx), vB0);
+		__m128 n1 = _mm_add_ps(_mm_mul_ps(vA1, fx), vB1);
+		__m128 n = _mm_add_ps(n0, _mm_mul_ps(w, _mm_sub_ps(n1, n0)));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(n, vAmplitude)));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float fx = fx0 + (float) i * step;
+		float n0 = a0 * fx + b0;
+		float n1 = a1 * (fx - 1.0f) + b1;
+		dst[i] += amplitude * (n0 + fade(fx) * (n1 - n0));
+	}
+}
+
+// dst[i] = sqrt(x^2 + c) * scale + offset at x = x0 + i * step
+void radialRow(float x0, float step, float c, float scale, float offset, unsigned int count, float* dst)
+{
+	unsigned int i = 0;
+#if defined(SIMDTOOLS_AVX2)
+	const __m256 vC = _mm256_set1_ps(c), vScale = _mm256_set1_ps(scale), vOffset = _mm256_set1_ps(offset), vStep = _mm256_set1_ps(8.0f * step);
+	__m256 x = _mm256_add_ps(_mm256_set1_ps(x0), _mm256_mul_ps(_mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0), _mm256_set1_ps(step)));
+	for (; i + 8 <= count; i += 8, x = _mm256_add_ps(x, vStep))
+	{
+		__m256 radius = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(x, x), vC));
+		_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_mul_ps(radius, vScale), vOffset));
+	}
+#elif defined(SIMDTOOLS_SSE2)
+	const __m128 vC = _mm_set1_ps(c), vScale = _mm_set1_ps(scale), vOffset = _mm_set1_ps(offset), vStep = _mm_set1_ps(4.0f * step);
+	__m128 x = _mm_add_ps(_mm_set1_ps(x0), _mm_mul_ps(_mm_set_ps(3, 2, 1, 0), _mm_set1_ps(step)));
+	for (; i + 4 <= count; i += 4, x = _mm_add_ps(x, vStep))
+	{
+		__m128 radius = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(x, x), vC));
+		_mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(radius, vScale), vOffset));
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float x = x0 + (float) i * step;
+		dst[i] = std::sqrt(x * x + c) * scale + offset;
+	}
+}
+
+} // namespace
+
+////////////////////////////// RadialGradientField //////////////////////////////
+
+SyntheticVolume::RadialGradientField::RadialGradientField(unsigned int size_x, unsigned int size_y, unsigned int size_z, float centerValue, float outerValue)
+	: centerValue(centerValue)
+	, outerValue(outerValue)
+{
+	size[0] = size_x;
+	size[1] = size_y;
+	size[2] = size_z;
+}
+
+void SyntheticVolume::RadialGradientField::operator()(unsigned int y, unsigned int z, float* row) const
+{
+	// voxel centers in [0, 1]^3, the radius relative to the corners
+	const float maxRadius = glm::length(glm::vec3(0.5f));
+	const float dy = ((float) y + 0.5f) / (float) size[1] - 0.5f;
+	const float dz = ((float) z + 0.5f) / (float) size[2] - 0.5f;
+	const float step = 1.0f / (float) size[0];
+	radialRow(0.5f * step - 0.5f, step, dy * dy + dz * dz, (outerValue - centerValue) / maxRadius, centerValue, size[0], row);
+}
+
+////////////////////////////// NoiseField //////////////////////////////
+
+SyntheticVolume::NoiseField::NoiseField(unsigned int size_x, unsigned int size_y, unsigned int size_z, float average, float maxDeviation, Parameters parameters)
+	: average(average)
+	, maxDeviation(maxDeviation)
+	, parameters(parameters)
+{
+	size[0] = size_x;
+	size[1] = size_y;
+	size[2] = size_z;
+	this->parameters.octaves = std::max(1, parameters.octaves);
+
+	std::mt19937 rng(parameters.seed);
+	for (int i = 0; i < 256; i++) { permutation[i] = (unsigned char) i; }
+	for (int i = 255; i > 0; i--) { std::swap(permutation[i], permutation[rng() % (i + 1)]); }
+	for (int i = 0; i < 256; i++) { permutation[256 + i] = permutation[i]; }
+
+	scale = parameters.frequency / (float) std::max(1u, std::max(size_x, std::max(size_y, size_z)));
+	amplitudeSum = 0.0f;
+	float amplitude = 1.0f;
+	for (int o = 0; o < this->parameters.octaves; o++, amplitude *= parameters.gain) { amplitudeSum += amplitude; }
+}
+
+void SyntheticVolume::NoiseField::addOctave(float x, float y, float z, float step, unsigned int count, float amplitude, float* row) const
+{
+	const float iyf = std::floor(y), izf = std::floor(z);
+	const float fy = y - iyf, fz = z - izf;
+	const int iy = (int) iyf & 255, iz = (int) izf & 255;
+	const float wy = fade(fy), wz = fade(fz);
+	const float weights[4] = { (1.0f - wy) * (1.0f - wz), wy * (1.0f - wz), (1.0f - wy) * wz, wy * wz }; // corners (0,0), (1,0), (0,1), (1,1) in y, z
+
+	unsigned int i = 0;
+	while (i < count)
+	{
+		// voxels of the row inside the current lattice cell
+		const float px = x + (float) i * step;
+		const float ixf = std::floor(px);
+		const float fx = px - ixf;
+		unsigned int span = std::min(count - i, (unsigned int) std::ceil((1.0f - fx) / step));
+		span = std::max(1u, span);
+		const int ix = (int) ixf & 255;
+
+		// y / z interpolated contributions of the corners on both x faces: a * offset along x + b
+		float a[2] = { 0.0f, 0.0f }, b[2] = { 0.0f, 0.0f };
+		for (int cx = 0; cx < 2; cx++) { for (int c = 0; c < 4; c++)
+		{
+			const int cy = c & 1, cz = c >> 1;
+			const float* g = GRADIENTS[permutation[permutation[permutation[ix + cx] + iy + cy] + iz + cz] & 15];
+			a[cx] += weights[c] * g[0];
+			b[cx] += weights[c] * (g[1] * (fy - (float) cy) + g[2] * (fz - (float) cz));
+		}}
+
+		addCellSpan(fx, step, span, a[0], b[0], a[1], b[1], amplitude, row + i);
+		i += span;
+	}
+}
+
+void SyntheticVolume::NoiseField::operator()(unsigned int y, unsigned int z, float* row) const
+{
+	std::fill(row, row + size[0], 0.0f);
+	float frequency = scale;
+	float amplitude = maxDeviation / amplitudeSum;
+	for (int o = 0; o < parameters.octaves; o++)
+	{
+		// every octave shifted, so their lattices do not line up at the origin
+		const float shift = 17.31f * (float) o;
+		addOctave(0.5f * frequency + shift, ((float) y + 0.5f) * frequency + shift, ((float) z + 0.5f) * frequency + shift, frequency, size[0], amplitude, row);
+		frequency *= parameters.lacunarity;
+		amplitude *= parameters.gain;
+	}
+	for (unsigned int i = 0; i < size[0]; i++) { row[i] += average; }
+}
+
+////////////////////////////// BlobField //////////////////////////////
+
+SyntheticVolume::BlobField::BlobField(unsigned int size_x, unsigned int size_y, unsigned int size_z, float backgroundValue, float blobValue, unsigned int numBlobs, float minRadius, float maxRadius, unsigned int seed)
+	: backgroundValue(backgroundValue)
+	, blobValue(blobValue)
+{
+	size[0] = size_x;
+	size[1] = size_y;
+	size[2] = size_z;
+
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	blobs.resize(numBlobs);
+	for (unsigned int i = 0; i < numBlobs; i++)
+	{
+		blobs[i].center = glm::vec3(unit(rng) * size_x, unit(rng) * size_y, unit(rng) * size_z);
+		blobs[i].radius = std::max(0.5f, minRadius + unit(rng) * (maxRadius - minRadius));
+	}
+
+	buckets.resize((size_z + BUCKET_SLICES - 1) / BUCKET_SLICES);
+	for (unsigned int i = 0; i < numBlobs; i++)
+	{
+		int first = std::max(0, (int) std::floor((blobs[i].center.z - blobs[i].radius) / (float) BUCKET_SLICES));
+		int last = std::min((int) buckets.size() - 1, (int) std::floor((blobs[i].center.z + blobs[i].radius) / (float) BUCKET_SLICES));
+		for (int b = first; b <= last; b++) { buckets[b].push_back(i); }
+	}
+}
+
+void SyntheticVolume::BlobField::operator()(unsigned int y, unsigned int z, float* row) const
+{
+	// weight of the strongest blob per voxel, (1 - r^2 / R^2)^2 inside a blob
+	std::fill(row, row + size[0], 0.0f);
+	const float py = (float) y + 0.5f, pz = (float) z + 0.5f;
+	for (unsigned int index : buckets[z / BUCKET_SLICES])
+	{
+		const Blob& blob = blobs[index];
+		const float r2 = blob.radius * blob.radius;
+		const float dyz = (py - blob.center.y) * (py - blob.center.y) + (pz - blob.center.z) * (pz - blob.center.z);
+		if (dyz >= r2) { continue; }
+
+		const float halfWidth = std::sqrt(r2 - dyz);
+		const int begin = std::max(0, (int) std::ceil(blob.center.x - halfWidth - 0.5f));
+		const int end = std::min((int) size[0], (int) std::floor(blob.center.x + halfWidth - 0.5f) + 1);
+		const float inverse = 1.0f / r2;
+		for (int x = begin; x < end; x++)
+		{
+			const float dx = (float) x + 0.5f - blob.center.x;
+			const float w = std::max(0.0f, 1.0f - (dx * dx + dyz) * inverse);
+			row[x] = std::max(row[x], w * w);
+		}
+	}
+	for (unsigned int i = 0; i < size[0]; i++) { row[i] = backgroundValue + row[i] * (blobValue - backgroundValue); }
+}
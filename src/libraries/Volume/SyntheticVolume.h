@@ -1,24 +1,196 @@
 #ifndef VOLUME_SYNTHETICVOLUME_H_
 #define VOLUME_SYNTHETICVOLUME_H_
 
+#ifdef MINGW_THREADS
+	#include <mingw-std-threads/mingw.mutex.h>
+#else
+	#include <mutex>
+#endif
+
 #include <glm/glm.hpp>
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include <Core/ThreadPool.h>
+#include <Core/SimdTools.h>
+#include <Core/LargeVolume.h>
 #include <Core/VolumeData.h>
 //#include <Rendering/GLTools.h>
 
+/**
+ * Generators for synthetic volumes, i.e. to stress-test empty space skipping, streaming and level of detail without real datasets.
+ * Every generator is a field that computes one row of voxels at a time from its global coordinates, so rows are generated
+ * in parallel and any slab of a volume (i.e. a chunk of a multi-GB volume that never fits into memory at once) can be generated
+ * on its own, with the same voxels as in the whole volume. Volumes keep the convention of the original generators:
+ * width along x, depth along y, height along z.
+ */
 namespace SyntheticVolume
 {
-	template<typename T> 
+	/** @brief distance to the center of the volume, mapped from centerValue (center) to outerValue (corners) */
+	struct RadialGradientField
+	{
+		unsigned int size[3];
+		float centerValue, outerValue;
+
+		RadialGradientField(unsigned int size_x, unsigned int size_y, unsigned int size_z, float centerValue, float outerValue);
+		void operator()(unsigned int y, unsigned int z, float* row) const; //!< size[0] values
+	};
+
+	/** @brief seeded 3D gradient (Perlin) noise, summed over octaves (fractal noise) and mapped to average +- maxDeviation */
+	struct NoiseField
+	{
+		struct Parameters
+		{
+			unsigned int seed;
+			float frequency;  //!< lattice cells along the largest edge of the volume, for the first octave
+			int octaves;      //!< 1: plain gradient noise
+			float lacunarity; //!< frequency factor from one octave to the next
+			float gain;       //!< amplitude factor from one octave to the next
+
+			Parameters(unsigned int seed = 0, float frequency = 8.0f, int octaves = 1, float lacunarity = 2.0f, float gain = 0.5f)
+				: seed(seed), frequency(frequency), octaves(octaves), lacunarity(lacunarity), gain(gain)
+			{}
+		};
+
+		unsigned int size[3];
+		float average, maxDeviation;
+		Parameters parameters;
+		unsigned char permutation[512]; //!< lattice hash, shuffled by the seed and repeated once
+		float scale; //!< lattice cells per voxel of the first octave
+		float amplitudeSum;
+
+		NoiseField(unsigned int size_x, unsigned int size_y, unsigned int size_z, float average, float maxDeviation, Parameters parameters = Parameters());
+		void operator()(unsigned int y, unsigned int z, float* row) const; //!< size[0] values
+
+		/** @brief noise of one octave at (x + i * step, y, z) for i < count, times amplitude, added to row */
+		void addOctave(float x, float y, float z, float step, unsigned int count, float amplitude, float* row) const;
+	};
+
+	/** @brief sparse field of spherical blobs with smooth falloff (max where they overlap) on a constant background */
+	struct BlobField
+	{
+		struct Blob
+		{
+			glm::vec3 center; //!< in voxels
+			float radius;     //!< in voxels
+		};
+
+		static const unsigned int BUCKET_SLICES = 16; //!< blobs are sorted into buckets of this many slices
+
+		unsigned int size[3];
+		float backgroundValue, blobValue;
+		std::vector<Blob> blobs;
+		std::vector< std::vector<unsigned int> > buckets; //!< blobs reaching into each bucket of slices
+
+		/** @param minRadius, maxRadius in voxels, radii are uniformly distributed */
+		BlobField(unsigned int size_x, unsigned int size_y, unsigned int size_z, float backgroundValue, float blobValue, unsigned int numBlobs, float minRadius, float maxRadius, unsigned int seed = 0);
+		void operator()(unsigned int y, unsigned int z, float* row) const; //!< size[0] values
+	};
+
+	/**
+	 * @brief generate slices [zBegin, zBegin + target.size_z) of a field into target on the thread pool, i.e. one chunk of a volume too large for memory.
+	 *        Values are rounded and clamped to the range of integer types
+	 * @param target of field extents along x and y
+	 * @param min, max will be extended by the values written
+	 */
+	template<typename T, class Field>
+	void generateSlab(const Field& field, unsigned int zBegin, const LargeVolumeView<T>& target, T& min, T& max);
+
+	/** @brief whole volume of a field on the thread pool, min and max are the values found */
+	template<typename T, class Field>
+	static VolumeData<T> generate(const Field& field);
+
+	template<typename T>
 	static VolumeData<T> generateHomogeneousVolume(unsigned int width, unsigned int height, unsigned int depth, T value);
 
-	template<typename T> 
+	template<typename T>
 	static VolumeData<T> generateRadialGradientVolume(unsigned int width, unsigned int height, unsigned int depth, T centerValue, T outerValue);
 
-	template<typename T> 
-	static VolumeData<T> generateNoiseVolume(unsigned int width, unsigned int height, unsigned int depth, T avgValue, T maxDeviation);
+	template<typename T>
+	static VolumeData<T> generateNoiseVolume(unsigned int width, unsigned int height, unsigned int depth, T avgValue, T maxDeviation, unsigned int seed = 0, float frequency = 8.0f);
+
+	template<typename T>
+	static VolumeData<T> generateFractalNoiseVolume(unsigned int width, unsigned int height, unsigned int depth, T avgValue, T maxDeviation, NoiseField::Parameters parameters = NoiseField::Parameters(0, 4.0f, 5));
+
+	template<typename T>
+	static VolumeData<T> generateBlobVolume(unsigned int width, unsigned int height, unsigned int depth, T backgroundValue, T blobValue, unsigned int numBlobs, float minRadius, float maxRadius, unsigned int seed = 0);
+
+	/** @brief dst = value rounded and clamped to the range of T */
+	template<typename T>
+	void convertRow(const float* row, unsigned int count, T* dst);
 }
 
 ////// IMPLEMENTATION
 #include <Core/DebugLog.h>
+
+template<typename T>
+void SyntheticVolume::convertRow(const float* row, unsigned int count, T* dst)
+{
+	if (std::numeric_limits<T>::is_integer)
+	{
+		const float lowest = (float) std::numeric_limits<T>::lowest(), highest = (float) std::numeric_limits<T>::max();
+		for (unsigned int i = 0; i < count; i++) { dst[i] = (T) std::floor(std::max(lowest, std::min(row[i], highest)) + 0.5f); }
+	}
+	else
+	{
+		for (unsigned int i = 0; i < count; i++) { dst[i] = (T) row[i]; }
+	}
+}
+
+template<typename T, class Field>
+void SyntheticVolume::generateSlab(const Field& field, unsigned int zBegin, const LargeVolumeView<T>& target, T& min, T& max)
+{
+	if (target.isEmpty()) { return; }
+	const unsigned int sx = (unsigned int) target.size_x, sy = (unsigned int) target.size_y;
+
+	// one task per range of rows, ranges merged under a lock
+	std::mutex rangeMutex;
+	THREADPOOL->parallelFor(0, (size_t) target.size_y * target.size_z, [&](size_t begin, size_t end)
+	{
+		std::vector<float> row(sx);
+		T localMin = std::numeric_limits<T>::max(), localMax = std::numeric_limits<T>::lowest();
+		for (size_t r = begin; r < end; r++)
+		{
+			unsigned int y = (unsigned int) (r % sy), z = (unsigned int) (r / sy);
+			field(y, zBegin + z, &row[0]);
+			T* dst = target.row(y, z);
+			convertRow(&row[0], sx, dst);
+			SimdTools::updateMinMax(dst, sx, localMin, localMax);
+		}
+		std::lock_guard<std::mutex> lock(rangeMutex);
+		min = std::min(min, localMin);
+		max = std::max(max, localMax);
+	}, std::max<size_t>(1, (1 << 16) / sx));
+}
+
+template<typename T, class Field>
+VolumeData<T> SyntheticVolume::generate(const Field& field)
+{
+	VolumeData<T> result;
+	result.size_x = field.size[0];
+	result.size_y = field.size[1];
+	result.size_z = field.size[2];
+	if (result.size_x == 0 || result.size_y == 0 || result.size_z == 0)
+	{
+		DEBUGLOG->log("ERROR: synthetic volume without voxels");
+		return result;
+	}
+
+	result.real_size_x = 1.0f / (float) result.size_x;
+	result.real_size_y = 1.0f / (float) result.size_y;
+	result.real_size_z = 1.0f / (float) result.size_z;
+
+	result.data = AlignedVector<T>(); // reset
+	result.data.resize((size_t) result.size_x * result.size_y * result.size_z);
+	result.min = std::numeric_limits<T>::max();
+	result.max = std::numeric_limits<T>::lowest();
+	generateSlab(field, 0, LargeVolumeView<T>(&result.data[0], result.size_x, result.size_y, result.size_z), result.min, result.max);
+	return result;
+}
+
 template<typename T>
 VolumeData<T> SyntheticVolume::generateHomogeneousVolume(unsigned int width, unsigned int height, unsigned int depth, T value)
 {
@@ -35,82 +207,44 @@ VolumeData<T> SyntheticVolume::generateHomogeneousVolume(unsigned int width, uns
 	result.real_size_x = 1.0f / (float) width;
 	result.real_size_y = 1.0f / (float) depth;
 	result.real_size_z = 1.0f / (float) height;
-	
+
 	DEBUGLOG->log("Filling homogeneous volume data...");
-	result.data = std::vector<T>(); // reset
-	result.data.resize(width * height * depth, value);
+	result.data = AlignedVector<T>(); // reset
+	result.data.resize((size_t) width * height * depth, value);
 	return result;
 }
 
 template<typename T>
 VolumeData<T> SyntheticVolume::generateRadialGradientVolume( unsigned int width, unsigned int height, unsigned int depth, T centerValue, T outerValue)
 {
-	VolumeData<T> result;
-	result.min = std::min<T>(centerValue, outerValue);
-	result.max = std::max<T>(centerValue, outerValue);
-
-	result.size_x = width;
-	result.size_y = depth;
-	result.size_z = height;
-
-	result.real_size_x = 1.0f / (float) width;
-	result.real_size_y = 1.0f / (float) depth;
-	result.real_size_z = 1.0f / (float) height;
-
-	glm::vec3 center(
-		0.5f * (float) result.size_x * result.real_size_x,
-		0.5f * (float) result.size_y * result.real_size_y,
-		0.5f * (float) result.size_z * result.real_size_z);
-
-	float maxRadius = length(center);
-	
 	DEBUGLOG->log("Filling radial gradient volume data...");
-	result.data = std::vector<T>(); // reset
-	result.data.resize( result.size_x * result.size_y * result.size_z);
+	VolumeData<T> result = generate<T>(RadialGradientField(width, depth, height, (float) centerValue, (float) outerValue));
 
-	for (unsigned int k = 0; k < result.size_z; k ++ ) // slice
-	{
-	std::cout << ".";
-	for (unsigned int j = 0; j < result.size_y; j ++ ) // row
-	{
-	for (unsigned int i = 0; i < result.size_x; i ++ ) // column
-	{
-	
-		glm::vec3 position(
-			(float) i * result.real_size_x + 0.5f * result.real_size_x,
-			(float) j * result.real_size_y + 0.5f * result.real_size_y,
-			(float) k * result.real_size_z + 0.5f * result.real_size_z);
-
-		float radius = glm::length(position - center);
-		float mixParam = (radius) / maxRadius;
-
-		result.data[k * result.size_x * result.size_y
-		           +j * result.size_x
-				   +i] = (1.0f - mixParam) * centerValue + (mixParam) * outerValue;
-	}}}
-	
-	std::cout << std::endl;
+	// the full range, even where the corners are not reached exactly
+	result.min = std::min<T>(centerValue, outerValue);
+	result.max = std::max<T>(centerValue, outerValue);
 	return result;
 }
 
-template<typename T> 
-VolumeData<T> SyntheticVolume::generateNoiseVolume(unsigned int width, unsigned int height, unsigned int depth, T avgValue, T maxDeviation)
+template<typename T>
+VolumeData<T> SyntheticVolume::generateNoiseVolume(unsigned int width, unsigned int height, unsigned int depth, T avgValue, T maxDeviation, unsigned int seed, float frequency)
 {
-	VolumeData<T> result;
-
-	result.size_x = width;
-	result.size_y = depth;
-	result.size_z = height;
-
-	result.real_size_x = 1.0f / (float) width;
-	result.real_size_y = 1.0f / (float) depth;
-	result.real_size_z = 1.0f / (float) height;
+	DEBUGLOG->log("Filling noise volume data...");
+	return generate<T>(NoiseField(width, depth, height, (float) avgValue, (float) maxDeviation, NoiseField::Parameters(seed, frequency, 1)));
+}
 
-	//TODO
-	
-	result.data = std::vector<T>(); // reset
-	return result;
+template<typename T>
+VolumeData<T> SyntheticVolume::generateFractalNoiseVolume(unsigned int width, unsigned int height, unsigned int depth, T avgValue, T maxDeviation, NoiseField::Parameters parameters)
+{
+	DEBUGLOG->log("Filling fractal noise volume data...");
+	return generate<T>(NoiseField(width, depth, height, (float) avgValue, (float) maxDeviation, parameters));
 }
 
+template<typename T>
+VolumeData<T> SyntheticVolume::generateBlobVolume(unsigned int width, unsigned int height, unsigned int depth, T backgroundValue, T blobValue, unsigned int numBlobs, float minRadius, float maxRadius, unsigned int seed)
+{
+	DEBUGLOG->log("Filling blob volume data...");
+	return generate<T>(BlobField(width, depth, height, (float) backgroundValue, (float) blobValue, numBlobs, minRadius, maxRadius, seed));
+}
 
 #endif
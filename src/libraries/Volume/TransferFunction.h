@@ -22,6 +22,7 @@ public:
 	GLuint getTextureHandle();
 	inline std::vector<glm::vec4>& getColors(){ return m_colors; }
 	inline std::vector<float>& getValues(){ return m_values; }
+	inline const std::vector<float>& getTexData() const { return m_transferFunctionTexData; } //!< RGBA texels as uploaded by updateTex()
 };
 
 #endif
@@ -0,0 +1,90 @@
+#include "VolumeCrop.h"
+
+#include <glm/gtx/transform.hpp>
+
+VolumeCrop::Region VolumeCrop::getFullRegion(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+{
+	return getRegion(size_x, size_y, size_z, glm::vec3(0.0f), glm::vec3(1.0f), 0);
+}
+
+VolumeCrop::Region VolumeCrop::getRegion(unsigned int size_x, unsigned int size_y, unsigned int size_z, glm::vec3 cullMin, glm::vec3 cullMax, unsigned int border)
+{
+	const unsigned int size[3] = { size_x, size_y, size_z };
+	const glm::vec3 lower = glm::min(cullMin, cullMax), upper = glm::max(cullMin, cullMax);
+
+	Region region;
+	for (int a = 0; a < 3; a++)
+	{
+		// voxel i spans [i, i + 1) / size in texture coordinates
+		int first = (int) std::floor(glm::clamp(lower[a], 0.0f, 1.0f) * (float) size[a]) - (int) border;
+		int last = (int) std::ceil(glm::clamp(upper[a], 0.0f, 1.0f) * (float) size[a]) + (int) border; // exclusive
+		first = std::max(0, std::min(first, (int) size[a] - 1));
+		last = std::max(first + 1, std::min(last, (int) size[a]));
+
+		region.offset[a] = (unsigned int) first;
+		region.size[a] = (unsigned int) (last - first);
+		region.textureMin[a] = (float) first / (float) std::max(1u, size[a]);
+		region.textureMax[a] = (float) last / (float) std::max(1u, size[a]);
+	}
+	return region;
+}
+
+glm::mat4 VolumeCrop::getTextureToCrop(const Region& region)
+{
+	return glm::scale(1.0f / (region.textureMax - region.textureMin)) * glm::translate(-region.textureMin);
+}
+
+glm::mat4 VolumeCrop::getModelToTexture(const glm::mat4& modelToTexture, const Region& region)
+{
+	return getTextureToCrop(region) * modelToTexture;
+}
+
+glm::mat4 VolumeCrop::getCropToModel(const glm::mat4& modelToTexture, const Region& region)
+{
+	// volume box in model space -> texture space -> region in texture space -> model space
+	return glm::inverse(modelToTexture) * glm::inverse(getTextureToCrop(region)) * modelToTexture;
+}
+
+void VolumeCrop::getAxisWeights(unsigned int offset, unsigned int size, unsigned int targetSize, Filter filter, AxisWeights& result)
+{
+	result.begin.assign(1, 0);
+	result.index.clear();
+	result.weight.clear();
+
+	const double scale = (double) size / (double) targetSize; // source voxels per target voxel
+	for (unsigned int i = 0; i < targetSize; i++)
+	{
+		if (filter == TRILINEAR || scale <= 1.0)
+		{
+			// source position of the target voxel center, clamped to the centers of the border voxels
+			double position = std::max(0.0, std::min((i + 0.5) * scale - 0.5, (double) size - 1.0));
+			unsigned int first = std::min((unsigned int) position, size - 1);
+			float fraction = (float) (position - (double) first);
+			if (filter == BOX) // upsampling: nearest voxel
+			{
+				first = std::min((unsigned int) ((i + 0.5) * scale), size - 1);
+				fraction = 0.0f;
+			}
+			result.index.push_back(offset + first);
+			result.weight.push_back(1.0f - fraction);
+			if (fraction > 0.0f && first + 1 < size)
+			{
+				result.index.push_back(offset + first + 1);
+				result.weight.push_back(fraction);
+			}
+		}
+		else
+		{
+			// coverage of every source voxel in [i, i + 1) * scale
+			double lower = i * scale, upper = std::min((i + 1) * scale, (double) size);
+			for (unsigned int j = (unsigned int) lower; j < size && (double) j < upper; j++)
+			{
+				double overlap = std::min(upper, (double) j + 1.0) - std::max(lower, (double) j);
+				if (overlap <= 0.0) { continue; }
+				result.index.push_back(offset + j);
+				result.weight.push_back((float) (overlap / (upper - lower)));
+			}
+		}
+		result.begin.push_back((unsigned int) result.index.size());
+	}
+}
@@ -0,0 +1,193 @@
+#ifndef VOLUME_VOLUMECROP_H_
+#define VOLUME_VOLUMECROP_H_
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include <Core/ThreadPool.h>
+#include <Core/VolumeData.h>
+#include <Importing/ImportProgress.h>
+
+/**
+ * Cuts the region of interest out of a volume, optionally resampled to another resolution, so only that region occupies
+ * texture memory and the proxy geometry (and with it every ray) spans only that region. The cropped texture covers a
+ * box of whole source voxels; getModelToTexture() replaces VolumeParameters::s_modelToTexture for it and getCropToModel()
+ * places the proxy geometry onto that box.
+ */
+namespace VolumeCrop
+{
+	enum Filter {
+		TRILINEAR, //!< interpolate at the centers of target voxels, like the texture sampler would
+		BOX,       //!< average of the source voxels covered by a target voxel, for downsampling
+	};
+
+	/** @brief box of whole voxels of a source volume */
+	struct Region
+	{
+		unsigned int offset[3]; //!< first voxel
+		unsigned int size[3];   //!< number of voxels
+		glm::vec3 textureMin;   //!< texture coordinates of the box in the source volume
+		glm::vec3 textureMax;
+	};
+
+	/** @brief the whole volume */
+	Region getFullRegion(unsigned int size_x, unsigned int size_y, unsigned int size_z);
+
+	/**
+	 * @brief smallest box of voxels that contains the texture coordinates [cullMin, cullMax] (i.e. RaycastingParameters::s_cullMin, s_cullMax)
+	 * @param border voxels added on every side, so samples filtered at the cull planes read the same neighbours as before
+	 */
+	Region getRegion(unsigned int size_x, unsigned int size_y, unsigned int size_z, glm::vec3 cullMin, glm::vec3 cullMax, unsigned int border = 1);
+
+	glm::mat4 getTextureToCrop(const Region& region); //!< source texture coordinates to texture coordinates of the cropped volume
+	glm::mat4 getModelToTexture(const glm::mat4& modelToTexture, const Region& region); //!< model coordinates to texture coordinates of the cropped volume
+	glm::mat4 getCropToModel(const glm::mat4& modelToTexture, const Region& region); //!< moves and shrinks the volume box in model space onto the region
+
+	/** @brief per target voxel along one axis: the source voxels and their weights */
+	struct AxisWeights
+	{
+		std::vector<unsigned int> begin;  //!< first tap of every target voxel, one more for the end
+		std::vector<unsigned int> index;  //!< source voxel of every tap
+		std::vector<float> weight;
+	};
+
+	/** @brief taps along one axis of region [offset, offset + size) resampled to targetSize voxels, reads never leave the region */
+	void getAxisWeights(unsigned int offset, unsigned int size, unsigned int targetSize, Filter filter, AxisWeights& result);
+
+	/**
+	 * @brief resample a region of a volume to target_x * target_y * target_z voxels on the thread pool, one task per slab of target slices.
+	 *        The filter is separable, every target slice is reduced from its source slices to a plane, then along y and x.
+	 *        Without resampling the rows of the region are copied. Min and max are kept from the source, so windowing stays as it was.
+	 *        Reports to and can be cancelled by the ImportProgress of the calling thread, if any
+	 * @param result voxel sizes are scaled with the resolution, so the cropped volume keeps the physical extent of the region
+	 * @return false if the volume is empty, the region does not fit into it or it was cancelled
+	 */
+	template<class T>
+	bool cropAndResample(const VolumeDataView<T>& volume, const Region& region, unsigned int target_x, unsigned int target_y, unsigned int target_z, Filter filter, VolumeData<T>& result);
+
+	/** @brief the region at its original resolution */
+	template<class T>
+	bool crop(const VolumeDataView<T>& volume, const Region& region, VolumeData<T>& result);
+}
+
+////// IMPLEMENTATION
+#include <Core/DebugLog.h>
+
+template<class T>
+bool VolumeCrop::cropAndResample(const VolumeDataView<T>& volume, const Region& region, unsigned int target_x, unsigned int target_y, unsigned int target_z, Filter filter, VolumeData<T>& result)
+{
+	const unsigned int volumeSize[3] = { volume.size_x, volume.size_y, volume.size_z };
+	for (int a = 0; a < 3; a++)
+	{
+		if (region.size[a] == 0 || region.offset[a] + region.size[a] > volumeSize[a])
+		{
+			DEBUGLOG->log("ERROR: crop region exceeds the volume along axis ", a);
+			return false;
+		}
+	}
+	if (volume.data == nullptr || target_x == 0 || target_y == 0 || target_z == 0)
+	{
+		DEBUGLOG->log("ERROR: nothing to crop");
+		return false;
+	}
+
+	result.size_x = target_x;
+	result.size_y = target_y;
+	result.size_z = target_z;
+	result.real_size_x = volume.real_size_x * (float) region.size[0] / (float) target_x;
+	result.real_size_y = volume.real_size_y * (float) region.size[1] / (float) target_y;
+	result.real_size_z = volume.real_size_z * (float) region.size[2] / (float) target_z;
+	result.min = volume.min;
+	result.max = volume.max;
+	result.data = AlignedVector<T>(); // reset
+	result.data.resize((size_t) target_x * target_y * target_z);
+
+	ImportProgress* progress = ImportProgress::getCurrent(); // i.e. when cropping on a loader thread, workers run on other threads
+	if (progress) { progress->addWork(target_z); }
+	auto finish = [&]()
+	{
+		if (progress && progress->isCancelled()) { result.data.clear(); return false; }
+		return true;
+	};
+
+	const size_t stride_y = volume.size_x, stride_z = (size_t) volume.size_x * volume.size_y;
+	if (target_x == region.size[0] && target_y == region.size[1] && target_z == region.size[2])
+	{
+		THREADPOOL->parallelFor(0, (size_t) target_z, [&](size_t begin, size_t end)
+		{
+			for (size_t z = begin; z < end; z++)
+			{
+				if (progress && progress->isCancelled()) { return; }
+				for (size_t y = 0; y < target_y; y++)
+				{
+					const T* src = volume.data + (region.offset[2] + z) * stride_z + (region.offset[1] + y) * stride_y + region.offset[0];
+					memcpy(&result.data[(z * target_y + y) * target_x], src, target_x * sizeof(T));
+				}
+				if (progress) { progress->advance(); }
+			}
+		});
+		return finish();
+	}
+
+	AxisWeights weights[3];
+	getAxisWeights(region.offset[0], region.size[0], target_x, filter, weights[0]);
+	getAxisWeights(region.offset[1], region.size[1], target_y, filter, weights[1]);
+	getAxisWeights(region.offset[2], region.size[2], target_z, filter, weights[2]);
+
+	const unsigned int rx = region.size[0], ry = region.size[1];
+	THREADPOOL->parallelFor(0, (size_t) target_z, [&](size_t begin, size_t end)
+	{
+		std::vector<float> plane((size_t) rx * ry); // region rows reduced along z
+		std::vector<float> row(rx);                 // plane rows reduced along y
+		for (size_t z = begin; z < end; z++)
+		{
+			if (progress && progress->isCancelled()) { return; }
+			std::fill(plane.begin(), plane.end(), 0.0f);
+			for (unsigned int tz = weights[2].begin[z]; tz < weights[2].begin[z + 1]; tz++)
+			{
+				const float wz = weights[2].weight[tz];
+				const T* slice = volume.data + (size_t) weights[2].index[tz] * stride_z + region.offset[0];
+				for (unsigned int y = 0; y < ry; y++)
+				{
+					const T* src = slice + (size_t) (region.offset[1] + y) * stride_y;
+					float* dst = &plane[(size_t) y * rx];
+					for (unsigned int x = 0; x < rx; x++) { dst[x] += wz * (float) src[x]; }
+				}
+			}
+
+			for (unsigned int y = 0; y < target_y; y++)
+			{
+				std::fill(row.begin(), row.end(), 0.0f);
+				for (unsigned int ty = weights[1].begin[y]; ty < weights[1].begin[y + 1]; ty++)
+				{
+					const float wy = weights[1].weight[ty];
+					const float* src = &plane[(size_t) (weights[1].index[ty] - region.offset[1]) * rx];
+					for (unsigned int x = 0; x < rx; x++) { row[x] += wy * src[x]; }
+				}
+
+				T* dst = &result.data[(z * target_y + y) * target_x];
+				for (unsigned int x = 0; x < target_x; x++)
+				{
+					float value = 0.0f;
+					for (unsigned int tx = weights[0].begin[x]; tx < weights[0].begin[x + 1]; tx++) { value += weights[0].weight[tx] * row[weights[0].index[tx] - region.offset[0]]; }
+					dst[x] = std::numeric_limits<T>::is_integer ? (T) std::floor(value + 0.5f) : (T) value;
+				}
+			}
+			if (progress) { progress->advance(); }
+		}
+	});
+	return finish();
+}
+
+template<class T>
+bool VolumeCrop::crop(const VolumeDataView<T>& volume, const Region& region, VolumeData<T>& result)
+{
+	return cropAndResample(volume, region, region.size[0], region.size[1], region.size[2], TRILINEAR, result);
+}
+
+#endif
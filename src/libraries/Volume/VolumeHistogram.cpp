@@ -0,0 +1,123 @@
+#include "VolumeHistogram.h"
+
+VolumeHistogram::VolumeHistogram(unsigned int numBins, unsigned int numValueBins2D, unsigned int numGradientBins)
+	: m_numBins(std::max(1u, numBins))
+	, m_numValueBins2D(std::max(1u, numValueBins2D))
+	, m_numGradientBins(std::max(1u, numGradientBins))
+{
+	invalidate();
+}
+
+VolumeHistogram::~VolumeHistogram()
+{
+}
+
+void VolumeHistogram::invalidate()
+{
+	m_min = 0.0;
+	m_max = 0.0;
+	m_maxGradient = 0.0f;
+	m_numVoxels = 0;
+	m_counts.clear();
+	m_counts2D.clear();
+	m_cumulative.clear();
+	m_source = nullptr;
+	for (int i = 0; i < 3; i++) { m_sourceSize[i] = 0; }
+}
+
+void VolumeHistogram::setCounts(const unsigned int* counts, unsigned int numBins, double min, double max)
+{
+	invalidate();
+	if (counts == nullptr || numBins == 0)
+	{
+		return;
+	}
+
+	m_min = min;
+	m_max = max;
+	m_counts.assign(counts, counts + numBins);
+	for (unsigned int b = 0; b < numBins; b++) { m_numVoxels += counts[b]; }
+	finish();
+}
+
+void VolumeHistogram::finish()
+{
+	m_cumulative.resize(m_counts.size());
+	unsigned long long sum = 0;
+	for (size_t b = 0; b < m_counts.size(); b++)
+	{
+		sum += m_counts[b];
+		m_cumulative[b] = sum;
+	}
+}
+
+float VolumeHistogram::getPercentile(float fraction) const
+{
+	if (m_numVoxels == 0)
+	{
+		return (float) m_min;
+	}
+
+	// first bin whose running sum reaches the target, then linear within it
+	double target = std::max(0.0, std::min((double) fraction, 1.0)) * (double) m_numVoxels;
+	size_t bin = std::lower_bound(m_cumulative.begin(), m_cumulative.end(), std::max(1ull, (unsigned long long) std::ceil(target))) - m_cumulative.begin();
+	bin = std::min(bin, m_cumulative.size() - 1);
+	double before = (bin > 0) ? (double) m_cumulative[bin - 1] : 0.0;
+	double inBin = (m_counts[bin] > 0) ? (target - before) / (double) m_counts[bin] : 0.0;
+	double binWidth = (m_max - m_min) / (double) m_counts.size();
+	return (float) (m_min + ((double) bin + std::max(0.0, std::min(inBin, 1.0))) * binWidth);
+}
+
+bool VolumeHistogram::getWindowing(float lowerFraction, float upperFraction, float& windowingMinVal, float& windowingRange) const
+{
+	if (m_numVoxels == 0)
+	{
+		return false;
+	}
+
+	windowingMinVal = getPercentile(lowerFraction);
+	windowingRange = std::max(getPercentile(upperFraction) - windowingMinVal, std::numeric_limits<float>::min());
+	return true;
+}
+
+float VolumeHistogram::getRelativeValue(float value) const
+{
+	double range = std::max(m_max - m_min, std::numeric_limits<double>::min());
+	return (float) (((double) value - m_min) / range);
+}
+
+void VolumeHistogram::getNormalized(unsigned int numBins, std::vector<float>& result, bool logarithmic) const
+{
+	result.assign(numBins, 0.0f);
+	if (m_counts.empty() || numBins == 0)
+	{
+		return;
+	}
+
+	// every source bin goes to the target bin of its center
+	for (size_t b = 0; b < m_counts.size(); b++)
+	{
+		size_t target = std::min((size_t) (((double) b + 0.5) * numBins / (double) m_counts.size()), (size_t) numBins - 1);
+		result[target] += (float) m_counts[b];
+	}
+
+	float maximum = 0.0f;
+	for (float& count : result)
+	{
+		if (logarithmic) { count = std::log(1.0f + count); }
+		maximum = std::max(maximum, count);
+	}
+	if (maximum > 0.0f) { for (float& count : result) { count /= maximum; } }
+}
+
+void VolumeHistogram::getNormalized2D(std::vector<float>& result, bool logarithmic) const
+{
+	result.assign(m_counts2D.size(), 0.0f);
+	float maximum = 0.0f;
+	for (size_t b = 0; b < m_counts2D.size(); b++)
+	{
+		result[b] = logarithmic ? std::log(1.0f + (float) m_counts2D[b]) : (float) m_counts2D[b];
+		maximum = std::max(maximum, result[b]);
+	}
+	if (maximum > 0.0f) { for (float& count : result) { count /= maximum; } }
+}
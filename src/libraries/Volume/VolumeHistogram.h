@@ -0,0 +1,211 @@
+#ifndef VOLUME_VOLUMEHISTOGRAM_H_
+#define VOLUME_VOLUMEHISTOGRAM_H_
+
+#ifdef MINGW_THREADS
+	#include <mingw-std-threads/mingw.mutex.h>
+#else
+	#include <mutex>
+#endif
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include <Core/ThreadPool.h>
+#include <Core/VolumeData.h>
+
+/**
+ * @brief value histogram and 2D value / gradient magnitude histogram of a volume, computed once on the thread pool
+ *        with per task bins merged at the end. Keep it next to the volume: transfer function editing and auto-windowing
+ *        query it instead of scanning the voxels again. build() does nothing if it was already built for the same volume.
+ *        Bins cover [min, max] of the volume, gradient magnitudes are central differences per (smallest) voxel spacing.
+ */
+class VolumeHistogram
+{
+protected:
+	unsigned int m_numBins;         //!< of the value histogram
+	unsigned int m_numValueBins2D;  //!< along the value axis of the 2D histogram
+	unsigned int m_numGradientBins; //!< along the gradient magnitude axis of the 2D histogram
+
+	double m_min, m_max; //!< value range covered by the bins
+	float m_maxGradient; //!< gradient magnitude covered by the last gradient bin
+	unsigned long long m_numVoxels;
+
+	std::vector<unsigned long long> m_counts;   //!< value histogram
+	std::vector<unsigned long long> m_counts2D; //!< value-fastest, one row per gradient bin
+	std::vector<unsigned long long> m_cumulative; //!< running sum of m_counts, for percentiles
+
+	// what the histograms were built for
+	const void* m_source;
+	unsigned int m_sourceSize[3];
+
+	void finish(); //!< cumulative counts
+
+	/** @brief central differences of the voxels of one row, in values per smallest spacing */
+	template<class T>
+	static void gradientMagnitudes(const VolumeData<T>& volume, unsigned int y, unsigned int z, const float* scale, float* magnitudes);
+
+public:
+	/**
+	 * @param numBins (optional) of the value histogram, percentiles are resolved to (max - min) / numBins
+	 * @param numValueBins2D, numGradientBins (optional) size of the 2D histogram
+	 */
+	VolumeHistogram(unsigned int numBins = 4096, unsigned int numValueBins2D = 256, unsigned int numGradientBins = 128);
+	virtual ~VolumeHistogram();
+
+	/**
+	 * @brief count all voxels on the thread pool. The 2D histogram takes a second pass, since its gradient range is only known after the first.
+	 *        Nothing is done if the histograms were already built for this volume, call invalidate() after changing its voxels
+	 * @param gradients (optional) also build the 2D value / gradient magnitude histogram
+	 * @return true if the histograms were (re)built
+	 */
+	template<class T>
+	bool build(const VolumeData<T>& volume, bool gradients = true);
+
+	/** @brief adopt a precomputed value histogram over [min, max], i.e. VolumeCache::CachedVolume::histogram. Clears the 2D histogram */
+	void setCounts(const unsigned int* counts, unsigned int numBins, double min, double max);
+
+	void invalidate(); //!< the next build() rescans the volume
+
+	/** @brief value below which the given fraction of voxels lies, linear within a bin */
+	float getPercentile(float fraction) const;
+
+	/**
+	 * @brief auto-windowing: the window between two percentiles, as the uWindowingMinVal / uWindowingRange uniforms
+	 * @param lowerFraction, upperFraction i.e. 0.01 and 0.99 to ignore outliers
+	 * @return false if the histogram is empty
+	 */
+	bool getWindowing(float lowerFraction, float upperFraction, float& windowingMinVal, float& windowingRange) const;
+
+	/** @brief position of a source value in [min, max] of the volume, i.e. for transfer function control points given in source values */
+	float getRelativeValue(float value) const;
+
+	/**
+	 * @brief value histogram resampled to numBins (a divisor of the original bin count gives exact sums), scaled to a maximum of 1
+	 * @param logarithmic (optional) log(1 + count), so small peaks remain visible next to the background
+	 */
+	void getNormalized(unsigned int numBins, std::vector<float>& result, bool logarithmic = false) const;
+
+	/** @brief 2D histogram scaled to a maximum of 1, value-fastest, i.e. as a GL_R32F texture for the transfer function editor */
+	void getNormalized2D(std::vector<float>& result, bool logarithmic = true) const;
+
+	inline bool isEmpty() const { return m_numVoxels == 0; }
+	inline bool hasGradients() const { return !m_counts2D.empty(); }
+	inline double getMin() const { return m_min; }
+	inline double getMax() const { return m_max; }
+	inline float getMaxGradient() const { return m_maxGradient; }
+	inline unsigned long long getNumVoxels() const { return m_numVoxels; }
+	inline unsigned int getNumValueBins2D() const { return m_numValueBins2D; }
+	inline unsigned int getNumGradientBins() const { return m_numGradientBins; }
+	inline const std::vector<unsigned long long>& getCounts() const { return m_counts; }
+	inline const std::vector<unsigned long long>& getCounts2D() const { return m_counts2D; }
+};
+
+////// IMPLEMENTATION
+template<class T>
+void VolumeHistogram::gradientMagnitudes(const VolumeData<T>& volume, unsigned int y, unsigned int z, const float* scale, float* magnitudes)
+{
+	const size_t sx = volume.size_x, sy = volume.size_y, sz = volume.size_z;
+	const T* data = &volume.data[0];
+	const T* row = data + ((size_t) z * sy + y) * sx;
+	const T* below = data + ((size_t) z * sy + (y > 0 ? y - 1 : y)) * sx;
+	const T* above = data + ((size_t) z * sy + std::min<size_t>(y + 1, sy - 1)) * sx;
+	const T* back = data + ((size_t) (z > 0 ? z - 1 : z) * sy + y) * sx;
+	const T* front = data + (std::min<size_t>(z + 1, sz - 1) * sy + y) * sx;
+	for (size_t x = 0; x < sx; x++)
+	{
+		float gx = ((float) row[std::min(x + 1, sx - 1)] - (float) row[x > 0 ? x - 1 : x]) * scale[0];
+		float gy = ((float) above[x] - (float) below[x]) * scale[1];
+		float gz = ((float) front[x] - (float) back[x]) * scale[2];
+		magnitudes[x] = std::sqrt(gx * gx + gy * gy + gz * gz);
+	}
+}
+
+template<class T>
+bool VolumeHistogram::build(const VolumeData<T>& volume, bool gradients)
+{
+	const size_t sx = volume.size_x, sy = volume.size_y, sz = volume.size_z;
+	const void* source = volume.data.empty() ? nullptr : &volume.data[0];
+	if (source == m_source && sx == m_sourceSize[0] && sy == m_sourceSize[1] && sz == m_sourceSize[2]
+		&& m_min == (double) volume.min && m_max == (double) volume.max && (!gradients || hasGradients()))
+	{
+		return false;
+	}
+	invalidate();
+	if (source == nullptr || volume.data.size() != sx * sy * sz)
+	{
+		return false;
+	}
+
+	m_min = (double) volume.min;
+	m_max = (double) volume.max;
+	const double range = std::max(m_max - m_min, std::numeric_limits<double>::min());
+	const double binScale = (double) m_numBins / range;
+	const double binScale2D = (double) m_numValueBins2D / range;
+	auto binOf = [&](double value, double scale, unsigned int numBins) { return (unsigned int) std::max(0.0, std::min((value - m_min) * scale, (double) numBins - 1.0)); };
+
+	// halved central differences, per spacing of the smallest voxel edge
+	float spacing[3] = { volume.real_size_x, volume.real_size_y, volume.real_size_z };
+	if (!(spacing[0] > 0.0f && spacing[1] > 0.0f && spacing[2] > 0.0f)) { spacing[0] = spacing[1] = spacing[2] = 1.0f; }
+	const float smallest = std::min(spacing[0], std::min(spacing[1], spacing[2]));
+	const float scale[3] = { 0.5f * smallest / spacing[0], 0.5f * smallest / spacing[1], 0.5f * smallest / spacing[2] };
+
+	// values and the largest gradient magnitude, per task and merged under a lock
+	m_counts.assign(m_numBins, 0);
+	float maxGradient = 0.0f;
+	std::mutex mergeMutex;
+	THREADPOOL->parallelFor(0, sz, [&](size_t zBegin, size_t zEnd)
+	{
+		std::vector<unsigned long long> local(m_numBins, 0);
+		std::vector<float> magnitudes(gradients ? sx : 0);
+		float localMax = 0.0f;
+		for (size_t z = zBegin; z < zEnd; z++) { for (size_t y = 0; y < sy; y++)
+		{
+			const T* row = &volume.data[(z * sy + y) * sx];
+			for (size_t x = 0; x < sx; x++) { local[binOf((double) row[x], binScale, m_numBins)]++; }
+			if (gradients)
+			{
+				gradientMagnitudes(volume, (unsigned int) y, (unsigned int) z, scale, &magnitudes[0]);
+				localMax = std::max(localMax, *std::max_element(magnitudes.begin(), magnitudes.end()));
+			}
+		}}
+		std::lock_guard<std::mutex> lock(mergeMutex);
+		for (unsigned int b = 0; b < m_numBins; b++) { m_counts[b] += local[b]; }
+		maxGradient = std::max(maxGradient, localMax);
+	});
+
+	if (gradients)
+	{
+		m_maxGradient = std::max(maxGradient, std::numeric_limits<float>::min());
+		const double gradientScale = (double) m_numGradientBins / (double) m_maxGradient;
+		m_counts2D.assign((size_t) m_numValueBins2D * m_numGradientBins, 0);
+		THREADPOOL->parallelFor(0, sz, [&](size_t zBegin, size_t zEnd)
+		{
+			std::vector<unsigned long long> local((size_t) m_numValueBins2D * m_numGradientBins, 0);
+			std::vector<float> magnitudes(sx);
+			for (size_t z = zBegin; z < zEnd; z++) { for (size_t y = 0; y < sy; y++)
+			{
+				const T* row = &volume.data[(z * sy + y) * sx];
+				gradientMagnitudes(volume, (unsigned int) y, (unsigned int) z, scale, &magnitudes[0]);
+				for (size_t x = 0; x < sx; x++)
+				{
+					size_t g = std::min((size_t) ((double) magnitudes[x] * gradientScale), (size_t) m_numGradientBins - 1);
+					local[g * m_numValueBins2D + binOf((double) row[x], binScale2D, m_numValueBins2D)]++;
+				}
+			}}
+			std::lock_guard<std::mutex> lock(mergeMutex);
+			for (size_t b = 0; b < local.size(); b++) { m_counts2D[b] += local[b]; }
+		});
+	}
+
+	m_numVoxels = (unsigned long long) volume.data.size();
+	m_source = source;
+	m_sourceSize[0] = (unsigned int) sx;
+	m_sourceSize[1] = (unsigned int) sy;
+	m_sourceSize[2] = (unsigned int) sz;
+	finish();
+	return true;
+}
+
+#endif
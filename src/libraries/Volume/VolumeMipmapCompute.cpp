@@ -0,0 +1,79 @@
+#include "VolumeMipmapCompute.h"
+
+#include <Core/DebugLog.h>
+#include <Rendering/OpenGLContext.h>
+#include <Rendering/ShaderProgram.h>
+
+VolumeMipmapCompute::VolumeMipmapCompute(VolumeReduction::Reduction reduction, GLenum internalFormat)
+	: m_reduction(reduction)
+	, m_internalFormat(internalFormat)
+	, m_shader(nullptr)
+{
+}
+
+VolumeMipmapCompute::~VolumeMipmapCompute()
+{
+	release();
+}
+
+bool VolumeMipmapCompute::getImageFormat(GLenum internalFormat, std::string& imageType, std::string& imageDefine)
+{
+	imageDefine = "";
+	switch (internalFormat)
+	{
+	case GL_R8:    imageType = "r8"; break;
+	case GL_R16:   imageType = "r16"; break;
+	case GL_R16F:  imageType = "r16f"; break;
+	case GL_R32F:  imageType = "r32f"; break;
+	case GL_R8I:   imageType = "r8i"; imageDefine = "INTEGER_IMAGE"; break;
+	case GL_R16I:  imageType = "r16i"; imageDefine = "INTEGER_IMAGE"; break;
+	case GL_R32I:  imageType = "r32i"; imageDefine = "INTEGER_IMAGE"; break;
+	case GL_R8UI:  imageType = "r8ui"; imageDefine = "UNSIGNED_IMAGE"; break;
+	case GL_R16UI: imageType = "r16ui"; imageDefine = "UNSIGNED_IMAGE"; break;
+	case GL_R32UI: imageType = "r32ui"; imageDefine = "UNSIGNED_IMAGE"; break;
+	default: return false;
+	}
+	return true;
+}
+
+bool VolumeMipmapCompute::generate(GLuint texture, glm::ivec3 size, int numLevels)
+{
+	if (m_shader == nullptr)
+	{
+		std::string imageType, imageDefine;
+		if (!getImageFormat(m_internalFormat, imageType, imageDefine))
+		{
+			DEBUGLOG->log("ERROR: internal format is not supported for mipmapping: ", (int) m_internalFormat);
+			return false;
+		}
+
+		std::vector<std::string> defines(1, "IMAGE_TYPE " + imageType);
+		if (!imageDefine.empty()) { defines.push_back(imageDefine); }
+		switch (m_reduction)
+		{
+		case VolumeReduction::MAXIMUM: defines.push_back("MAXIMUM_MIPMAP"); break;
+		case VolumeReduction::MINIMUM: defines.push_back("MINIMUM_MIPMAP"); break;
+		default: defines.push_back("AVERAGE_MIPMAP"); break;
+		}
+		m_shader = new ShaderProgram("/compute/mipmap3D.glsl", defines);
+	}
+
+	m_shader->use();
+	const glm::ivec3 localSize(8, 8, 4); // LOCAL_SIZE_X, LOCAL_SIZE_Y, LOCAL_SIZE_Z of the shader
+	for (int level = 1; level < numLevels; level++)
+	{
+		size = glm::max(glm::ivec3(1), size / 2);
+		OPENGLCONTEXT->bindImageTextureToUnit(texture, IMAGE_UNIT_BASE, m_internalFormat, GL_READ_ONLY, level - 1, GL_TRUE);
+		OPENGLCONTEXT->bindImageTextureToUnit(texture, IMAGE_UNIT_TARGET, m_internalFormat, GL_WRITE_ONLY, level, GL_TRUE);
+		glDispatchCompute((size.x + localSize.x - 1) / localSize.x, (size.y + localSize.y - 1) / localSize.y, (size.z + localSize.z - 1) / localSize.z);
+		glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT); // the next level reads this one
+	}
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+	return true;
+}
+
+void VolumeMipmapCompute::release()
+{
+	delete m_shader;
+	m_shader = nullptr;
+}
@@ -0,0 +1,48 @@
+#ifndef VOLUME_VOLUMEMIPMAPCOMPUTE_H_
+#define VOLUME_VOLUMEMIPMAPCOMPUTE_H_
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <string>
+
+#include "VolumeReduction.h"
+
+class ShaderProgram;
+
+/**
+ * @brief mip levels of a GPU-resident 3D texture with compute/mipmap3D.glsl, one dispatch per level.
+ *        The 3D counterpart of compute/mipmap.glsl, with the reductions and non-power-of-two handling of VolumeReduction::downsample(),
+ *        for volumes that have no CPU copy. glGenerateMipmap always averages.
+ */
+class VolumeMipmapCompute
+{
+public:
+	static const int IMAGE_UNIT_BASE = 0;   //!< see compute/mipmap3D.glsl
+	static const int IMAGE_UNIT_TARGET = 1; //!< see compute/mipmap3D.glsl
+
+protected:
+	VolumeReduction::Reduction m_reduction;
+	GLenum m_internalFormat;
+	ShaderProgram* m_shader; //!< created on first use
+
+	/** @brief image format qualifier of an internal format and the define for its image type, false if it is not supported */
+	static bool getImageFormat(GLenum internalFormat, std::string& imageType, std::string& imageDefine);
+
+public:
+	/** @param internalFormat of the textures to mipmap, i.e. GL_R16F, GL_R8 or GL_R16I */
+	VolumeMipmapCompute(VolumeReduction::Reduction reduction = VolumeReduction::AVERAGE, GLenum internalFormat = GL_R16F);
+	virtual ~VolumeMipmapCompute();
+
+	/**
+	 * @brief fill levels 1 .. numLevels - 1 from level 0. Binds the levels to IMAGE_UNIT_BASE and IMAGE_UNIT_TARGET
+	 * @param texture with immutable storage of at least numLevels levels (i.e. from loadTo3DTexture()) in the internal format
+	 * @param size of level 0
+	 * @return false if the internal format is not supported
+	 */
+	bool generate(GLuint texture, glm::ivec3 size, int numLevels);
+
+	void release(); //!< delete the compute shader
+};
+
+#endif
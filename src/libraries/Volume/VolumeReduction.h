@@ -0,0 +1,189 @@
+#ifndef VOLUME_VOLUMEREDUCTION_H_
+#define VOLUME_VOLUMEREDUCTION_H_
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+
+#include <Core/ThreadPool.h>
+#include <Core/VolumeData.h>
+
+namespace VolumeReduction
+{
+	enum Reduction {
+		AVERAGE, //!< like glGenerateMipmap
+		MAXIMUM, //!< conservative for empty space skipping and max-based level of detail
+		MINIMUM
+	};
+
+	/** @brief levels of a mip pyramid, level 0 references the source volume */
+	template<class T>
+	struct Pyramid
+	{
+		std::vector< std::vector<T> > mips; //!< voxels of levels 1 and up
+		std::vector< VolumeDataView<T> > levels; //!< i.e. for loadTo3DTexture() or IncrementalTextureUploader::begin()
+	};
+
+	/** @brief number of levels of a full OpenGL mip pyramid down to a single voxel */
+	inline unsigned int getNumLevels(unsigned int size_x, unsigned int size_y, unsigned int size_z)
+	{
+		unsigned int numLevels = 1;
+		for (unsigned int size = std::max(size_x, std::max(size_y, size_z)); size > 1; size /= 2) { numLevels++; }
+		return numLevels;
+	}
+
+	/**
+	 * @brief next mip level on the thread pool. Sizes are halved and rounded down like OpenGL mip levels. Along an odd axis the
+	 *        last voxel reduces three source voxels instead of two, so no source voxel is dropped (which matters for MAXIMUM and MINIMUM)
+	 */
+	template<class T>
+	void downsample(const VolumeDataView<T>& level, Reduction reduction, std::vector<T>& result, unsigned int& size_x, unsigned int& size_y, unsigned int& size_z);
+
+	/**
+	 * @brief mip pyramid of a volume, one level after the other, each on the thread pool
+	 * @param numLevels (optional) including level 0, 0 for a full pyramid
+	 */
+	template<class T>
+	void buildPyramid(const VolumeDataView<T>& volume, Reduction reduction, Pyramid<T>& pyramid, unsigned int numLevels = 0);
+
+	/**
+	 * @brief mean of every block of factor^3 voxels on the thread pool, blocks at the far borders may be partial
+	 * @param result will hold the means, x-fastest
+	 * @param size will receive the number of blocks per axis
+	 */
+	template<class T>
+	void averageBlocks(const VolumeDataView<T>& volume, unsigned int factor, std::vector<float>& result, unsigned int* size);
+	template<class T>
+	inline void averageBlocks(const VolumeData<T>& volume, unsigned int factor, std::vector<float>& result, unsigned int* size) { averageBlocks(VolumeDataView<T>(volume), factor, result, size); }
+}
+
+////// IMPLEMENTATION
+template<class T>
+void VolumeReduction::averageBlocks(const VolumeDataView<T>& volume, unsigned int factor, std::vector<float>& result, unsigned int* size)
+{
+	const size_t f = std::max(1u, factor);
+	const size_t sx = volume.size_x, sy = volume.size_y, sz = volume.size_z;
+	size[0] = (unsigned int) ((sx + f - 1) / f);
+	size[1] = (unsigned int) ((sy + f - 1) / f);
+	size[2] = (unsigned int) ((sz + f - 1) / f);
+	result.assign((size_t) size[0] * size[1] * size[2], 0.0f);
+	if (volume.data == nullptr || volume.getNumVoxels() == 0) { return; }
+
+	// one task per row of blocks: sum up the voxel rows it covers, then per block along x
+	THREADPOOL->parallelFor(0, (size_t) size[1] * size[2], [&](size_t begin, size_t end)
+	{
+		std::vector<float> rowSum(sx);
+		for (size_t row = begin; row < end; row++)
+		{
+			const size_t by = row % size[1], bz = row / size[1];
+			const size_t yEnd = std::min<size_t>((by + 1) * f, sy), zEnd = std::min<size_t>((bz + 1) * f, sz);
+			std::fill(rowSum.begin(), rowSum.end(), 0.0f);
+			for (size_t z = bz * f; z < zEnd; z++) { for (size_t y = by * f; y < yEnd; y++)
+			{
+				const T* voxels = &volume.data[(z * sy + y) * sx];
+				for (size_t x = 0; x < sx; x++) { rowSum[x] += (float) voxels[x]; }
+			}}
+
+			const float rows = (float) ((yEnd - by * f) * (zEnd - bz * f));
+			for (size_t bx = 0; bx < size[0]; bx++)
+			{
+				const size_t xBegin = bx * f, xEnd = std::min<size_t>(xBegin + f, sx);
+				float sum = 0.0f;
+				for (size_t x = xBegin; x < xEnd; x++) { sum += rowSum[x]; }
+				result[row * size[0] + bx] = sum / (rows * (float) (xEnd - xBegin));
+			}
+		}
+	}, 1);
+}
+
+template<class T>
+void VolumeReduction::downsample(const VolumeDataView<T>& level, Reduction reduction, std::vector<T>& result, unsigned int& size_x, unsigned int& size_y, unsigned int& size_z)
+{
+	const size_t sx = level.size_x, sy = level.size_y, sz = level.size_z;
+	size_x = std::max(1u, level.size_x / 2);
+	size_y = std::max(1u, level.size_y / 2);
+	size_z = std::max(1u, level.size_z / 2);
+	result.resize((size_t) size_x * size_y * size_z);
+	if (level.data == nullptr) { return; }
+
+	// source voxels [begin, end) along an axis that reduce to target voxel i
+	auto footprint = [](size_t i, size_t targetSize, size_t sourceSize, size_t& begin, size_t& end)
+	{
+		begin = std::min(2 * i, sourceSize - 1);
+		end = (i + 1 == targetSize) ? sourceSize : std::min(2 * i + 2, sourceSize);
+	};
+
+	const size_t tx = size_x, ty = size_y;
+	THREADPOOL->parallelFor(0, (size_t) size_y * size_z, [&](size_t begin, size_t end)
+	{
+		// source rows of the footprint reduced into one row first, then along x
+		std::vector<double> row(sx);
+		for (size_t target = begin; target < end; target++)
+		{
+			size_t y = target % ty, z = target / ty;
+			size_t yBegin, yEnd, zBegin, zEnd;
+			footprint(y, ty, sy, yBegin, yEnd);
+			footprint(z, size_z, sz, zBegin, zEnd);
+
+			bool first = true;
+			for (size_t sourceZ = zBegin; sourceZ < zEnd; sourceZ++) { for (size_t sourceY = yBegin; sourceY < yEnd; sourceY++)
+			{
+				const T* src = level.data + (sourceZ * sy + sourceY) * sx;
+				if (first)
+				{
+					for (size_t x = 0; x < sx; x++) { row[x] = (double) src[x]; }
+					first = false;
+				}
+				else if (reduction == AVERAGE) { for (size_t x = 0; x < sx; x++) { row[x] += (double) src[x]; } }
+				else if (reduction == MAXIMUM) { for (size_t x = 0; x < sx; x++) { row[x] = std::max(row[x], (double) src[x]); } }
+				else { for (size_t x = 0; x < sx; x++) { row[x] = std::min(row[x], (double) src[x]); } }
+			}}
+			const double rows = (double) ((yEnd - yBegin) * (zEnd - zBegin));
+
+			T* dst = &result[target * tx];
+			for (size_t x = 0; x < tx; x++)
+			{
+				size_t xBegin, xEnd;
+				footprint(x, tx, sx, xBegin, xEnd);
+				double value = row[xBegin];
+				for (size_t i = xBegin + 1; i < xEnd; i++)
+				{
+					if (reduction == AVERAGE) { value += row[i]; }
+					else if (reduction == MAXIMUM) { value = std::max(value, row[i]); }
+					else { value = std::min(value, row[i]); }
+				}
+				if (reduction == AVERAGE)
+				{
+					value /= rows * (double) (xEnd - xBegin);
+					if (std::numeric_limits<T>::is_integer) { value = std::floor(value + 0.5); }
+				}
+				dst[x] = (T) value;
+			}
+		}
+	});
+}
+
+template<class T>
+void VolumeReduction::buildPyramid(const VolumeDataView<T>& volume, Reduction reduction, Pyramid<T>& pyramid, unsigned int numLevels)
+{
+	const unsigned int maxLevels = getNumLevels(volume.size_x, volume.size_y, volume.size_z);
+	numLevels = (numLevels == 0) ? maxLevels : std::min(numLevels, maxLevels);
+
+	pyramid.mips.clear();
+	pyramid.mips.reserve(numLevels); // views into mips must stay valid
+	pyramid.levels.assign(1, volume);
+	while (pyramid.levels.size() < numLevels)
+	{
+		pyramid.mips.push_back(std::vector<T>());
+		VolumeDataView<T> next = pyramid.levels.back(); // keeps min and max of the source, so windowing stays consistent across levels
+		downsample(pyramid.levels.back(), reduction, pyramid.mips.back(), next.size_x, next.size_y, next.size_z);
+		next.data = &pyramid.mips.back()[0];
+		next.real_size_x = volume.real_size_x * (float) volume.size_x / (float) next.size_x;
+		next.real_size_y = volume.real_size_y * (float) volume.size_y / (float) next.size_y;
+		next.real_size_z = volume.real_size_z * (float) volume.size_z / (float) next.size_z;
+		pyramid.levels.push_back(next);
+	}
+}
+
+#endif
@@ -0,0 +1,84 @@
+#version 430 core
+
+////////////////////////////////     DEFINES      ////////////////////////////////
+/*********** LIST OF POSSIBLE DEFINES ***********
+	LOCAL_SIZE_X <int>
+	LOCAL_SIZE_Y <int>
+***********/
+
+#ifndef LOCAL_SIZE_X
+#define LOCAL_SIZE_X 16
+#endif
+#ifndef LOCAL_SIZE_Y
+#define LOCAL_SIZE_Y 16
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+
+// one slice of the light volume per dispatch, see LightVolume
+layout (local_size_x = LOCAL_SIZE_X, local_size_y = LOCAL_SIZE_Y) in;
+
+// opacity between each light voxel and the light
+layout(binding = 7, r16f) coherent uniform image3D light_image;
+
+uniform sampler3D volume_texture;
+uniform sampler1D transferFunctionTex;
+uniform float uWindowingRange;  // windowing value range
+uniform float uWindowingMinVal; // windowing lower bound
+
+uniform int uAxis;          // main axis of the light direction, slices are perpendicular to it
+uniform int uSlice;         // slice to compute
+uniform int uPreviousSlice; // neighbouring slice towards the light, < 0 for the slice closest to the light
+uniform vec2 uOffset;       // position of the point towards the light in the previous slice, along (uAxis + 1) % 3 and (uAxis + 2) % 3
+uniform float uStepOpacity; // ALPHA_SCALE * distance between a point and its predecessor in texture space
+
+ivec3 toVoxel(ivec2 lateral, int slice)
+{
+	ivec3 voxel;
+	voxel[uAxis] = slice;
+	voxel[(uAxis + 1) % 3] = lateral.x;
+	voxel[(uAxis + 2) % 3] = lateral.y;
+	return voxel;
+}
+
+/**
+* @brief light leaving a voxel of the previous slice: what reached it, attenuated by the voxel itself
+* @return 1 outside the volume
+*/
+float leaving(ivec2 lateral, ivec3 size)
+{
+	ivec3 voxel = toVoxel(lateral, uPreviousSlice);
+	if ( any( lessThan(voxel, ivec3(0)) ) || any( greaterThanEqual(voxel, size) ) )
+	{
+		return 1.0;
+	}
+
+	float value = texture(volume_texture, (vec3(voxel) + 0.5) / vec3(size)).r;
+	float rel = (value - uWindowingMinVal) / uWindowingRange;
+	float alpha = texture(transferFunctionTex, max(0.0, min(1.0, rel))).a;
+	return (1.0 - imageLoad(light_image, voxel).r) * (1.0 - min(1.0, alpha * uStepOpacity));
+}
+
+void main()
+{
+	ivec3 size = imageSize(light_image);
+	ivec2 lateral = ivec2( gl_GlobalInvocationID.xy );
+	ivec3 voxel = toVoxel(lateral, uSlice);
+	if ( any( greaterThanEqual(voxel, size) ) )
+	{
+		return;
+	}
+
+	float transmittance = 1.0;
+	if (uPreviousSlice >= 0)
+	{
+		// bilinear between the four voxels around the point towards the light
+		ivec2 corner = lateral + ivec2( floor(uOffset) );
+		vec2 f = uOffset - floor(uOffset);
+		float bottom = mix( leaving(corner, size), leaving(corner + ivec2(1, 0), size), f.x );
+		float top = mix( leaving(corner + ivec2(0, 1), size), leaving(corner + ivec2(1, 1), size), f.x );
+		transmittance = mix( bottom, top, f.y );
+	}
+
+	imageStore( light_image, voxel, vec4(1.0 - transmittance) );
+}
@@ -0,0 +1,115 @@
+#version 430 core
+
+////////////////////////////////     DEFINES      ////////////////////////////////
+/*********** LIST OF POSSIBLE DEFINES ***********
+	LOCAL_SIZE_X <int>
+	LOCAL_SIZE_Y <int>
+	LOCAL_SIZE_Z <int>
+	IMAGE_TYPE <internalType>
+	INTEGER_IMAGE
+	UNSIGNED_IMAGE
+
+	AVERAGE_MIPMAP
+	MAXIMUM_MIPMAP
+	MINIMUM_MIPMAP
+***********/
+
+#ifndef LOCAL_SIZE_X
+#define LOCAL_SIZE_X 8
+#endif
+#ifndef LOCAL_SIZE_Y
+#define LOCAL_SIZE_Y 8
+#endif
+#ifndef LOCAL_SIZE_Z
+#define LOCAL_SIZE_Z 4
+#endif
+
+#ifndef IMAGE_TYPE
+#define IMAGE_TYPE r16f
+#endif
+
+// image and value types matching IMAGE_TYPE, i.e. r16i with INTEGER_IMAGE
+#if defined(INTEGER_IMAGE)
+	#define IMAGE_3D iimage3D
+	#define VALUE_TYPE ivec4
+#elif defined(UNSIGNED_IMAGE)
+	#define IMAGE_3D uimage3D
+	#define VALUE_TYPE uvec4
+#else
+	#define IMAGE_3D image3D
+	#define VALUE_TYPE vec4
+#endif
+
+// standard behaviour: average
+#ifndef MAXIMUM_MIPMAP
+#ifndef MINIMUM_MIPMAP
+#ifndef AVERAGE_MIPMAP
+#define AVERAGE_MIPMAP
+#endif
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////
+
+// specify local work group size
+layout (local_size_x = LOCAL_SIZE_X, local_size_y = LOCAL_SIZE_Y, local_size_z = LOCAL_SIZE_Z) in;
+
+// specify level to mipmap
+layout(binding = 0, IMAGE_TYPE) readonly uniform IMAGE_3D mipmap_base;
+
+// specify level to write to
+layout(binding = 1, IMAGE_TYPE) writeonly uniform IMAGE_3D mipmap_target;
+
+void main()
+{
+	// read x, y & z index of global invocation as index to write to
+	ivec3 index = ivec3( gl_GlobalInvocationID.xyz );
+	ivec3 baseSize = imageSize( mipmap_base );
+	ivec3 targetSize = imageSize( mipmap_target );
+	if ( any( greaterThanEqual(index, targetSize) ) )
+	{
+		return;
+	}
+
+	// voxels of the base level to reduce: two per axis, three for the last voxel along an odd axis (non-power-of-two sizes), one along an axis of size 1
+	ivec3 begin = min( index * 2, baseSize - 1 );
+	ivec3 end = min( index * 2 + 2, baseSize );
+	ivec3 last = ivec3( equal(index, targetSize - 1) ); // mix() with a bvec3 selector needs 4.50 for integer vectors
+	end = last * baseSize + (1 - last) * end;
+
+	VALUE_TYPE value = imageLoad( mipmap_base, begin );
+	#ifdef AVERAGE_MIPMAP
+	vec4 sum = vec4(0);
+	#endif
+	for (int z = begin.z; z < end.z; z++) {
+	for (int y = begin.y; y < end.y; y++) {
+	for (int x = begin.x; x < end.x; x++)
+	{
+		VALUE_TYPE val = imageLoad( mipmap_base, ivec3(x, y, z) );
+
+		#ifdef AVERAGE_MIPMAP
+		sum += vec4(val);
+		#endif
+
+		#ifdef MAXIMUM_MIPMAP
+		value = max(value, val);
+		#endif
+
+		#ifdef MINIMUM_MIPMAP
+		value = min(value, val);
+		#endif
+	}}}
+
+	#ifdef AVERAGE_MIPMAP
+	ivec3 count = end - begin;
+	sum /= float(count.x * count.y * count.z);
+	#if defined(INTEGER_IMAGE) || defined(UNSIGNED_IMAGE)
+	value = VALUE_TYPE( floor(sum + 0.5) );
+	#else
+	value = sum;
+	#endif
+	#endif
+
+	// write value
+	imageStore( mipmap_target, index, value );
+}
@@ -109,6 +109,7 @@ uniform float uWindowingMinVal; // windowing lower bound
 
 // ray traversal related uniforms
 uniform float uStepSize;		// ray sampling step size
+uniform vec3 uCropExtent = vec3(1.0); // of a cropped volume texture in texture coordinates of the whole volume (see VolumeCrop), step sizes refer to the whole volume
 
 uniform mat4 uProjection;
 uniform mat4 uViewToTexture;
@@ -239,6 +240,14 @@ vec4 beerLambertEmissionAbsorptionToColorTransmission(vec3 E, float A, float z)
 	return vec4(C, T);
 }
 
+/**
+ * @brief distance between two uvw coordinates of the volume texture, in texture coordinates of the whole volume
+ */
+float uvwDistance(vec3 fromUVW, vec3 toUVW)
+{
+	return length((toUVW - fromUVW) * uCropExtent);
+}
+
 /**
  * @brief retrieve value for a maximum intensity projection	
  * 
@@ -252,7 +261,7 @@ vec4 beerLambertEmissionAbsorptionToColorTransmission(vec3 E, float A, float z)
  */
 RaycastResult raycast(vec3 startUVW, vec3 endUVW, float stepSize, float startDistance, float endDistance)
 {
-	float parameterStepSize = stepSize / length(endUVW - startUVW); // necessary parametric steps to get from start to end
+	float parameterStepSize = stepSize / uvwDistance(startUVW, endUVW); // necessary parametric steps to get from start to end
 	float distanceStepSize = parameterStepSize * (endDistance - startDistance); // distance of a step
 
 	RaycastResult result;
@@ -310,7 +319,7 @@ RaycastResult raycast(vec3 startUVW, vec3 endUVW, float stepSize, float startDis
 		#ifdef LEVEL_OF_DETAIL
 			float curLod = max(0.0, min(1.0, ((curDistance - uLodBegin) / uLodRange) ) ) * uLodMaxLevel; // bad approximation, but idc for now
 			float curStepSize = stepSize * pow(2.0, curLod);
-			parameterStepSize = curStepSize / length(endUVW - startUVW); // parametric step size (scaled to 0..1)
+			parameterStepSize = curStepSize / uvwDistance(startUVW, endUVW); // parametric step size (scaled to 0..1)
 			distanceStepSize = parameterStepSize * (endDistance - startDistance); // distance of a step
 			curSample.value = textureLod(volume_texture, curUVW, curLod).r;
 		#else
@@ -411,7 +420,7 @@ RaycastResult raycast(vec3 startUVW, vec3 endUVW, float stepSize, float startDis
 				float shadow = 0.0;
 				for (int j = 1; j <= min(uNumSamples - (i * num_opacity_samples), num_opacity_samples); j++)
 				{
-					vec3 opacitySampleUVW = curUVW + curStepSize * 1.0 * pow(2.0,float(j)) * vec3(cubemapSampleDir.x, (cubemapSampleDir.z), -cubemapSampleDir.y);
+					vec3 opacitySampleUVW = curUVW + curStepSize * 1.0 * pow(2.0,float(j)) * vec3(cubemapSampleDir.x, (cubemapSampleDir.z), -cubemapSampleDir.y) / uCropExtent;
 					
 					#ifdef CULL_PLANES // lazy 
 					if ( any( lessThan(opacitySampleUVW, uCullMin) ) ||  any( greaterThan(opacitySampleUVW, uCullMax) ) ) // outside bounds?
@@ -451,16 +460,16 @@ RaycastResult raycast(vec3 startUVW, vec3 endUVW, float stepSize, float startDis
 				#ifdef LEVEL_OF_DETAIL
 					float shadow_lod = max(1.0, min(uLodMaxLevel, curLod + 0.5 ) );
 					float shadow_stepSize = stepSize * pow(2.0, shadow_lod + 1.0);
-					vec3 shadow_sampleUVW = curUVW + uShadowRayDirection * ( float(i) * shadow_stepSize );
+					vec3 shadow_sampleUVW = curUVW + (uShadowRayDirection / uCropExtent) * ( float(i) * shadow_stepSize );
 					float shadow_value = textureLod(volume_texture, shadow_sampleUVW, shadow_lod).r;
 				#else
 					float shadow_stepSize = curStepSize * 2.5;
-					vec3 shadow_sampleUVW = curUVW + uShadowRayDirection * ( float(i) * shadow_stepSize );
+					vec3 shadow_sampleUVW = curUVW + (uShadowRayDirection / uCropExtent) * ( float(i) * shadow_stepSize );
 					float shadow_value = texture(volume_texture, shadow_sampleUVW).r;
 				#endif
 			
 				#ifdef EMISSION_ABSORPTION_RAW
-					float shadow_parameterStepSize = shadow_stepSize / length(endUVW - startUVW); // parametric step size (scaled to 0..1)
+					float shadow_parameterStepSize = shadow_stepSize / uvwDistance(startUVW, endUVW); // parametric step size (scaled to 0..1)
 					float shadow_distanceStepSize = shadow_parameterStepSize * (endDistance - startDistance); // distance of a step
 					float shadow_alpha = (1.0 - exp( - (pow(transferFunctionRaw( shadow_value ).a * ABSORPTION_SCALE, 2.0) ) * shadow_distanceStepSize  * 2.0 ));
 				#else
@@ -6,21 +6,28 @@
 	ALPHA_SCALE <float>
 	AMBIENT_OCCLUSION
 		AMBIENT_OCCLUSION_SCALE <float>
+		AMBIENT_OCCLUSION_VOLUME
 	CULL_PLANES
 	COLOR_SCALE <float>
 	CUBEMAP_SAMPLING
 		CUBEMAP_STRENGTH <float>
+	DISTANCE_SKIPPING
 	ERT_THRESHOLD <float>
 	EMISSION_ABSORPTION_RAW
 		EMISSION_SCALE <float>
 		ABSORPTION_SCALE <float>
+	EMPTY_SPACE_SKIPPING
 	FIRST_HIT
+	GRADIENT_SHADING
+		GRADIENT_SHADING_AMBIENT <float>
+		GRADIENT_SHADING_SCALE <float>
 	LEVEL_OF_DETAIL
 	OCCLUSION_MAP
 	RANDOM_OFFSET
 	SCENE_DEPTH
 	SHADOW_SAMPLING
 		SHADOW_SCALE <float>
+		SHADOW_VOLUME
 	STEREO_SINGLE_PASS
 		STEREO_SINGLE_OUTPUT
 ***********/
@@ -62,6 +69,16 @@ float rand(vec2 co) { //!< http://stackoverflow.com/questions/4200224/random-noi
 	#endif
 #endif
 
+#ifdef GRADIENT_SHADING
+	#ifndef GRADIENT_SHADING_AMBIENT
+	#define GRADIENT_SHADING_AMBIENT 0.3
+	#endif
+
+	#ifndef GRADIENT_SHADING_SCALE
+	#define GRADIENT_SHADING_SCALE 8.0 // 1 / relative gradient magnitude at which a sample counts as surface
+	#endif
+#endif
+
 #ifdef SHADOW_SAMPLING
 	#ifndef SHADOW_SCALE
 	#define SHADOW_SCALE 1.0
@@ -91,6 +108,23 @@ uniform sampler3D volume_texture; // volume 3D integer texture sampler
 	uniform sampler2D scene_depth_map;   // depth map of scene
 #endif
 
+#if defined(EMPTY_SPACE_SKIPPING) || defined(DISTANCE_SKIPPING)
+	// per macro cell: > 0 if visible with the current transfer function, see MacroCellGrid
+	// with DISTANCE_SKIPPING: Chebyshev distance in cells to the nearest visible cell / 255 instead
+	uniform sampler3D macro_cell_texture;
+	uniform vec3 uVolumeSize;             // in voxels
+	uniform float uMacroCellSize;         // voxels per macro cell edge
+#endif
+
+#if defined(AMBIENT_OCCLUSION) && defined(AMBIENT_OCCLUSION_VOLUME)
+	uniform sampler3D occlusion_texture; // mean transfer function alpha around each block of voxels, see AmbientOcclusionVolume
+#endif
+
+#ifdef GRADIENT_SHADING
+	uniform sampler3D gradient_texture; // per voxel: unit gradient and magnitude relative to the largest one, see GradientVolume
+	uniform vec3 uLightDirection;       // towards the light, in texture space
+#endif
+
 #ifdef STEREO_SINGLE_PASS
 	#ifdef STEREO_SINGLE_OUTPUT
 		layout(binding = 0, rgba16f) restrict uniform image2D stereo_image;
@@ -124,6 +158,7 @@ uniform float uWindowingMinVal; // windowing lower bound
 
 // ray traversal related uniforms
 uniform float uStepSize;	// ray sampling step size
+uniform vec3 uCropExtent = vec3(1.0); // of a cropped volume texture in texture coordinates of the whole volume (see VolumeCrop), step sizes refer to the whole volume
 
 #ifdef LEVEL_OF_DETAIL
 	uniform float uLodMaxLevel; // factor with wich depth influences sampled LoD and step size 
@@ -138,6 +173,9 @@ uniform mat4 uProjection;
 #ifdef SHADOW_SAMPLING
 	uniform vec3 uShadowRayDirection; // simplified: in texture space
 	uniform int uShadowRayNumSteps;
+	#ifdef SHADOW_VOLUME
+		uniform sampler3D light_texture; // opacity between each point and the light along uShadowRayDirection, see LightVolume
+	#endif
 #endif
 
 #ifdef CULL_PLANES
@@ -226,6 +264,41 @@ struct RaycastResult
 	}
 #endif
 
+#if defined(EMPTY_SPACE_SKIPPING) || defined(DISTANCE_SKIPPING)
+	/**
+	* @brief ray parameter at which the ray leaves the macro cell containing the sample at t, if that cell is empty.
+	*        With DISTANCE_SKIPPING, the ray leaves the whole block of empty cells around it instead
+	* @return t if the cell is visible
+	*/
+	float leaveEmptyCell(vec3 startUVW, vec3 endUVW, float t)
+	{
+		// ray in macro cell coordinates: cell c holds the samples between voxel centers c * uMacroCellSize and (c + 1) * uMacroCellSize
+		vec3 origin = (startUVW * uVolumeSize - 0.5) / uMacroCellSize;
+		vec3 dir = (endUVW - startUVW) * uVolumeSize / uMacroCellSize;
+		ivec3 cell = clamp( ivec3( floor(origin + t * dir) ), ivec3(0), textureSize(macro_cell_texture, 0) - 1 );
+		#ifdef DISTANCE_SKIPPING
+			// nearest visible cell is emptyCells away, so all cells within emptyCells - 1 of this one are empty
+			float emptyCells = floor( texelFetch(macro_cell_texture, cell, 0).r * 255.0 + 0.5 );
+			if ( emptyCells < 1.0 )
+			{
+				return t;
+			}
+		#else
+			float emptyCells = 1.0;
+			if ( texelFetch(macro_cell_texture, cell, 0).r > 0.0 )
+			{
+				return t;
+			}
+		#endif
+
+		// distance to the far faces of the empty block, axis parallel rays never leave through the faces of that axis
+		dir = mix( vec3(1e-6), dir, greaterThan( abs(dir), vec3(1e-6) ) );
+		vec3 farFace = vec3(cell) + mix( vec3(1.0 - emptyCells), vec3(emptyCells), step(vec3(0.0), dir) );
+		vec3 tFar = ( farFace - origin ) / dir;
+		return max(t, min(tFar.x, min(tFar.y, tFar.z)));
+	}
+#endif
+
 /**
 * @brief 'transfer-function' applied to value.
 * @param value to be mapped to a color
@@ -244,6 +317,14 @@ vec4 transferFunction(float value, float stepSize)
 	return color;
 }
 
+/**
+ * @brief distance between two uvw coordinates of the volume texture, in texture coordinates of the whole volume
+ */
+float uvwDistance(vec3 fromUVW, vec3 toUVW)
+{
+	return length((toUVW - fromUVW) * uCropExtent);
+}
+
 /**
  * @brief retrieve color for a front-to-back raycast between two points in the volume
  * 
@@ -263,7 +344,7 @@ RaycastResult raycast(vec3 startUVW, vec3 endUVW, float stepSize, float startDep
 #endif
 )
 {
-	float parameterStepSize = stepSize / length(endUVW - startUVW); // parametric step size (scaled to 0..1)
+	float parameterStepSize = stepSize / uvwDistance(startUVW, endUVW); // parametric step size (scaled to 0..1)
 	
 	RaycastResult result;
 	result.color = vec4(0);
@@ -293,6 +374,16 @@ RaycastResult raycast(vec3 startUVW, vec3 endUVW, float stepSize, float startDep
 			}
 		#endif
 
+		#if defined(EMPTY_SPACE_SKIPPING) || defined(DISTANCE_SKIPPING)
+			float tLeave = leaveEmptyCell(startUVW, endUVW, t);
+			if (tLeave > t)
+			{
+				// first sample behind the empty cells, on the regular sample positions so skipping does not shift the sampling pattern
+				t += max(1.0, ceil( (tLeave - t) / parameterStepSize )) * parameterStepSize;
+				continue;
+			}
+		#endif
+
 		float curDepth = mix( startDepth, endDepth, t);
 
 		VolumeSample curSample;
@@ -301,7 +392,7 @@ RaycastResult raycast(vec3 startUVW, vec3 endUVW, float stepSize, float startDep
 		#ifdef LEVEL_OF_DETAIL
 			float curLod = min( max(0.0, min(1.0, ((curDepth - uLodBegin) / uLodRange) ) ) * uLodMaxLevel, float( textureQueryLevels( volume_texture ) - 1) ); // bad approximation, but idc for now
 			float curStepSize = stepSize * pow(2.0, curLod);
-			parameterStepSize = curStepSize / length(endUVW - startUVW); // parametric step size (scaled to 0..1)
+			parameterStepSize = curStepSize / uvwDistance(startUVW, endUVW); // parametric step size (scaled to 0..1)
 			curSample.value = textureLod(volume_texture, curUVW, curLod).r;
 		#else
 			float curStepSize = stepSize;
@@ -347,7 +438,19 @@ RaycastResult raycast(vec3 startUVW, vec3 endUVW, float stepSize, float startDep
 			continue; 
 		} // skip invisible voxel
 
-		#ifdef AMBIENT_OCCLUSION
+		#ifdef GRADIENT_SHADING
+			// a single fetch of the precomputed gradient, homogeneous regions stay unshaded
+			vec4 gradient = texture(gradient_texture, curUVW);
+			float diffuse = abs( dot( gradient.xyz, uLightDirection ) ) / max( length(gradient.xyz), 0.001 );
+			float surface = min( 1.0, gradient.a * GRADIENT_SHADING_SCALE );
+			sampleColor.rgb *= mix( 1.0, GRADIENT_SHADING_AMBIENT + (1.0 - GRADIENT_SHADING_AMBIENT) * diffuse, surface );
+		#endif
+
+		#if defined(AMBIENT_OCCLUSION) && defined(AMBIENT_OCCLUSION_VOLUME)
+			// precomputed mean alpha of the neighbourhood, scaled like the 14 samples below
+			float occlusion = texture(occlusion_texture, curUVW).r * ALPHA_SCALE * curStepSize * AMBIENT_OCCLUSION_SCALE;
+			sampleColor.rgb *= max(0.0, min( 1.0, 1.0 - occlusion));
+		#elif defined(AMBIENT_OCCLUSION)
 			float occlusion = 0.0;	
 			float numSamples = 8.0;
 			for (int i = -1; i <= 1; i+= 2) {	for (int j = -1; j <= 1; j+= 2) { for (int k = -1; k <= 1; k+= 2)
@@ -423,7 +526,7 @@ RaycastResult raycast(vec3 startUVW, vec3 endUVW, float stepSize, float startDep
 				float shadow = 0.0;
 				for (int j = 1; j <= min(uNumSamples - (i * num_opacity_samples), num_opacity_samples); j++)
 				{
-					vec3 opacitySampleUVW = curUVW + curStepSize * 1.0 * pow(2.0,float(j)) * vec3(cubemapSampleDir.x, (cubemapSampleDir.z), -cubemapSampleDir.y);
+					vec3 opacitySampleUVW = curUVW + curStepSize * 1.0 * pow(2.0,float(j)) * vec3(cubemapSampleDir.x, (cubemapSampleDir.z), -cubemapSampleDir.y) / uCropExtent;
 					
 					#ifdef CULL_PLANES // lazy 
 					if ( any( lessThan(opacitySampleUVW, uCullMin) ) ||  any( greaterThan(opacitySampleUVW, uCullMax) ) ) // outside bounds?
@@ -455,23 +558,27 @@ RaycastResult raycast(vec3 startUVW, vec3 endUVW, float stepSize, float startDep
 			);
 		#endif
 
-		#ifdef SHADOW_SAMPLING
+		#if defined(SHADOW_SAMPLING) && defined(SHADOW_VOLUME)
+			// precomputed by sweeping the volume along the light direction
+			float shadow = texture(light_texture, curUVW).r * SHADOW_SCALE;
+			sampleColor.rgb *= max(0.25, min( 1.0, 1.0 - shadow));
+		#elif defined(SHADOW_SAMPLING)
 			float shadow = 0.0;
 			for (int i = 1; i < uShadowRayNumSteps; i++)
 			{	
 				#ifdef LEVEL_OF_DETAIL
 					float shadow_lod = max(1.0, min(uLodMaxLevel, curLod + 0.5 ) );
 					float shadow_stepSize = stepSize * pow(2.0, shadow_lod + 1.0);
-					vec3 shadow_sampleUVW = curUVW + uShadowRayDirection * ( float(i) * shadow_stepSize );
+					vec3 shadow_sampleUVW = curUVW + (uShadowRayDirection / uCropExtent) * ( float(i) * shadow_stepSize );
 					float shadow_value = textureLod(volume_texture, shadow_sampleUVW, shadow_lod).r;
 				#else
 					float shadow_stepSize = curStepSize * 2.5;
-					vec3 shadow_sampleUVW = curUVW + uShadowRayDirection * ( float(i) * shadow_stepSize );
+					vec3 shadow_sampleUVW = curUVW + (uShadowRayDirection / uCropExtent) * ( float(i) * shadow_stepSize );
 					float shadow_value = texture(volume_texture, shadow_sampleUVW).r;
 				#endif
 			
 				#ifdef EMISSION_ABSORPTION_RAW
-					float shadow_parameterStepSize = shadow_stepSize / length(endUVW - startUVW); // parametric step size (scaled to 0..1)
+					float shadow_parameterStepSize = shadow_stepSize / uvwDistance(startUVW, endUVW); // parametric step size (scaled to 0..1)
 					float shadow_distanceStepSize = shadow_parameterStepSize * (endDepth - startDepth); // distance of a step
 					float shadow_alpha = (1.0 - exp( - (pow(transferFunctionRaw( shadow_value ).a * ABSORPTION_SCALE, 2.0) ) * shadow_distanceStepSize  * 2.0 ));
 				#else